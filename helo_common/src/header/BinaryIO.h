@@ -0,0 +1,116 @@
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+/**
+ * @file BinaryIO.h
+ *
+ * This file contains small helpers for reading and writing the binary files of HELO
+ * (cluster models, caches, checkpoints). All values are written in native byte order,
+ * every file format stores a byte order mark to detect foreign files.
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/// The value written to binary file headers to detect byte order mismatch
+///
+#define HELO_BYTE_ORDER_MARK 0x01020304u
+
+/**
+ * Writes a trivially copyable value to a binary stream
+ *
+ * @param[in,out] os The stream to write to
+ * @param[in] value The value to write
+ */
+template<typename T>
+inline void writePod(std::ostream& os,const T& value){
+	os.write(reinterpret_cast<const char*>(&value),sizeof(T));
+}
+
+/**
+ * Writes an array of trivially copyable values to a binary stream
+ *
+ * @param[in,out] os The stream to write to
+ * @param[in] values Pointer to the first value
+ * @param[in] count The number of values to write
+ */
+template<typename T>
+inline void writePodArray(std::ostream& os,const T* values,size_t count){
+	if(count>0) os.write(reinterpret_cast<const char*>(values),sizeof(T)*count);
+}
+
+/**
+ * Writes zero bytes until the stream position is aligned to 8 bytes
+ *
+ * @param[in,out] os The stream to write to
+ * @param[in] pos The current position (number of bytes already written)
+ * @return The aligned position
+ */
+inline uint64_t writePadding(std::ostream& os,uint64_t pos){
+	static const char zeros[8]={0};
+	size_t pad=(8-pos%8)%8;
+	os.write(zeros,pad);
+	return pos+pad;
+}
+
+/**
+ * Reads a trivially copyable value from a binary stream
+ *
+ * @param[in,out] is The stream to read from
+ * @return The read value
+ * @throws std::runtime_error if the stream ended before the value could be read
+ */
+template<typename T>
+inline T readPod(std::istream& is){
+	T value;
+	is.read(reinterpret_cast<char*>(&value),sizeof(T));
+	if(is.gcount()!=(std::streamsize)sizeof(T)) throw std::runtime_error("Unexpected end of binary file!");
+	return value;
+}
+
+/**
+ * Reads an array of trivially copyable values from a binary stream
+ *
+ * @param[in,out] is The stream to read from
+ * @param[out] values Pointer to the first value to fill
+ * @param[in] count The number of values to read
+ * @throws std::runtime_error if the stream ended before all values could be read
+ */
+template<typename T>
+inline void readPodArray(std::istream& is,T* values,size_t count){
+	if(count==0) return;
+	is.read(reinterpret_cast<char*>(values),sizeof(T)*count);
+	if(is.gcount()!=(std::streamsize)(sizeof(T)*count)) throw std::runtime_error("Unexpected end of binary file!");
+}
+
+/**
+ * Writes a length prefixed string to a binary stream
+ *
+ * @param[in,out] os The stream to write to
+ * @param[in] str The string to write
+ */
+inline void writeString(std::ostream& os,const std::string& str){
+	writePod<uint32_t>(os,str.size());
+	os.write(str.data(),str.size());
+}
+
+/**
+ * Reads a length prefixed string from a binary stream
+ *
+ * @param[in,out] is The stream to read from
+ * @return The read string
+ * @throws std::runtime_error if the stream ended before the string could be read
+ */
+inline std::string readString(std::istream& is){
+	uint32_t len=readPod<uint32_t>(is);
+	std::string str(len,'\0');
+	readPodArray(is,&str[0],len);
+	return str;
+}
+
+#endif
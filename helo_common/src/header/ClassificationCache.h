@@ -0,0 +1,87 @@
+#ifndef CLASSIFICATION_CACHE_H
+#define CLASSIFICATION_CACHE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "LogParser.h"
+
+/**
+* @file ClassificationCache.h
+*
+* This file contains the ClassificationCache class.
+* @author Jenei Gábor <jengab@elte.hu>
+*/
+
+/// The number of independently locked parts of the cache
+///
+#define CLASSIFICATION_CACHE_SHARDS 16
+
+/**
+* <p>This class caches the exact matches of recently seen messages: it maps the tokenized body of a message to the
+* cluster it matched. Repeated messages (heartbeats, looping errors) are classified by one hash lookup instead of
+* a template search. The cache has a fixed number of slots, a new entry replaces the entry of the same slot. It is
+* split into shards with separate locks, so it can be used by many threads together.</p>
+*
+* <p>The cached answer must stay the first matching template. ClusterTemplate::join() generalizes a template, so after
+* a join the joined template may not match its cached messages anymore, and it may match messages cached for later
+* templates. Thus an entry is valid only if no template up to the position of its template was joined since the
+* entry was stored. The join epochs of the templates are kept in a Fenwick tree of prefix maximums, so the check is
+* logarithmic. New templates are appended at the end, they don't invalidate any entry.</p>
+*
+* <p>find() and insert() may run concurrently, but invalidate() must not run together with them (ClusterParser calls
+* them under the shared and the exclusive lock of its templates respectively).</p>
+*/
+class ClassificationCache{
+private:
+	struct Entry{
+		std::string Key;
+		int64_t ClusterId;
+		uint32_t Index;
+		uint64_t Epoch;
+		bool Used;
+	};
+
+	struct Shard{
+		std::mutex Mutex;
+		std::vector<Entry> Entries;
+	};
+
+	std::unique_ptr<Shard[]> Shards;
+	size_t ShardSize;
+	std::vector<uint64_t> LastJoin;
+	std::vector<uint64_t> JoinTree;
+	uint64_t Epoch;
+	std::atomic<uint64_t> Hits;
+	std::atomic<uint64_t> Misses;
+	uint64_t getLastJoin(uint32_t) const;
+	Entry& getSlot(const std::string&,std::unique_lock<std::mutex>&);
+
+public:
+	ClassificationCache(size_t);
+	static void makeKey(const std::vector<TokenDescriptor>&,std::string&);
+	bool find(const std::string&,int64_t&);
+	void insert(const std::string&,uint32_t,int64_t);
+	void invalidate(uint32_t);
+	std::string getStatistics() const;
+
+	/**
+	* @return true if the cache has slots (a cache of 0 slots is disabled)
+	*/
+	bool isEnabled() const{return ShardSize>0;}
+
+	/**
+	* @return The number of messages found in the cache
+	*/
+	uint64_t getHits() const{return Hits;}
+
+	/**
+	* @return The number of messages not found in the cache
+	*/
+	uint64_t getMisses() const{return Misses;}
+};
+
+#endif
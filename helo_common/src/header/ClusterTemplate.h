@@ -0,0 +1,104 @@
+#ifndef CLUSTER_TEMPLATE_H
+#define CLUSTER_TEMPLATE_H
+
+#include <string>
+#include <sstream>
+#include <cstdint>
+#include "LogParser.h"
+#include "TokenTable.h"
+
+/**
+* @file ClusterTemplate.h
+*
+* This file contains the ClusterTemplate class.
+* @author Jenei Gábor <jengab@elte.hu>
+*/
+
+/**
+* This class represents a token of a message that is matched against the templates.
+* It stores the id of the token in the TokenTable of the templates (it is
+* TokenTable::UnknownTokenId if the token isn't used by any template) and the type of the token.
+*/
+class MessageToken{
+public:
+	/// The id of the token in the TokenTable
+	///
+	uint32_t Id;
+
+	/// The type of the token
+	///
+	wordtype TypeOfToken;
+
+	/**
+	* Constructor
+	* @param[in] Id The id of the token
+	* @param[in] TypeOfToken The type of the token
+	*/
+	MessageToken(uint32_t Id,wordtype TypeOfToken):Id(Id),TypeOfToken(TypeOfToken){}
+};
+
+/**
+* This class represents a cluster that only has a template and
+* some statistics stored(average line length, goodness). The
+* represented clusters have an assigned ID (identification number)
+* as well. The template is stored as an array of token ids, the tokens
+* themselves are stored in a TokenTable shared by all templates.
+*/
+class ClusterTemplate{
+private:
+	std::vector<uint32_t> Template;
+	double goodness;
+	double AvgLen;
+	int64_t id;
+
+public:
+	
+	/**
+	* Constructor
+	* @param[in] Template The starting template of the cluster (ids of the tokens)
+	* @param[in] goodness The starting goodness value
+	* @param[in] AvgLen The formerly calculated average line length of the cluster
+	* @param[in] id The id number to use in the cluster (set 0 if you don't know it yet)
+	*/
+	ClusterTemplate(std::vector<uint32_t> Template,
+		double goodness,double AvgLen,int64_t id):Template(std::move(Template)),
+		goodness(goodness),AvgLen(AvgLen),id(id){}
+	
+	/**
+	* @return The current average line length of the cluster.
+	*/
+	double getAvgLen() const{return AvgLen;}
+	
+	/**
+	* @return The current goodness of the cluster.
+	*/
+	double getGoodness() const{return goodness;}
+	
+	/**
+	* @return A unique number that identifies the cluster briefly
+	*/
+	int64_t getId() const{return id;}
+	
+	/**
+	* @return The current cluster template (ids of the tokens)
+	*/
+	const std::vector<uint32_t>& getTemplate() const{return Template;}
+
+	/**
+	* This method sets the ID of the cluster (sometimes it gets known only after
+	* building the object)
+	*
+	* @param[in] id The identifier number to set
+	*/
+	void setId(int64_t id){this->id=id;}
+	
+	double getGoodness(const std::vector<MessageToken>&) const;
+	bool match(const std::vector<MessageToken>&) const;
+	void join(const std::vector<MessageToken>&,double,const TokenTable&);
+	std::string getTemplateStr(const TokenTable&) const;
+	std::string getValueStr(const TokenTable&) const;
+	std::string getUpdateStr(const TokenTable&) const;
+	static std::vector<uint32_t> parseTemplate(const std::string&,TokenTable&);
+};
+
+#endif
@@ -3,11 +3,16 @@
 
 #include <string>
 #include <list>
+#include <deque>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <sstream>
 #include <memory>
 #include <locale>
+#include <regex>
+#include "Utf8.h"
 
 /**
  * @file LogParser.h
@@ -26,7 +31,7 @@ enum wordtype{
 
 /**
  * This class represents a token, it stores the token type and the actual string (value)
- * of the token
+ * of the token. The string is stored in UTF-8 encoding.
  */
 class TokenDescriptor{
 public:
@@ -36,7 +41,7 @@ public:
 	 * @param[in] type The determined token type
 	 * @see LogParser::parse()
 	 */
-	TokenDescriptor(std::wstring str,wordtype type):TokenString(str),TypeOfToken(type){}
+	TokenDescriptor(std::string str,wordtype type):TokenString(str),TypeOfToken(type){}
 
 	/**
 	 * This constructor shouldn't be used generally, it is only for search,
@@ -46,12 +51,12 @@ public:
 	 *
 	 * @param[in] str The token string to use
 	 */
-	TokenDescriptor(std::wstring str):TokenString(str),TypeOfToken(Word){}
+	TokenDescriptor(std::string str):TokenString(str),TypeOfToken(Word){}
 
 	/**
-	 * The actual value (string of token)
+	 * The actual value (string of token in UTF-8)
 	 */
-	std::wstring TokenString;
+	std::string TokenString;
 
 	/**
 	 * The set type of token
@@ -60,24 +65,123 @@ public:
 	wordtype TypeOfToken;
 };
 
+/**
+ * This class represents a token string that is not copied (it points into a message buffer),
+ * it is used to look up tokens in the dictionary without making a TokenDescriptor.
+ */
+class TokenKey{
+public:
+	/// The first byte of the token
+	///
+	const char* Data;
+
+	/// The number of bytes of the token
+	///
+	size_t Length;
+
+	/**
+	 * @param[in] Data The first byte of the token
+	 * @param[in] Length The number of bytes of the token
+	 */
+	TokenKey(const char* Data,size_t Length):Data(Data),Length(Length){}
+};
+
 /**
  * This class only implements a comparison for TokenDescriptor smart pointers.
- * The comparison is an ABC sort according to the token strings.
+ * The comparison is an ABC sort according to the token strings. The comparator is
+ * transparent, thus a TokenKey can be searched in a Dictionary directly.
  */
 class WordComparator{
 public:
+	/// Marks the comparator transparent (heterogeneous lookup)
+	///
+	typedef void is_transparent;
 
 	/**
-	 * This is the only method of this class, it implements the comparison between TokenDescriptor
+	 * This method implements the comparison between TokenDescriptor
 	 * smart pointers, it is based on the token strings.
 	 *
 	 * @param[in] first The first token to compare
 	 * @param[in] second The second token to compare
 	 * @return true if first token string precedes the second one according to the ABC sort
 	 */
-	bool operator()(const std::shared_ptr<TokenDescriptor> first,const std::shared_ptr<TokenDescriptor> second) const {
+	bool operator()(const std::shared_ptr<TokenDescriptor>& first,const std::shared_ptr<TokenDescriptor>& second) const {
 		return first->TokenString<second->TokenString;
 	}
+
+	/**
+	 * @param[in] first The token to compare
+	 * @param[in] second The token string to compare
+	 * @return true if first token string precedes the second one according to the ABC sort
+	 */
+	bool operator()(const std::shared_ptr<TokenDescriptor>& first,const TokenKey& second) const {
+		return first->TokenString.compare(0,std::string::npos,second.Data,second.Length)<0;
+	}
+
+	/**
+	 * @param[in] first The token string to compare
+	 * @param[in] second The token to compare
+	 * @return true if first token string precedes the second one according to the ABC sort
+	 */
+	bool operator()(const TokenKey& first,const std::shared_ptr<TokenDescriptor>& second) const {
+		return second->TokenString.compare(0,std::string::npos,first.Data,first.Length)>0;
+	}
+};
+
+/**
+ * This class represents a token of a message as a view (offset and length) into the
+ * buffer of the message (see TokenizedMessage), thus the token string is not copied.
+ */
+class TokenView{
+public:
+	/// The offset of the first byte of the token in the buffer
+	///
+	size_t Offset;
+
+	/// The number of bytes of the token
+	///
+	size_t Length;
+
+	/// The type of the token (see LogParser::parse())
+	///
+	wordtype TypeOfToken;
+
+	/**
+	 * @param[in] Offset The offset of the first byte of the token in the buffer
+	 * @param[in] Length The number of bytes of the token
+	 */
+	TokenView(size_t Offset,size_t Length):Offset(Offset),Length(Length),TypeOfToken(Word){}
+};
+
+/**
+ * This class represents a tokenized message (see LogParser::tokenize()). The object can be reused
+ * for several messages, thus its buffers are allocated only once.
+ */
+class TokenizedMessage{
+public:
+	/// The last line read from the input in UTF-8 (see LogParser::readMessage())
+	///
+	std::string Line;
+
+	/// The message without the header, its tokens are separated by one space
+	///
+	std::string Buffer;
+
+	/// The tokens of the message, they point into Buffer
+	///
+	std::vector<TokenView> Tokens;
+
+	/**
+	 * @param[in] i The index of the token
+	 * @return A copy of the string of the i-th token
+	 */
+	std::string getToken(size_t i) const{return Buffer.substr(Tokens[i].Offset,Tokens[i].Length);}
+
+	/**
+	 * @param[in] i The index of the token
+	 * @return The string of the i-th token without copying it
+	 */
+	TokenKey getKey(size_t i) const{return TokenKey(Buffer.data()+Tokens[i].Offset,Tokens[i].Length);}
 };
 
 /**
@@ -106,11 +210,87 @@ typedef std::set<std::shared_ptr<TokenDescriptor>,WordComparator> Dictionary;
  */
 typedef std::shared_ptr<std::set<std::shared_ptr<TokenDescriptor>,WordComparator>> DictionaryPtr;
 
+/**
+ * \c typedef for the storage of Number tokens that are kept out of the Dictionary (see LogParser::setNumberTable()).
+ * The elements of a std::deque never move, thus the lines can point to them. All the number tokens of the lines share
+ * the ownership of the table, it is released when the last line (or template) that refers to a number is released.
+ */
+typedef std::deque<TokenDescriptor> NumberTable;
+
+/**
+ * This class implements hashing of tokens by their strings (it is used to find the stored numbers)
+ */
+class TokenStringHash{
+public:
+	/**
+	 * @param[in] token The token to hash
+	 * @return The hash value of the token string
+	 */
+	size_t operator()(const TokenDescriptor* token) const {
+		return std::hash<std::string>()(token->TokenString);
+	}
+};
+
+/**
+ * This class compares tokens by their strings (it is used to find the stored numbers)
+ */
+class TokenStringEqual{
+public:
+	/**
+	 * @param[in] first The first token to compare
+	 * @param[in] second The second token to compare
+	 * @return true if the token strings are the same
+	 */
+	bool operator()(const TokenDescriptor* first,const TokenDescriptor* second) const {
+		return first->TokenString==second->TokenString;
+	}
+};
+
+/**
+ * \c typedef for the multiplicities of deduplicated lines. Only the lines that occurred more than once
+ * are stored, the weight of every other line is 1.
+ */
+typedef std::unordered_map<const ArrayOfWords*,size_t> LineWeights;
+
+/**
+ * This class implements the hashing of lines for deduplication. As the tokens of the lines are stored
+ * in the dictionary, the address of a token identifies its string, thus the addresses are hashed.
+ */
+class LineHash{
+public:
+	/**
+	 * @param[in] line The line to hash
+	 * @return The hash value of the line
+	 */
+	size_t operator()(const ArrayOfWords* line) const {
+		size_t ret=line->size();
+		for(const std::shared_ptr<TokenDescriptor>& ActWord:*line){
+			ret^=std::hash<const TokenDescriptor*>()(ActWord.get())+0x9e3779b9+(ret<<6)+(ret>>2);
+		}
+		return ret;
+	}
+};
+
+/**
+ * This class compares lines for deduplication (two lines are equal if they consist of the same tokens)
+ */
+class LineEqual{
+public:
+	/**
+	 * @param[in] first The first line to compare
+	 * @param[in] second The second line to compare
+	 * @return true if the lines consist of the same tokens
+	 */
+	bool operator()(const ArrayOfWords* first,const ArrayOfWords* second) const {
+		return *first==*second;
+	}
+};
+
 /**
  * @details <p>This class reads and preprocesses a log. The log can be given in the
  * form of any input stream. </p>
- * <p>It handles <b>wide streams</b>, thus we can handle also national characters
- * in the input. </p>
+ * <p>It reads <b>UTF-8 streams</b>, the tokens are stored in UTF-8 as well. National characters
+ * are classified by the global locale (ASCII characters are classified without it, see Utf8.h). </p>
  * <p>After reading a line we <b>divide it to tokens</b>, and then we parse each token.
  * <b>Parsing</b> rules can be set by regular expressions, or else we have a default built in parsing.
  * Here parsing means only the classification and preprocess of the identified tokens.
@@ -130,16 +310,51 @@ protected:
 	std::shared_ptr<ListOfLines> Content;
 	size_t HeaderLen;
 	DictionaryPtr dict;
-	std::wstring regexp;
-	virtual void ProcessHybrid(std::wstring&) const;
+	std::string regexp;
+	std::shared_ptr<const std::wregex> Expr;
+	bool Deduplicate;
+	std::shared_ptr<LineWeights> Weights;
+	std::unordered_set<const ArrayOfWords*,LineHash,LineEqual> DistinctLines;
+	std::shared_ptr<NumberTable> Numbers;
+	std::unordered_set<TokenDescriptor*,TokenStringHash,TokenStringEqual> NumberIndex;
+	TokenDescriptor NumberProbe;
+	size_t MessageCount;
+	virtual void ProcessHybrid(const std::string&,TokenView&) const;
+	std::shared_ptr<TokenDescriptor> intern(const TokenKey&,wordtype);
+	void addLine(ArrayOfWords&&);
 
 public:
-	LogParser(size_t,const std::wstring&);
+	LogParser(size_t,const std::string&);
 	const DictionaryPtr getDictionary() const;
 	const std::shared_ptr<ListOfLines> getContent() const;
+	void setDeduplication(bool);
+	void setNumberTable(bool);
+
+	/**
+	 * @return The table of the numbers if they are kept out of the dictionary (see setNumberTable()), NULL otherwise
+	 */
+	const std::shared_ptr<const NumberTable> getNumberTable() const{return Numbers;}
+
+	/**
+	 * @return The multiplicities of the repeated lines if deduplication is switched on (see setDeduplication()),
+	 * NULL otherwise
+	 */
+	const std::shared_ptr<const LineWeights> getWeights() const{return Weights;}
+
+	/**
+	 * @return The number of messages added so far (including the duplicates)
+	 */
+	size_t getMessageCount() const{return MessageCount;}
 
 
-	wordtype parse(std::wstring&) const;
+	wordtype parse(std::string&) const;
+	wordtype parse(const std::string&,TokenView&) const;
+	bool tokenize(const std::string&,TokenizedMessage&) const;
+	bool tokenize(const std::string&,std::vector<TokenDescriptor>&) const;
+	bool readMessage(std::istream&,TokenizedMessage&) const;
+	bool readMessage(std::istream&,std::vector<TokenDescriptor>&) const;
+	void addMessage(const TokenizedMessage&);
+	void addMessage(std::vector<TokenDescriptor>&);
 
 	/// The XML tag used in the cluster output
 	/// to denote the end/beginning of a template description
@@ -185,7 +400,7 @@ public:
 	///
 	static const wchar_t* TokenTypeAttributeName;
 
-	friend std::wistream& operator>>(std::wistream& is,LogParser& parser);
+	friend std::istream& operator>>(std::istream& is,LogParser& parser);
 	friend std::wostream& operator<<(std::wostream&,const LogParser&);
 
 };
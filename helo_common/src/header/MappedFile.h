@@ -0,0 +1,43 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @file MappedFile.h
+ *
+ * This file contains the MappedFile class
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/**
+ * This class maps a whole file read-only into the memory. On POSIX systems
+ * mmap is used, thus the file is loaded lazily by the operating system, and
+ * the pages can be shared between processes. On other systems the file is
+ * simply read into a buffer.
+ */
+class MappedFile{
+private:
+	const char* Data;
+	size_t Size;
+	std::vector<char> Buffer;
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+public:
+	MappedFile(const std::string&);
+	~MappedFile();
+
+	/**
+	 * @return Pointer to the first byte of the mapped file
+	 */
+	const char* data() const{return Data;}
+
+	/**
+	 * @return The size of the mapped file in bytes
+	 */
+	size_t size() const{return Size;}
+};
+
+#endif
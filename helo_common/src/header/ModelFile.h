@@ -0,0 +1,234 @@
+#ifndef MODEL_FILE_H
+#define MODEL_FILE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <cstdint>
+#include <stdexcept>
+#include "LogParser.h"
+#include "MappedFile.h"
+
+/**
+ * @file ModelFile.h
+ *
+ * This file contains the binary cluster model format, and the classes that
+ * can write (ModelWriter) and read (ModelReader) it.
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/// The current version of the binary cluster model format
+///
+#define MODEL_FILE_VERSION 4
+
+/// The flag of the model header that is set if the model has the generation of its database (see ModelWriter::setGeneration())
+///
+#define MODEL_FLAG_GENERATION 1
+
+/**
+ * This class represents an exception that is thrown if a binary cluster model can't be
+ * opened or it is invalid.
+ */
+class ModelError:public std::runtime_error{
+public:
+	/**
+	 * Constructor
+	 * @param[in] msg The error message
+	 */
+	ModelError(const std::string& msg):std::runtime_error(msg){}
+};
+
+/**
+ * The header at the beginning of a binary cluster model file. Every offset is
+ * counted from the beginning of the file, and every section is aligned to 8 bytes.
+ */
+struct ModelHeader{
+	char Magic[8];
+	uint32_t Version;
+	uint32_t ByteOrder;
+	uint32_t Flags;
+	uint32_t Reserved;
+	uint64_t TokenCount;
+	uint64_t ClusterCount;
+	uint64_t TemplateTokenCount;
+	uint64_t StringTableSize;
+	uint64_t TokenTableOffset;
+	uint64_t ClusterTableOffset;
+	uint64_t TemplateTableOffset;
+	uint64_t StringTableOffset;
+	uint64_t IndexTemplateCount;
+	uint64_t IndexNodeCount;
+	uint64_t IndexEdgeCount;
+	uint64_t IndexPostingCount;
+	uint64_t IndexListSize;
+	uint64_t IndexNodeOffset;
+	uint64_t IndexEdgeOffset;
+	uint64_t IndexPostingOffset;
+	uint64_t IndexListOffset;
+	uint64_t Generation;
+	uint64_t FileSize;
+};
+
+/**
+ * An interned token of the model. The token string is stored in the string table
+ * in UTF-8 encoding (it is not terminated by zero).
+ */
+struct ModelToken{
+	uint64_t StringOffset;
+	uint32_t StringLength;
+	uint32_t Type;
+};
+
+/**
+ * A cluster of the model. Its template is stored in the template table as
+ * TokenCount token ids starting at FirstToken.
+ */
+struct ModelCluster{
+	int64_t Id;
+	double Goodness;
+	double AvgLen;
+	uint64_t FirstToken;
+	uint32_t TokenCount;
+	uint32_t Reserved;
+};
+
+/**
+ * A node of the prebuilt template trie (see TemplateIndex). Its children are ChildCount edges starting
+ * at FirstChild, sorted by token id. The templates that end at the node (Complete) and the templates
+ * that continue with +n (Open) are ranges of the list table, sorted by position.
+ */
+struct ModelIndexNode{
+	uint32_t FirstChild;
+	uint32_t ChildCount;
+	uint32_t FirstComplete;
+	uint32_t CompleteCount;
+	uint32_t FirstOpen;
+	uint32_t OpenCount;
+};
+
+/**
+ * An edge of the prebuilt template trie: the child node that belongs to a token.
+ */
+struct ModelIndexEdge{
+	uint32_t Token;
+	uint32_t Node;
+};
+
+/**
+ * A posting list of the prebuilt inverted index: the positions of the templates that have the
+ * token at the position of the key (see TemplateIndex). The postings are sorted by key, the lists are
+ * Count entries of the list table starting at First, sorted by position.
+ */
+struct ModelPosting{
+	uint64_t Key;
+	uint32_t First;
+	uint32_t Count;
+};
+
+/**
+ * The arrays of a prebuilt template index. They are either in a mapped model (see ModelReader::getIndex())
+ * or built in the memory by TemplateIndex::build(). The nodes are empty if there is no index, otherwise the first
+ * node is the root.
+ */
+struct ModelIndex{
+	size_t TemplateCount;
+	const ModelIndexNode* Nodes;
+	size_t NodeCount;
+	const ModelIndexEdge* Edges;
+	size_t EdgeCount;
+	const ModelPosting* Postings;
+	size_t PostingCount;
+	const uint32_t* Lists;
+	size_t ListSize;
+};
+
+/**
+ * This class builds a binary cluster model from cluster templates and writes it to a stream.
+ * Tokens are interned, thus each distinct token string is stored only once, and the special tokens
+ * (*, +d, +n) have the same ids as in a TokenTable. The template index of the clusters is built
+ * on writing, thus the online algorithm can map it instead of building it on every start.
+ */
+class ModelWriter{
+private:
+	std::vector<std::string> TokenStrings;
+	std::vector<wordtype> TokenTypes;
+	std::unordered_map<std::string,uint32_t> TokenIds;
+	std::vector<ModelCluster> Clusters;
+	std::vector<uint32_t> TemplateTokens;
+	uint32_t Flags;
+	uint64_t Generation;
+
+	uint32_t internToken(const TokenDescriptor&);
+
+public:
+	ModelWriter();
+	void addCluster(const ArrayOfWords&,double,double,int64_t);
+	void setGeneration(uint64_t);
+
+	/**
+	 * @return The number of clusters added so far
+	 */
+	size_t getClusterCount() const{return Clusters.size();}
+
+	void write(std::ostream&) const;
+	void save(const std::string&) const;
+};
+
+/**
+ * This class gives read access to a binary cluster model. The model file is memory mapped,
+ * nothing is copied on opening except the validation of the file's structure.
+ */
+class ModelReader{
+private:
+	std::shared_ptr<MappedFile> File;
+	const char* Data;
+	size_t Size;
+	const ModelHeader* Header;
+	const ModelToken* Tokens;
+	const ModelCluster* ClusterTable;
+	const uint32_t* TemplateTable;
+	const char* StringTable;
+
+	void validate();
+
+public:
+	ModelReader(const std::string&);
+	ModelReader(const char*,size_t);
+
+	/**
+	 * @return The number of distinct tokens in the model
+	 */
+	size_t getTokenCount() const{return Header->TokenCount;}
+
+	/**
+	 * @return The number of clusters in the model
+	 */
+	size_t getClusterCount() const{return Header->ClusterCount;}
+
+	/**
+	 * @param[in] i The index of the cluster (0 <= i < getClusterCount())
+	 * @return The cluster record
+	 */
+	const ModelCluster& getCluster(size_t i) const{return ClusterTable[i];}
+
+	/**
+	 * @param[in] i The index of the cluster (0 <= i < getClusterCount())
+	 * @return Pointer to the token ids of the cluster's template (getCluster(i).TokenCount ids)
+	 */
+	const uint32_t* getTemplate(size_t i) const{return TemplateTable+ClusterTable[i].FirstToken;}
+
+	/**
+	 * @param[in] id The id of the token (0 <= id < getTokenCount())
+	 * @return The type of the token
+	 */
+	wordtype getTokenType(uint32_t id) const{return (wordtype)Tokens[id].Type;}
+
+	std::string getTokenString(uint32_t) const;
+	std::wstring getTokenWString(uint32_t) const;
+	ModelIndex getIndex() const;
+	bool getGeneration(uint64_t&) const;
+};
+
+#endif
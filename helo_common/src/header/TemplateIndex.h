@@ -0,0 +1,103 @@
+#ifndef TEMPLATE_INDEX_H
+#define TEMPLATE_INDEX_H
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include "ClusterTemplate.h"
+#include "ModelFile.h"
+
+/**
+* @file TemplateIndex.h
+*
+* This file contains the TemplateIndex class.
+* @author Jenei Gábor <jengab@elte.hu>
+*/
+
+/**
+* <p>This class indexes an array of cluster templates, so that the template of a message can be found
+* without testing every template. The templates are referred to by their position in the array.</p>
+*
+* <p>Exact matches are found in a prefix trie over the token positions. Each node has a child for every
+* constant token, for * and for +d that follows it in a template. A message walks the trie along its own tokens,
+* and along the * child (and the +d child for numbers) too, thus only the templates that can match it are
+* visited. A template ending with +n is stored at the node of the +n, and it matches every longer message.</p>
+*
+* <p>The best-goodness fallback uses an inverted index from (position, token) pairs to the templates. The
+* common tokens of a message and every template are counted by walking the lists of the message's tokens, thus
+* only the templates that share a token with the message are candidates (the others have zero goodness).</p>
+*
+* <p>The index has two parts. The base is flat: the nodes, the edges sorted by token, the postings sorted by key
+* and the lists of positions are arrays (see ModelIndex). It is either built at once by build(), or it is mapped
+* from a binary cluster model by attach() (ModelWriter builds it offline). The templates inserted later are
+* stored in a small trie whose nodes keep their children sorted by token, and in a hashed inverted index.
+* Removing a template of the base only marks it as removed, its entries are skipped by the lookups.</p>
+*
+* <p>The results are the same as testing the templates one by one in the order of the array: the first matching
+* template, or the first one of the highest goodness. ClusterTemplate::join() changes a template, so it must be
+* removed before and inserted again after the join. The nodes and the postings of the inserted templates that are
+* left empty by a removal are freed. This class is <b>NOT thread-safe</b> for modifications, but the lookups
+* can run concurrently.</p>
+*/
+class TemplateIndex{
+private:
+	struct Node;
+	typedef std::pair<uint32_t,std::unique_ptr<Node> > ChildEdge;
+	struct Node{
+		std::vector<ChildEdge> Children;
+		std::vector<uint32_t> Complete;
+		std::vector<uint32_t> Open;
+	};
+
+	ModelIndex Base;
+	std::shared_ptr<const ModelReader> Model;
+	std::vector<ModelIndexNode> BaseNodes;
+	std::vector<ModelIndexEdge> BaseEdges;
+	std::vector<ModelPosting> BasePostings;
+	std::vector<uint32_t> BaseLists;
+	std::vector<bool> Removed;
+
+	Node Root;
+	std::unordered_map<uint64_t,std::vector<uint32_t> > Postings;
+
+	/**
+	* @param[in] Index The position of a template
+	* @return true if the template is in the base, but it was removed
+	*/
+	bool isRemoved(uint32_t Index) const{return Index<Removed.size() && Removed[Index];}
+
+	void clear();
+	void buildTrie(const std::vector<ClusterTemplate>&);
+	void buildPostings(const std::vector<ClusterTemplate>&);
+	static uint64_t getKey(size_t,uint32_t);
+	static size_t getNodeCount(const Node&);
+	static Node* findChild(const Node&,uint32_t);
+	const ModelIndexNode* findChild(const ModelIndexNode&,uint32_t) const;
+	void keepFirst(uint32_t,uint32_t,uint32_t&) const;
+	void findMatch(const Node&,const std::vector<MessageToken>&,size_t,uint32_t&) const;
+	void findMatch(const ModelIndexNode&,const std::vector<MessageToken>&,size_t,uint32_t&) const;
+	void count(size_t,uint32_t,std::vector<uint32_t>&,std::vector<uint32_t>&) const;
+
+public:
+	/// The value returned if no template is found
+	///
+	static const uint32_t NoMatch=0xFFFFFFFF;
+
+	TemplateIndex();
+	void build(const std::vector<ClusterTemplate>&);
+	void attach(const ModelReader&);
+
+	/**
+	* @return The arrays of the base (see build() and attach())
+	*/
+	const ModelIndex& getBase() const{return Base;}
+
+	void insert(uint32_t,const ClusterTemplate&);
+	void remove(uint32_t,const ClusterTemplate&);
+	uint32_t findMatch(const std::vector<MessageToken>&) const;
+	uint32_t findBest(const std::vector<MessageToken>&,const std::vector<ClusterTemplate>&,double&) const;
+	size_t getNodeCount() const;
+};
+
+#endif
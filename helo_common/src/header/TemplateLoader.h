@@ -0,0 +1,69 @@
+#ifndef TEMPLATE_LOADER_H
+#define TEMPLATE_LOADER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "ClusterTemplate.h"
+#include "ModelFile.h"
+
+/**
+* @file TemplateLoader.h
+*
+* This file contains the TemplateLoader class.
+* @author Jenei Gábor <jengab@elte.hu>
+*/
+
+/**
+* <p>This class collects the cluster templates of the online algorithm from a binary cluster model
+* and from the rows of the clusters table. The model is only a snapshot: the online algorithm keeps
+* updating the database, so the database is the master copy. A row replaces the cluster of the model
+* with the same id if the row differs from it, the other rows are added as new clusters.</p>
+*
+* <p>The tokens of the model keep their types, the tokens that are only in the database are typed
+* as ClusterTemplate::parseTemplate() does.</p>
+*
+* <p>The prebuilt template index of the model (see TemplateIndex::attach()) can be used if the loaded
+* templates have the same positions and token ids as in the model. Then only the replaced clusters
+* and the added ones have to be indexed.</p>
+*
+* <p>The clusters are found by their ids with a binary search while the ids are ascending (the offline algorithm
+* writes them so), the ids are only hashed if they are out of order.</p>
+*/
+class TemplateLoader{
+private:
+	TokenTable& Tokens;
+	std::vector<ClusterTemplate>& Clusters;
+	std::unordered_map<int64_t,size_t> Positions;
+	std::vector<size_t> Replaced;
+	int64_t MaxId;
+	bool ModelIndexed;
+	bool Sorted;
+
+	void updateMaxId(int64_t id){if(id>MaxId) MaxId=id;}
+	void addPosition(int64_t);
+	size_t findPosition(int64_t) const;
+
+public:
+	TemplateLoader(TokenTable&,std::vector<ClusterTemplate>&);
+	void loadModel(const ModelReader&);
+	bool addRow(int64_t,const std::string&,double,double);
+
+	/**
+	* @return The highest cluster id seen so far (0 if there was none)
+	*/
+	int64_t getMaxId() const{return MaxId;}
+
+	/**
+	* @return true if the prebuilt index of the loaded model can be used for the loaded templates
+	*/
+	bool isModelIndexed() const{return ModelIndexed;}
+
+	/**
+	* @return The positions of the clusters of the model that were replaced by a row
+	*/
+	const std::vector<size_t>& getReplaced() const{return Replaced;}
+};
+
+#endif
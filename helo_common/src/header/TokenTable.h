@@ -0,0 +1,62 @@
+#ifndef TOKEN_TABLE_H
+#define TOKEN_TABLE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "LogParser.h"
+
+/**
+ * @file TokenTable.h
+ *
+ * This file contains the TokenTable class
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/**
+ * This class interns tokens, and assigns a small integer id to each distinct token string.
+ * Templates can be stored as arrays of ids, and two tokens can be compared by comparing their ids.
+ * The special template tokens (*, +d, +n) always have the same ids.
+ * This class is <b>NOT thread-safe</b>.
+ */
+class TokenTable{
+private:
+	std::vector<TokenDescriptor> Tokens;
+	std::unordered_map<std::string,uint32_t> Ids;
+
+public:
+	/// The id of the * token (variable word)
+	///
+	static const uint32_t AnyTokenId=0;
+
+	/// The id of the +d token (variable number)
+	///
+	static const uint32_t NumberTokenId=1;
+
+	/// The id of the +n token (variable line ending)
+	///
+	static const uint32_t EndTokenId=2;
+
+	/// The id that is given for tokens that are not in the table
+	///
+	static const uint32_t UnknownTokenId=0xFFFFFFFF;
+
+	TokenTable();
+	uint32_t intern(const std::string&,wordtype);
+	uint32_t find(const std::string&) const;
+	void reserve(size_t);
+
+	/**
+	 * @param[in] id The id of the token (it must be a valid id)
+	 * @return The token with the given id
+	 */
+	const TokenDescriptor& operator[](uint32_t id) const{return Tokens[id];}
+
+	/**
+	 * @return The number of stored tokens
+	 */
+	size_t size() const{return Tokens.size();}
+};
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cwctype>
+
+/**
+ * @file Utf8.h
+ *
+ * This file contains the helpers to handle the UTF-8 encoded strings of HELO. The tokens are
+ * stored in UTF-8, characters are decoded only for classification, and strings are converted to
+ * wide strings only where an interface needs them (the XML documents and the regular expressions).
+ * ASCII characters are classified without the locale, only the other code points are classified
+ * by the global locale.
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/// The code point returned for invalid UTF-8 sequences
+///
+#define UTF8_REPLACEMENT_CHAR 0xFFFDu
+
+/**
+ * Decodes the character at the given position of a UTF-8 string, and moves the position
+ * after it. An invalid or truncated sequence is read as one UTF8_REPLACEMENT_CHAR byte.
+ *
+ * @param[in] Data The UTF-8 string
+ * @param[in] Length The length of the string in bytes
+ * @param[in,out] Pos The position of the character (it must be less than Length)
+ * @return The code point of the character
+ */
+inline uint32_t decodeUtf8(const char* Data,size_t Length,size_t& Pos){
+	unsigned char Lead=Data[Pos];
+	if(Lead<0x80){
+		++Pos;
+		return Lead;
+	}
+
+	size_t Count=0;
+	uint32_t CodePoint=0;
+	if((Lead & 0xE0)==0xC0){
+		Count=1;
+		CodePoint=Lead & 0x1F;
+	}
+	else if((Lead & 0xF0)==0xE0){
+		Count=2;
+		CodePoint=Lead & 0x0F;
+	}
+	else if((Lead & 0xF8)==0xF0){
+		Count=3;
+		CodePoint=Lead & 0x07;
+	}
+	if(Count==0 || Pos+Count>=Length){
+		++Pos;
+		return UTF8_REPLACEMENT_CHAR;
+	}
+
+	for(size_t i=1;i<=Count;++i){
+		unsigned char Next=Data[Pos+i];
+		if((Next & 0xC0)!=0x80){
+			++Pos;
+			return UTF8_REPLACEMENT_CHAR;
+		}
+		CodePoint=(CodePoint<<6) | (Next & 0x3F);
+	}
+
+	static const uint32_t MinCodePoint[4]={0,0x80,0x800,0x10000};
+	if(CodePoint<MinCodePoint[Count] || CodePoint>0x10FFFF || (CodePoint>=0xD800 && CodePoint<=0xDFFF)){
+		++Pos;
+		return UTF8_REPLACEMENT_CHAR;
+	}
+	Pos+=Count+1;
+	return CodePoint;
+}
+
+/**
+ * Appends the UTF-8 encoding of a character to a string
+ *
+ * @param[in,out] str The string to append to
+ * @param[in] CodePoint The code point of the character
+ */
+inline void appendUtf8(std::string& str,uint32_t CodePoint){
+	if(CodePoint<0x80){
+		str.push_back((char)CodePoint);
+	}
+	else if(CodePoint<0x800){
+		str.push_back((char)(0xC0 | (CodePoint>>6)));
+		str.push_back((char)(0x80 | (CodePoint & 0x3F)));
+	}
+	else if(CodePoint<0x10000){
+		str.push_back((char)(0xE0 | (CodePoint>>12)));
+		str.push_back((char)(0x80 | ((CodePoint>>6) & 0x3F)));
+		str.push_back((char)(0x80 | (CodePoint & 0x3F)));
+	}
+	else{
+		str.push_back((char)(0xF0 | (CodePoint>>18)));
+		str.push_back((char)(0x80 | ((CodePoint>>12) & 0x3F)));
+		str.push_back((char)(0x80 | ((CodePoint>>6) & 0x3F)));
+		str.push_back((char)(0x80 | (CodePoint & 0x3F)));
+	}
+}
+
+/**
+ * Converts a UTF-8 string to a wide string (on platforms with 16 bit wchar_t surrogate pairs are used)
+ *
+ * @param[in] Data The UTF-8 string
+ * @param[in] Length The length of the string in bytes
+ * @param[out] Offsets If it isn't NULL, the byte offset of each wide character is stored in it,
+ * followed by Length (thus a range of wide characters can be mapped back to bytes)
+ * @return The converted string
+ */
+inline std::wstring toWide(const char* Data,size_t Length,std::vector<size_t>* Offsets=NULL){
+	std::wstring ret;
+	ret.reserve(Length);
+	if(Offsets!=NULL) Offsets->clear();
+
+	size_t Pos=0;
+	while(Pos<Length){
+		size_t Begin=Pos;
+		uint32_t CodePoint=decodeUtf8(Data,Length,Pos);
+		if(sizeof(wchar_t)==2 && CodePoint>=0x10000){
+			CodePoint-=0x10000;
+			ret.push_back((wchar_t)(0xD800+(CodePoint>>10)));
+			ret.push_back((wchar_t)(0xDC00+(CodePoint & 0x3FF)));
+			if(Offsets!=NULL) Offsets->push_back(Begin);
+		}
+		else{
+			ret.push_back((wchar_t)CodePoint);
+		}
+		if(Offsets!=NULL) Offsets->push_back(Begin);
+	}
+	if(Offsets!=NULL) Offsets->push_back(Length);
+	return ret;
+}
+
+/**
+ * @param[in] str The UTF-8 string
+ * @return The string converted to a wide string
+ */
+inline std::wstring toWide(const std::string& str){
+	return toWide(str.data(),str.size());
+}
+
+/**
+ * @param[in] str The wide string (it can be zero terminated string from an XML document)
+ * @return The string converted to UTF-8
+ */
+inline std::string toUtf8(const wchar_t* str){
+	std::string ret;
+	for(;*str!=L'\0';++str){
+		uint32_t CodePoint=(uint32_t)*str;
+		if(sizeof(wchar_t)==2 && CodePoint>=0xD800 && CodePoint<0xDC00 && str[1]>=0xDC00 && str[1]<0xE000){
+			CodePoint=0x10000+((CodePoint-0xD800)<<10)+((uint32_t)str[1]-0xDC00);
+			++str;
+		}
+		appendUtf8(ret,CodePoint);
+	}
+	return ret;
+}
+
+/**
+ * @param[in] str The wide string
+ * @return The string converted to UTF-8
+ */
+inline std::string toUtf8(const std::wstring& str){
+	return toUtf8(str.c_str());
+}
+
+/**
+ * @param[in] CodePoint The character to classify
+ * @return true if the character is a white space
+ */
+inline bool isSpaceChar(uint32_t CodePoint){
+	if(CodePoint<0x80) return CodePoint==' ' || (CodePoint>='\t' && CodePoint<='\r');
+	return std::iswspace((wint_t)CodePoint)!=0;
+}
+
+/**
+ * @param[in] CodePoint The character to classify
+ * @return true if the character is a digit
+ */
+inline bool isDigitChar(uint32_t CodePoint){
+	if(CodePoint<0x80) return CodePoint>='0' && CodePoint<='9';
+	return std::iswdigit((wint_t)CodePoint)!=0;
+}
+
+/**
+ * @param[in] CodePoint The character to classify
+ * @return true if the character is a letter
+ */
+inline bool isAlphaChar(uint32_t CodePoint){
+	if(CodePoint<0x80) return (CodePoint|0x20)>='a' && (CodePoint|0x20)<='z';
+	return std::iswalpha((wint_t)CodePoint)!=0;
+}
+
+/**
+ * @param[in] CodePoint The character to classify
+ * @return true if the character is a letter or a digit
+ */
+inline bool isAlnumChar(uint32_t CodePoint){
+	if(CodePoint<0x80) return isDigitChar(CodePoint) || isAlphaChar(CodePoint);
+	return std::iswalnum((wint_t)CodePoint)!=0;
+}
+
+#endif
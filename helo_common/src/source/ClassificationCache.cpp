@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include "ClassificationCache.h"
+
+/**
+* Constructor
+*
+* @param[in] Size The number of slots of the cache (0 disables the cache)
+*/
+ClassificationCache::ClassificationCache(size_t Size):Shards(new Shard[CLASSIFICATION_CACHE_SHARDS]),
+  ShardSize((Size+CLASSIFICATION_CACHE_SHARDS-1)/CLASSIFICATION_CACHE_SHARDS),Epoch(0),Hits(0),Misses(0){
+  for(size_t i=0;i<CLASSIFICATION_CACHE_SHARDS;++i) Shards[i].Entries.resize(ShardSize,Entry{std::string(),0,0,0,false});
+}
+
+/**
+* Makes the key of a message: the types and the strings of its tokens (each string is preceded by its length,
+* thus different token lists never have the same key)
+*
+* @param[in] LineVect The tokens of the message
+* @param[out] Key The key of the message
+*/
+void ClassificationCache::makeKey(const std::vector<TokenDescriptor>& LineVect,std::string& Key){
+  Key.clear();
+  for(const TokenDescriptor& ActToken:LineVect){
+    uint32_t Length=ActToken.TokenString.size();
+    Key+=(char)ActToken.TypeOfToken;
+    Key.append(reinterpret_cast<const char*>(&Length),sizeof(Length));
+    Key+=ActToken.TokenString;
+  }
+}
+
+/**
+* Finds the slot of a key, and locks its shard
+*
+* @param[in] Key The key
+* @param[out] lock The lock of the shard
+* @return The slot of the key
+*/
+ClassificationCache::Entry& ClassificationCache::getSlot(const std::string& Key,std::unique_lock<std::mutex>& lock){
+  size_t Hash=std::hash<std::string>()(Key);
+  Shard& ActShard=Shards[Hash%CLASSIFICATION_CACHE_SHARDS];
+  lock=std::unique_lock<std::mutex>(ActShard.Mutex);
+  return ActShard.Entries[(Hash/CLASSIFICATION_CACHE_SHARDS)%ShardSize];
+}
+
+/**
+* @param[in] Index The position of a template
+* @return The latest epoch when a template up to the given position was joined (0 if none of them)
+*/
+uint64_t ClassificationCache::getLastJoin(uint32_t Index) const{
+  uint64_t Last=0;
+  for(size_t k=std::min<size_t>(Index+1,JoinTree.size());k>0;k-=k&(~k+1)) Last=std::max(Last,JoinTree[k-1]);
+  return Last;
+}
+
+/**
+* Looks up the cluster of a message
+*
+* @param[in] Key The key of the message (see makeKey())
+* @param[out] ClusterId The id of the cluster of the message, if it is found
+* @return true if the message is in the cache, and its entry is still valid
+*/
+bool ClassificationCache::find(const std::string& Key,int64_t& ClusterId){
+  if(!isEnabled()) return false;
+
+  std::unique_lock<std::mutex> lock;
+  const Entry& Slot=getSlot(Key,lock);
+  if(Slot.Used && Slot.Key==Key && Slot.Epoch>=getLastJoin(Slot.Index)){
+    ClusterId=Slot.ClusterId;
+    ++Hits;
+    return true;
+  }
+  ++Misses;
+  return false;
+}
+
+/**
+* Stores the cluster of a message (it replaces the former entry of the slot)
+*
+* @param[in] Key The key of the message (see makeKey())
+* @param[in] Index The position of the template that matched the message
+* @param[in] ClusterId The id of the cluster
+*/
+void ClassificationCache::insert(const std::string& Key,uint32_t Index,int64_t ClusterId){
+  if(!isEnabled()) return;
+
+  std::unique_lock<std::mutex> lock;
+  Entry& Slot=getSlot(Key,lock);
+  Slot.Key=Key;
+  Slot.ClusterId=ClusterId;
+  Slot.Index=Index;
+  Slot.Epoch=Epoch;
+  Slot.Used=true;
+}
+
+/**
+* Invalidates the entries that depend on a template, it must be called when the template is joined
+*
+* @param[in] Index The position of the joined template
+*/
+void ClassificationCache::invalidate(uint32_t Index){
+  if(!isEnabled()) return;
+
+  ++Epoch;
+  if(Index>=LastJoin.size()){ //the tree is rebuilt at a doubled size
+    LastJoin.resize(std::max<size_t>(std::max<size_t>(Index+1,LastJoin.size()*2),1024),0);
+    JoinTree.assign(LastJoin.size(),0);
+    for(size_t i=0;i<LastJoin.size();++i){
+      for(size_t k=i+1;LastJoin[i]>0 && k<=JoinTree.size();k+=k&(~k+1)) JoinTree[k-1]=std::max(JoinTree[k-1],LastJoin[i]);
+    }
+  }
+  LastJoin[Index]=Epoch;
+  for(size_t k=Index+1;k<=JoinTree.size();k+=k&(~k+1)) JoinTree[k-1]=Epoch;
+}
+
+/**
+* @return The counters of the cache in a human-readable form
+*/
+std::string ClassificationCache::getStatistics() const{
+  uint64_t ActHits=getHits(),ActMisses=getMisses();
+  std::ostringstream str;
+  str << "Classification cache hits: " << ActHits << ", misses: " << ActMisses;
+  if(ActHits+ActMisses>0) str << ", hit ratio: " << (double)ActHits/(ActHits+ActMisses);
+  str << "\n";
+  return str.str();
+}
@@ -0,0 +1,138 @@
+#include "ClusterTemplate.h"
+
+/**
+* This method tests if a log messages matches the represented cluster template
+*
+* @param[in] msg The syslog message to test
+* @return true if the message matches the template represented by the object, false otherwise
+*/
+bool ClusterTemplate::match(const std::vector<MessageToken>& msg) const{
+  for(size_t i=0;i<msg.size() && i<Template.size();++i){
+    if(Template[i]==TokenTable::AnyTokenId) continue; //Anything matches *
+    if(Template[i]==TokenTable::NumberTokenId && msg[i].TypeOfToken==Number) continue; //accept number matching
+    if(Template[i]==TokenTable::EndTokenId) return true;
+    if(msg[i].Id!=Template[i]) return false;
+  }
+
+  return msg.size()==Template.size();
+}
+
+/**
+* This method calculates the goodness that would be correct if we appended the
+* provided message to the represented cluster. This method does not change the cluster!
+*
+* @param[in] msg The message to try
+* @return The goodness value that is correct if msg was added to the cluster
+*/
+double ClusterTemplate::getGoodness(const std::vector<MessageToken>& msg) const{
+  double NewAvgLen=(AvgLen+msg.size())/2;
+  size_t CommonWordCounter=0;
+
+  for(size_t i=0;i<msg.size() && i<Template.size();++i){
+    if(Template[i]==TokenTable::EndTokenId) break;
+    if(Template[i]==msg[i].Id || //match for exact match
+      (Template[i]==TokenTable::NumberTokenId && msg[i].TypeOfToken==Number)){ //match for number
+      ++CommonWordCounter;
+    }
+  }
+
+  return CommonWordCounter/NewAvgLen;
+}
+
+/**
+* This method adds a given line to the represented cluster, it calculates the
+* new goodness, average length and template values. It really modifies the object.
+*
+* @param[in] line The line to append to the cluster
+* @param[in] NewGoodness The new goodness value for the cluster. Use getGoodness to determine it!
+* @param[in] Tokens The token table of the templates (it is used to get the types of template tokens)
+*/
+void ClusterTemplate::join(const std::vector<MessageToken>& line,double NewGoodness,const TokenTable& Tokens){
+  goodness=NewGoodness;
+  AvgLen=(AvgLen+line.size())/2;
+
+  for(size_t i=0;i<Template.size() && i<line.size();++i){
+    if(Template[i]==TokenTable::EndTokenId) break;
+    if(Template[i]!=line[i].Id && Template[i]!=TokenTable::AnyTokenId){ //constant tokens and * are not modified
+      if(line[i].TypeOfToken!=Number){  //received token is not a number => template only can be (*,Word)
+        Template[i]=TokenTable::AnyTokenId;
+      }
+      else if(Template[i]!=TokenTable::NumberTokenId){ //received token is a number and the template is not +d
+        if(Tokens[Template[i]].TypeOfToken==Number){ //template is also number, so we can provide +d
+          Template[i]=TokenTable::NumberTokenId;
+        }
+        else{ //template is not a number so we must set *
+          Template[i]=TokenTable::AnyTokenId;
+        }
+      }
+    }
+  }
+
+  if(line.size()>Template.size()){
+    Template.push_back(TokenTable::EndTokenId);
+  }
+  else if(line.size()<Template.size()){
+    for(size_t i=Template.size();i>line.size()+1;--i) Template.pop_back();
+    Template[line.size()]=TokenTable::EndTokenId;
+  }
+}
+
+/**
+* @param[in] Tokens The token table of the templates
+* @return The template as it is stored in the template column of the clusters' table
+* (each token is followed by a space)
+*/
+std::string ClusterTemplate::getTemplateStr(const TokenTable& Tokens) const{
+  std::string str;
+  for(uint32_t ActToken:Template){
+    str+=Tokens[ActToken].TokenString;
+    str+=' ';
+  }
+  return str;
+}
+
+/**
+* @param[in] Tokens The token table of the templates
+* @return The SQLite command that inserts the cluster to the clusters' table
+* (This is normally used on clusters that are not already present in the database)
+*/
+std::string ClusterTemplate::getValueStr(const TokenTable& Tokens) const{
+  std::ostringstream values;
+  values << "INSERT INTO clusters VALUES(NULL,\"" << getTemplateStr(Tokens) << "\"," << goodness << "," << AvgLen << ")";
+
+  return values.str();
+}
+
+/**
+* @param[in] Tokens The token table of the templates
+* @return The SQLite command that updates the cluster
+* (this is normally used for such clusters that are already
+* stored in the database)
+*/
+std::string ClusterTemplate::getUpdateStr(const TokenTable& Tokens) const{
+  std::ostringstream update;
+  update << "UPDATE clusters SET goodness=" << goodness << ",AvgLen=" << AvgLen << ",template=\"" << getTemplateStr(Tokens) << "\"" << "WHERE clustid=" << id;
+
+  return update.str();
+}
+
+/**
+* Converts a template stored as text (in the clusters table of the database) to token ids.
+* Token types are not stored in the database, thus only +d is interned as Number, every other
+* token is a Word (unless the token is already in the table).
+*
+* @param[in] TemplateStr The tokens of the template separated by white spaces (in UTF-8, as it is stored in the database)
+* @param[in,out] Tokens The token table to intern the tokens in
+* @return The ids of the template tokens
+*/
+std::vector<uint32_t> ClusterTemplate::parseTemplate(const std::string& TemplateStr,TokenTable& Tokens){
+  std::vector<uint32_t> Template;
+  std::istringstream TemplStr(TemplateStr);
+  std::string ActToken;
+  while(TemplStr >> ActToken){
+    wordtype type=Word;
+    if(ActToken=="+d") type=Number;
+    Template.push_back(Tokens.intern(ActToken,type));
+  }
+  return Template;
+}
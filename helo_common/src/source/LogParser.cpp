@@ -1,4 +1,5 @@
 #include <regex>
+#include <algorithm>
 #include "LogParser.h"
 
 const wchar_t* LogParser::TemplateNodeName(L"template");
@@ -10,44 +11,57 @@ const wchar_t* LogParser::TokenTypeAttributeName(L"type");
 const wchar_t* LogParser::TokenValAttributeName(L"value");
 const wchar_t* LogParser::TokenNodeName(L"token");
 
+/// The default regular expression, messages are split at white spaces without using std::regex
+///
+static const char* WhiteSpaceRegexp="[\\s]+";
+
 /**
  * @param[in] HeaderLen The length of header part (irrelevant prefix) of log messages (on syslog protocol this is typically 4)
- * @param[in] regexp The regular expression used for tokenizing the log messages
+ * @param[in] regexp The regular expression used for tokenizing the log messages (in UTF-8)
+ * @throws std::regex_error if the regular expression is invalid
  */
-LogParser::LogParser(size_t HeaderLen,const std::wstring& regexp):HeaderLen(HeaderLen),regexp(regexp){
+LogParser::LogParser(size_t HeaderLen,const std::string& regexp):HeaderLen(HeaderLen),regexp(regexp),Deduplicate(false),
+    NumberProbe("",Number),MessageCount(0){
+  if(regexp!=WhiteSpaceRegexp) Expr=std::make_shared<const std::wregex>(toWide(regexp));
   Content=std::make_shared<ListOfLines>();
   dict=std::make_shared<Dictionary>();
-  dict->insert(std::make_shared<TokenDescriptor>(L"*",Word));
-  dict->insert(std::make_shared<TokenDescriptor>(L"+d",Number));
-  dict->insert(std::make_shared<TokenDescriptor>(L"+n",Word));
+  dict->insert(std::make_shared<TokenDescriptor>("*",Word));
+  dict->insert(std::make_shared<TokenDescriptor>("+d",Number));
+  dict->insert(std::make_shared<TokenDescriptor>("+n",Word));
 }
 
 /**
- * This method processes a Hybrid token, it replaces the original token with its longest Word prefix.
+ * This method processes a Hybrid token, it replaces the original token with its first run of alphabetic characters.
+ * The token is not copied, only its view is adjusted.
  *
- * @param[in,out] str The token to process
+ * @param[in] buffer The buffer of the message
+ * @param[in,out] view The token to process
  */
-void LogParser::ProcessHybrid(std::wstring& str) const {
-  size_t len=str.length();
+void LogParser::ProcessHybrid(const std::string& buffer,TokenView& view) const {
+  const char* str=buffer.data()+view.Offset;
+  size_t len=view.Length;
   size_t j=0;
   bool firstAlphaFound=false;
   size_t firstAlphaIndex=0;
   size_t lastAlphaIndex=0;
 
-  for(j=0;j<len;++j){
-    if(!firstAlphaFound && iswalpha(str[j])){
+  while(j<len){
+    size_t ActIndex=j;
+    bool IsAlpha=isAlphaChar(decodeUtf8(str,len,j));
+    if(!firstAlphaFound && IsAlpha){
       firstAlphaFound=true;
-      firstAlphaIndex=j;
+      firstAlphaIndex=ActIndex;
     }
 
-    if(firstAlphaFound && !iswalpha(str[j])){
-      lastAlphaIndex=j;
+    if(firstAlphaFound && !IsAlpha){
+      lastAlphaIndex=ActIndex;
       break;
     }
   }
 
-  str=str.substr(firstAlphaIndex,lastAlphaIndex-firstAlphaIndex);
-
+  //same as substr(firstAlphaIndex,lastAlphaIndex-firstAlphaIndex), the length may wrap around
+  view.Offset+=firstAlphaIndex;
+  view.Length=std::min(lastAlphaIndex-firstAlphaIndex,len-firstAlphaIndex);
 }
 
 /**
@@ -59,61 +73,78 @@ void LogParser::ProcessHybrid(std::wstring& str) const {
  * @param[in,out] word The token to classify
  * @return The determined category, and the processed token
  */
-wordtype LogParser::parse(std::wstring& word) const {
+wordtype LogParser::parse(std::string& word) const {
+  TokenView View(0,word.length());
+  wordtype ret=parse(word,View);
+  if(View.Offset!=0 || View.Length!=word.length()) word=word.substr(View.Offset,View.Length);
+  return ret;
+}
+
+/**
+ * This method categorizes a token given as a view into a message buffer (see parse(std::string&)).
+ * If the token is Hybrid then only its view is adjusted by ProcessHybrid method, the buffer is not modified.
+ * The characters are decoded from UTF-8 one by one, only non-ASCII characters are classified by the locale.
+ *
+ * @param[in] buffer The buffer of the message
+ * @param[in,out] view The token to classify
+ * @return The determined category
+ */
+wordtype LogParser::parse(const std::string& buffer,TokenView& view) const {
+  const char* Data=buffer.data()+view.Offset;
+  size_t WordLen=view.Length;
   wordtype ret=Word;
-  unsigned int Index=0;
-  unsigned int WordLen=word.length();
+  size_t Index=0;
   bool accept=true;
   bool IsHex=false;
 
-  if(iswdigit(word[0]) || word[0]=='-' || word[0]=='+'){
+  uint32_t First=WordLen>0 ? decodeUtf8(Data,WordLen,Index) : 0; //an empty token reads as a terminating zero
+  if(isDigitChar(First) || First=='-' || First=='+'){
     ret=Number;
   }
-  Index++;
 
-  if(!iswalnum(word[0]) && ret!=Number){
-    ProcessHybrid(word);
+  if(!isAlnumChar(First) && ret!=Number){
+    ProcessHybrid(buffer,view);
     return Hybrid;
   }
 
-  if(word[0]=='0' && word[1]=='x'){
+  if(First=='0' && Index<WordLen && Data[Index]=='x'){
     ret=Number;
     Index=2;
     IsHex=true;
   }
 
   while(Index<WordLen){
+    uint32_t Act=decodeUtf8(Data,WordLen,Index);
 
-    if(Index==WordLen-1 && word[Index]=='\n') return ret;
+    if(Index==WordLen && Act=='\n') return ret;
 
-    if(IsHex==true && (!iswalnum(word[Index]) || (word[Index]>'F' && word[Index]<'a') || word[Index]>'f')){
-      ProcessHybrid(word);
+    if(IsHex==true && (!isAlnumChar(Act) || (Act>'F' && Act<'a') || Act>'f')){
+      ProcessHybrid(buffer,view);
       return Hybrid;
     }
 
     //current state is number, but received alpha
-    if(IsHex!=true && ret==Number && iswalpha(word[Index])){
-      ProcessHybrid(word);
+    if(IsHex!=true && ret==Number && isAlphaChar(Act)){
+      ProcessHybrid(buffer,view);
       return Hybrid;
     }
 
     //current state is word, but received digit
-    if(ret==Word && iswdigit(word[Index])){
-      ProcessHybrid(word);
+    if(ret==Word && isDigitChar(Act)){
+      ProcessHybrid(buffer,view);
       return Hybrid;
     }
 
     //hybrid return for not alphanumerical input
-    if(!iswalnum(word[Index])){
-      if(ret==Number && accept==true && (word[Index]=='.' || word[Index]==',')){
+    if(!isAlnumChar(Act)){
+      if(ret==Number && accept==true && (Act=='.' || Act==',')){
         accept=false;
       }
       else{
-        ProcessHybrid(word);
+        ProcessHybrid(buffer,view);
         return Hybrid;
       }
     }
-    Index++;
   }
 
   return ret;
@@ -133,6 +164,35 @@ const std::shared_ptr<ListOfLines> LogParser::getContent() const{
   return Content;
 }
 
+/**
+ * This method switches the deduplication of messages on or off. If it is on, a message that consists of
+ * the same tokens as a former one (after the header is dropped) is not stored again, the multiplicity of the
+ * former message is increased instead (see getWeights()). It must be set before the first message is added.
+ *
+ * @param[in] enabled true to switch deduplication on
+ */
+void LogParser::setDeduplication(bool enabled){
+  Deduplicate=enabled;
+  if(enabled && !Weights) Weights=std::make_shared<LineWeights>();
+  if(!enabled) Weights.reset();
+}
+
+/**
+ * This method switches the number table on or off. If it is on, the Number tokens are not stored in the
+ * dictionary, but in a separate table (see NumberTable), which is much cheaper for the many distinct numbers
+ * (ports, process ids, counters) of a log. Each distinct number is still stored only once, thus two
+ * number tokens of the lines can be compared by address as usual. It must be set before the first message is added.
+ *
+ * @param[in] enabled true to keep the numbers in the number table
+ */
+void LogParser::setNumberTable(bool enabled){
+  if(enabled && !Numbers) Numbers=std::make_shared<NumberTable>();
+  if(!enabled){
+    Numbers.reset();
+    NumberIndex.clear();
+  }
+}
+
 /**
  * This method implements how a BaseParser object can be written to a stream.
  * It is used only for debugging, thus we can write to the console the
@@ -145,7 +205,7 @@ const std::shared_ptr<ListOfLines> LogParser::getContent() const{
 std::wostream& operator<<(std::wostream& o,const LogParser& parser){
   for(const ArrayOfWords& ActLine:*(parser.Content)){
     for(const std::shared_ptr<TokenDescriptor> ActWord:ActLine){
-      o << ActWord->TokenString << " ";
+      o << toWide(ActWord->TokenString) << " ";
     }
     o << std::endl;
   }
@@ -155,35 +215,122 @@ std::wostream& operator<<(std::wostream& o,const LogParser& parser){
 
 
 /**
- * This method implements the read and preprocess of an input stream
- * to a LogParser object. Usually the stream here is the input log file.
+ * This method drops the header of a message, and splits it to parsed tokens. The tokens are views
+ * into the buffer of the message (the message without the header, its tokens are separated by one space),
+ * no token string is copied. If the default regular expression (white spaces) is used, the message is
+ * split without std::regex, otherwise the regular expression is applied to the decoded message, and the
+ * tokens are mapped back to the buffer.
  *
- * @param[in,out] is The stream which gives us the input(log)
- * @param[in,out] parser The LogParser object to be filled with content
- * @return A reference to the used input stream
+ * @param[in] line The message (one line of the log in UTF-8)
+ * @param[out] message The tokenized message
+ * @return true if the message has at least one token
+ * @throws std::regex_error if the regular expression can't be applied
+ */
+bool LogParser::tokenize(const std::string& line,TokenizedMessage& message) const{
+  message.Buffer.clear();
+  message.Tokens.clear();
+  if(line.empty()) return false;
+
+  const char* Data=line.data();
+  size_t Length=line.size();
+  size_t Pos=0;
+  size_t Next=0;
+  size_t TokenCounter=0;
+  while(true){
+    while(Pos<Length && isSpaceChar(decodeUtf8(Data,Length,Next=Pos))) Pos=Next;
+    if(Pos==Length) break;
+    size_t Begin=Pos;
+    while(Pos<Length && !isSpaceChar(decodeUtf8(Data,Length,Next=Pos))) Pos=Next;
+    if(TokenCounter++<HeaderLen) continue; //drop header tokens away
+
+    if(!Expr) message.Tokens.push_back(TokenView(message.Buffer.size(),Pos-Begin));
+    message.Buffer.append(line,Begin,Pos-Begin);
+    message.Buffer.push_back(' ');
+  }
+
+  if(Expr){
+    std::vector<size_t> Offsets;
+    std::wstring WideBuffer=toWide(message.Buffer.data(),message.Buffer.size(),&Offsets);
+    std::wstring::const_iterator BufferBegin=WideBuffer.begin();
+    std::wsregex_token_iterator WordIterator(BufferBegin,WideBuffer.cend(),*Expr,-1);
+    std::wsregex_token_iterator End;
+    for(;WordIterator!=End;++WordIterator){
+      size_t First=Offsets[WordIterator->first-BufferBegin];
+      message.Tokens.push_back(TokenView(First,Offsets[WordIterator->second-BufferBegin]-First));
+    }
+  }
+
+  size_t Kept=0;
+  for(size_t i=0;i<message.Tokens.size();++i){
+    TokenView ActView=message.Tokens[i];
+    ActView.TypeOfToken=parse(message.Buffer,ActView);
+    if(ActView.Length>0) message.Tokens[Kept++]=ActView;
+  }
+  message.Tokens.erase(message.Tokens.begin()+Kept,message.Tokens.end());
+
+  return Kept>0;
+}
+
+/**
+ * This method drops the header of a message, and splits it to parsed tokens.
+ * The tokens are copied, and they are not stored in the dictionary.
+ *
+ * @param[in] line The message (one line of the log)
+ * @param[out] tokens The parsed tokens of the message
+ * @return true if the message has at least one token
  */
-std::wistream& operator>>(std::wistream& is,LogParser& parser){
+bool LogParser::tokenize(const std::string& line,std::vector<TokenDescriptor>& tokens) const{
+  tokens.clear();
+  TokenizedMessage Message;
+  if(!tokenize(line,Message)) return false;
+
+  tokens.reserve(Message.Tokens.size());
+  for(size_t i=0;i<Message.Tokens.size();++i){
+    tokens.push_back(TokenDescriptor(Message.getToken(i),Message.Tokens[i].TypeOfToken));
+  }
+  return true;
+}
+
+/**
+ * This method reads the next non-empty message from a stream, drops its header
+ * and splits it to parsed tokens (see tokenize()).
+ *
+ * @param[in,out] is The stream to read from (usually the input log file)
+ * @param[out] message The tokenized message, its buffers are reused
+ * @return true if a message was read, false if the stream ended
+ */
+bool LogParser::readMessage(std::istream& is,TokenizedMessage& message) const{
+  message.Tokens.clear();
   while(!is.eof()){
-    std::wstring msg;
+    try{
+      getline(is,message.Line);
+    }
+    catch(...){
+      if(!is.eof()){
+        throw;
+      }
+    }
 
+    if(tokenize(message.Line,message)) return true;
+  }
+
+  return false;
+}
+
+/**
+ * This method reads the next non-empty message from a stream, drops its header
+ * and splits it to parsed tokens. The tokens are not stored in the dictionary.
+ *
+ * @param[in,out] is The stream to read from (usually the input log file)
+ * @param[out] tokens The parsed tokens of the message
+ * @return true if a message was read, false if the stream ended
+ */
+bool LogParser::readMessage(std::istream& is,std::vector<TokenDescriptor>& tokens) const{
+  tokens.clear();
+  while(!is.eof()){
+    std::string ActLine;
     try{
-      std::wstring ActLine;
       getline(is,ActLine);
-      if(ActLine.empty()) continue;
-
-      std::wostringstream msgStream;
-      size_t TokenCounter=0;
-      std::wstring ActToken;
-      for(std::wistringstream iss(ActLine);!iss.eof();TokenCounter++){
-        if(TokenCounter<parser.HeaderLen){ //drop header tokens away
-          iss >> ActToken;
-          continue;
-        }
-
-        iss >> ActToken;
-        msgStream << ActToken << " ";
-      }
-      msg=msgStream.str();
     }
     catch(...){
       if(!is.eof()){
@@ -191,31 +338,101 @@ std::wistream& operator>>(std::wistream& is,LogParser& parser){
       }
     }
 
-    std::wregex expr(parser.regexp);
-    std::wsregex_token_iterator WordIterator(msg.begin(), msg.end(), expr, -1);
-    std::wsregex_token_iterator End;
+    if(tokenize(ActLine,tokens)) return true;
+  }
 
-    ArrayOfWords LineArray;
-    for(;WordIterator!=End;++WordIterator){
-      std::wstring ActWord=*WordIterator;
-      wordtype TokenType=parser.parse(ActWord);
-      if(ActWord.empty()) continue;
-
-      std::shared_ptr<TokenDescriptor> ActDesc=std::make_shared<TokenDescriptor>(ActWord,TokenType);
-      auto it=parser.dict->find(ActDesc);
-      if(it==parser.dict->end()){
-        parser.dict->insert(ActDesc);
-        LineArray.push_back(ActDesc);
-      }
-      else{
-        LineArray.push_back(*it);
-      }
+  return false;
+}
+
+/**
+ * This method finds a token in the dictionary, or in the number table if it is switched on.
+ * A new TokenDescriptor (and a copy of the string) is made only if the token isn't stored yet.
+ *
+ * @param[in] key The string of the token
+ * @param[in] type The type of the token
+ * @return The stored token
+ */
+std::shared_ptr<TokenDescriptor> LogParser::intern(const TokenKey& key,wordtype type){
+  if(Numbers && type==Number){
+    NumberProbe.TokenString.assign(key.Data,key.Length);
+    auto it=NumberIndex.find(&NumberProbe);
+    if(it==NumberIndex.end()){
+      Numbers->push_back(TokenDescriptor(NumberProbe.TokenString,Number));
+      it=NumberIndex.insert(&Numbers->back()).first;
     }
+    return std::shared_ptr<TokenDescriptor>(Numbers,*it); //shares the ownership of the table
+  }
+
+  auto it=dict->find(key);
+  if(it==dict->end()){
+    it=dict->insert(std::make_shared<TokenDescriptor>(std::string(key.Data,key.Length),type)).first;
+  }
+  return *it;
+}
 
-    if(!LineArray.empty()){
-      parser.Content->push_back(LineArray);
+/**
+ * This method stores a line in the content. If deduplication is switched on, and the same
+ * line was already stored, only its weight is increased.
+ *
+ * @param[in,out] line The line to store, it is moved out
+ */
+void LogParser::addLine(ArrayOfWords&& line){
+  ++MessageCount;
+  if(Deduplicate){
+    auto it=DistinctLines.find(&line);
+    if(it!=DistinctLines.end()){
+      ++Weights->insert(std::make_pair(*it,(size_t)1)).first->second;
+      return;
     }
   }
 
+  Content->push_back(std::move(line));
+  if(Deduplicate) DistinctLines.insert(&Content->back());
+}
+
+/**
+ * This method adds a tokenized message to the content, its tokens are stored in the dictionary, or in the
+ * number table if it is switched on (each distinct token is stored only once). If deduplication is switched on,
+ * and the same message was already added, only its weight is increased.
+ *
+ * @param[in] message The tokenized message (see readMessage())
+ */
+void LogParser::addMessage(const TokenizedMessage& message){
+  ArrayOfWords LineArray;
+  LineArray.reserve(message.Tokens.size());
+  for(size_t i=0;i<message.Tokens.size();++i){
+    LineArray.push_back(intern(message.getKey(i),message.Tokens[i].TypeOfToken));
+  }
+  addLine(std::move(LineArray));
+}
+
+/**
+ * This method adds a message to the content (see addMessage(const TokenizedMessage&)).
+ *
+ * @param[in] tokens The parsed tokens of the message (see readMessage())
+ */
+void LogParser::addMessage(std::vector<TokenDescriptor>& tokens){
+  ArrayOfWords LineArray;
+  LineArray.reserve(tokens.size());
+  for(const TokenDescriptor& ActToken:tokens){
+    LineArray.push_back(intern(TokenKey(ActToken.TokenString.data(),ActToken.TokenString.size()),ActToken.TypeOfToken));
+  }
+  addLine(std::move(LineArray));
+}
+
+/**
+ * This method implements the read and preprocess of an input stream
+ * to a LogParser object. Usually the stream here is the input log file.
+ *
+ * @param[in,out] is The stream which gives us the input (log in UTF-8)
+ * @param[in,out] parser The LogParser object to be filled with content
+ * @return A reference to the used input stream
+ */
+std::istream& operator>>(std::istream& is,LogParser& parser){
+  TokenizedMessage Message;
+  while(parser.readMessage(is,Message)){
+    parser.addMessage(Message);
+  }
+
   return is;
 }
@@ -0,0 +1,55 @@
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <iterator>
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Constructor, it maps the given file into the memory
+ *
+ * @param[in] path The path of the file to map
+ * @throws std::runtime_error if the file can't be opened or mapped
+ */
+MappedFile::MappedFile(const std::string& path):Data(NULL),Size(0){
+#ifndef _WIN32
+  int fd=open(path.c_str(),O_RDONLY);
+  if(fd<0) throw std::runtime_error("Couldn't open "+path+": "+strerror(errno));
+
+  struct stat st;
+  if(fstat(fd,&st)!=0){
+    close(fd);
+    throw std::runtime_error("Couldn't stat "+path+": "+strerror(errno));
+  }
+
+  Size=st.st_size;
+  if(Size>0){
+    void* addr=mmap(NULL,Size,PROT_READ,MAP_PRIVATE,fd,0);
+    if(addr==MAP_FAILED){
+      close(fd);
+      throw std::runtime_error("Couldn't map "+path+": "+strerror(errno));
+    }
+    Data=static_cast<const char*>(addr);
+  }
+  close(fd);
+#else
+  std::ifstream file(path.c_str(),std::ios::in | std::ios::binary);
+  if(file.fail()) throw std::runtime_error("Couldn't open "+path);
+  Buffer.assign(std::istreambuf_iterator<char>(file),std::istreambuf_iterator<char>());
+  Data=Buffer.data();
+  Size=Buffer.size();
+#endif
+}
+
+MappedFile::~MappedFile(){
+#ifndef _WIN32
+  if(Data!=NULL) munmap(const_cast<char*>(Data),Size);
+#endif
+}
@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include "BinaryIO.h"
+#include "ModelFile.h"
+#include "TemplateIndex.h"
+
+static const char ModelMagic[8]={'H','E','L','O','M','D','L','\0'};
+
+/**
+ * Checks whether an array fits into a region without overflowing the arithmetic.
+ *
+ * @param[in] Offset The offset of the array in the region
+ * @param[in] Count The number of elements
+ * @param[in] ElemSize The size of an element in bytes
+ * @param[in] Size The size of the region in bytes
+ * @return true if the array is in the region
+ */
+static inline bool arrayFits(uint64_t Offset,uint64_t Count,uint64_t ElemSize,uint64_t Size){
+  return Offset<=Size && Count<=(Size-Offset)/ElemSize;
+}
+
+/**
+ * Checks whether an array of T fits into the model and it is properly aligned for T.
+ *
+ * @param[in] Data The beginning of the model
+ * @param[in] Offset The offset of the array in the model
+ * @param[in] Count The number of elements
+ * @param[in] Size The size of the model in bytes
+ * @return true if the array can be accessed in place
+ */
+template<typename T>
+static inline bool sectionValid(const char* Data,uint64_t Offset,uint64_t Count,uint64_t Size){
+  return arrayFits(Offset,Count,sizeof(T),Size) && reinterpret_cast<uintptr_t>(Data+Offset)%alignof(T)==0;
+}
+
+/**
+ * Checks whether the ranges of a list table are in the table, and their entries are positions of templates.
+ *
+ * @param[in] First The first entry of the range
+ * @param[in] Count The number of entries
+ * @param[in] Index The index that contains the list table
+ * @return true if the range is valid
+ */
+static inline bool listValid(uint32_t First,uint32_t Count,const ModelIndex& Index){
+  if(!arrayFits(First,Count,1,Index.ListSize)) return false;
+  for(uint64_t i=First;i<(uint64_t)First+Count;++i){
+    if(Index.Lists[i]>=Index.TemplateCount) return false;
+  }
+  return true;
+}
+
+/**
+ * Constructor, it interns the special template tokens, thus they have the same ids as in a TokenTable
+ */
+ModelWriter::ModelWriter():Flags(0),Generation(0){
+  internToken(TokenDescriptor("*",Word));
+  internToken(TokenDescriptor("+d",Number));
+  internToken(TokenDescriptor("+n",Word));
+}
+
+/**
+ * Looks up a token among the already stored tokens, and stores it if it's new.
+ *
+ * @param[in] token The token to intern
+ * @return The id of the token in the model
+ */
+uint32_t ModelWriter::internToken(const TokenDescriptor& token){
+  auto it=TokenIds.find(token.TokenString);
+  if(it!=TokenIds.end()) return it->second;
+
+  uint32_t id=TokenStrings.size();
+  TokenStrings.push_back(token.TokenString);
+  TokenTypes.push_back(token.TypeOfToken);
+  TokenIds.insert(std::make_pair(token.TokenString,id));
+  return id;
+}
+
+/**
+ * Adds a cluster to the model
+ *
+ * @param[in] Template The template of the cluster
+ * @param[in] goodness The goodness of the cluster
+ * @param[in] AvgLen The average line length of the cluster
+ * @param[in] id The id of the cluster (the same as the id in the database or XML output)
+ */
+void ModelWriter::addCluster(const ArrayOfWords& Template,double goodness,double AvgLen,int64_t id){
+  ModelCluster clust;
+  clust.Id=id;
+  clust.Goodness=goodness;
+  clust.AvgLen=AvgLen;
+  clust.FirstToken=TemplateTokens.size();
+  clust.TokenCount=Template.size();
+  clust.Reserved=0;
+
+  for(const std::shared_ptr<TokenDescriptor>& ActWord:Template){
+    TemplateTokens.push_back(internToken(*ActWord));
+  }
+  Clusters.push_back(clust);
+}
+
+/**
+ * Sets the generation of the database that the clusters were read from: the last sequence number of
+ * its cluster_changes table. The rows changed later have higher sequence numbers, thus the online
+ * algorithm only has to read those rows besides the model.
+ *
+ * @param[in] generation The generation of the database
+ */
+void ModelWriter::setGeneration(uint64_t generation){
+  Flags|=MODEL_FLAG_GENERATION;
+  Generation=generation;
+}
+
+/**
+ * Writes the model to a binary stream
+ *
+ * @param[in,out] os The stream to write to (it must be opened in binary mode)
+ */
+void ModelWriter::write(std::ostream& os) const{
+  ModelHeader header;
+  std::copy(ModelMagic,ModelMagic+sizeof(ModelMagic),header.Magic);
+  header.Version=MODEL_FILE_VERSION;
+  header.ByteOrder=HELO_BYTE_ORDER_MARK;
+  header.Flags=Flags;
+  header.Reserved=0;
+  header.TokenCount=TokenStrings.size();
+  header.ClusterCount=Clusters.size();
+  header.TemplateTokenCount=TemplateTokens.size();
+  header.Generation=Generation;
+
+  //the positions of the templates are the same as the positions that TemplateLoader gives them (it skips the empty ones)
+  std::vector<ClusterTemplate> Templates;
+  Templates.reserve(Clusters.size());
+  for(const ModelCluster& ActClust:Clusters){
+    if(ActClust.TokenCount==0) continue;
+    auto First=TemplateTokens.begin()+ActClust.FirstToken;
+    Templates.push_back(ClusterTemplate(std::vector<uint32_t>(First,First+ActClust.TokenCount),ActClust.Goodness,ActClust.AvgLen,ActClust.Id));
+  }
+  TemplateIndex Index;
+  Index.build(Templates);
+  const ModelIndex& Built=Index.getBase();
+  header.IndexTemplateCount=Built.TemplateCount;
+  header.IndexNodeCount=Built.NodeCount;
+  header.IndexEdgeCount=Built.EdgeCount;
+  header.IndexPostingCount=Built.PostingCount;
+  header.IndexListSize=Built.ListSize;
+
+  std::vector<ModelToken> Tokens(TokenStrings.size());
+  uint64_t StringTableSize=0;
+  for(size_t i=0;i<TokenStrings.size();++i){
+    Tokens[i].StringOffset=StringTableSize;
+    Tokens[i].StringLength=TokenStrings[i].size();
+    Tokens[i].Type=TokenTypes[i];
+    StringTableSize+=TokenStrings[i].size();
+  }
+  header.StringTableSize=StringTableSize;
+
+  uint64_t pos=sizeof(ModelHeader);
+  header.TokenTableOffset=pos;
+  pos+=Tokens.size()*sizeof(ModelToken);
+  header.ClusterTableOffset=pos;
+  pos+=Clusters.size()*sizeof(ModelCluster);
+  header.TemplateTableOffset=pos;
+  pos+=TemplateTokens.size()*sizeof(uint32_t);
+  pos+=(8-pos%8)%8;
+  header.StringTableOffset=pos;
+  pos+=StringTableSize;
+  pos+=(8-pos%8)%8;
+  header.IndexPostingOffset=pos;
+  pos+=Built.PostingCount*sizeof(ModelPosting);
+  header.IndexNodeOffset=pos;
+  pos+=Built.NodeCount*sizeof(ModelIndexNode);
+  pos+=(8-pos%8)%8;
+  header.IndexEdgeOffset=pos;
+  pos+=Built.EdgeCount*sizeof(ModelIndexEdge);
+  header.IndexListOffset=pos;
+  pos+=Built.ListSize*sizeof(uint32_t);
+  pos+=(8-pos%8)%8;
+  header.FileSize=pos;
+
+  writePod(os,header);
+  writePodArray(os,Tokens.data(),Tokens.size());
+  writePodArray(os,Clusters.data(),Clusters.size());
+  writePodArray(os,TemplateTokens.data(),TemplateTokens.size());
+  writePadding(os,header.TemplateTableOffset+TemplateTokens.size()*sizeof(uint32_t));
+  for(const std::string& ActString:TokenStrings){
+    os.write(ActString.data(),ActString.size());
+  }
+  writePadding(os,header.StringTableOffset+StringTableSize);
+  writePodArray(os,Built.Postings,Built.PostingCount);
+  writePodArray(os,Built.Nodes,Built.NodeCount);
+  writePadding(os,header.IndexNodeOffset+Built.NodeCount*sizeof(ModelIndexNode));
+  writePodArray(os,Built.Edges,Built.EdgeCount);
+  writePodArray(os,Built.Lists,Built.ListSize);
+  writePadding(os,header.IndexListOffset+Built.ListSize*sizeof(uint32_t));
+}
+
+/**
+ * Writes the model to a file
+ *
+ * @param[in] path The path of the file to write
+ * @throws std::ios::failure if the file couldn't be written
+ */
+void ModelWriter::save(const std::string& path) const{
+  std::ofstream file;
+  file.exceptions(std::ios::failbit | std::ios::badbit);
+  file.open(path.c_str(),std::ios::out | std::ios::binary | std::ios::trunc);
+  write(file);
+  file.close();
+}
+
+/**
+ * Constructor, it maps the given model file into the memory
+ *
+ * @param[in] path The path of the binary model file
+ * @throws ModelError if the file can't be opened, or it is not a valid model
+ */
+ModelReader::ModelReader(const std::string& path){
+  try{
+    File=std::make_shared<MappedFile>(path);
+  }
+  catch(const std::runtime_error& e){
+    throw ModelError(e.what());
+  }
+  Data=File->data();
+  Size=File->size();
+  validate();
+}
+
+/**
+ * Constructor, it reads a model that is already in the memory. The buffer must outlive the object.
+ *
+ * @param[in] data Pointer to the beginning of the model (it must be aligned to 8 bytes)
+ * @param[in] size The size of the model in bytes
+ * @throws ModelError if the buffer doesn't contain a valid model
+ */
+ModelReader::ModelReader(const char* data,size_t size):Data(data),Size(size){
+  validate();
+}
+
+/**
+ * Checks the structure of the model, and sets the section pointers.
+ *
+ * @throws ModelError if the model is invalid, truncated or it was written by an other version
+ */
+void ModelReader::validate(){
+  if(Data==NULL || Size<sizeof(ModelHeader)) throw ModelError("Invalid model file: the file is too short!");
+  if(reinterpret_cast<uintptr_t>(Data)%alignof(ModelHeader)!=0) throw ModelError("Invalid model file: the model is not aligned!");
+  Header=reinterpret_cast<const ModelHeader*>(Data);
+  if(!std::equal(ModelMagic,ModelMagic+sizeof(ModelMagic),Header->Magic)){
+    throw ModelError("Invalid model file: this is not a HELO model!");
+  }
+  if(Header->ByteOrder!=HELO_BYTE_ORDER_MARK) throw ModelError("Invalid model file: wrong byte order!");
+  if(Header->Version!=MODEL_FILE_VERSION) throw ModelError("Unsupported model file version!");
+  if(Header->FileSize!=Size) throw ModelError("Invalid model file: the file is truncated!");
+
+  if(!sectionValid<ModelToken>(Data,Header->TokenTableOffset,Header->TokenCount,Size) ||
+     !sectionValid<ModelCluster>(Data,Header->ClusterTableOffset,Header->ClusterCount,Size) ||
+     !sectionValid<uint32_t>(Data,Header->TemplateTableOffset,Header->TemplateTokenCount,Size) ||
+     !arrayFits(Header->StringTableOffset,Header->StringTableSize,1,Size) ||
+     !sectionValid<ModelIndexNode>(Data,Header->IndexNodeOffset,Header->IndexNodeCount,Size) ||
+     !sectionValid<ModelIndexEdge>(Data,Header->IndexEdgeOffset,Header->IndexEdgeCount,Size) ||
+     !sectionValid<ModelPosting>(Data,Header->IndexPostingOffset,Header->IndexPostingCount,Size) ||
+     !sectionValid<uint32_t>(Data,Header->IndexListOffset,Header->IndexListSize,Size)){
+    throw ModelError("Invalid model file: a section is out of the file or misaligned!");
+  }
+
+  Tokens=reinterpret_cast<const ModelToken*>(Data+Header->TokenTableOffset);
+  ClusterTable=reinterpret_cast<const ModelCluster*>(Data+Header->ClusterTableOffset);
+  TemplateTable=reinterpret_cast<const uint32_t*>(Data+Header->TemplateTableOffset);
+  StringTable=Data+Header->StringTableOffset;
+
+  for(size_t i=0;i<Header->TokenCount;++i){
+    if(!arrayFits(Tokens[i].StringOffset,Tokens[i].StringLength,1,Header->StringTableSize)){
+      throw ModelError("Invalid model file: wrong token string!");
+    }
+  }
+  for(size_t i=0;i<Header->ClusterCount;++i){
+    if(!arrayFits(ClusterTable[i].FirstToken,ClusterTable[i].TokenCount,1,Header->TemplateTokenCount)){
+      throw ModelError("Invalid model file: wrong cluster template!");
+    }
+  }
+  for(size_t i=0;i<Header->TemplateTokenCount;++i){
+    if(TemplateTable[i]>=Header->TokenCount) throw ModelError("Invalid model file: wrong token id!");
+  }
+
+  //the lookups of the index don't check the ranges, they must be in the sections
+  ModelIndex Index=getIndex();
+  if(Index.NodeCount==0 || Index.TemplateCount>Header->ClusterCount){
+    throw ModelError("Invalid model file: wrong template index!");
+  }
+  for(size_t i=0;i<Index.NodeCount;++i){
+    const ModelIndexNode& ActNode=Index.Nodes[i];
+    if(!arrayFits(ActNode.FirstChild,ActNode.ChildCount,1,Index.EdgeCount) ||
+       !listValid(ActNode.FirstComplete,ActNode.CompleteCount,Index) || !listValid(ActNode.FirstOpen,ActNode.OpenCount,Index)){
+      throw ModelError("Invalid model file: wrong template index node!");
+    }
+    for(uint64_t j=ActNode.FirstChild;j<(uint64_t)ActNode.FirstChild+ActNode.ChildCount;++j){
+      if(Index.Edges[j].Node>=Index.NodeCount || (j>ActNode.FirstChild && Index.Edges[j-1].Token>=Index.Edges[j].Token)){
+        throw ModelError("Invalid model file: wrong template index edge!");
+      }
+    }
+  }
+  for(size_t i=0;i<Index.PostingCount;++i){
+    if(!listValid(Index.Postings[i].First,Index.Postings[i].Count,Index) || (i>0 && Index.Postings[i-1].Key>=Index.Postings[i].Key)){
+      throw ModelError("Invalid model file: wrong template index posting!");
+    }
+  }
+}
+
+/**
+ * @param[in] id The id of the token (0 <= id < getTokenCount())
+ * @return The token string in UTF-8 encoding
+ */
+std::string ModelReader::getTokenString(uint32_t id) const{
+  return std::string(StringTable+Tokens[id].StringOffset,Tokens[id].StringLength);
+}
+
+/**
+ * @param[in] id The id of the token (0 <= id < getTokenCount())
+ * @return The token string converted to a wide string
+ */
+std::wstring ModelReader::getTokenWString(uint32_t id) const{
+  return toWide(StringTable+Tokens[id].StringOffset,Tokens[id].StringLength);
+}
+
+/**
+ * @return The arrays of the prebuilt template index, they point into the model
+ */
+ModelIndex ModelReader::getIndex() const{
+  ModelIndex Index;
+  Index.TemplateCount=Header->IndexTemplateCount;
+  Index.Nodes=reinterpret_cast<const ModelIndexNode*>(Data+Header->IndexNodeOffset);
+  Index.NodeCount=Header->IndexNodeCount;
+  Index.Edges=reinterpret_cast<const ModelIndexEdge*>(Data+Header->IndexEdgeOffset);
+  Index.EdgeCount=Header->IndexEdgeCount;
+  Index.Postings=reinterpret_cast<const ModelPosting*>(Data+Header->IndexPostingOffset);
+  Index.PostingCount=Header->IndexPostingCount;
+  Index.Lists=reinterpret_cast<const uint32_t*>(Data+Header->IndexListOffset);
+  Index.ListSize=Header->IndexListSize;
+  return Index;
+}
+
+/**
+ * @param[out] generation The generation of the database the model was made from (see ModelWriter::setGeneration())
+ * @return true if the model has the generation of its database
+ */
+bool ModelReader::getGeneration(uint64_t& generation) const{
+  generation=Header->Generation;
+  return (Header->Flags & MODEL_FLAG_GENERATION)!=0;
+}
@@ -0,0 +1,466 @@
+#include <algorithm>
+#include <stdexcept>
+#include "TemplateIndex.h"
+
+const uint32_t TemplateIndex::NoMatch;
+
+/**
+* Compares a child of a node of the inserted templates' trie to a token
+*
+* @param[in] Child The token and the child node
+* @param[in] Token The token
+* @return true if the token of the child is smaller
+*/
+template<typename T>
+static inline bool childLess(const T& Child,uint32_t Token){
+  return Child.first<Token;
+}
+
+/**
+* Compares an edge of the base trie to a token
+*
+* @param[in] Edge The edge
+* @param[in] Token The token
+* @return true if the token of the edge is smaller
+*/
+static inline bool edgeLess(const ModelIndexEdge& Edge,uint32_t Token){
+  return Edge.Token<Token;
+}
+
+/**
+* Compares a posting of the base to a key
+*
+* @param[in] Posting The posting
+* @param[in] Key The key
+* @return true if the key of the posting is smaller
+*/
+static inline bool postingLess(const ModelPosting& Posting,uint64_t Key){
+  return Posting.Key<Key;
+}
+
+/**
+* Constructor, it creates an empty index
+*/
+TemplateIndex::TemplateIndex():Base(){}
+
+/**
+* @param[in] Pos A position of a template
+* @param[in] Id A token id
+* @return The key of the pair in the inverted index
+*/
+uint64_t TemplateIndex::getKey(size_t Pos,uint32_t Id){
+  return ((uint64_t)Pos<<32) | Id;
+}
+
+/**
+* Removes every template from the index, and frees the base
+*/
+void TemplateIndex::clear(){
+  Base=ModelIndex();
+  Model.reset();
+  BaseNodes=std::vector<ModelIndexNode>();
+  BaseEdges=std::vector<ModelIndexEdge>();
+  BasePostings=std::vector<ModelPosting>();
+  BaseLists=std::vector<uint32_t>();
+  Removed.clear();
+  Root=Node();
+  Postings.clear();
+}
+
+/**
+* Builds the base trie. The nodes are built in breadth-first order: the templates of a node are sorted by
+* their next token, so that the children of the node get consecutive ids and their edges are sorted by token.
+*
+* @param[in] Templates The templates
+*/
+void TemplateIndex::buildTrie(const std::vector<ClusterTemplate>& Templates){
+  struct Range{
+    size_t Begin;
+    size_t End;
+    size_t Depth;
+  };
+
+  //Order holds the positions of the templates that belong to the subtrie of each node in Ranges
+  std::vector<uint32_t> Order(Templates.size());
+  for(uint32_t i=0;i<Order.size();++i) Order[i]=i;
+  std::vector<Range> Ranges(1,Range{0,Order.size(),0});
+  std::vector<uint32_t> Opened;
+  std::vector<uint64_t> Keys;
+  BaseNodes.resize(1);
+
+  for(size_t ActNode=0;ActNode<BaseNodes.size();++ActNode){
+    Range ActRange=Ranges[ActNode];
+    ModelIndexNode Built;
+    Built.FirstComplete=BaseLists.size();
+    Opened.clear();
+    Keys.clear();
+    for(size_t i=ActRange.Begin;i<ActRange.End;++i){
+      const std::vector<uint32_t>& Template=Templates[Order[i]].getTemplate();
+      if(Template.size()==ActRange.Depth) BaseLists.push_back(Order[i]);
+      else if(Template[ActRange.Depth]==TokenTable::EndTokenId) Opened.push_back(Order[i]);
+      else Keys.push_back(((uint64_t)Template[ActRange.Depth]<<32) | Order[i]);
+    }
+    Built.CompleteCount=BaseLists.size()-Built.FirstComplete;
+    Built.FirstOpen=BaseLists.size();
+    Built.OpenCount=Opened.size();
+    BaseLists.insert(BaseLists.end(),Opened.begin(),Opened.end());
+
+    std::sort(Keys.begin(),Keys.end());
+    for(size_t i=0;i<Keys.size();++i) Order[ActRange.Begin+i]=(uint32_t)Keys[i];
+    Built.FirstChild=BaseEdges.size();
+    for(size_t i=0,j;i<Keys.size();i=j){
+      uint32_t Token=Keys[i]>>32;
+      for(j=i+1;j<Keys.size() && (Keys[j]>>32)==Token;++j);
+      BaseEdges.push_back(ModelIndexEdge{Token,(uint32_t)BaseNodes.size()});
+      BaseNodes.push_back(ModelIndexNode());
+      Ranges.push_back(Range{ActRange.Begin+i,ActRange.Begin+j,ActRange.Depth+1});
+    }
+    Built.ChildCount=BaseEdges.size()-Built.FirstChild;
+    BaseNodes[ActNode]=Built;
+  }
+}
+
+/**
+* Builds the base inverted index. The (position, token) pairs of the templates are sorted by two stable
+* counting sorts (by token, then by position), thus the lists are sorted by the position of the template.
+*
+* @param[in] Templates The templates
+*/
+void TemplateIndex::buildPostings(const std::vector<ClusterTemplate>& Templates){
+  size_t MaxLen=0;
+  std::vector<size_t> TokenStart;
+  for(const ClusterTemplate& ActTempl:Templates){
+    const std::vector<uint32_t>& Template=ActTempl.getTemplate();
+    for(size_t i=0;i<Template.size() && Template[i]!=TokenTable::EndTokenId;++i){
+      if(TokenStart.size()<(size_t)Template[i]+2) TokenStart.resize((size_t)Template[i]+2,0);
+      ++TokenStart[Template[i]+1];
+      MaxLen=std::max(MaxLen,i+1);
+    }
+  }
+  for(size_t i=1;i<TokenStart.size();++i) TokenStart[i]+=TokenStart[i-1];
+  if(TokenStart.empty()) return;
+
+  //the (position, template) pairs grouped by token
+  std::vector<uint64_t> ByToken(TokenStart.back());
+  std::vector<size_t> PosStart(MaxLen+1,0);
+  std::vector<size_t> Next(TokenStart.begin(),TokenStart.end()-1);
+  for(uint32_t t=0;t<Templates.size();++t){
+    const std::vector<uint32_t>& Template=Templates[t].getTemplate();
+    for(size_t i=0;i<Template.size() && Template[i]!=TokenTable::EndTokenId;++i){
+      ByToken[Next[Template[i]]++]=((uint64_t)i<<32) | t;
+      ++PosStart[i+1];
+    }
+  }
+  for(size_t i=1;i<PosStart.size();++i) PosStart[i]+=PosStart[i-1];
+
+  //the templates grouped by position, then by token
+  size_t ListBase=BaseLists.size();
+  BaseLists.resize(ListBase+ByToken.size());
+  std::vector<uint32_t> SlotTokens(ByToken.size());
+  Next.assign(PosStart.begin(),PosStart.end()-1);
+  for(uint32_t Token=0;Token+1<TokenStart.size();++Token){
+    for(size_t i=TokenStart[Token];i<TokenStart[Token+1];++i){
+      size_t Slot=Next[ByToken[i]>>32]++;
+      BaseLists[ListBase+Slot]=(uint32_t)ByToken[i];
+      SlotTokens[Slot]=Token;
+    }
+  }
+
+  for(size_t Pos=0;Pos<MaxLen;++Pos){
+    for(size_t i=PosStart[Pos],j;i<PosStart[Pos+1];i=j){
+      for(j=i+1;j<PosStart[Pos+1] && SlotTokens[j]==SlotTokens[i];++j);
+      BasePostings.push_back(ModelPosting{getKey(Pos,SlotTokens[i]),(uint32_t)(ListBase+i),(uint32_t)(j-i)});
+    }
+  }
+}
+
+/**
+* Builds the base of the index from an array of templates, the former content of the index is dropped.
+*
+* @param[in] Templates The templates, their positions are the positions in the array
+* @throws std::length_error if the templates have too many tokens to be indexed
+*/
+void TemplateIndex::build(const std::vector<ClusterTemplate>& Templates){
+  clear();
+  //every list entry, node and edge belongs to a token or a template
+  uint64_t Size=Templates.size();
+  for(const ClusterTemplate& ActTempl:Templates) Size+=ActTempl.getTemplate().size();
+  if(Size>=NoMatch) throw std::length_error("The templates have too many tokens to be indexed!");
+
+  buildTrie(Templates);
+  buildPostings(Templates);
+  Base.TemplateCount=Templates.size();
+  Base.Nodes=BaseNodes.data();
+  Base.NodeCount=BaseNodes.size();
+  Base.Edges=BaseEdges.data();
+  Base.EdgeCount=BaseEdges.size();
+  Base.Postings=BasePostings.data();
+  Base.PostingCount=BasePostings.size();
+  Base.Lists=BaseLists.data();
+  Base.ListSize=BaseLists.size();
+}
+
+/**
+* Uses the prebuilt index of a binary cluster model as the base, the former content of the index is dropped.
+* The positions of the templates and the ids of the tokens must be the same as in the model (see TemplateLoader).
+*
+* @param[in] model The opened model, the index keeps it mapped
+*/
+void TemplateIndex::attach(const ModelReader& model){
+  clear();
+  Model=std::make_shared<ModelReader>(model);
+  Base=Model->getIndex();
+}
+
+/**
+* Adds a template to the index (it isn't added to the base)
+*
+* @param[in] Index The position of the template in the array of templates
+* @param[in] Templ The template
+*/
+void TemplateIndex::insert(uint32_t Index,const ClusterTemplate& Templ){
+  const std::vector<uint32_t>& Template=Templ.getTemplate();
+  Node* ActNode=&Root;
+  for(size_t i=0;i<Template.size();++i){
+    if(Template[i]==TokenTable::EndTokenId){
+      ActNode->Open.push_back(Index);
+      return;
+    }
+    Postings[getKey(i,Template[i])].push_back(Index);
+    auto Child=std::lower_bound(ActNode->Children.begin(),ActNode->Children.end(),Template[i],childLess<ChildEdge>);
+    if(Child==ActNode->Children.end() || Child->first!=Template[i]){
+      Child=ActNode->Children.insert(Child,std::make_pair(Template[i],std::unique_ptr<Node>(new Node())));
+    }
+    ActNode=Child->second.get();
+  }
+  ActNode->Complete.push_back(Index);
+}
+
+/**
+* Removes a template from the index. The template must be the same as it was on insert().
+* A template of the base is only marked as removed, the nodes of the other templates' trie
+* that are left without templates and children are freed.
+*
+* @param[in] Index The position of the template in the array of templates
+* @param[in] Templ The template
+*/
+void TemplateIndex::remove(uint32_t Index,const ClusterTemplate& Templ){
+  if(Index<Base.TemplateCount && !isRemoved(Index)){
+    if(Removed.empty()) Removed.resize(Base.TemplateCount,false);
+    Removed[Index]=true;
+    return;
+  }
+
+  auto erase=[Index](std::vector<uint32_t>& List){
+    List.erase(std::remove(List.begin(),List.end(),Index),List.end());
+  };
+
+  const std::vector<uint32_t>& Template=Templ.getTemplate();
+  std::vector<Node*> Path(1,&Root);
+  bool Open=false;
+  for(size_t i=0;i<Template.size();++i){
+    if(Template[i]==TokenTable::EndTokenId){
+      Open=true;
+      break;
+    }
+    auto Posting=Postings.find(getKey(i,Template[i]));
+    if(Posting!=Postings.end()){
+      erase(Posting->second);
+      if(Posting->second.empty()) Postings.erase(Posting);
+    }
+    Node* Child=findChild(*Path.back(),Template[i]);
+    if(Child==NULL) return;
+    Path.push_back(Child);
+  }
+  erase(Open ? Path.back()->Open : Path.back()->Complete);
+
+  //the i-th node of the path is the child of the (i-1)-th node by the (i-1)-th token of the template
+  for(size_t i=Path.size()-1;i>0;--i){
+    const Node* ActNode=Path[i];
+    if(!ActNode->Children.empty() || !ActNode->Complete.empty() || !ActNode->Open.empty()) break;
+    std::vector<ChildEdge>& Children=Path[i-1]->Children;
+    Children.erase(std::lower_bound(Children.begin(),Children.end(),Template[i-1],childLess<ChildEdge>));
+  }
+}
+
+/**
+* @param[in] ActNode A node of the inserted templates' trie
+* @param[in] Token The id of a token
+* @return The child of the node by the token, NULL if there is no such child
+*/
+TemplateIndex::Node* TemplateIndex::findChild(const Node& ActNode,uint32_t Token){
+  auto Child=std::lower_bound(ActNode.Children.begin(),ActNode.Children.end(),Token,childLess<ChildEdge>);
+  return Child!=ActNode.Children.end() && Child->first==Token ? Child->second.get() : NULL;
+}
+
+/**
+* @param[in] ActNode A node of the base trie
+* @param[in] Token The id of a token
+* @return The child of the node by the token, NULL if there is no such child
+*/
+const ModelIndexNode* TemplateIndex::findChild(const ModelIndexNode& ActNode,uint32_t Token) const{
+  const ModelIndexEdge* First=Base.Edges+ActNode.FirstChild;
+  const ModelIndexEdge* Last=First+ActNode.ChildCount;
+  const ModelIndexEdge* Edge=std::lower_bound(First,Last,Token,edgeLess);
+  return Edge!=Last && Edge->Token==Token ? Base.Nodes+Edge->Node : NULL;
+}
+
+/**
+* @param[in] ActNode A node of the trie
+* @return The number of nodes in the subtrie of the node (including the node)
+*/
+size_t TemplateIndex::getNodeCount(const Node& ActNode){
+  size_t Count=1;
+  for(const auto& Child:ActNode.Children) Count+=getNodeCount(*Child.second);
+  return Count;
+}
+
+/**
+* @return The number of nodes in the tries (the roots are counted once), it walks the whole trie of the inserted templates
+*/
+size_t TemplateIndex::getNodeCount() const{
+  return (Base.NodeCount>0 ? Base.NodeCount-1 : 0)+getNodeCount(Root);
+}
+
+/**
+* Keeps the first template of a list of the base that isn't removed, if it precedes the best one found so far
+*
+* @param[in] First The first entry of the list
+* @param[in] Count The number of entries
+* @param[in,out] Best The smallest position of the matching templates found so far
+*/
+void TemplateIndex::keepFirst(uint32_t First,uint32_t Count,uint32_t& Best) const{
+  for(const uint32_t* ActIndex=Base.Lists+First;ActIndex!=Base.Lists+First+Count && *ActIndex<Best;++ActIndex){
+    if(!isRemoved(*ActIndex)){
+      Best=*ActIndex;
+      return;
+    }
+  }
+}
+
+/**
+* Walks the base trie from a node along the tokens of a message, and keeps the
+* smallest template position that matches the message
+*
+* @param[in] ActNode The node of the base trie
+* @param[in] msg The message
+* @param[in] Pos The position of the message that belongs to the node
+* @param[in,out] Best The smallest position of the matching templates found so far
+*/
+void TemplateIndex::findMatch(const ModelIndexNode& ActNode,const std::vector<MessageToken>& msg,size_t Pos,uint32_t& Best) const{
+  if(Pos==msg.size()){
+    keepFirst(ActNode.FirstComplete,ActNode.CompleteCount,Best);
+    return;
+  }
+  keepFirst(ActNode.FirstOpen,ActNode.OpenCount,Best);
+
+  const MessageToken& Token=msg[Pos];
+  const ModelIndexNode* Child=findChild(ActNode,Token.Id);
+  if(Child) findMatch(*Child,msg,Pos+1,Best);
+  if(Token.Id!=TokenTable::AnyTokenId && (Child=findChild(ActNode,TokenTable::AnyTokenId))){ //anything matches *
+    findMatch(*Child,msg,Pos+1,Best);
+  }
+  if(Token.TypeOfToken==Number && Token.Id!=TokenTable::NumberTokenId && (Child=findChild(ActNode,TokenTable::NumberTokenId))){ //numbers match +d
+    findMatch(*Child,msg,Pos+1,Best);
+  }
+}
+
+/**
+* Walks the trie of the inserted templates from a node along the tokens of a message, and keeps the
+* smallest template position that matches the message
+*
+* @param[in] ActNode The node of the inserted templates' trie
+* @param[in] msg The message
+* @param[in] Pos The position of the message that belongs to the node
+* @param[in,out] Best The smallest position of the matching templates found so far
+*/
+void TemplateIndex::findMatch(const Node& ActNode,const std::vector<MessageToken>& msg,size_t Pos,uint32_t& Best) const{
+  if(Pos==msg.size()){
+    for(uint32_t ActIndex:ActNode.Complete) Best=std::min(Best,ActIndex);
+    return;
+  }
+  for(uint32_t ActIndex:ActNode.Open) Best=std::min(Best,ActIndex);
+
+  const MessageToken& Token=msg[Pos];
+  const Node* Child=findChild(ActNode,Token.Id);
+  if(Child) findMatch(*Child,msg,Pos+1,Best);
+  if(Token.Id!=TokenTable::AnyTokenId && (Child=findChild(ActNode,TokenTable::AnyTokenId))){ //anything matches *
+    findMatch(*Child,msg,Pos+1,Best);
+  }
+  if(Token.TypeOfToken==Number && Token.Id!=TokenTable::NumberTokenId && (Child=findChild(ActNode,TokenTable::NumberTokenId))){ //numbers match +d
+    findMatch(*Child,msg,Pos+1,Best);
+  }
+}
+
+/**
+* Finds the template that matches the message exactly (see ClusterTemplate::match())
+*
+* @param[in] msg The message
+* @return The smallest position of the matching templates, NoMatch if there is no matching template
+*/
+uint32_t TemplateIndex::findMatch(const std::vector<MessageToken>& msg) const{
+  uint32_t Best=NoMatch;
+  if(Base.NodeCount>0) findMatch(Base.Nodes[0],msg,0,Best);
+  findMatch(Root,msg,0,Best);
+  return Best;
+}
+
+/**
+* Increments the common token counters of the templates that have a token at a position
+*
+* @param[in] Pos The position
+* @param[in] Id The id of the token
+* @param[in,out] Counts The counters of the templates
+* @param[in,out] Touched The templates whose counter isn't zero
+*/
+void TemplateIndex::count(size_t Pos,uint32_t Id,std::vector<uint32_t>& Counts,std::vector<uint32_t>& Touched) const{
+  uint64_t Key=getKey(Pos,Id);
+  const ModelPosting* Last=Base.Postings+Base.PostingCount;
+  const ModelPosting* BasePosting=std::lower_bound(Base.Postings,Last,Key,postingLess);
+  if(BasePosting!=Last && BasePosting->Key==Key){
+    for(const uint32_t* ActIndex=Base.Lists+BasePosting->First;ActIndex!=Base.Lists+BasePosting->First+BasePosting->Count;++ActIndex){
+      if(!isRemoved(*ActIndex) && Counts[*ActIndex]++==0) Touched.push_back(*ActIndex);
+    }
+  }
+
+  auto Posting=Postings.find(Key);
+  if(Posting==Postings.end()) return;
+  for(uint32_t ActIndex:Posting->second){
+    if(Counts[ActIndex]++==0) Touched.push_back(ActIndex);
+  }
+}
+
+/**
+* Finds the template of the highest goodness for the message (see ClusterTemplate::getGoodness())
+*
+* @param[in] msg The message
+* @param[in] Clusters The array of the indexed templates
+* @param[out] Goodness The goodness of the found template
+* @return The smallest position of the templates of the highest goodness, NoMatch if every goodness is zero
+*/
+uint32_t TemplateIndex::findBest(const std::vector<MessageToken>& msg,const std::vector<ClusterTemplate>& Clusters,double& Goodness) const{
+  static thread_local std::vector<uint32_t> Counts;
+  static thread_local std::vector<uint32_t> Touched;
+  if(Counts.size()<Clusters.size()) Counts.resize(Clusters.size(),0);
+
+  for(size_t i=0;i<msg.size();++i){
+    count(i,msg[i].Id,Counts,Touched);
+    if(msg[i].TypeOfToken==Number && msg[i].Id!=TokenTable::NumberTokenId) count(i,TokenTable::NumberTokenId,Counts,Touched);
+  }
+
+  uint32_t Best=NoMatch;
+  Goodness=0;
+  for(uint32_t ActIndex:Touched){
+    size_t CommonWordCounter=Counts[ActIndex];
+    Counts[ActIndex]=0;
+    double NewAvgLen=(Clusters[ActIndex].getAvgLen()+msg.size())/2;
+    double ActGoodness=CommonWordCounter/NewAvgLen;
+    if(ActGoodness>Goodness || (ActGoodness==Goodness && ActIndex<Best)){
+      Best=ActIndex;
+      Goodness=ActGoodness;
+    }
+  }
+  Touched.clear();
+
+  return Best;
+}
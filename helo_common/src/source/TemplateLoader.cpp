@@ -0,0 +1,99 @@
+#include <algorithm>
+#include "TemplateLoader.h"
+
+/**
+* Constructor
+*
+* @param[in,out] tokens The token table to intern the tokens of the templates in
+* @param[in,out] clusters The array to collect the templates in (it should be empty)
+*/
+TemplateLoader::TemplateLoader(TokenTable& tokens,std::vector<ClusterTemplate>& clusters):
+  Tokens(tokens),Clusters(clusters),MaxId(0),ModelIndexed(false),Sorted(true){}
+
+/**
+* Registers the position of a cluster that is added to the end of the array (it must be called before adding it).
+* If the id doesn't follow the ids of the array, the positions of every cluster are hashed from now on.
+*
+* @param[in] id The id of the cluster
+*/
+void TemplateLoader::addPosition(int64_t id){
+  if(Sorted && !Clusters.empty() && Clusters.back().getId()>=id){
+    Sorted=false;
+    for(size_t i=0;i<Clusters.size();++i) Positions[Clusters[i].getId()]=i;
+  }
+  if(!Sorted) Positions[id]=Clusters.size();
+}
+
+/**
+* @param[in] id The id of a cluster
+* @return The position of the cluster in the array, the size of the array if there is no such cluster
+*/
+size_t TemplateLoader::findPosition(int64_t id) const{
+  if(!Sorted){
+    auto it=Positions.find(id);
+    return it!=Positions.end() ? it->second : Clusters.size();
+  }
+  auto it=std::lower_bound(Clusters.begin(),Clusters.end(),id,[](const ClusterTemplate& Clust,int64_t id){return Clust.getId()<id;});
+  return it!=Clusters.end() && it->getId()==id ? it-Clusters.begin() : Clusters.size();
+}
+
+/**
+* Loads the clusters of a binary cluster model. Each token of the model is interned
+* only once, the templates are only remapped to the ids of the token table.
+* The index of the model can be used if nothing was loaded before.
+*
+* @param[in] model The opened model
+*/
+void TemplateLoader::loadModel(const ModelReader& model){
+  bool Aligned=Clusters.empty();
+  std::vector<uint32_t> TokenIds(model.getTokenCount());
+  Tokens.reserve(Tokens.size()+model.getTokenCount());
+  for(uint32_t i=0;i<TokenIds.size();++i){
+    TokenIds[i]=Tokens.intern(model.getTokenString(i),model.getTokenType(i));
+    Aligned=Aligned && TokenIds[i]==i;
+  }
+
+  Clusters.reserve(Clusters.size()+model.getClusterCount());
+  for(size_t i=0;i<model.getClusterCount();++i){
+    const ModelCluster& ActClust=model.getCluster(i);
+    updateMaxId(ActClust.Id);
+    if(ActClust.TokenCount==0) continue;
+
+    const uint32_t* ModelTemplate=model.getTemplate(i);
+    std::vector<uint32_t> Template(ActClust.TokenCount);
+    for(uint32_t j=0;j<ActClust.TokenCount;++j) Template[j]=TokenIds[ModelTemplate[j]];
+
+    addPosition(ActClust.Id);
+    Clusters.push_back(ClusterTemplate(std::move(Template),ActClust.Goodness,ActClust.AvgLen,ActClust.Id));
+  }
+  ModelIndexed=Aligned && Clusters.size()==model.getIndex().TemplateCount;
+}
+
+/**
+* Adds a row of the clusters table. If a cluster with the same id is already loaded
+* (from the model), it is replaced unless it is the same as the row.
+*
+* @param[in] id The id of the cluster
+* @param[in] TemplateStr The template as it is stored in the database
+* @param[in] goodness The goodness of the cluster
+* @param[in] AvgLen The average line length of the cluster
+* @return true if the row added or changed a cluster
+*/
+bool TemplateLoader::addRow(int64_t id,const std::string& TemplateStr,double goodness,double AvgLen){
+  updateMaxId(id);
+  std::vector<uint32_t> Template=ClusterTemplate::parseTemplate(TemplateStr,Tokens);
+  if(Template.empty()) return false;
+
+  size_t Position=findPosition(id);
+  if(Position==Clusters.size()){
+    addPosition(id);
+    Clusters.push_back(ClusterTemplate(std::move(Template),goodness,AvgLen,id));
+    return true;
+  }
+
+  ClusterTemplate& Loaded=Clusters[Position];
+  if(Loaded.getTemplate()==Template && Loaded.getGoodness()==goodness && Loaded.getAvgLen()==AvgLen) return false;
+  Loaded=ClusterTemplate(std::move(Template),goodness,AvgLen,id);
+  Replaced.push_back(Position);
+  return true;
+}
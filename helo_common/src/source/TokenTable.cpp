@@ -0,0 +1,53 @@
+#include "TokenTable.h"
+
+const uint32_t TokenTable::AnyTokenId;
+const uint32_t TokenTable::NumberTokenId;
+const uint32_t TokenTable::EndTokenId;
+const uint32_t TokenTable::UnknownTokenId;
+
+/**
+ * Constructor, it stores the special template tokens with their reserved ids
+ */
+TokenTable::TokenTable(){
+  intern("*",Word);
+  intern("+d",Number);
+  intern("+n",Word);
+}
+
+/**
+ * Looks up a token, and stores it if it's new.
+ *
+ * @param[in] str The token string (in UTF-8)
+ * @param[in] type The type of the token (it is only used if the token is new)
+ * @return The id of the token
+ */
+uint32_t TokenTable::intern(const std::string& str,wordtype type){
+  auto it=Ids.find(str);
+  if(it!=Ids.end()) return it->second;
+
+  uint32_t id=Tokens.size();
+  Tokens.push_back(TokenDescriptor(str,type));
+  Ids.insert(std::make_pair(str,id));
+  return id;
+}
+
+/**
+ * Looks up a token without storing it.
+ *
+ * @param[in] str The token string
+ * @return The id of the token, or UnknownTokenId if the token is not stored
+ */
+uint32_t TokenTable::find(const std::string& str) const{
+  auto it=Ids.find(str);
+  return it==Ids.end() ? UnknownTokenId : it->second;
+}
+
+/**
+ * Reserves memory for the given number of tokens
+ *
+ * @param[in] count The expected number of tokens
+ */
+void TokenTable::reserve(size_t count){
+  Tokens.reserve(count);
+  Ids.reserve(count);
+}
@@ -0,0 +1,85 @@
+#include <functional>
+#include "ClassificationCache.h"
+#include "lest/lest.hpp"
+
+static inline std::string genKey(const std::vector<std::string>& tokens) {
+    std::vector<TokenDescriptor> line;
+    for (const std::string& token : tokens) line.push_back(TokenDescriptor(token, isdigit((unsigned char)token[0]) ? Number : Word));
+    std::string key;
+    ClassificationCache::makeKey(line, key);
+    return key;
+}
+
+static const lest::test _classificationCacheSuite[] {
+    CASE("ClassificationCache: A stored message is found, other messages are missed") {
+        ClassificationCache cache(1024);
+        int64_t clusterId = 0;
+        cache.insert(genKey({"A", "B", "1"}), 3, 42);
+        EXPECT(cache.find(genKey({"A", "B", "1"}), clusterId));
+        EXPECT(clusterId == 42);
+        EXPECT(!cache.find(genKey({"A", "B", "2"}), clusterId));
+        EXPECT(!cache.find(genKey({"AB", "1"}), clusterId));
+        EXPECT(cache.getHits() == 1u);
+        EXPECT(cache.getMisses() == 2u);
+
+        ClassificationCache disabled(0);
+        disabled.insert(genKey({"A", "B", "1"}), 3, 42);
+        EXPECT(!disabled.isEnabled());
+        EXPECT(!disabled.find(genKey({"A", "B", "1"}), clusterId));
+    },
+    CASE("ClassificationCache: Joining a template invalidates its own entries") {
+        ClassificationCache cache(1024);
+        int64_t clusterId = 0;
+        cache.insert(genKey({"A", "B", "1"}), 3, 42);
+        cache.invalidate(3);
+        EXPECT(!cache.find(genKey({"A", "B", "1"}), clusterId));
+
+        cache.insert(genKey({"A", "B", "1"}), 3, 42); // stored again after the join
+        EXPECT(cache.find(genKey({"A", "B", "1"}), clusterId));
+        EXPECT(clusterId == 42);
+    },
+    CASE("ClassificationCache: Joining a template invalidates the entries of the later templates only") {
+        ClassificationCache cache(1024);
+        int64_t clusterId = 0;
+        cache.insert(genKey({"early"}), 2, 1);
+        cache.insert(genKey({"joined"}), 4, 2);
+        cache.insert(genKey({"later"}), 10, 3);
+        cache.invalidate(4);
+        EXPECT(cache.find(genKey({"early"}), clusterId));
+        EXPECT(clusterId == 1);
+        EXPECT(!cache.find(genKey({"joined"}), clusterId));
+        EXPECT(!cache.find(genKey({"later"}), clusterId)); // the joined template may match it now
+
+        // the Fenwick tree is rebuilt for a far position, the earlier joins are kept
+        cache.insert(genKey({"later"}), 10, 3);
+        cache.insert(genKey({"far"}), 5000, 4);
+        cache.invalidate(3000);
+        EXPECT(cache.find(genKey({"early"}), clusterId));
+        EXPECT(cache.find(genKey({"later"}), clusterId));
+        EXPECT(clusterId == 3);
+        EXPECT(!cache.find(genKey({"far"}), clusterId));
+        cache.invalidate(1);
+        EXPECT(!cache.find(genKey({"early"}), clusterId));
+        EXPECT(!cache.find(genKey({"later"}), clusterId));
+    },
+    CASE("ClassificationCache: A new entry replaces the entry of the same slot (the cache is not LRU)") {
+        // with 1 slot per shard, the keys of the same shard share the slot
+        ClassificationCache cache(CLASSIFICATION_CACHE_SHARDS);
+        std::string first = genKey({"message", "0"}), second;
+        size_t shard = std::hash<std::string>()(first) % CLASSIFICATION_CACHE_SHARDS;
+        for (int i = 1; second.empty(); ++i) {
+            std::string key = genKey({"message", std::to_string(i)});
+            if (std::hash<std::string>()(key) % CLASSIFICATION_CACHE_SHARDS == shard) second = key;
+        }
+
+        int64_t clusterId = 0;
+        cache.insert(first, 0, 1);
+        EXPECT(cache.find(first, clusterId)); // a recent hit doesn't protect the entry
+        cache.insert(second, 1, 2);
+        EXPECT(!cache.find(first, clusterId));
+        EXPECT(cache.find(second, clusterId));
+        EXPECT(clusterId == 2);
+    },
+};
+
+extern const lest::tests classificationCacheSuite(_classificationCacheSuite, _classificationCacheSuite + sizeof(_classificationCacheSuite) / sizeof(*_classificationCacheSuite));
@@ -0,0 +1,46 @@
+#include "ClusterTemplate.h"
+#include "lest/lest.hpp"
+
+static inline std::vector<MessageToken> genMessage(const std::vector<std::string>& tokens, const TokenTable& table) {
+    std::vector<MessageToken> msg;
+    for (const std::string& token : tokens) {
+        wordtype type = isdigit((unsigned char)token[0]) ? Number : Word;
+        msg.push_back(MessageToken(table.find(token), type));
+    }
+    return msg;
+}
+
+static const lest::test _clusterTemplateSuite[] {
+    CASE("parseTemplate: Tokens are interned, only +d is a Number") {
+        TokenTable table;
+        std::vector<uint32_t> templ = ClusterTemplate::parseTemplate("A +d  * B +n ", table);
+        EXPECT(templ.size() == 5u);
+        EXPECT(templ[1] == TokenTable::NumberTokenId);
+        EXPECT(templ[2] == TokenTable::AnyTokenId);
+        EXPECT(templ[4] == TokenTable::EndTokenId);
+        EXPECT(table[templ[0]].TokenString == "A");
+        EXPECT(table[templ[3]].TypeOfToken == Word);
+    },
+    CASE("match: Wildcards match the proper tokens") {
+        TokenTable table;
+        ClusterTemplate templ(ClusterTemplate::parseTemplate("A +d * B", table), 1, 4, 1);
+        EXPECT(templ.match(genMessage({"A", "12", "X", "B"}, table)));
+        EXPECT_NOT(templ.match(genMessage({"A", "X", "X", "B"}, table)));
+        EXPECT_NOT(templ.match(genMessage({"A", "12", "X", "C"}, table)));
+        EXPECT_NOT(templ.match(genMessage({"A", "12", "X"}, table)));
+    },
+    CASE("match: +n matches any remaining tokens") {
+        TokenTable table;
+        ClusterTemplate templ(ClusterTemplate::parseTemplate("A B +n", table), 1, 3, 1);
+        EXPECT(templ.match(genMessage({"A", "B", "C", "D"}, table)));
+        EXPECT_NOT(templ.match(genMessage({"A", "C", "C"}, table)));
+    },
+    CASE("getTemplateStr: The template is stored in the format of parseTemplate") {
+        TokenTable table;
+        ClusterTemplate templ(ClusterTemplate::parseTemplate("A \"x\" +d * +n", table), 1, 5, 1);
+        EXPECT(templ.getTemplateStr(table) == "A \"x\" +d * +n ");
+        EXPECT(ClusterTemplate::parseTemplate(templ.getTemplateStr(table), table) == templ.getTemplate());
+    }
+};
+
+extern const lest::tests clusterTemplateSuite(_clusterTemplateSuite, _clusterTemplateSuite + sizeof(_clusterTemplateSuite) / sizeof(*_clusterTemplateSuite));
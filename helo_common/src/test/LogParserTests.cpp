@@ -3,65 +3,160 @@
 
 static const lest::test _logParserSuite[] {
     CASE("parse: Word determined correctly") {
-        std::wstring str(L"WordTrial");
-        wordtype ret = LogParser(0, L"[\\s+]").parse(str);
+        std::string str("WordTrial");
+        wordtype ret = LogParser(0, "[\\s+]").parse(str);
         EXPECT(ret == Word);
     },
     CASE("parse: Positive number determined correctly") {
-        std::wstring str(L"1234567890");
-        wordtype ret = LogParser(0, L"[\\s+]").parse(str);
+        std::string str("1234567890");
+        wordtype ret = LogParser(0, "[\\s+]").parse(str);
         EXPECT(ret == Number);
     },
     CASE("parse: Negative number determined correctly") {
-        std::wstring str(L"-1234567890");
-        wordtype ret = LogParser(0, L"[\\s+]").parse(str);
+        std::string str("-1234567890");
+        wordtype ret = LogParser(0, "[\\s+]").parse(str);
         EXPECT(ret == Number);
     },
     CASE("parse: Pi is number") {
-        std::wstring str(L"3.141592654");
-        wordtype ret = LogParser(0, L"[\\s+]").parse(str);
+        std::string str("3.141592654");
+        wordtype ret = LogParser(0, "[\\s+]").parse(str);
         EXPECT(ret == Number);
     },
     CASE("parse: coma separated floating is number") {
-        std::wstring str(L"3,141592654");
-        wordtype ret = LogParser(0, L"[\\s+]").parse(str);
+        std::string str("3,141592654");
+        wordtype ret = LogParser(0, "[\\s+]").parse(str);
         EXPECT(ret == Number);
     },
     CASE("parse: Upper hexa determined correctly") {
-        std::wstring str(L"0x1234567890ABCDEF");
-        wordtype ret = LogParser(0, L"[\\s+]").parse(str);
+        std::string str("0x1234567890ABCDEF");
+        wordtype ret = LogParser(0, "[\\s+]").parse(str);
         EXPECT(ret == Number);
     },
     CASE("parse: Lower hexa determined correctly") {
-        std::wstring str(L"0xabcdef1234567890");
-        wordtype ret = LogParser(0, L"[\\s+]").parse(str);
+        std::string str("0xabcdef1234567890");
+        wordtype ret = LogParser(0, "[\\s+]").parse(str);
         EXPECT(ret == Number);
     },
     CASE("parse: Wrong hexa is not number") {
-        std::wstring str(L"0x123fg");
-        wordtype ret = LogParser(0, L"[\\s+]").parse(str);
+        std::string str("0x123fg");
+        wordtype ret = LogParser(0, "[\\s+]").parse(str);
         EXPECT(ret != Number);
     },
     CASE("parse: Hybrid found if first character is not alnum") {
-        std::wstring str(L"#ThisIsHybrid123");
-        wordtype ret = LogParser(0, L"[\\s+]").parse(str);
+        std::string str("#ThisIsHybrid123");
+        wordtype ret = LogParser(0, "[\\s+]").parse(str);
         EXPECT(ret == Hybrid);
     },
     CASE("parse: Hybrid found if middle character is not alnum") {
-        std::wstring str(L"ThisIs&Hybrid123");
-        wordtype ret = LogParser(0, L"[\\s+]").parse(str);
+        std::string str("ThisIs&Hybrid123");
+        wordtype ret = LogParser(0, "[\\s+]").parse(str);
         EXPECT(ret == Hybrid);
     },
     CASE("parse: Hybrid found if last character is not alnum") {
-        std::wstring str(L"ThisIsHybrid123!");
-        wordtype ret = LogParser(0, L"[\\s+]").parse(str);
+        std::string str("ThisIsHybrid123!");
+        wordtype ret = LogParser(0, "[\\s+]").parse(str);
         EXPECT(ret == Hybrid);
     },
     CASE("parse: Hybrid is identified with number prefix") {
-        std::wstring str(L"123xc456");
-        wordtype ret = LogParser(0, L"[\\s]+").parse(str);
+        std::string str("123xc456");
+        wordtype ret = LogParser(0, "[\\s]+").parse(str);
         EXPECT(ret == Hybrid);
     },
+    CASE("tokenize: Header is dropped and tokens are views into the buffer") {
+        LogParser parser(2, "[\\s]+");
+        TokenizedMessage message;
+        EXPECT(parser.tokenize("Oct 19  sshd[12]: Accepted  42 #ab1", message));
+        EXPECT(message.Buffer == "sshd[12]: Accepted 42 #ab1 ");
+        EXPECT(message.Tokens.size() == 4u);
+        EXPECT(message.getToken(0) == "sshd");
+        EXPECT(message.Tokens[0].TypeOfToken == Hybrid);
+        EXPECT(message.getToken(2) == "42");
+        EXPECT(message.Tokens[2].TypeOfToken == Number);
+        EXPECT(message.getToken(3) == "ab");
+    },
+    CASE("tokenize: Trailing white space doesn't repeat the last token") {
+        LogParser parser(0, "[\\s]+");
+        TokenizedMessage message;
+        EXPECT(parser.tokenize("A B C \r", message));
+        EXPECT(message.Tokens.size() == 3u);
+        EXPECT(!parser.tokenize("   ", message));
+    },
+    CASE("tokenize: Custom regular expression gives views as well") {
+        LogParser parser(0, "[\\s=]+");
+        TokenizedMessage message;
+        EXPECT(parser.tokenize("key=value other", message));
+        EXPECT(message.Tokens.size() == 3u);
+        EXPECT(message.getToken(1) == "value");
+        std::vector<TokenDescriptor> tokens;
+        EXPECT(parser.tokenize("key=value other", tokens));
+        EXPECT(tokens.size() == 3u);
+        EXPECT(tokens[2].TokenString == "other");
+    },
+    CASE("tokenize: Matches of a custom regular expression are mapped back to UTF-8 bytes") {
+        LogParser parser(0, "[\\s\xc2\xb7]+");
+        TokenizedMessage message;
+        EXPECT(parser.tokenize("first\xc2\xb7second third", message));
+        EXPECT(message.Tokens.size() == 3u);
+        EXPECT(message.getToken(1) == "second");
+        EXPECT(message.getToken(2) == "third");
+    },
+    CASE("Utf8: National characters are converted without loss") {
+        std::string str("\xc3\xa1rv\xc3\xadzt\xc5\xb1r\xc5\x91 \xe2\x82\xac \xf0\x9f\x98\x80");
+        EXPECT(toUtf8(toWide(str)) == str);
+        EXPECT(toWide(str).size() == 13u);
+    },
+    CASE("Utf8: Invalid bytes are read one by one") {
+        std::string str("a\xff\xc3");
+        size_t pos = 1;
+        EXPECT(decodeUtf8(str.data(), str.size(), pos) == UTF8_REPLACEMENT_CHAR);
+        EXPECT(pos == 2u);
+        EXPECT(decodeUtf8(str.data(), str.size(), pos) == UTF8_REPLACEMENT_CHAR);
+        EXPECT(pos == 3u);
+        LogParser parser(0, "[\\s]+");
+        std::vector<TokenDescriptor> tokens;
+        EXPECT(parser.tokenize("ab\xff" "cd 12", tokens));
+        EXPECT(tokens[0].TokenString == "ab");
+        EXPECT(tokens[1].TypeOfToken == Number);
+    },
+    CASE("addMessage: Tokens are interned only once") {
+        LogParser parser(0, "[\\s]+");
+        std::stringstream input("A B\nB A\n");
+        input >> parser;
+        EXPECT(parser.getDictionary()->size() == 5u);
+        EXPECT(parser.getContent()->front()[0].get() == parser.getContent()->back()[1].get());
+    },
+    CASE("addMessage: Duplicates are stored once with their multiplicity") {
+        LogParser parser(0, "[\\s]+");
+        parser.setDeduplication(true);
+        std::stringstream input("A B 1\nA B 1\nA B 2\nA B 1\n");
+        input >> parser;
+        EXPECT(parser.getContent()->size() == 2u);
+        EXPECT(parser.getMessageCount() == 4u);
+        EXPECT(parser.getWeights()->size() == 1u);
+        EXPECT(parser.getWeights()->at(&parser.getContent()->front()) == 3u);
+    },
+    CASE("addMessage: Numbers are stored in the number table once") {
+        LogParser parser(0, "[\\s]+");
+        parser.setNumberTable(true);
+        size_t dictSize = parser.getDictionary()->size();
+        std::stringstream input("A 1 2\nA 1 3\n");
+        input >> parser;
+        EXPECT(parser.getDictionary()->size() == dictSize + 1);
+        EXPECT(parser.getNumberTable()->size() == 3u);
+        const ArrayOfWords& first = parser.getContent()->front();
+        const ArrayOfWords& second = parser.getContent()->back();
+        EXPECT(first[1].get() == second[1].get());
+        EXPECT(first[2].get() != second[2].get());
+        EXPECT(first[1]->TokenString == "1");
+        EXPECT(first[1]->TypeOfToken == Number);
+    },
+    CASE("addMessage: Duplicates are kept without deduplication") {
+        LogParser parser(0, "[\\s]+");
+        std::stringstream input("A B 1\nA B 1\n");
+        input >> parser;
+        EXPECT(parser.getContent()->size() == 2u);
+        EXPECT(!parser.getWeights());
+    },
 };
 
 extern const lest::tests logParserSuite(_logParserSuite,
@@ -0,0 +1,144 @@
+#include <sstream>
+#include <cstring>
+#include "ModelFile.h"
+#include "lest/lest.hpp"
+
+static inline ArrayOfWords genTemplate(const std::vector<std::string>& tokens) {
+    ArrayOfWords Template;
+    for (const std::string& token : tokens) {
+        wordtype type = Word;
+        if (token == "+d" || isdigit((unsigned char)token[0])) type = Number;
+        Template.push_back(std::make_shared<TokenDescriptor>(token, type));
+    }
+    return Template;
+}
+
+static inline std::string genModel() {
+    ModelWriter writer;
+    writer.addCluster(genTemplate({"A", "+d", "C"}), 0.5, 3, 1);
+    writer.addCluster(genTemplate({"A", "B", "+n"}), 0.75, 4.5, 2);
+    writer.addCluster(genTemplate({"uid", "0"}), 1, 2, 7);
+    writer.addCluster(genTemplate({"árvíztűrő", "B", "C"}), 1, 3, 8);
+
+    std::ostringstream os(std::ios::out | std::ios::binary);
+    writer.write(os);
+    return os.str();
+}
+
+static inline ModelHeader getHeader(const std::string& model) {
+    ModelHeader header;
+    std::memcpy(&header, model.data(), sizeof(header));
+    return header;
+}
+
+static inline void setHeader(std::string& model, const ModelHeader& header) {
+    std::memcpy(&model[0], &header, sizeof(header));
+}
+
+static const lest::test _modelFileSuite[] {
+    CASE("ModelReader: Clusters are read back in order") {
+        std::string model = genModel();
+        ModelReader reader(model.data(), model.size());
+        EXPECT(reader.getClusterCount() == 4u);
+        EXPECT(reader.getCluster(0).Id == 1);
+        EXPECT(reader.getCluster(1).Goodness == 0.75);
+        EXPECT(reader.getCluster(1).AvgLen == 4.5);
+        EXPECT(reader.getCluster(2).Id == 7);
+    },
+    CASE("ModelReader: Tokens are interned") {
+        std::string model = genModel();
+        ModelReader reader(model.data(), model.size());
+        EXPECT(reader.getTokenCount() == 9u); // *, +d and +n are always interned first
+        EXPECT(reader.getTemplate(0)[0] == reader.getTemplate(1)[0]);
+    },
+    CASE("ModelReader: Token types are kept") {
+        std::string model = genModel();
+        ModelReader reader(model.data(), model.size());
+        EXPECT(reader.getCluster(2).TokenCount == 2u);
+        EXPECT(reader.getTokenWString(reader.getTemplate(2)[1]) == L"0");
+        EXPECT(reader.getTokenType(reader.getTemplate(2)[1]) == Number);
+        EXPECT(reader.getTokenType(reader.getTemplate(2)[0]) == Word);
+    },
+    CASE("ModelReader: National characters are stored in UTF-8") {
+        std::string model = genModel();
+        ModelReader reader(model.data(), model.size());
+        uint32_t id = reader.getTemplate(3)[0];
+        EXPECT(reader.getTokenWString(id) == L"árvíztűrő");
+        EXPECT(reader.getTokenString(id) == "\xc3\xa1rv\xc3\xadzt\xc5\xb1r\xc5\x91");
+    },
+    CASE("ModelReader: The generation of the database is kept") {
+        std::string model = genModel();
+        uint64_t generation = 1;
+        EXPECT(!ModelReader(model.data(), model.size()).getGeneration(generation));
+
+        ModelWriter writer;
+        writer.addCluster(genTemplate({"A", "B"}), 1, 2, 1);
+        writer.setGeneration(42);
+        std::ostringstream os(std::ios::out | std::ios::binary);
+        writer.write(os);
+        model = os.str();
+        EXPECT(ModelReader(model.data(), model.size()).getGeneration(generation));
+        EXPECT(generation == 42u);
+    },
+    CASE("ModelReader: Invalid file is rejected") {
+        std::string model = genModel();
+        model[0] = 'X';
+        EXPECT_THROWS_AS(ModelReader(model.data(), model.size()), ModelError);
+    },
+    CASE("ModelReader: Truncated file is rejected") {
+        std::string model = genModel();
+        EXPECT_THROWS_AS(ModelReader(model.data(), model.size() - 8), ModelError);
+    },
+    CASE("ModelReader: Section size that overflows the offset arithmetic is rejected") {
+        std::string model = genModel();
+        ModelHeader header = getHeader(model);
+        header.ClusterCount = 1ull << 61; // ClusterCount*sizeof(ModelCluster) wraps around to 0
+        setHeader(model, header);
+        EXPECT_THROWS_AS(ModelReader(model.data(), model.size()), ModelError);
+    },
+    CASE("ModelReader: Token string that overflows the offset arithmetic is rejected") {
+        std::string model = genModel();
+        ModelHeader header = getHeader(model);
+        ModelToken token;
+        std::memcpy(&token, model.data() + header.TokenTableOffset, sizeof(token));
+        token.StringOffset = ~0ull;
+        std::memcpy(&model[header.TokenTableOffset], &token, sizeof(token));
+        EXPECT_THROWS_AS(ModelReader(model.data(), model.size()), ModelError);
+    },
+    CASE("ModelReader: Cluster template that overflows the offset arithmetic is rejected") {
+        std::string model = genModel();
+        ModelHeader header = getHeader(model);
+        ModelCluster cluster;
+        std::memcpy(&cluster, model.data() + header.ClusterTableOffset, sizeof(cluster));
+        cluster.FirstToken = ~0ull;
+        std::memcpy(&model[header.ClusterTableOffset], &cluster, sizeof(cluster));
+        EXPECT_THROWS_AS(ModelReader(model.data(), model.size()), ModelError);
+    },
+    CASE("ModelReader: Template index edge that points out of the index is rejected") {
+        std::string model = genModel();
+        ModelHeader header = getHeader(model);
+        EXPECT(header.IndexEdgeCount > 0u);
+        ModelIndexEdge edge;
+        std::memcpy(&edge, model.data() + header.IndexEdgeOffset, sizeof(edge));
+        edge.Node = header.IndexNodeCount;
+        std::memcpy(&model[header.IndexEdgeOffset], &edge, sizeof(edge));
+        EXPECT_THROWS_AS(ModelReader(model.data(), model.size()), ModelError);
+    },
+    CASE("ModelReader: Misaligned section is rejected") {
+        std::string model = genModel();
+        ModelHeader header = getHeader(model);
+        header.ClusterTableOffset += 4;
+        setHeader(model, header);
+        EXPECT_THROWS_AS(ModelReader(model.data(), model.size()), ModelError);
+    },
+    CASE("ModelReader: Misaligned buffer is rejected") {
+        std::string model = genModel();
+        std::vector<uint64_t> buffer(model.size() / 8 + 1);
+        char* misaligned = reinterpret_cast<char*>(buffer.data()) + 4;
+        std::memcpy(misaligned, model.data(), model.size());
+        EXPECT_THROWS_AS(ModelReader(misaligned, model.size()), ModelError);
+    },
+};
+
+extern const lest::tests modelFileSuite(_modelFileSuite,
+                                  _modelFileSuite + sizeof(_modelFileSuite) / sizeof(*_modelFileSuite));
@@ -0,0 +1,205 @@
+#include <random>
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include "TemplateIndex.h"
+#include "TemplateLoader.h"
+#include "lest/lest.hpp"
+
+static inline std::vector<MessageToken> genMessage(const std::vector<std::string>& tokens, const TokenTable& table) {
+    std::vector<MessageToken> msg;
+    for (const std::string& token : tokens) {
+        wordtype type = isdigit((unsigned char)token[0]) ? Number : Word;
+        msg.push_back(MessageToken(table.find(token), type));
+    }
+    return msg;
+}
+
+static inline uint32_t linearMatch(const std::vector<ClusterTemplate>& clusters, const std::vector<MessageToken>& msg) {
+    for (uint32_t i = 0; i < clusters.size(); ++i) {
+        if (clusters[i].match(msg)) return i;
+    }
+    return TemplateIndex::NoMatch;
+}
+
+static inline uint32_t linearBest(const std::vector<ClusterTemplate>& clusters, const std::vector<MessageToken>& msg, double& goodness) {
+    uint32_t best = TemplateIndex::NoMatch;
+    goodness = 0;
+    for (uint32_t i = 0; i < clusters.size(); ++i) {
+        double actGoodness = clusters[i].getGoodness(msg);
+        if (actGoodness > goodness) {
+            best = i;
+            goodness = actGoodness;
+        }
+    }
+    return best;
+}
+
+static const lest::test _templateIndexSuite[] {
+    CASE("TemplateIndex: Exact matches handle *, +d and +n, and the first matching template is found") {
+        TokenTable table;
+        std::vector<ClusterTemplate> clusters;
+        clusters.push_back(ClusterTemplate(ClusterTemplate::parseTemplate("A B C", table), 1, 3, 1));
+        clusters.push_back(ClusterTemplate(ClusterTemplate::parseTemplate("A +d * B", table), 1, 4, 2));
+        clusters.push_back(ClusterTemplate(ClusterTemplate::parseTemplate("A * +n", table), 1, 3, 3));
+        clusters.push_back(ClusterTemplate(ClusterTemplate::parseTemplate("A B C", table), 1, 3, 4));
+        TemplateIndex index;
+        for (uint32_t i = 0; i < clusters.size(); ++i) index.insert(i, clusters[i]);
+
+        EXPECT(index.findMatch(genMessage({"A", "B", "C"}, table)) == 0u);
+        EXPECT(index.findMatch(genMessage({"A", "12", "X", "B"}, table)) == 1u);
+        EXPECT(index.findMatch(genMessage({"A", "X", "X", "B"}, table)) == 2u);
+        EXPECT(index.findMatch(genMessage({"A", "B", "D"}, table)) == 2u);
+        EXPECT(index.findMatch(genMessage({"A", "B"}, table)) == TemplateIndex::NoMatch);
+        EXPECT(index.findMatch(genMessage({"B", "B", "C"}, table)) == TemplateIndex::NoMatch);
+
+        index.remove(0, clusters[0]);
+        EXPECT(index.findMatch(genMessage({"A", "B", "C"}, table)) == 2u);
+    },
+    CASE("TemplateIndex: The results are the same as testing the templates one by one, also after joins") {
+        std::mt19937 rnd(42);
+        const std::vector<std::string> words = {"A", "B", "C", "D", "E", "F", "G", "H", "1", "2", "3", "*", "+d"};
+        auto randomTokens = [&](size_t minLen, size_t maxLen, size_t wordCount) {
+            std::vector<std::string> tokens(minLen + rnd() % (maxLen - minLen + 1));
+            for (std::string& token : tokens) token = words[rnd() % wordCount];
+            return tokens;
+        };
+
+        TokenTable table;
+        for (const std::string& word : words) table.intern(word, isdigit((unsigned char)word[0]) ? Number : Word);
+        std::vector<ClusterTemplate> clusters;
+        TemplateIndex index;
+        for (int i = 0; i < 300; ++i) {
+            std::string templ;
+            std::vector<std::string> tokens = randomTokens(2, 6, words.size());
+            for (const std::string& token : tokens) templ += token + " ";
+            if (rnd() % 8 == 0) templ += "+n";
+            clusters.push_back(ClusterTemplate(ClusterTemplate::parseTemplate(templ, table), 1, tokens.size(), i));
+            index.insert(clusters.size() - 1, clusters.back());
+        }
+
+        bool same = true;
+        for (int i = 0; i < 3000; ++i) {
+            std::vector<MessageToken> msg = genMessage(randomTokens(1, 7, words.size() - 2), table);
+            uint32_t expected = linearMatch(clusters, msg);
+            same = same && index.findMatch(msg) == expected;
+            if (expected != TemplateIndex::NoMatch) continue;
+
+            double expectedGoodness, goodness;
+            expected = linearBest(clusters, msg, expectedGoodness);
+            uint32_t best = index.findBest(msg, clusters, goodness);
+            same = same && best == expected && goodness == expectedGoodness;
+            if (best != TemplateIndex::NoMatch && goodness >= 0.3) {
+                index.remove(best, clusters[best]);
+                clusters[best].join(msg, goodness, table);
+                index.insert(best, clusters[best]);
+            }
+        }
+        EXPECT(same);
+    },
+    CASE("TemplateIndex: The built base and the base of a model give the same results as testing the templates one by one") {
+        std::mt19937 rnd(11);
+        const std::vector<std::string> words = {"A", "B", "C", "D", "E", "1", "2", "*", "+d"};
+        auto randomTokens = [&](size_t minLen, size_t maxLen, size_t wordCount) {
+            std::vector<std::string> tokens(minLen + rnd() % (maxLen - minLen + 1));
+            for (std::string& token : tokens) token = words[rnd() % wordCount];
+            return tokens;
+        };
+
+        ModelWriter writer;
+        for (int i = 0; i < 200; ++i) {
+            std::vector<std::string> tokens = randomTokens(1, 5, words.size());
+            if (rnd() % 8 == 0) tokens.push_back("+n");
+            ArrayOfWords templ;
+            for (const std::string& token : tokens) {
+                wordtype type = token == "+d" || isdigit((unsigned char)token[0]) ? Number : Word;
+                templ.push_back(std::make_shared<TokenDescriptor>(token, type));
+            }
+            writer.addCluster(templ, 1, tokens.size(), i + 1);
+        }
+        std::ostringstream os(std::ios::out | std::ios::binary);
+        writer.write(os);
+        std::vector<uint64_t> buffer(os.str().size() / 8 + 1);
+        std::memcpy(buffer.data(), os.str().data(), os.str().size());
+        ModelReader model(reinterpret_cast<const char*>(buffer.data()), os.str().size());
+
+        TokenTable table;
+        std::vector<ClusterTemplate> clusters;
+        TemplateLoader loader(table, clusters);
+        loader.loadModel(model);
+        EXPECT(loader.isModelIndexed());
+        TemplateIndex mapped, built;
+        mapped.attach(model);
+        built.build(clusters);
+        EXPECT(mapped.getBase().NodeCount == built.getBase().NodeCount);
+
+        bool same = true;
+        for (int i = 0; i < 2000; ++i) {
+            std::vector<MessageToken> msg = genMessage(randomTokens(1, 6, words.size() - 2), table);
+            uint32_t expected = linearMatch(clusters, msg);
+            same = same && mapped.findMatch(msg) == expected && built.findMatch(msg) == expected;
+            if (expected != TemplateIndex::NoMatch) continue;
+
+            double expectedGoodness, goodness, builtGoodness;
+            expected = linearBest(clusters, msg, expectedGoodness);
+            uint32_t best = mapped.findBest(msg, clusters, goodness);
+            same = same && best == expected && goodness == expectedGoodness;
+            same = same && built.findBest(msg, clusters, builtGoodness) == expected && builtGoodness == expectedGoodness;
+            if (best != TemplateIndex::NoMatch && goodness >= 0.3) { // the joined template is moved out of the base
+                mapped.remove(best, clusters[best]);
+                built.remove(best, clusters[best]);
+                clusters[best].join(msg, goodness, table);
+                mapped.insert(best, clusters[best]);
+                built.insert(best, clusters[best]);
+            }
+        }
+        EXPECT(same);
+    },
+    CASE("TemplateIndex: The trie doesn't keep the nodes of the removed templates") {
+        std::mt19937 rnd(7);
+        const std::vector<std::string> words = {"A", "B", "C", "D", "E", "F", "G", "H", "1", "2", "3"};
+        TokenTable table;
+        for (const std::string& word : words) table.intern(word, isdigit((unsigned char)word[0]) ? Number : Word);
+        auto randomMessage = [&]() {
+            std::vector<std::string> tokens(3 + rnd() % 4);
+            for (std::string& token : tokens) token = words[rnd() % words.size()];
+            return tokens;
+        };
+
+        std::vector<ClusterTemplate> clusters;
+        TemplateIndex index;
+        EXPECT(index.getNodeCount() == 1u);
+        for (int i = 0; i < 100; ++i) {
+            std::string templ;
+            for (const std::string& token : randomMessage()) templ += token + " ";
+            clusters.push_back(ClusterTemplate(ClusterTemplate::parseTemplate(templ, table), 1, 4, i));
+            index.insert(clusters.size() - 1, clusters.back());
+        }
+
+        // every join moves a template to a new path of the trie
+        size_t maxNodes = 0;
+        for (int i = 0; i < 5000; ++i) {
+            std::vector<MessageToken> msg = genMessage(randomMessage(), table);
+            uint32_t target = rnd() % clusters.size();
+            if (clusters[target].getTemplate().size() != msg.size()) continue;
+            index.remove(target, clusters[target]);
+            clusters[target].join(msg, 0.5, table);
+            index.insert(target, clusters[target]);
+            maxNodes = std::max(maxNodes, index.getNodeCount());
+        }
+
+        size_t bound = 1;
+        for (const ClusterTemplate& cluster : clusters) bound += cluster.getTemplate().size();
+        TemplateIndex rebuilt;
+        for (uint32_t i = 0; i < clusters.size(); ++i) rebuilt.insert(i, clusters[i]);
+        EXPECT(index.getNodeCount() == rebuilt.getNodeCount());
+        EXPECT(maxNodes <= 1 + 100 * 6u);
+        EXPECT(index.getNodeCount() <= bound);
+
+        for (uint32_t i = 0; i < clusters.size(); ++i) index.remove(i, clusters[i]);
+        EXPECT(index.getNodeCount() == 1u);
+        EXPECT(index.findMatch(genMessage({"A", "B", "C"}, table)) == TemplateIndex::NoMatch);
+    }
+};
+
+extern const lest::tests templateIndexSuite(_templateIndexSuite, _templateIndexSuite + sizeof(_templateIndexSuite) / sizeof(*_templateIndexSuite));
@@ -0,0 +1,115 @@
+#include <sstream>
+#include "TemplateLoader.h"
+#include "lest/lest.hpp"
+
+static inline ArrayOfWords genTemplate(const std::vector<std::string>& tokens) {
+    ArrayOfWords Template;
+    for (const std::string& token : tokens) {
+        wordtype type = isdigit((unsigned char)token[0]) ? Number : Word;
+        Template.push_back(std::make_shared<TokenDescriptor>(token, type));
+    }
+    return Template;
+}
+
+static inline std::string genModel() {
+    ModelWriter writer;
+    writer.addCluster(genTemplate({"A", "1", "C"}), 1, 3, 1);
+    writer.addCluster(genTemplate({"uid", "0"}), 1, 2, 2);
+
+    std::ostringstream os(std::ios::out | std::ios::binary);
+    writer.write(os);
+    return os.str();
+}
+
+static inline std::vector<MessageToken> genMessage(const std::vector<std::string>& tokens, const TokenTable& table) {
+    std::vector<MessageToken> msg;
+    for (const std::string& token : tokens) {
+        wordtype type = isdigit((unsigned char)token[0]) ? Number : Word;
+        msg.push_back(MessageToken(table.find(token), type));
+    }
+    return msg;
+}
+
+static const lest::test _templateLoaderSuite[] {
+    CASE("TemplateLoader: The rows of the database are added after the model") {
+        std::string model = genModel();
+        TokenTable tokens;
+        std::vector<ClusterTemplate> clusters;
+        TemplateLoader loader(tokens, clusters);
+        loader.loadModel(ModelReader(model.data(), model.size()));
+        EXPECT(loader.addRow(5, "X Y ", 1, 2));
+        EXPECT(clusters.size() == 3u);
+        EXPECT(clusters[2].getId() == 5);
+        EXPECT(loader.getMaxId() == 5);
+    },
+    CASE("TemplateLoader: Unchanged rows keep the clusters of the model") {
+        std::string model = genModel();
+        TokenTable tokens;
+        std::vector<ClusterTemplate> clusters;
+        TemplateLoader loader(tokens, clusters);
+        loader.loadModel(ModelReader(model.data(), model.size()));
+        EXPECT(!loader.addRow(1, "A 1 C ", 1, 3));
+        EXPECT(clusters.size() == 2u);
+        EXPECT(tokens[clusters[0].getTemplate()[1]].TypeOfToken == Number);
+    },
+    CASE("TemplateLoader: A cluster joined after the model was made is reloaded from the database") {
+        std::string model = genModel();
+        TokenTable tokens;
+        std::vector<ClusterTemplate> clusters;
+        TemplateLoader loader(tokens, clusters);
+        loader.loadModel(ModelReader(model.data(), model.size()));
+
+        //the online algorithm joins a message to cluster 1, and writes the row to the database
+        std::vector<MessageToken> msg = genMessage({"A", "2", "C"}, tokens);
+        ClusterTemplate joined = clusters[0];
+        joined.join(msg, joined.getGoodness(msg), tokens);
+        std::string row = joined.getTemplateStr(tokens);
+        EXPECT(row == "A +d C ");
+
+        //restart: the model is loaded again, then the rows of the database
+        TokenTable reloadedTokens;
+        std::vector<ClusterTemplate> reloaded;
+        TemplateLoader reloader(reloadedTokens, reloaded);
+        reloader.loadModel(ModelReader(model.data(), model.size()));
+        EXPECT(reloader.addRow(1, row, joined.getGoodness(), joined.getAvgLen()));
+        EXPECT(!reloader.addRow(2, "uid 0 ", 1, 2));
+
+        EXPECT(reloaded.size() == 2u);
+        EXPECT(reloaded[0].getId() == 1);
+        EXPECT(reloaded[0].getTemplateStr(reloadedTokens) == "A +d C ");
+        EXPECT(reloaded[0].getGoodness() == joined.getGoodness());
+        EXPECT(reloaded[0].getAvgLen() == joined.getAvgLen());
+        EXPECT(reloaded[0].match(genMessage({"A", "3", "C"}, reloadedTokens)));
+        EXPECT(reloaded[1].getTemplateStr(reloadedTokens) == "uid 0 ");
+        EXPECT(reloader.getMaxId() == 2);
+    },
+    CASE("TemplateLoader: A row replaces its cluster also if the ids are out of order") {
+        std::string model = genModel();
+        TokenTable tokens;
+        std::vector<ClusterTemplate> clusters;
+        TemplateLoader loader(tokens, clusters);
+        loader.loadModel(ModelReader(model.data(), model.size()));
+        EXPECT(loader.isModelIndexed());
+        EXPECT(loader.addRow(5, "B C ", 1, 2));
+        EXPECT(loader.addRow(3, "D E ", 1, 2));
+        EXPECT(loader.addRow(2, "uid +d ", 1, 2));
+        EXPECT(loader.addRow(5, "B * ", 1, 2));
+        EXPECT(clusters.size() == 4u);
+        EXPECT(clusters[1].getTemplateStr(tokens) == "uid +d ");
+        EXPECT(clusters[2].getTemplateStr(tokens) == "B * ");
+        EXPECT(loader.getReplaced() == std::vector<size_t>({1, 2}));
+        EXPECT(loader.getMaxId() == 5);
+    },
+    CASE("TemplateLoader: Rows with empty templates are skipped, but their ids are not reused") {
+        TokenTable tokens;
+        std::vector<ClusterTemplate> clusters;
+        TemplateLoader loader(tokens, clusters);
+        EXPECT(loader.addRow(1, "A B ", 1, 2));
+        EXPECT(!loader.addRow(4, "", 0, 0));
+        EXPECT(clusters.size() == 1u);
+        EXPECT(loader.getMaxId() == 4);
+    },
+};
+
+extern const lest::tests templateLoaderSuite(_templateLoaderSuite,
+                                  _templateLoaderSuite + sizeof(_templateLoaderSuite) / sizeof(*_templateLoaderSuite));
@@ -1,8 +1,19 @@
 #include "lest/lest.hpp"
 
 extern const lest::tests logParserSuite;
+extern const lest::tests modelFileSuite;
+extern const lest::tests clusterTemplateSuite;
+extern const lest::tests templateIndexSuite;
+extern const lest::tests templateLoaderSuite;
+extern const lest::tests classificationCacheSuite;
 
 int main(int argc, char* argv[]) {
-    int ret = lest::run(logParserSuite, argc, argv);
+    lest::tests allTests(logParserSuite);
+    allTests.insert(allTests.end(), modelFileSuite.begin(), modelFileSuite.end());
+    allTests.insert(allTests.end(), clusterTemplateSuite.begin(), clusterTemplateSuite.end());
+    allTests.insert(allTests.end(), templateIndexSuite.begin(), templateIndexSuite.end());
+    allTests.insert(allTests.end(), templateLoaderSuite.begin(), templateLoaderSuite.end());
+    allTests.insert(allTests.end(), classificationCacheSuite.begin(), classificationCacheSuite.end());
+    int ret = lest::run(allTests, argc, argv);
     return ret;
 }
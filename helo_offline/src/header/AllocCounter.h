@@ -0,0 +1,44 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+
+/**
+ * @file AllocCounter.h
+ *
+ * This file contains the interface of the counting allocator hook. The hook replaces
+ * the global operator new and delete, and it is only compiled if COUNT_ALLOC is defined
+ * (make COUNT_ALLOC=yes), as it makes every allocation slower.
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/**
+ * The allocation counters of the process
+ */
+struct AllocStats{
+	/// The number of allocations
+	///
+	uint64_t Allocations;
+
+	/// The number of deallocations
+	///
+	uint64_t Deallocations;
+
+	/// The sum of the allocated bytes
+	///
+	uint64_t AllocatedBytes;
+
+	/// The bytes allocated currently
+	///
+	uint64_t CurrentBytes;
+
+	/// The maximum of CurrentBytes since the start (or since the last resetAllocPeak() call)
+	///
+	uint64_t PeakBytes;
+};
+
+bool isAllocCountingEnabled();
+AllocStats getAllocStats();
+void resetAllocPeak();
+
+#endif
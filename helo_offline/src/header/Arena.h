@@ -0,0 +1,144 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+/**
+ * @file Arena.h
+ *
+ * This file contains the Arena class and the ArenaAllocator which can be used
+ * to allocate the elements of standard containers in an Arena.
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/// The size of the first memory chunk of an arena if there is no size hint
+///
+#define ARENA_MIN_CHUNK_SIZE 4096
+
+/// The chunks of an arena grow exponentially up to this size
+///
+#define ARENA_MAX_CHUNK_SIZE (16*1024*1024)
+
+/**
+ * This class implements a monotonic memory resource. Memory is allocated from large chunks,
+ * deallocation does nothing, and the whole memory is released at once when the arena is destroyed.
+ * Thus allocation is only a pointer increment, and the threads don't contend on the global allocator.
+ * This class is <b>NOT thread-safe</b>, an arena must be filled by one thread at a time.
+ */
+class Arena{
+private:
+	std::vector<char*> Chunks;
+	char* Next;
+	size_t Left;
+	size_t NextChunkSize;
+	size_t AllocatedBytes;
+	static std::atomic<uint64_t> TotalBytes;
+
+	void addChunk(size_t);
+
+public:
+	explicit Arena(size_t SizeHint=ARENA_MIN_CHUNK_SIZE);
+	~Arena();
+	Arena(const Arena&)=delete;
+	Arena& operator=(const Arena&)=delete;
+
+	void* allocate(size_t,size_t);
+
+	/**
+	 * @return The bytes of the chunks allocated by this arena
+	 */
+	size_t getAllocatedBytes() const{return AllocatedBytes;}
+
+	/**
+	 * @return The bytes of the chunks allocated by all arenas since the start of the program
+	 */
+	static uint64_t getTotalBytes(){return TotalBytes.load();}
+};
+
+/**
+ * This class is a standard allocator that allocates memory from an Arena. If no arena is given
+ * it allocates from the heap. Deallocation is a no-op if the memory comes from an arena.
+ *
+ * <p>The arena is propagated on move and swap, but a container copied from an arena based container
+ * allocates from the heap. Thus a copy can be used by any thread without touching the arena.</p>
+ *
+ * @tparam T The type of elements to allocate
+ */
+template<typename T>
+class ArenaAllocator{
+public:
+	/// The type of elements to allocate
+	///
+	typedef T value_type;
+
+	/// The arena is moved together with the container
+	///
+	typedef std::true_type propagate_on_container_move_assignment;
+
+	/// The arena is swapped together with the container
+	///
+	typedef std::true_type propagate_on_container_swap;
+
+	/// The arena to allocate from (NULL means heap)
+	///
+	Arena* Memory;
+
+	/**
+	 * Constructor, it makes an allocator that allocates from the heap
+	 */
+	ArenaAllocator() noexcept:Memory(NULL){}
+
+	/**
+	 * Constructor
+	 * @param[in] Memory The arena to allocate from (NULL means heap)
+	 */
+	explicit ArenaAllocator(Arena* Memory) noexcept:Memory(Memory){}
+
+	/**
+	 * Converting constructor, the new allocator uses the same arena
+	 * @param[in] other The allocator to convert
+	 */
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) noexcept:Memory(other.Memory){}
+
+	/**
+	 * @param[in] n The number of elements to allocate
+	 * @return Pointer to the allocated memory
+	 * @throws std::bad_alloc if the memory can't be allocated
+	 */
+	T* allocate(size_t n){
+		if(Memory!=NULL) return static_cast<T*>(Memory->allocate(n*sizeof(T),alignof(T)));
+		return static_cast<T*>(::operator new(n*sizeof(T)));
+	}
+
+	/**
+	 * @param[in] ptr Pointer to the memory to free
+	 */
+	void deallocate(T* ptr,size_t) noexcept{
+		if(Memory==NULL) ::operator delete(ptr);
+	}
+
+	/**
+	 * @return A heap allocator, a copied container never allocates from the arena
+	 */
+	ArenaAllocator select_on_container_copy_construction() const{return ArenaAllocator();}
+};
+
+/**
+ * @return true if the two allocators use the same arena
+ */
+template<typename T,typename U>
+bool operator==(const ArenaAllocator<T>& first,const ArenaAllocator<U>& second){return first.Memory==second.Memory;}
+
+/**
+ * @return true if the two allocators use different arenas
+ */
+template<typename T,typename U>
+bool operator!=(const ArenaAllocator<T>& first,const ArenaAllocator<U>& second){return first.Memory!=second.Memory;}
+
+#endif
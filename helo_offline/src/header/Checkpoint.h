@@ -0,0 +1,126 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdint>
+#include "cluster.h"
+
+/**
+ * @file Checkpoint.h
+ *
+ * This file contains the Checkpoint class, which saves and restores the state of the split phase
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/// The current version of the checkpoint file format
+///
+#define CHECKPOINT_FILE_VERSION 2
+
+/**
+ * This class represents an exception that is thrown if a checkpoint can't be loaded,
+ * or it doesn't belong to the parsed input.
+ */
+class CheckpointError:public std::runtime_error{
+public:
+	/**
+	 * Constructor
+	 * @param[in] msg The error message
+	 */
+	CheckpointError(const std::string& msg):std::runtime_error(msg){}
+};
+
+/**
+ * <p>This class saves the state of the split phase to a binary file, and restores it. The state consists of
+ * the finished clusters and the clusters still to split. The clusters to split are stored as the indexes of their
+ * lines in the parsed input, the finished clusters are already compressed, thus they are stored as their templates.
+ * The lines and the dictionary are not saved, the input must be parsed again (with the same
+ * options) before the checkpoint is loaded. The number of lines, the size of the dictionary and a hash of the
+ * line lengths are stored to detect if a checkpoint belongs to a different input.</p>
+ *
+ * <p>The file is written to a temporary file first, and then it is renamed, thus a crash during writing
+ * never corrupts the last checkpoint.</p>
+ */
+class Checkpoint{
+public:
+	/**
+	 * The lines of a cluster to split (they are copied from the cluster while the workers are blocked)
+	 */
+	struct LineSet{
+		/// Pointers to the lines of the cluster
+		///
+		std::vector<const ArrayOfWords*> Lines;
+
+		/// The depth of the cluster in the split tree
+		///
+		unsigned int Depth;
+	};
+
+	/**
+	 * A finished cluster that is compressed to its template (see Cluster::compressToTemplate())
+	 */
+	struct CompressedCluster{
+		/// The template of the cluster
+		///
+		ArrayOfWords Template;
+
+		/// The goodness of the cluster
+		///
+		double Goodness;
+
+		/// The number of lines in the original cluster
+		///
+		uint64_t LineCount;
+
+		/// The total length of the lines in the original cluster
+		///
+		uint64_t LineLen;
+
+		/// The depth of the cluster in the split tree
+		///
+		unsigned int Depth;
+	};
+
+private:
+	std::string Path;
+	std::shared_ptr<ListOfLines> Corpus;
+	DictionaryPtr dict;
+	std::shared_ptr<const LineWeights> Weights;
+	uint64_t DictSize;
+	std::vector<std::pair<const ArrayOfWords*,uint32_t> > LineIndex;
+	uint64_t LoadedSplitCount;
+	uint32_t LoadedMaxDepth;
+
+	void buildLineIndex();
+	uint64_t getCorpusHash() const;
+	void writeLineSets(std::ostream&,const std::vector<LineSet>&) const;
+	void readLineSets(std::istream&,const std::vector<const ArrayOfWords*>&,ListOfClusters&) const;
+	void writeTemplates(std::ostream&,const std::vector<CompressedCluster>&) const;
+	void readTemplates(std::istream&,ListOfClusters&) const;
+
+public:
+	Checkpoint(const std::string&,const std::shared_ptr<ListOfLines>,const DictionaryPtr,
+			const std::shared_ptr<const LineWeights> =std::shared_ptr<const LineWeights>());
+	void save(const std::vector<LineSet>&,const std::vector<CompressedCluster>&,uint64_t,uint32_t);
+	void load(ListOfClusters&,ListOfClusters&);
+	bool exists() const;
+	void remove() const;
+
+	/**
+	 * @return The path of the checkpoint file
+	 */
+	const std::string& getPath() const{return Path;}
+
+	/**
+	 * @return The number of Split calls done before the loaded checkpoint was saved
+	 */
+	uint64_t getLoadedSplitCount() const{return LoadedSplitCount;}
+
+	/**
+	 * @return The depth of the split tree when the loaded checkpoint was saved
+	 */
+	uint32_t getLoadedMaxDepth() const{return LoadedMaxDepth;}
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef CORPUS_CACHE_H
+#define CORPUS_CACHE_H
+
+#include <string>
+#include <memory>
+#include <stdexcept>
+#include <cstdint>
+#include "LogParser.h"
+
+/**
+ * @file CorpusCache.h
+ *
+ * This file contains the tokenized corpus cache format (.helotok), and the CorpusCache class that writes and reads it
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/// The current version of the tokenized corpus cache format
+///
+#define CORPUS_CACHE_VERSION 1
+
+/**
+ * \enum CorpusCacheFlags
+ * Flags stored in the header of a tokenized corpus cache
+ */
+enum CorpusCacheFlags{
+	/// The lines were deduplicated (see LogParser::setDeduplication())
+	CorpusDeduplicated=1,
+	/// The numbers were kept in a number table (see LogParser::setNumberTable())
+	CorpusNumberTable=2
+};
+
+/**
+ * This class represents an exception that is thrown if a tokenized corpus cache can't be
+ * opened, it is invalid, or it was made with other settings.
+ */
+class CorpusCacheError:public std::runtime_error{
+public:
+	/**
+	 * Constructor
+	 * @param[in] msg The error message
+	 */
+	CorpusCacheError(const std::string& msg):std::runtime_error(msg){}
+};
+
+/**
+ * The settings of the parser that made a corpus, a cache can only be used with the same settings
+ */
+struct CorpusSettings{
+	/// The length of the header part of the messages
+	///
+	uint32_t HeaderLen;
+
+	/// The regular expression used for tokenizing the messages
+	///
+	std::string Regex;
+
+	/// The name of the localization used to classify the characters
+	///
+	std::string Locale;
+
+	/// The combination of CorpusCacheFlags
+	///
+	uint32_t Flags;
+};
+
+/**
+ * The header at the beginning of a tokenized corpus cache. Every offset is
+ * counted from the beginning of the file, and every section is aligned to 8 bytes.
+ */
+struct CorpusCacheHeader{
+	char Magic[8];
+	uint32_t Version;
+	uint32_t ByteOrder;
+	uint32_t Flags;
+	uint32_t HeaderLen;
+	uint32_t RegexLength;
+	uint32_t LocaleLength;
+	uint64_t DictionaryTokenCount;
+	uint64_t NumberTokenCount;
+	uint64_t LineCount;
+	uint64_t LineTokenCount;
+	uint64_t MessageCount;
+	uint64_t StringTableSize;
+	uint64_t TokenTableOffset;
+	uint64_t LineTableOffset;
+	uint64_t LineTokenOffset;
+	uint64_t WeightTableOffset;
+	uint64_t StringTableOffset;
+	uint64_t FileSize;
+};
+
+/**
+ * A token of the cache. The token string is stored in the string table
+ * in UTF-8 encoding (it is not terminated by zero).
+ */
+struct CorpusToken{
+	uint64_t StringOffset;
+	uint32_t StringLength;
+	uint32_t Type;
+};
+
+/**
+ * <p>This class writes the parsed input (the dictionary, the number table and the lines as token ids) to a binary
+ * cache file, and loads it back, thus repeated runs on the same input (e.g. with other thresholds) don't have to parse
+ * it again. The file is memory mapped when it is loaded, the lines are built straight from the token ids.</p>
+ *
+ * <p>The dictionary tokens are stored first in the order of the dictionary, followed by the tokens of the number
+ * table. The line table stores LineCount+1 offsets into the line tokens, the weight table (only if the lines were
+ * deduplicated) stores the multiplicity of each line. The regular expression and the localization are stored at the
+ * beginning of the string table.</p>
+ */
+class CorpusCache{
+private:
+	std::shared_ptr<ListOfLines> Content;
+	DictionaryPtr dict;
+	std::shared_ptr<LineWeights> Weights;
+	std::shared_ptr<NumberTable> Numbers;
+	size_t MessageCount;
+
+public:
+	CorpusCache(const std::string&,const CorpusSettings&);
+	static bool isCache(const std::string&);
+	static void save(const std::string&,const LogParser&,const CorpusSettings&);
+
+	/**
+	 * @return The lines of the corpus
+	 */
+	const std::shared_ptr<ListOfLines> getContent() const{return Content;}
+
+	/**
+	 * @return The dictionary of the corpus
+	 */
+	const DictionaryPtr getDictionary() const{return dict;}
+
+	/**
+	 * @return The multiplicities of the repeated lines if the corpus was deduplicated, NULL otherwise
+	 */
+	const std::shared_ptr<const LineWeights> getWeights() const{return Weights;}
+
+	/**
+	 * @return The table of the numbers if they were kept out of the dictionary, NULL otherwise
+	 */
+	const std::shared_ptr<const NumberTable> getNumberTable() const{return Numbers;}
+
+	/**
+	 * @return The number of messages in the corpus (including the duplicates)
+	 */
+	size_t getMessageCount() const{return MessageCount;}
+};
+
+#endif
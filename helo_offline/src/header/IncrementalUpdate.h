@@ -0,0 +1,65 @@
+#ifndef INCREMENTAL_UPDATE_H
+#define INCREMENTAL_UPDATE_H
+
+#include <vector>
+#include <SQLiteCpp/SQLiteCpp.h>
+#include "ClusterTemplate.h"
+#include "TemplateIndex.h"
+#include "ModelFile.h"
+#include "cluster.h"
+
+/**
+ * @file IncrementalUpdate.h
+ *
+ * This file contains the IncrementalUpdate class
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/**
+ * <p>This class implements the incremental update of an existing cluster database. The clusters
+ * of the database are loaded as templates, and the new log messages are classified against them
+ * (with the same matching rules and the same TemplateIndex as the online algorithm uses). Only the messages
+ * that match no template have to be clustered by the offline algorithm.</p>
+ *
+ * <p>The new clusters are merged into the existing ones if they are similar enough (with the same
+ * rules as the clusters are merged by the offline algorithm), otherwise they are added as new
+ * clusters. Thus the ids of the existing clusters don't change.</p>
+ *
+ * <p>The weight of an existing cluster in a merge is its whole history: the number and the total length of
+ * its lines are read from the cluster_stats table (written by the offline algorithm and kept up to date by the
+ * online algorithm), and the lines matched now are added to them. The clusters written before cluster_stats
+ * existed have no history, only the lines matched now are counted for them (at least 1 line).</p>
+ */
+class IncrementalUpdate{
+private:
+	TokenTable Tokens;
+	std::vector<ClusterTemplate> Templates;
+	TemplateIndex Index;
+	std::vector<size_t> MatchedLines;
+	std::vector<size_t> MatchedLen;
+	std::vector<size_t> HistoryLines;
+	std::vector<size_t> HistoryLen;
+	std::vector<Cluster> ExistingClusters;
+	std::vector<bool> Updated;
+	std::vector<MessageToken> LineIds;
+	size_t TotalMatched;
+
+public:
+	IncrementalUpdate(SQLite::Database&);
+	bool classify(const std::vector<TokenDescriptor>&);
+	size_t merge(ListOfClusters&,const DictionaryPtr,double);
+	size_t save(SQLite::Database&);
+	void addToModel(ModelWriter&);
+
+	/**
+	 * @return The number of clusters loaded from the database
+	 */
+	size_t getTemplateCount() const{return Templates.size();}
+
+	/**
+	 * @return The number of messages that matched an existing template
+	 */
+	size_t getMatchedLines() const{return TotalMatched;}
+};
+
+#endif
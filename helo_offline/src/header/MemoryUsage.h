@@ -0,0 +1,50 @@
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <string>
+#include <cstddef>
+#include <memory>
+#include "LogParser.h"
+
+/**
+ * @file MemoryUsage.h
+ *
+ * This file contains the MemoryUsage class
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/// The estimated size of a node of std::set/std::map without the stored value
+/// (color, parent, left and right pointers)
+///
+#define TREE_NODE_OVERHEAD (4*sizeof(void*))
+
+/// The estimated size of a node of std::list without the stored value (previous and next pointers)
+///
+#define LIST_NODE_OVERHEAD (2*sizeof(void*))
+
+/// The estimated size of the control block of std::make_shared without the stored value
+///
+#define SHARED_BLOCK_OVERHEAD (2*sizeof(void*))
+
+/**
+ * This class collects utilities that can be used to measure the memory usage of the process,
+ * and to estimate the memory held by the main data structures of the algorithm.
+ * The estimations count the memory allocated by the containers (nodes, buffers and
+ * heap allocated strings), but they don't count the overhead of the memory allocator.
+ */
+class MemoryUsage{
+private:
+	MemoryUsage();
+
+public:
+	static size_t getPeakRss();
+	static size_t getCurrentRss();
+	static bool resetPeakRss();
+
+	static size_t estimate(const std::string&);
+	static size_t estimate(const Dictionary&);
+	static size_t estimate(const NumberTable&);
+	static size_t estimate(const ListOfLines&);
+};
+
+#endif
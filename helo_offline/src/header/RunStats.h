@@ -0,0 +1,74 @@
+#ifndef RUN_STATS_H
+#define RUN_STATS_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <ostream>
+#include <chrono>
+#include <ctime>
+#include <cstdint>
+#include "AllocCounter.h"
+
+/**
+ * @file RunStats.h
+ *
+ * This file contains the RunStats class
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/// The version of the written statistics report, it must be increased if a field is renamed or removed
+///
+#define RUN_STATS_VERSION 1
+
+/**
+ * This class collects statistics about a run of the offline algorithm: the wall clock and
+ * CPU time spent in each phase, the peak memory usage of each phase, and some counters
+ * (number of lines, tokens, estimated size of data structures, etc.).
+ * If the counting allocator hook is compiled in (COUNT_ALLOC), the allocations of each phase are reported as well.
+ * The collected data can be written in JSON format, so the runs can be compared to each other.
+ * This class is <b>NOT thread-safe</b>, it should be used by the main thread only.
+ */
+class RunStats{
+private:
+	/**
+	 * The measured values of a finished phase
+	 */
+	struct Phase{
+		std::string Name;
+		double WallTime;
+		double CpuTime;
+		size_t PeakRss;
+		size_t EndRss;
+		AllocStats Allocs;
+	};
+
+	std::vector<std::pair<std::string,std::string> > Info;
+	std::vector<Phase> Phases;
+	std::vector<std::pair<std::string,uint64_t> > Counters;
+	std::string ActPhase;
+	std::chrono::steady_clock::time_point PhaseWallStart;
+	std::clock_t PhaseCpuStart;
+	AllocStats PhaseAllocStart;
+	bool PeakRssResettable;
+
+	static std::string escape(const std::string&);
+
+public:
+	RunStats():PhaseCpuStart(0),PhaseAllocStart(getAllocStats()),PeakRssResettable(true){}
+
+	void setInfo(const std::string&,const std::string&);
+	void beginPhase(const std::string&);
+	void endPhase();
+	void setCounter(const std::string&,uint64_t);
+	uint64_t getCounter(const std::string&) const;
+	void write(std::ostream&) const;
+	void save(const std::string&) const;
+
+	/**
+	 * @return The number of finished phases
+	 */
+	size_t getPhaseCount() const{return Phases.size();}
+};
+
+#endif
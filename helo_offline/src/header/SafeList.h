@@ -112,6 +112,15 @@ public:
 		list.push_back(elem);
 	}
 
+	/**
+	 * This method moves an element to the end of the list.
+	 * @param[in] elem The element to move
+	 */
+	void push_back(T&& elem){
+		std::lock_guard<std::mutex> g(mutex);
+		list.push_back(std::move(elem));
+	}
+
 	/**
 	 * @return Tells whether the list is empty
 	 */
@@ -122,7 +131,7 @@ public:
 
 	/**
 	 * This method tests if the list is empty, and deletes the first element,
-	 * and finally returns it.
+	 * and finally returns it (the element is moved out of the list).
 	 *
 	 * @throws Throws EmptyContainer if the list is empty
 	 * @return The popped element
@@ -130,7 +139,7 @@ public:
 	T pop_front(){
 		std::lock_guard<std::mutex> g(mutex);
 		if(list.empty()) throw EmptyContainer("List is empty!");
-		T ret=list.front();
+		T ret=std::move(list.front());
 		list.pop_front();
 		return ret;
 	}
@@ -145,6 +154,14 @@ public:
 		return list.erase(it);
 	}
 
+	/**
+	 * This method deletes all elements.
+	 */
+	void clear(){
+		std::lock_guard<std::mutex> g(mutex);
+		list.clear();
+	}
+
 };
 
 #endif
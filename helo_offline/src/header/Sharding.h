@@ -0,0 +1,69 @@
+#ifndef SHARDING_H
+#define SHARDING_H
+
+#include <string>
+#include <cstdint>
+#include "cluster.h"
+
+/**
+ * @file Sharding.h
+ *
+ * This file contains the utilities of the sharded (multi-process) offline clustering
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/**
+ * This class describes the part of the input file processed by one shard.
+ * The boundaries are always at the beginning of a line.
+ */
+class ShardRange{
+public:
+	/// The offset of the first byte of the shard
+	///
+	uint64_t Begin;
+
+	/// The offset of the first byte after the shard
+	///
+	uint64_t End;
+
+	/// The number of lines in the shard
+	///
+	size_t LineCount;
+
+	ShardRange():Begin(0),End(0),LineCount(0){}
+};
+
+/**
+ * <p>This class implements the sharded offline clustering. The input file is divided into byte ranges
+ * (at line boundaries), and each range can be clustered by a separate process (shard). A shard writes
+ * a partial template set: the templates of its clusters together with their line counts and total line
+ * lengths.</p>
+ *
+ * <p>The partial template sets of the shards are merged into one result the same way as the clusters of
+ * one run are merged (see Cluster::join()). As the line counts are kept, the average line lengths of the
+ * merged clusters are the same as they would be in one run.</p>
+ */
+class Sharding{
+private:
+	static uint64_t alignToLine(std::istream&,uint64_t,uint64_t);
+
+public:
+	/// The root XML tag of a partial template set
+	///
+	static const wchar_t* PartialNodeName;
+
+	/// The XML attribute of a cluster node that stores the number of lines in the cluster
+	///
+	static const wchar_t* LineCountAttributeName;
+
+	/// The XML attribute of a cluster node that stores the total length of lines in the cluster
+	///
+	static const wchar_t* LineLenAttributeName;
+
+	static ShardRange getRange(const std::string&,unsigned int,unsigned int);
+	static void readRange(const std::string&,const ShardRange&,LogParser&);
+	static void writePartial(const std::string&,ListOfClusters&);
+	static void readPartial(const std::string&,const DictionaryPtr,ListOfClusters&);
+};
+
+#endif
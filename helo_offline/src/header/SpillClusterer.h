@@ -0,0 +1,159 @@
+#ifndef SPILL_CLUSTERER_H
+#define SPILL_CLUSTERER_H
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <functional>
+#include <cstdint>
+#include "LogParser.h"
+#include "TokenTable.h"
+#include "cluster.h"
+
+/**
+ * @file SpillClusterer.h
+ *
+ * This file contains the out-of-core (spill) mode of the offline algorithm
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/// The bytes of partition data buffered in the memory before the buffers are written to disk
+///
+#define SPILL_BUFFER_SIZE (16*1024*1024)
+
+/**
+ * This class calculates the same statistics about a stream of lines as Cluster does about
+ * its lines in the memory, thus the split position, the goodness and the template of a
+ * partition can be determined without loading its lines. The lines are given as token ids.
+ */
+class StreamStatistics{
+private:
+	std::vector<std::unordered_set<uint32_t> > Values;
+	std::vector<size_t> FilledColumns;
+	std::vector<size_t> FilledNonNumColumns;
+	std::vector<uint32_t> FirstLine;
+	size_t LineCount;
+	size_t TotalLineLen;
+	size_t DistinctCount;
+
+public:
+	StreamStatistics():LineCount(0),TotalLineLen(0),DistinctCount(0){}
+	void add(const std::vector<uint32_t>&,const TokenTable&);
+	int getSplit() const;
+	double getGoodness() const;
+	std::vector<uint32_t> getTemplate() const;
+	size_t estimateClusterBytes() const;
+
+	/**
+	 * @return The number of lines added
+	 */
+	size_t getLineCount() const{return LineCount;}
+
+	/**
+	 * @return The total length (number of tokens) of the added lines
+	 */
+	size_t getTotalLineLen() const{return TotalLineLen;}
+};
+
+/**
+ * <p>This class implements the spill mode of the offline algorithm, it can cluster logs that
+ * don't fit in the memory. The input is read in a streaming way, only the dictionary
+ * and the statistics of the first cluster are kept in the memory.</p>
+ *
+ * <p>If the estimated memory need of the whole file exceeds the memory budget, the file is
+ * split on disk: the lines are written to partition files (one per subcluster) as token ids.
+ * A partition that is still too large is split again the same way. A partition whose goodness
+ * reaches the threshold becomes an output cluster directly (its template is calculated from
+ * the statistics). The other partitions are loaded into the memory in batches that fit in the
+ * budget, and the clusters of a batch are split in parallel by a ThreadPool. The templates of
+ * all partitions are merged by the caller globally, as usual.</p>
+ *
+ * <p>The split decisions are the same as the ones made in the memory, thus the resulting
+ * clusters are the same, only their order may differ.</p>
+ */
+class SpillClusterer{
+private:
+	/**
+	 * A partition of the input that is stored in a file
+	 */
+	struct Partition{
+		std::string Path;
+		StreamStatistics Stats;
+		unsigned int Depth;
+		uint32_t Label;
+		std::vector<uint32_t> Buffer;
+	};
+
+	LogParser Parser;
+	size_t Budget;
+	std::string SpillPrefix;
+	double lim;
+	unsigned int numThreads;
+	TokenTable Tokens;
+	std::vector<std::shared_ptr<TokenDescriptor> > TokenPtrs;
+	DictionaryPtr dict;
+	StreamStatistics RootStats;
+	size_t FileCounter;
+	size_t PartitionCount;
+	uint64_t SpilledBytes;
+	size_t SplitCount;
+	unsigned int MaxDepth;
+	std::vector<Partition> Batch;
+	size_t BatchBytes;
+	size_t Available;
+
+	void readText(std::istream&,const std::function<void(const std::vector<uint32_t>&)>&);
+	void readPartition(const std::string&,const std::function<void(const std::vector<uint32_t>&)>&) const;
+	void flush(Partition&);
+	void split(const std::string&,bool,const StreamStatistics&,unsigned int,ListOfClusters&);
+	void process(Partition&,ListOfClusters&);
+	void processBatch(ListOfClusters&);
+	void buildDictionary();
+
+public:
+	SpillClusterer(size_t,const std::string&,size_t,const std::string&,double,unsigned int);
+	bool analyze(std::istream&);
+	void run(const std::string&,ListOfClusters&);
+
+	/**
+	 * @return The number of distinct tokens of the input
+	 */
+	size_t getDictionarySize() const{return Tokens.size();}
+
+	/**
+	 * @return The number of lines of the input
+	 */
+	size_t getLineCount() const{return RootStats.getLineCount();}
+
+	/**
+	 * @return The number of tokens of the input
+	 */
+	size_t getTokenCount() const{return RootStats.getTotalLineLen();}
+
+	/**
+	 * @return The estimated memory need of clustering the whole input in the memory
+	 */
+	size_t getEstimatedBytes() const{return RootStats.estimateClusterBytes();}
+
+	/**
+	 * @return The number of partition files written
+	 */
+	size_t getPartitionCount() const{return PartitionCount;}
+
+	/**
+	 * @return The bytes written to partition files
+	 */
+	uint64_t getSpilledBytes() const{return SpilledBytes;}
+
+	/**
+	 * @return The number of splits made on disk
+	 */
+	size_t getSplitCount() const{return SplitCount;}
+
+	/**
+	 * @return The depth of the deepest partition
+	 */
+	unsigned int getMaxDepth() const{return MaxDepth;}
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef SPLIT_TREE_H
+#define SPLIT_TREE_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdexcept>
+#include <cstdint>
+#include <unordered_map>
+#include "cluster.h"
+
+/**
+ * @file SplitTree.h
+ *
+ * This file contains the SplitTree class, which records the whole split hierarchy of a run
+ * @author Jenei Gábor <jengab@elte.hu>
+ */
+
+/// The current version of the split tree file format
+///
+#define SPLIT_TREE_FILE_VERSION 1
+
+/// The label of the root node (it isn't made by a split)
+///
+#define SPLIT_TREE_NO_LABEL 0xFFFFFFFFu
+
+/**
+ * This class represents an exception that is thrown if a split tree file can't be loaded.
+ */
+class SplitTreeError:public std::runtime_error{
+public:
+	/**
+	 * Constructor
+	 * @param[in] msg The error message
+	 */
+	SplitTreeError(const std::string& msg):std::runtime_error(msg){}
+};
+
+/**
+ * <p>This class records the split hierarchy of the split phase: every cluster made by a split is a node with its
+ * statistics, goodness, template, the column it was split on, and the label (the token of the split column) it got
+ * from its parent. If the input is split until no cluster can be split further (a goodness threshold of 1), the
+ * tree contains the result of every goodness threshold, thus it can be cut at any threshold (see cut()) without
+ * parsing and splitting the input again.</p>
+ *
+ * <p>The tokens of the templates and the labels are stored once in a token table, the nodes refer to them by index.
+ * The tree can be saved to a compact binary file and loaded back (see save() and load()).</p>
+ */
+class SplitTree{
+public:
+	/**
+	 * A cluster of the split hierarchy
+	 */
+	struct Node{
+		/// The depth of the cluster in the split tree (the root has depth 0)
+		///
+		uint32_t Depth;
+
+		/// The goodness of the cluster
+		///
+		double Goodness;
+
+		/// The number of lines in the cluster
+		///
+		uint64_t LineCount;
+
+		/// The total length (number of tokens) of the lines in the cluster
+		///
+		uint64_t LineLen;
+
+		/// The column the cluster was split on, -1 if it wasn't split (it is good enough or it can't be split)
+		///
+		int32_t SplitColumn;
+
+		/// The index of the split column's token in the parent (SPLIT_TREE_NO_LABEL for the root)
+		///
+		uint32_t Label;
+
+		/// The template of the cluster as indexes of the token table
+		///
+		std::vector<uint32_t> Template;
+
+		/// The indexes of the subclusters in the order they were made by the split
+		///
+		std::vector<uint32_t> Children;
+	};
+
+private:
+	DictionaryPtr dict;
+	std::vector<Node> Nodes;
+	std::vector<std::shared_ptr<TokenDescriptor> > Tokens;
+	std::unordered_map<const TokenDescriptor*,uint32_t> TokenIds;
+	std::mutex Locker;
+
+	uint32_t getTokenId(const std::shared_ptr<TokenDescriptor>&);
+	uint32_t addNode(Cluster&,uint32_t);
+
+public:
+	SplitTree(const DictionaryPtr);
+	void setRoot(Cluster&);
+	void addSplit(Cluster&,int,ListOfClusters&);
+	void cut(double,ListOfClusters&) const;
+	void save(const std::string&) const;
+	void load(const std::string&);
+
+	/**
+	 * @return The number of nodes in the tree
+	 */
+	size_t size() const{return Nodes.size();}
+
+	/**
+	 * @param[in] i The index of the node (0 <= i < size(), the root is 0)
+	 * @return The i-th node of the tree
+	 */
+	const Node& getNode(size_t i) const{return Nodes[i];}
+
+	/**
+	 * @param[in] i The index of the token (see Node::Template and Node::Label)
+	 * @return The i-th token of the token table
+	 */
+	const TokenDescriptor& getToken(size_t i) const{return *Tokens[i];}
+};
+
+#endif
@@ -3,7 +3,12 @@
 
 #include "SafeList.h"
 #include "cluster.h"
+#include "Checkpoint.h"
+#include "SplitTree.h"
 #include <thread>
+#include <atomic>
+#include <shared_mutex>
+#include <condition_variable>
 
 /**
  * @file ThreadPool.h
@@ -15,6 +20,16 @@
 /**
  * This class implements a producer-consumer model for clusters.
  * Thus cluster splitting can be done in a parallel way, which speeds up the algorithm.
+ * The clusters that are good enough are compressed to their templates by the workers
+ * (see Cluster::compressToTemplate()) before they are stored in the output.
+ *
+ * <p>If a Checkpoint is given, the state of the split phase is saved periodically by a separate thread.
+ * The workers hold a shared lock only while they take a cluster or store its subclusters, the checkpoint
+ * thread holds the exclusive lock only while it copies the line pointers of the clusters to split, and collects
+ * the clusters finished since the previous checkpoint. The templates of these clusters are copied after the lock
+ * is released (a finished cluster doesn't change), and they are kept for the next checkpoints, then the file is written.</p>
+ *
+ * <p>If a SplitTree is given, every split is recorded in it (the starting clusters must be recorded already).</p>
  */
 class ThreadPool{
 private:
@@ -25,12 +40,52 @@ private:
 	std::mutex BusyLocker;
 	std::mutex ErrorLocker;
 	std::vector<bool> Busy;
+	std::atomic<size_t> SplitCount;
+	std::atomic<unsigned int> MaxDepth;
+	Checkpoint* Saver;
+	unsigned int Interval;
+	SplitTree* Tree;
+	std::shared_timed_mutex StateLock;
+	std::vector<const Cluster*> InFlight;
+	std::vector<Checkpoint::CompressedCluster> Finished;
+	ListOfClusters::iterator LastFinished;
+	size_t FinishedCount;
+	std::thread CheckpointThread;
+	std::mutex StopLocker;
+	std::condition_variable StopSignal;
+	bool Stopping;
+	size_t CheckpointCount;
+	uint64_t MaxCheckpointPause;
 	void ThreadFunction(size_t id);
+	void CheckpointFunction();
+	void saveCheckpoint();
+	void start(size_t);
 
 public:
-	ThreadPool(size_t,Cluster,ListOfClusters&,double);
+	ThreadPool(size_t,Cluster,ListOfClusters&,double,Checkpoint* =NULL,unsigned int=0,SplitTree* =NULL);
+	ThreadPool(size_t,ListOfClusters&,ListOfClusters&,double,Checkpoint* =NULL,unsigned int=0,SplitTree* =NULL);
 	bool isBusy();
 	void joinAll();
+
+	/**
+	 * @return The number of checkpoints written so far
+	 */
+	size_t getCheckpointCount() const{return CheckpointCount;}
+
+	/**
+	 * @return The longest time (in microseconds) the workers were blocked by a checkpoint
+	 */
+	uint64_t getMaxCheckpointPause() const{return MaxCheckpointPause;}
+
+	/**
+	 * @return The number of Cluster::Split calls made by the threads so far (including the failed ones)
+	 */
+	size_t getSplitCount() const{return SplitCount.load();}
+
+	/**
+	 * @return The depth of the deepest cluster processed so far in the split tree
+	 */
+	unsigned int getMaxDepth() const{return MaxDepth.load();}
 };
 
 #endif
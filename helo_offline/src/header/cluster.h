@@ -5,6 +5,7 @@
 #include <SQLiteCpp/SQLiteCpp.h>
 #include "LogParser.h"
 #include "SafeList.h"
+#include "Arena.h"
 
 /**
  * @file cluster.h
@@ -17,35 +18,75 @@
 ///
 #define PERCENT_OF_FILL 0.5
 
+/**
+ * \c typedef for the lines of a cluster, these are pointers to the lines of the parsed file
+ */
+typedef std::vector<const ArrayOfWords*,ArenaAllocator<const ArrayOfWords*> > LineVector;
+
+/**
+ * \c typedef for the distinct tokens of a column. As the tokens are stored in the dictionary,
+ * each token string has exactly one TokenDescriptor, thus the tokens can be compared by address.
+ */
+typedef std::set<const TokenDescriptor*,std::less<const TokenDescriptor*>,ArenaAllocator<const TokenDescriptor*> > TokenSet;
+
 /**
  * This class represents a cluster, it also stores all the statistics,
  * that we need to split this cluster to subclusters.
+ *
+ * <p>The lines are not copied into the clusters, a cluster only stores pointers
+ * to the lines of the parsed file (Corpus). The lines and the statistics of
+ * the subclusters made by one Split() call are allocated from one Arena, which
+ * is released at once when the last cluster of the group is destroyed or compressed.</p>
  */
 class Cluster{
 
     private:
-        std::shared_ptr<ListOfLines> Content;
+        std::shared_ptr<const ListOfLines> Corpus;
+        std::shared_ptr<Arena> Memory;
+        std::shared_ptr<const ArrayOfWords> TemplateLine;
+        LineVector Lines;
         DictionaryPtr dict;
-        std::vector< std::set<std::shared_ptr<TokenDescriptor>,WordComparator> > Values;
-        std::vector<size_t> FilledColumns;
-        std::vector<size_t> FilledNonNumColumns;
+        std::shared_ptr<const LineWeights> Weights;
+        std::vector<TokenSet,ArenaAllocator<TokenSet> > Values;
+        std::vector<size_t,ArenaAllocator<size_t> > FilledColumns;
+        std::vector<size_t,ArenaAllocator<size_t> > FilledNonNumColumns;
         size_t TotalLineCount;
         size_t MaxLineLen;
         double goodness;
         unsigned int id;
         size_t TotalLineLen;
+        unsigned int depth;
+        unsigned int TreeNode;
 
         //private methods
         int getSplit();
         void CalcStatistics();
+        Cluster(const Cluster&,LineVector&&,const std::shared_ptr<Arena>&);
+        void setTemplateLine(ArrayOfWords&&);
+
+        /**
+         * @param[in] line A line of the cluster
+         * @return The multiplicity of the line (1 if the input was not deduplicated)
+         */
+        size_t getWeight(const ArrayOfWords* line) const{
+            if(!Weights) return 1;
+            auto it=Weights->find(line);
+            return it==Weights->end() ? 1 : it->second;
+        }
 
     public:
-        void Split(SafeList<Cluster>&);
+        int Split(SafeList<Cluster>&);
         ArrayOfWords getTemplate() const;
         void compressToTemplate();
-        Cluster(const std::shared_ptr<ListOfLines>,const DictionaryPtr);
+        Cluster(const std::shared_ptr<ListOfLines>,const DictionaryPtr,unsigned int=0,
+                const std::shared_ptr<const LineWeights> =std::shared_ptr<const LineWeights>());
+        Cluster(const std::shared_ptr<ListOfLines>,const std::vector<const ArrayOfWords*>&,const DictionaryPtr,unsigned int,
+                const std::shared_ptr<const LineWeights> =std::shared_ptr<const LineWeights>());
+        Cluster(ArrayOfWords&&,double,size_t,size_t,const DictionaryPtr,unsigned int);
         double getGoodness();
         double getGoodness(Cluster&);
+        size_t getStatisticsBytes() const;
+        size_t getContentBytes() const;
         void join(Cluster&);
         friend std::wostream& operator<<(std::wostream&,const Cluster&);
         friend SQLite::Database& operator<<(SQLite::Database&,const Cluster&);
@@ -58,10 +99,29 @@ class Cluster{
         }
 
         /**
-         * @return The list of lines that currently belong to the cluster (by address)
+         * @return The number of lines in the original cluster (it is kept when the cluster is compressed)
          */
-        const std::shared_ptr<const ListOfLines> getContent() const {
-            return Content;
+        size_t getTotalLineCount() const{return TotalLineCount;}
+
+        /**
+         * @return The total length (number of tokens) of the lines in the original cluster
+         */
+        size_t getTotalLineLen() const{return TotalLineLen;}
+
+        /**
+         * @return The number of distinct lines that currently belong to the cluster (if the input was deduplicated,
+         * see getTotalLineCount() for the number of lines with the duplicates)
+         */
+        size_t getLineCount() const {
+            return Lines.size();
+        }
+
+        /**
+         * @param[in] i The index of the line (0 <= i < getLineCount())
+         * @return The i-th line of the cluster
+         */
+        const ArrayOfWords& getLine(size_t i) const {
+            return *Lines[i];
         }
 
         /**
@@ -76,12 +136,40 @@ class Cluster{
          */
         unsigned int getId(){return id;}
 
+        /**
+         * @return The depth of the cluster in the split tree (the cluster of the whole file has depth 0)
+         */
+        unsigned int getDepth() const{return depth;}
+
+        /**
+         * @return The index of the cluster's node in the recorded split tree (see SplitTree), 0 is the root
+         */
+        unsigned int getTreeNode() const{return TreeNode;}
+
+        /**
+         * @param[in] Node The index of the cluster's node in the recorded split tree
+         */
+        void setTreeNode(unsigned int Node){TreeNode=Node;}
+
         /**
          * A simple (almost useless) constructor, that builds an empty cluster.
          * It is used for temporal variables only, when we don't know yet the
          * contents of the cluster in the time of construction.
          */
-        Cluster():TotalLineCount(0),MaxLineLen(0),goodness(1),id(0),TotalLineLen(0){}
+        Cluster():TotalLineCount(0),MaxLineLen(0),goodness(1),id(0),TotalLineLen(0),depth(0),TreeNode(0){}
+
+        /**
+         * Copy constructor, the lines and the statistics of the copy are allocated from the heap (see ArenaAllocator)
+         */
+        Cluster(const Cluster&)=default;
+
+        /**
+         * Move constructor
+         */
+        Cluster(Cluster&&)=default;
+
+        Cluster& operator=(const Cluster&);
+        Cluster& operator=(Cluster&&);
 
         /**
          * An equality operator
@@ -0,0 +1,131 @@
+#include "AllocCounter.h"
+
+#ifdef COUNT_ALLOC
+
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+
+/// Size of the prefix that stores the size of each allocation (it keeps the alignment of malloc)
+///
+#define ALLOC_PREFIX_SIZE alignof(std::max_align_t)
+
+static std::atomic<uint64_t> Allocations(0);
+static std::atomic<uint64_t> Deallocations(0);
+static std::atomic<uint64_t> AllocatedBytes(0);
+static std::atomic<uint64_t> CurrentBytes(0);
+static std::atomic<uint64_t> PeakBytes(0);
+
+/**
+ * Allocates memory and updates the counters
+ *
+ * @param[in] size The number of bytes to allocate
+ * @return Pointer to the allocated memory, NULL if the allocation failed
+ */
+static void* countedAlloc(size_t size){
+	char* block=static_cast<char*>(std::malloc(size+ALLOC_PREFIX_SIZE));
+	if(block==NULL) return NULL;
+	*reinterpret_cast<size_t*>(block)=size;
+
+	++Allocations;
+	AllocatedBytes+=size;
+	uint64_t Current=(CurrentBytes+=size);
+	uint64_t Peak=PeakBytes.load();
+	while(Current>Peak && !PeakBytes.compare_exchange_weak(Peak,Current));
+
+	return block+ALLOC_PREFIX_SIZE;
+}
+
+/**
+ * Frees memory allocated by countedAlloc() and updates the counters
+ *
+ * @param[in] ptr Pointer to the memory to free (it may be NULL)
+ */
+static void countedFree(void* ptr){
+	if(ptr==NULL) return;
+	char* block=static_cast<char*>(ptr)-ALLOC_PREFIX_SIZE;
+	++Deallocations;
+	CurrentBytes-=*reinterpret_cast<size_t*>(block);
+	std::free(block);
+}
+
+/**
+ * Allocates memory, and calls the new handler if the allocation fails
+ *
+ * @param[in] size The number of bytes to allocate
+ * @throws std::bad_alloc if the memory can't be allocated
+ */
+static void* countedNew(size_t size){
+	if(size==0) size=1;
+	void* ret;
+	while((ret=countedAlloc(size))==NULL){
+		std::new_handler handler=std::get_new_handler();
+		if(handler==NULL) throw std::bad_alloc();
+		handler();
+	}
+	return ret;
+}
+
+void* operator new(size_t size){return countedNew(size);}
+void* operator new[](size_t size){return countedNew(size);}
+
+void* operator new(size_t size,const std::nothrow_t&) noexcept{
+	try{
+		return countedNew(size);
+	}
+	catch(const std::bad_alloc&){
+		return NULL;
+	}
+}
+
+void* operator new[](size_t size,const std::nothrow_t& tag) noexcept{return operator new(size,tag);}
+
+void operator delete(void* ptr) noexcept{countedFree(ptr);}
+void operator delete[](void* ptr) noexcept{countedFree(ptr);}
+void operator delete(void* ptr,const std::nothrow_t&) noexcept{countedFree(ptr);}
+void operator delete[](void* ptr,const std::nothrow_t&) noexcept{countedFree(ptr);}
+void operator delete(void* ptr,size_t) noexcept{countedFree(ptr);}
+void operator delete[](void* ptr,size_t) noexcept{countedFree(ptr);}
+
+/**
+ * @return true if the counting allocator hook is compiled into the program
+ */
+bool isAllocCountingEnabled(){
+	return true;
+}
+
+/**
+ * @return The current values of the allocation counters
+ */
+AllocStats getAllocStats(){
+	AllocStats ret;
+	ret.Allocations=Allocations.load();
+	ret.Deallocations=Deallocations.load();
+	ret.AllocatedBytes=AllocatedBytes.load();
+	ret.CurrentBytes=CurrentBytes.load();
+	ret.PeakBytes=PeakBytes.load();
+	return ret;
+}
+
+/**
+ * Resets the peak of the allocated bytes to the currently allocated bytes
+ */
+void resetAllocPeak(){
+	PeakBytes=CurrentBytes.load();
+}
+
+#else
+
+bool isAllocCountingEnabled(){
+	return false;
+}
+
+AllocStats getAllocStats(){
+	AllocStats ret={0,0,0,0,0};
+	return ret;
+}
+
+void resetAllocPeak(){}
+
+#endif
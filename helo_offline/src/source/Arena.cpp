@@ -0,0 +1,59 @@
+#include "Arena.h"
+
+std::atomic<uint64_t> Arena::TotalBytes(0);
+
+/**
+ * Constructor
+ * @param[in] SizeHint The expected number of bytes to allocate, it is used as the size of the first chunk
+ */
+Arena::Arena(size_t SizeHint):Next(NULL),Left(0),AllocatedBytes(0){
+	if(SizeHint<ARENA_MIN_CHUNK_SIZE) SizeHint=ARENA_MIN_CHUNK_SIZE;
+	if(SizeHint>ARENA_MAX_CHUNK_SIZE) SizeHint=ARENA_MAX_CHUNK_SIZE;
+	NextChunkSize=SizeHint;
+}
+
+/**
+ * Destructor, it releases all the memory allocated from the arena
+ */
+Arena::~Arena(){
+	for(char* ActChunk:Chunks) ::operator delete(ActChunk);
+}
+
+/**
+ * Allocates a new chunk. The size of the chunks grows exponentially.
+ *
+ * @param[in] MinSize The chunk must be at least this large
+ */
+void Arena::addChunk(size_t MinSize){
+	size_t ChunkSize=NextChunkSize;
+	if(ChunkSize<MinSize) ChunkSize=MinSize;
+	if(NextChunkSize<ARENA_MAX_CHUNK_SIZE) NextChunkSize*=2;
+
+	Chunks.reserve(Chunks.size()+1);
+	Next=static_cast<char*>(::operator new(ChunkSize));
+	Chunks.push_back(Next);
+	Left=ChunkSize;
+	AllocatedBytes+=ChunkSize;
+	TotalBytes+=ChunkSize;
+}
+
+/**
+ * Allocates memory from the arena
+ *
+ * @param[in] size The number of bytes to allocate
+ * @param[in] align The required alignment (it must be a power of 2)
+ * @return Pointer to the allocated memory
+ * @throws std::bad_alloc if a new chunk can't be allocated
+ */
+void* Arena::allocate(size_t size,size_t align){
+	size_t Padding=(align-reinterpret_cast<uintptr_t>(Next)%align)%align;
+	if(Next==NULL || Padding+size>Left){
+		addChunk(size+align);
+		Padding=(align-reinterpret_cast<uintptr_t>(Next)%align)%align;
+	}
+
+	char* ret=Next+Padding;
+	Next+=Padding+size;
+	Left-=Padding+size;
+	return ret;
+}
@@ -0,0 +1,245 @@
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include "BinaryIO.h"
+#include "Checkpoint.h"
+
+static const char CheckpointMagic[8]={'H','E','L','O','C','K','P','\0'};
+
+/**
+ * Constructor
+ *
+ * @param[in] path The path of the checkpoint file
+ * @param[in] Corpus The lines of the parsed input (the clusters of the checkpoint point to these lines)
+ * @param[in] dict The dictionary of the parsed input (its size is stored to detect a checkpoint of another input,
+ * thus the object must be made right after the input is parsed)
+ * @param[in] Weights The multiplicities of the lines if the input was deduplicated (NULL otherwise)
+ */
+Checkpoint::Checkpoint(const std::string& path,const std::shared_ptr<ListOfLines> Corpus,const DictionaryPtr dict,
+		const std::shared_ptr<const LineWeights> Weights):
+	Path(path),Corpus(Corpus),dict(dict),Weights(Weights),DictSize(dict->size()),LoadedSplitCount(0),LoadedMaxDepth(0){}
+
+/**
+ * Builds the sorted address -> index table of the lines, it is built only once,
+ * as the parsed input doesn't change during the split phase.
+ */
+void Checkpoint::buildLineIndex(){
+	if(!LineIndex.empty() || Corpus->empty()) return;
+	LineIndex.reserve(Corpus->size());
+	uint32_t Index=0;
+	for(const ArrayOfWords& ActLine:*Corpus) LineIndex.push_back(std::make_pair(&ActLine,Index++));
+	std::sort(LineIndex.begin(),LineIndex.end());
+}
+
+/**
+ * @return A hash of the line lengths of the parsed input (FNV-1a), it is used to detect a checkpoint of another input
+ */
+uint64_t Checkpoint::getCorpusHash() const{
+	uint64_t Hash=14695981039346656037ull;
+	for(const ArrayOfWords& ActLine:*Corpus){
+		Hash^=ActLine.size();
+		Hash*=1099511628211ull;
+	}
+	return Hash;
+}
+
+/**
+ * Writes clusters as the indexes of their lines
+ *
+ * @param[in,out] os The stream to write to
+ * @param[in] Sets The lines of the clusters
+ */
+void Checkpoint::writeLineSets(std::ostream& os,const std::vector<LineSet>& Sets) const{
+	writePod<uint64_t>(os,Sets.size());
+	std::vector<uint32_t> Indexes;
+	for(const LineSet& ActSet:Sets){
+		Indexes.clear();
+		Indexes.reserve(ActSet.Lines.size());
+		for(const ArrayOfWords* ActLine:ActSet.Lines){
+			auto it=std::lower_bound(LineIndex.begin(),LineIndex.end(),std::make_pair(ActLine,(uint32_t)0));
+			if(it==LineIndex.end() || it->first!=ActLine) throw CheckpointError("A cluster contains a line that isn't in the parsed input!");
+			Indexes.push_back(it->second);
+		}
+		writePod<uint32_t>(os,ActSet.Depth);
+		writePod<uint32_t>(os,Indexes.size());
+		writePodArray(os,Indexes.data(),Indexes.size());
+	}
+}
+
+/**
+ * Reads clusters written by writeLineSets(), and appends them to a list
+ *
+ * @param[in,out] is The stream to read from
+ * @param[in] Lines The lines of the parsed input in the original order
+ * @param[out] Output The list to append to
+ * @throws CheckpointError if a line index is invalid
+ */
+void Checkpoint::readLineSets(std::istream& is,const std::vector<const ArrayOfWords*>& Lines,ListOfClusters& Output) const{
+	uint64_t Count=readPod<uint64_t>(is);
+	std::vector<uint32_t> Indexes;
+	std::vector<const ArrayOfWords*> ClusterLines;
+	for(uint64_t i=0;i<Count;++i){
+		uint32_t Depth=readPod<uint32_t>(is);
+		Indexes.resize(readPod<uint32_t>(is));
+		readPodArray(is,Indexes.data(),Indexes.size());
+
+		ClusterLines.clear();
+		ClusterLines.reserve(Indexes.size());
+		for(uint32_t ActIndex:Indexes){
+			if(ActIndex>=Lines.size()) throw CheckpointError("Invalid line index in checkpoint: "+Path);
+			ClusterLines.push_back(Lines[ActIndex]);
+		}
+		Output.push_back(Cluster(Corpus,ClusterLines,dict,Depth,Weights));
+	}
+}
+
+/**
+ * Writes compressed clusters as their templates, the tokens are written as strings
+ *
+ * @param[in,out] os The stream to write to
+ * @param[in] Templates The compressed clusters
+ */
+void Checkpoint::writeTemplates(std::ostream& os,const std::vector<CompressedCluster>& Templates) const{
+	writePod<uint64_t>(os,Templates.size());
+	for(const CompressedCluster& ActTemplate:Templates){
+		writePod<uint32_t>(os,ActTemplate.Depth);
+		writePod<double>(os,ActTemplate.Goodness);
+		writePod<uint64_t>(os,ActTemplate.LineCount);
+		writePod<uint64_t>(os,ActTemplate.LineLen);
+		writePod<uint32_t>(os,ActTemplate.Template.size());
+		for(const std::shared_ptr<TokenDescriptor>& ActWord:ActTemplate.Template){
+			writePod<uint32_t>(os,ActWord->TypeOfToken);
+			writeString(os,ActWord->TokenString);
+		}
+	}
+}
+
+/**
+ * Reads compressed clusters written by writeTemplates(), and appends them to a list. The tokens
+ * of the templates are looked up in the dictionary (a token that isn't in it, e.g. a number of the
+ * number table, is stored in it).
+ *
+ * @param[in,out] is The stream to read from
+ * @param[out] Output The list to append to
+ * @throws CheckpointError if a template is invalid
+ */
+void Checkpoint::readTemplates(std::istream& is,ListOfClusters& Output) const{
+	uint64_t Count=readPod<uint64_t>(is);
+	for(uint64_t i=0;i<Count;++i){
+		uint32_t Depth=readPod<uint32_t>(is);
+		double Goodness=readPod<double>(is);
+		uint64_t LineCount=readPod<uint64_t>(is);
+		uint64_t LineLen=readPod<uint64_t>(is);
+		uint32_t TokenCount=readPod<uint32_t>(is);
+		if(LineCount==0 || TokenCount==0) throw CheckpointError("Invalid template in checkpoint: "+Path);
+
+		ArrayOfWords Template;
+		Template.reserve(TokenCount);
+		for(uint32_t j=0;j<TokenCount;++j){
+			wordtype Type=(wordtype)readPod<uint32_t>(is);
+			std::string ActString=readString(is);
+
+			auto it=dict->find(TokenKey(ActString.data(),ActString.size()));
+			if(it==dict->end()) it=dict->insert(std::make_shared<TokenDescriptor>(ActString,Type)).first;
+			Template.push_back(*it);
+		}
+		Output.push_back(Cluster(std::move(Template),Goodness,LineCount,LineLen,dict,Depth));
+	}
+}
+
+/**
+ * Saves the state of the split phase. The file is written to <path>.tmp, and it is renamed
+ * to the path of the checkpoint when it is complete.
+ *
+ * @param[in] Pending The clusters that still have to be split
+ * @param[in] Finished The clusters that are good enough already (compressed to their templates)
+ * @param[in] SplitCount The number of Split calls done so far
+ * @param[in] MaxDepth The depth of the split tree so far
+ * @throws std::ios::failure if the file can't be written
+ * @throws CheckpointError if a cluster contains a line that isn't in the parsed input
+ */
+void Checkpoint::save(const std::vector<LineSet>& Pending,const std::vector<CompressedCluster>& Finished,uint64_t SplitCount,uint32_t MaxDepth){
+	buildLineIndex();
+	std::string TempPath=Path+".tmp";
+	{
+		std::ofstream file;
+		file.exceptions(std::ios::failbit | std::ios::badbit);
+		file.open(TempPath.c_str(),std::ios::out | std::ios::binary | std::ios::trunc);
+
+		file.write(CheckpointMagic,sizeof(CheckpointMagic));
+		writePod<uint32_t>(file,CHECKPOINT_FILE_VERSION);
+		writePod<uint32_t>(file,HELO_BYTE_ORDER_MARK);
+		writePod<uint64_t>(file,Corpus->size());
+		writePod<uint64_t>(file,DictSize);
+		writePod<uint64_t>(file,getCorpusHash());
+		writePod<uint64_t>(file,SplitCount);
+		writePod<uint32_t>(file,MaxDepth);
+		writeTemplates(file,Finished);
+		writeLineSets(file,Pending);
+		file.close();
+	}
+	if(std::rename(TempPath.c_str(),Path.c_str())!=0){
+		std::remove(TempPath.c_str());
+		throw std::ios::failure("Couldn't rename checkpoint file: "+TempPath);
+	}
+}
+
+/**
+ * Loads the state of the split phase. The lines of the clusters are taken from the parsed input,
+ * which must be the same as the one the checkpoint was saved from.
+ *
+ * @param[out] Pending The list to append the clusters to split to
+ * @param[out] Finished The list to append the finished clusters to
+ * @throws CheckpointError if the file can't be opened, it isn't a valid checkpoint, or it belongs to another input
+ */
+void Checkpoint::load(ListOfClusters& Pending,ListOfClusters& Finished){
+	std::ifstream file(Path.c_str(),std::ios::in | std::ios::binary);
+	if(!file.is_open()) throw CheckpointError("Couldn't open checkpoint file: "+Path);
+
+	try{
+		char Magic[sizeof(CheckpointMagic)];
+		readPodArray(file,Magic,sizeof(Magic));
+		if(!std::equal(CheckpointMagic,CheckpointMagic+sizeof(CheckpointMagic),Magic)){
+			throw CheckpointError("Not a checkpoint file: "+Path);
+		}
+		if(readPod<uint32_t>(file)!=CHECKPOINT_FILE_VERSION) throw CheckpointError("Unsupported checkpoint version: "+Path);
+		if(readPod<uint32_t>(file)!=HELO_BYTE_ORDER_MARK) throw CheckpointError("The checkpoint was written with another byte order: "+Path);
+
+		uint64_t LineCount=readPod<uint64_t>(file);
+		uint64_t SavedDictSize=readPod<uint64_t>(file);
+		uint64_t CorpusHash=readPod<uint64_t>(file);
+		if(LineCount!=Corpus->size() || SavedDictSize!=DictSize || CorpusHash!=getCorpusHash()){
+			throw CheckpointError("The checkpoint belongs to another input (or other options): "+Path);
+		}
+		LoadedSplitCount=readPod<uint64_t>(file);
+		LoadedMaxDepth=readPod<uint32_t>(file);
+
+		std::vector<const ArrayOfWords*> Lines;
+		Lines.reserve(Corpus->size());
+		for(const ArrayOfWords& ActLine:*Corpus) Lines.push_back(&ActLine);
+
+		readTemplates(file,Finished);
+		readLineSets(file,Lines,Pending);
+	}
+	catch(const CheckpointError&){
+		throw;
+	}
+	catch(const std::runtime_error& e){
+		throw CheckpointError(std::string("Corrupt checkpoint file ")+Path+": "+e.what());
+	}
+}
+
+/**
+ * @return Tells whether the checkpoint file exists
+ */
+bool Checkpoint::exists() const{
+	std::ifstream file(Path.c_str(),std::ios::in | std::ios::binary);
+	return file.is_open();
+}
+
+/**
+ * Deletes the checkpoint file (it is called after a successful run)
+ */
+void Checkpoint::remove() const{
+	std::remove(Path.c_str());
+}
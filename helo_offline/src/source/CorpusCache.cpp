@@ -0,0 +1,258 @@
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+#include "BinaryIO.h"
+#include "MappedFile.h"
+#include "CorpusCache.h"
+
+static const char CorpusCacheMagic[8]={'H','E','L','O','T','O','K','\0'};
+
+/**
+ * Checks whether an array fits into a region without overflowing the arithmetic
+ *
+ * @param[in] Offset The offset of the array in the region
+ * @param[in] Count The number of elements
+ * @param[in] ElemSize The size of an element in bytes
+ * @param[in] Size The size of the region in bytes
+ * @return true if the array is in the region
+ */
+static inline bool arrayFits(uint64_t Offset,uint64_t Count,uint64_t ElemSize,uint64_t Size){
+	return Offset<=Size && Count<=(Size-Offset)/ElemSize;
+}
+
+/**
+ * Checks whether an array of T fits into the cache and it is properly aligned for T
+ *
+ * @param[in] Data The beginning of the cache
+ * @param[in] Offset The offset of the array in the cache
+ * @param[in] Count The number of elements
+ * @param[in] Size The size of the cache in bytes
+ * @return true if the array can be accessed in place
+ */
+template<typename T>
+static inline bool sectionValid(const char* Data,uint64_t Offset,uint64_t Count,uint64_t Size){
+	return arrayFits(Offset,Count,sizeof(T),Size) && reinterpret_cast<uintptr_t>(Data+Offset)%alignof(T)==0;
+}
+
+/**
+ * Tells whether a file is a tokenized corpus cache (only the beginning of the file is read)
+ *
+ * @param[in] path The path of the file
+ * @return true if the file starts with the magic of the cache
+ */
+bool CorpusCache::isCache(const std::string& path){
+	std::ifstream file(path.c_str(),std::ios::in | std::ios::binary);
+	char Magic[sizeof(CorpusCacheMagic)];
+	if(!file.read(Magic,sizeof(Magic))) return false;
+	return std::equal(CorpusCacheMagic,CorpusCacheMagic+sizeof(CorpusCacheMagic),Magic);
+}
+
+/**
+ * Writes the parsed input to a cache file. The sections are written one after the other,
+ * thus nothing is copied except one line at a time.
+ *
+ * @param[in] path The path of the file to write
+ * @param[in] parser The parser that read the input
+ * @param[in] Settings The settings of the parser
+ * @throws std::ios::failure if the file couldn't be written
+ */
+void CorpusCache::save(const std::string& path,const LogParser& parser,const CorpusSettings& Settings){
+	const ListOfLines& Lines=*parser.getContent();
+	std::shared_ptr<const NumberTable> Numbers=parser.getNumberTable();
+	std::shared_ptr<const LineWeights> Weights=parser.getWeights();
+	bool HasWeights=(Settings.Flags & CorpusDeduplicated)!=0;
+
+	std::unordered_map<const TokenDescriptor*,uint32_t> TokenIds;
+	std::vector<CorpusToken> Tokens;
+	uint64_t StringTableSize=Settings.Regex.size()+Settings.Locale.size();
+	auto addToken=[&](const TokenDescriptor& Token){
+		TokenIds.insert(std::make_pair(&Token,(uint32_t)Tokens.size()));
+		Tokens.push_back(CorpusToken{StringTableSize,(uint32_t)Token.TokenString.size(),(uint32_t)Token.TypeOfToken});
+		StringTableSize+=Token.TokenString.size();
+	};
+	for(const std::shared_ptr<TokenDescriptor>& ActToken:*parser.getDictionary()) addToken(*ActToken);
+	if(Numbers){
+		for(const TokenDescriptor& ActToken:*Numbers) addToken(ActToken);
+	}
+
+	CorpusCacheHeader header;
+	std::copy(CorpusCacheMagic,CorpusCacheMagic+sizeof(CorpusCacheMagic),header.Magic);
+	header.Version=CORPUS_CACHE_VERSION;
+	header.ByteOrder=HELO_BYTE_ORDER_MARK;
+	header.Flags=Settings.Flags;
+	header.HeaderLen=Settings.HeaderLen;
+	header.RegexLength=Settings.Regex.size();
+	header.LocaleLength=Settings.Locale.size();
+	header.DictionaryTokenCount=parser.getDictionary()->size();
+	header.NumberTokenCount=Numbers ? Numbers->size() : 0;
+	header.LineCount=Lines.size();
+	header.LineTokenCount=0;
+	for(const ArrayOfWords& ActLine:Lines) header.LineTokenCount+=ActLine.size();
+	header.MessageCount=parser.getMessageCount();
+	header.StringTableSize=StringTableSize;
+
+	uint64_t pos=sizeof(CorpusCacheHeader);
+	header.TokenTableOffset=pos;
+	pos+=Tokens.size()*sizeof(CorpusToken);
+	header.LineTableOffset=pos;
+	pos+=(header.LineCount+1)*sizeof(uint64_t);
+	header.LineTokenOffset=pos;
+	pos+=header.LineTokenCount*sizeof(uint32_t);
+	pos+=(8-pos%8)%8;
+	header.WeightTableOffset=pos;
+	if(HasWeights) pos+=header.LineCount*sizeof(uint64_t);
+	header.StringTableOffset=pos;
+	pos+=StringTableSize;
+	pos+=(8-pos%8)%8;
+	header.FileSize=pos;
+
+	std::ofstream file;
+	file.exceptions(std::ios::failbit | std::ios::badbit);
+	file.open(path.c_str(),std::ios::out | std::ios::binary | std::ios::trunc);
+
+	writePod(file,header);
+	writePodArray(file,Tokens.data(),Tokens.size());
+
+	uint64_t Offset=0;
+	for(const ArrayOfWords& ActLine:Lines){
+		writePod<uint64_t>(file,Offset);
+		Offset+=ActLine.size();
+	}
+	writePod<uint64_t>(file,Offset);
+
+	std::vector<uint32_t> LineTokens;
+	for(const ArrayOfWords& ActLine:Lines){
+		LineTokens.clear();
+		for(const std::shared_ptr<TokenDescriptor>& ActWord:ActLine) LineTokens.push_back(TokenIds.at(ActWord.get()));
+		writePodArray(file,LineTokens.data(),LineTokens.size());
+	}
+	writePadding(file,header.LineTokenOffset+header.LineTokenCount*sizeof(uint32_t));
+
+	if(HasWeights){
+		for(const ArrayOfWords& ActLine:Lines){
+			uint64_t Weight=1;
+			if(Weights){
+				auto it=Weights->find(&ActLine);
+				if(it!=Weights->end()) Weight=it->second;
+			}
+			writePod<uint64_t>(file,Weight);
+		}
+	}
+
+	file.write(Settings.Regex.data(),Settings.Regex.size());
+	file.write(Settings.Locale.data(),Settings.Locale.size());
+	for(const std::shared_ptr<TokenDescriptor>& ActToken:*parser.getDictionary()){
+		file.write(ActToken->TokenString.data(),ActToken->TokenString.size());
+	}
+	if(Numbers){
+		for(const TokenDescriptor& ActToken:*Numbers) file.write(ActToken.TokenString.data(),ActToken.TokenString.size());
+	}
+	writePadding(file,header.StringTableOffset+StringTableSize);
+	file.close();
+}
+
+/**
+ * Constructor, it maps a cache file into the memory, checks it, and builds the corpus from it
+ *
+ * @param[in] path The path of the cache file
+ * @param[in] Settings The settings of the current run, they must be the same as the settings of the cache
+ * @throws CorpusCacheError if the file can't be opened, it is invalid, or it was made with other settings
+ */
+CorpusCache::CorpusCache(const std::string& path,const CorpusSettings& Settings):MessageCount(0){
+	std::unique_ptr<MappedFile> File;
+	try{
+		File.reset(new MappedFile(path));
+	}
+	catch(const std::runtime_error& e){
+		throw CorpusCacheError(e.what());
+	}
+	const char* Data=File->data();
+	size_t Size=File->size();
+
+	if(Data==NULL || Size<sizeof(CorpusCacheHeader)) throw CorpusCacheError("Invalid tokenized corpus: the file is too short!");
+	if(reinterpret_cast<uintptr_t>(Data)%alignof(CorpusCacheHeader)!=0) throw CorpusCacheError("Invalid tokenized corpus: the file is not aligned!");
+	const CorpusCacheHeader* Header=reinterpret_cast<const CorpusCacheHeader*>(Data);
+	if(!std::equal(CorpusCacheMagic,CorpusCacheMagic+sizeof(CorpusCacheMagic),Header->Magic)){
+		throw CorpusCacheError("Invalid tokenized corpus: this is not a HELO corpus cache!");
+	}
+	if(Header->ByteOrder!=HELO_BYTE_ORDER_MARK) throw CorpusCacheError("Invalid tokenized corpus: wrong byte order!");
+	if(Header->Version!=CORPUS_CACHE_VERSION) throw CorpusCacheError("Unsupported tokenized corpus version!");
+	if(Header->FileSize!=Size) throw CorpusCacheError("Invalid tokenized corpus: the file is truncated!");
+
+	//every count is checked against the file size first, thus their sums can't overflow
+	if(Header->DictionaryTokenCount>Size || Header->NumberTokenCount>Size || Header->LineCount>=Size){
+		throw CorpusCacheError("Invalid tokenized corpus: a section is out of the file or misaligned!");
+	}
+	uint64_t TokenCount=Header->DictionaryTokenCount+Header->NumberTokenCount;
+	bool HasWeights=(Header->Flags & CorpusDeduplicated)!=0;
+	if(!sectionValid<CorpusToken>(Data,Header->TokenTableOffset,TokenCount,Size) ||
+	   !sectionValid<uint64_t>(Data,Header->LineTableOffset,Header->LineCount+1,Size) ||
+	   !sectionValid<uint32_t>(Data,Header->LineTokenOffset,Header->LineTokenCount,Size) ||
+	   (HasWeights && !sectionValid<uint64_t>(Data,Header->WeightTableOffset,Header->LineCount,Size)) ||
+	   !arrayFits(Header->StringTableOffset,Header->StringTableSize,1,Size) ||
+	   (uint64_t)Header->RegexLength+Header->LocaleLength>Header->StringTableSize){
+		throw CorpusCacheError("Invalid tokenized corpus: a section is out of the file or misaligned!");
+	}
+
+	const CorpusToken* Tokens=reinterpret_cast<const CorpusToken*>(Data+Header->TokenTableOffset);
+	const uint64_t* LineTable=reinterpret_cast<const uint64_t*>(Data+Header->LineTableOffset);
+	const uint32_t* LineTokens=reinterpret_cast<const uint32_t*>(Data+Header->LineTokenOffset);
+	const uint64_t* WeightTable=reinterpret_cast<const uint64_t*>(Data+Header->WeightTableOffset);
+	const char* StringTable=Data+Header->StringTableOffset;
+
+	std::string Regex(StringTable,Header->RegexLength);
+	std::string Locale(StringTable+Header->RegexLength,Header->LocaleLength);
+	if(Header->HeaderLen!=Settings.HeaderLen || Regex!=Settings.Regex || Locale!=Settings.Locale || Header->Flags!=Settings.Flags){
+		throw CorpusCacheError("The tokenized corpus was made with other settings (header length: "+std::to_string(Header->HeaderLen)+
+				", regular expression: "+Regex+", localization: "+Locale+
+				", deduplication: "+((Header->Flags & CorpusDeduplicated) ? "on" : "off")+
+				", number table: "+((Header->Flags & CorpusNumberTable) ? "on" : "off")+")!");
+	}
+
+	for(uint64_t i=0;i<TokenCount;++i){
+		if(!arrayFits(Tokens[i].StringOffset,Tokens[i].StringLength,1,Header->StringTableSize) || Tokens[i].Type>Number){
+			throw CorpusCacheError("Invalid tokenized corpus: wrong token!");
+		}
+	}
+	if(LineTable[0]!=0 || LineTable[Header->LineCount]!=Header->LineTokenCount){
+		throw CorpusCacheError("Invalid tokenized corpus: wrong line table!");
+	}
+	for(uint64_t i=0;i<Header->LineCount;++i){
+		if(LineTable[i]>LineTable[i+1]) throw CorpusCacheError("Invalid tokenized corpus: wrong line table!");
+	}
+	for(uint64_t i=0;i<Header->LineTokenCount;++i){
+		if(LineTokens[i]>=TokenCount) throw CorpusCacheError("Invalid tokenized corpus: wrong token id!");
+	}
+
+	//the dictionary tokens are stored in the order of the dictionary, thus they are inserted at the end
+	std::vector<std::shared_ptr<TokenDescriptor> > TokenPtrs;
+	TokenPtrs.reserve(TokenCount);
+	dict=std::make_shared<Dictionary>();
+	for(uint64_t i=0;i<Header->DictionaryTokenCount;++i){
+		TokenPtrs.push_back(std::make_shared<TokenDescriptor>(std::string(StringTable+Tokens[i].StringOffset,Tokens[i].StringLength),
+				(wordtype)Tokens[i].Type));
+		dict->insert(dict->end(),TokenPtrs.back());
+	}
+	if(Header->Flags & CorpusNumberTable){
+		Numbers=std::make_shared<NumberTable>();
+		for(uint64_t i=Header->DictionaryTokenCount;i<TokenCount;++i){
+			Numbers->push_back(TokenDescriptor(std::string(StringTable+Tokens[i].StringOffset,Tokens[i].StringLength),
+					(wordtype)Tokens[i].Type));
+			TokenPtrs.push_back(std::shared_ptr<TokenDescriptor>(Numbers,&Numbers->back())); //shares the ownership of the table
+		}
+	}
+	else if(Header->NumberTokenCount>0){
+		throw CorpusCacheError("Invalid tokenized corpus: number tokens without a number table!");
+	}
+
+	Content=std::make_shared<ListOfLines>();
+	if(HasWeights) Weights=std::make_shared<LineWeights>();
+	for(uint64_t i=0;i<Header->LineCount;++i){
+		Content->emplace_back();
+		ArrayOfWords& ActLine=Content->back();
+		ActLine.reserve(LineTable[i+1]-LineTable[i]);
+		for(uint64_t j=LineTable[i];j<LineTable[i+1];++j) ActLine.push_back(TokenPtrs[LineTokens[j]]);
+		if(HasWeights && WeightTable[i]>1) Weights->insert(std::make_pair(&ActLine,(size_t)WeightTable[i]));
+	}
+	MessageCount=Header->MessageCount;
+}
@@ -0,0 +1,158 @@
+#include <cmath>
+#include <algorithm>
+#include "IncrementalUpdate.h"
+
+/**
+ * Constructor, it loads the clusters of the database and their line statistics
+ *
+ * @param[in] db The opened database that contains the clusters and the cluster_stats tables
+ * @throws SQLite::Exception if the clusters can't be read
+ */
+IncrementalUpdate::IncrementalUpdate(SQLite::Database& db):TotalMatched(0){
+	SQLite::Statement query(db,"SELECT clustid,template,goodness,AvgLen,LineCount,TotalLen FROM clusters "
+			"LEFT JOIN cluster_stats USING(clustid) ORDER BY clustid");
+	while(query.executeStep()){
+		std::vector<uint32_t> Template=ClusterTemplate::parseTemplate((const char*)query.getColumn(1),Tokens);
+		if(Template.empty()) continue;
+
+		Templates.push_back(ClusterTemplate(std::move(Template),query.getColumn(2).getDouble(),
+				query.getColumn(3).getDouble(),query.getColumn(0).getInt64()));
+		HistoryLines.push_back(query.getColumn(4).isNull() ? 0 : (size_t)query.getColumn(4).getInt64());
+		HistoryLen.push_back(query.getColumn(5).isNull() ? 0 : (size_t)query.getColumn(5).getInt64());
+	}
+	MatchedLines.resize(Templates.size(),0);
+	MatchedLen.resize(Templates.size(),0);
+	Index.build(Templates);
+}
+
+/**
+ * Classifies a message, it is assigned to the first matching template in the order of their ids
+ * (see ClusterTemplate::match()). The templates are looked up in the TemplateIndex.
+ *
+ * @param[in] tokens The parsed tokens of the message
+ * @return true if the message matches a template, false if it has to be clustered
+ */
+bool IncrementalUpdate::classify(const std::vector<TokenDescriptor>& tokens){
+	LineIds.clear();
+	for(const TokenDescriptor& ActToken:tokens){
+		LineIds.push_back(MessageToken(Tokens.find(ActToken.TokenString),ActToken.TypeOfToken));
+	}
+
+	uint32_t Match=Index.findMatch(LineIds);
+	if(Match==TemplateIndex::NoMatch) return false;
+
+	++MatchedLines[Match];
+	MatchedLen[Match]+=tokens.size();
+	++TotalMatched;
+	return true;
+}
+
+/**
+ * Merges the new clusters into the existing ones. Each new cluster is joined with the most similar
+ * existing cluster if their similarity reaches the merge limit (see Cluster::getGoodness(Cluster&)),
+ * and it is removed from the list. The remaining clusters are the ones to add to the database.
+ *
+ * @param[in,out] NewClusters The clusters made from the unmatched messages (their templates must be made)
+ * @param[in] dict The dictionary of the new clusters
+ * @param[in] MergeLimit The minimal similarity of clusters to merge
+ * @return The number of new clusters merged into existing ones
+ */
+size_t IncrementalUpdate::merge(ListOfClusters& NewClusters,const DictionaryPtr dict,double MergeLimit){
+	ExistingClusters.clear();
+	ExistingClusters.reserve(Templates.size());
+	for(size_t i=0;i<Templates.size();++i){
+		ArrayOfWords Template;
+		for(uint32_t ActId:Templates[i].getTemplate()){
+			std::shared_ptr<TokenDescriptor> ActDesc=std::make_shared<TokenDescriptor>(Tokens[ActId]);
+			auto it=dict->find(ActDesc);
+			if(it==dict->end()){
+				dict->insert(ActDesc);
+				Template.push_back(ActDesc);
+			}
+			else{
+				Template.push_back(*it);
+			}
+		}
+
+		size_t LineCount=HistoryLines[i]+MatchedLines[i];
+		size_t LineLen=HistoryLen[i]+MatchedLen[i];
+		if(HistoryLines[i]==0){ //no history, only the average length is known
+			LineCount=std::max<size_t>(MatchedLines[i],1);
+			LineLen=(size_t)std::llround(Templates[i].getAvgLen()*LineCount);
+		}
+		ExistingClusters.push_back(Cluster(std::move(Template),Templates[i].getGoodness(),LineCount,LineLen,dict,0));
+		ExistingClusters.back().setId(Templates[i].getId());
+	}
+	Updated.assign(Templates.size(),false);
+
+	size_t MergedCount=0;
+	for(auto it=NewClusters.begin();it!=NewClusters.end();){
+		double MaxGoodness=0;
+		size_t Best=0;
+		for(size_t i=0;i<ExistingClusters.size();++i){
+			double ActGoodness=ExistingClusters[i].getGoodness(*it);
+			if(ActGoodness>MaxGoodness){
+				MaxGoodness=ActGoodness;
+				Best=i;
+			}
+		}
+
+		if(!ExistingClusters.empty() && MaxGoodness>=MergeLimit){
+			ExistingClusters[Best].join(*it);
+			Updated[Best]=true;
+			++MergedCount;
+			it=NewClusters.erase(it);
+		}
+		else{
+			++it;
+		}
+	}
+
+	return MergedCount;
+}
+
+/**
+ * Updates the existing clusters that have been changed by merge(), and the line statistics of the clusters
+ * that got new lines (see merge()). The ids of the clusters are kept.
+ *
+ * @param[in,out] db The database to write to (it should be in a transaction)
+ * @return The number of updated clusters
+ * @throws SQLite::Exception if the database can't be written
+ */
+size_t IncrementalUpdate::save(SQLite::Database& db){
+	SQLite::Statement SaveStats(db,"INSERT OR REPLACE INTO cluster_stats VALUES(?,?,?)");
+	size_t UpdatedCount=0;
+	for(size_t i=0;i<ExistingClusters.size();++i){
+		if(!Updated[i] && MatchedLines[i]==0) continue;
+
+		SaveStats.reset();
+		SaveStats.bind(1,(sqlite3_int64)Templates[i].getId());
+		SaveStats.bind(2,(sqlite3_int64)ExistingClusters[i].getTotalLineCount());
+		SaveStats.bind(3,(sqlite3_int64)ExistingClusters[i].getTotalLineLen());
+		SaveStats.exec();
+		if(!Updated[i]) continue;
+
+		std::vector<uint32_t> Template;
+		for(const std::shared_ptr<TokenDescriptor>& ActWord:ExistingClusters[i].getLine(0)){
+			Template.push_back(Tokens.intern(ActWord->TokenString,ActWord->TypeOfToken));
+		}
+		Index.remove(i,Templates[i]);
+		Templates[i]=ClusterTemplate(std::move(Template),ExistingClusters[i].getGoodness(),
+				ExistingClusters[i].getAvgLen(),Templates[i].getId());
+		Index.insert(i,Templates[i]);
+		db.exec(Templates[i].getUpdateStr(Tokens).c_str());
+		++UpdatedCount;
+	}
+	return UpdatedCount;
+}
+
+/**
+ * Adds the existing clusters (with their merged templates) to a binary cluster model
+ *
+ * @param[in,out] model The model to add to
+ */
+void IncrementalUpdate::addToModel(ModelWriter& model){
+	for(Cluster& ActClust:ExistingClusters){
+		model.addCluster(ActClust.getLine(0),ActClust.getGoodness(),ActClust.getAvgLen(),ActClust.getId());
+	}
+}
@@ -0,0 +1,122 @@
+#include <fstream>
+#include <sstream>
+#include "MemoryUsage.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Reads a value given in kB from /proc/self/status
+ *
+ * @param[in] key The name of the value (e.g. VmHWM)
+ * @return The value in bytes, 0 if it can't be read
+ */
+static size_t readProcStatus(const std::string& key){
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while(std::getline(status,line)){
+		if(line.compare(0,key.size(),key)==0 && line.size()>key.size() && line[key.size()]==':'){
+			std::istringstream value(line.substr(key.size()+1));
+			size_t kb=0;
+			value >> kb;
+			return kb*1024;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @return The peak resident set size of the process in bytes since the start of the process
+ * (or since the last successful resetPeakRss() call), 0 if it can't be determined
+ */
+size_t MemoryUsage::getPeakRss(){
+	size_t ret=readProcStatus("VmHWM");
+#ifndef _WIN32
+	if(ret==0){
+		struct rusage usage;
+		if(getrusage(RUSAGE_SELF,&usage)==0){
+#ifdef __APPLE__
+			ret=usage.ru_maxrss;
+#else
+			ret=usage.ru_maxrss*1024;
+#endif
+		}
+	}
+#endif
+	return ret;
+}
+
+/**
+ * @return The current resident set size of the process in bytes, 0 if it can't be determined
+ */
+size_t MemoryUsage::getCurrentRss(){
+	return readProcStatus("VmRSS");
+}
+
+/**
+ * Resets the peak resident set size to the current resident set size, thus the peak
+ * of a phase can be measured. It is only supported on Linux.
+ *
+ * @return true if the peak was reset, false if it is not supported
+ */
+bool MemoryUsage::resetPeakRss(){
+	std::ofstream ClearRefs("/proc/self/clear_refs");
+	if(!ClearRefs.is_open()) return false;
+	ClearRefs << "5";
+	ClearRefs.close();
+	return !ClearRefs.fail();
+}
+
+/**
+ * @param[in] str The string to estimate
+ * @return The bytes allocated by the string on the heap (0 if the string is stored inside the object)
+ */
+size_t MemoryUsage::estimate(const std::string& str){
+	const char* data=reinterpret_cast<const char*>(str.data());
+	const char* obj=reinterpret_cast<const char*>(&str);
+	if(data>=obj && data<obj+sizeof(str)) return 0;
+	return str.capacity()+1;
+}
+
+/**
+ * @param[in] dict The dictionary to estimate
+ * @return The estimated bytes held by the dictionary, including the stored tokens
+ */
+size_t MemoryUsage::estimate(const Dictionary& dict){
+	size_t ret=0;
+	for(const std::shared_ptr<TokenDescriptor>& ActToken:dict){
+		ret+=TREE_NODE_OVERHEAD+sizeof(std::shared_ptr<TokenDescriptor>);
+		ret+=SHARED_BLOCK_OVERHEAD+sizeof(TokenDescriptor);
+		ret+=estimate(ActToken->TokenString);
+	}
+	return ret;
+}
+
+/**
+ * @param[in] numbers The number table to estimate
+ * @return The estimated bytes held by the number table (the tokens and their strings)
+ */
+size_t MemoryUsage::estimate(const NumberTable& numbers){
+	size_t ret=0;
+	for(const TokenDescriptor& ActToken:numbers){
+		ret+=sizeof(TokenDescriptor);
+		ret+=estimate(ActToken.TokenString);
+	}
+	return ret;
+}
+
+/**
+ * @param[in] lines The lines to estimate
+ * @return The estimated bytes held by the lines. The tokens are not counted, as they
+ * are shared with the dictionary.
+ */
+size_t MemoryUsage::estimate(const ListOfLines& lines){
+	size_t ret=0;
+	for(const ArrayOfWords& ActLine:lines){
+		ret+=LIST_NODE_OVERHEAD+sizeof(ArrayOfWords);
+		ret+=ActLine.capacity()*sizeof(std::shared_ptr<TokenDescriptor>);
+	}
+	return ret;
+}
@@ -0,0 +1,179 @@
+#include <fstream>
+#include <cstdio>
+#include "RunStats.h"
+#include "MemoryUsage.h"
+
+/**
+ * Escapes a string to be written as a JSON string value
+ *
+ * @param[in] str The string to escape
+ * @return The escaped string (without the surrounding quotes)
+ */
+std::string RunStats::escape(const std::string& str){
+	std::string ret;
+	for(char c:str){
+		switch(c){
+			case '"': ret+="\\\""; break;
+			case '\\': ret+="\\\\"; break;
+			case '\n': ret+="\\n"; break;
+			case '\r': ret+="\\r"; break;
+			case '\t': ret+="\\t"; break;
+			default:
+				if((unsigned char)c<0x20){
+					char buf[8];
+					snprintf(buf,sizeof(buf),"\\u%04x",(unsigned char)c);
+					ret+=buf;
+				}
+				else{
+					ret+=c;
+				}
+		}
+	}
+	return ret;
+}
+
+/**
+ * Stores a descriptive value about the run (e.g. the input file name)
+ *
+ * @param[in] key The name of the value
+ * @param[in] value The value to store
+ */
+void RunStats::setInfo(const std::string& key,const std::string& value){
+	for(auto& ActInfo:Info){
+		if(ActInfo.first==key){
+			ActInfo.second=value;
+			return;
+		}
+	}
+	Info.push_back(std::make_pair(key,value));
+}
+
+/**
+ * Starts the measurement of a new phase. If there is a phase in progress, it is finished first.
+ * The peak resident set size is reset (if the system supports it), thus the peak of each phase
+ * can be measured separately. Otherwise the peak of the phase is the peak of the process so far.
+ *
+ * @param[in] name The name of the phase
+ */
+void RunStats::beginPhase(const std::string& name){
+	if(!ActPhase.empty()) endPhase();
+	ActPhase=name;
+	PeakRssResettable&=MemoryUsage::resetPeakRss();
+	resetAllocPeak();
+	PhaseAllocStart=getAllocStats();
+	PhaseWallStart=std::chrono::steady_clock::now();
+	PhaseCpuStart=std::clock();
+}
+
+/**
+ * Finishes the measurement of the phase in progress. The CPU time is the time used
+ * by all the threads of the process during the phase.
+ */
+void RunStats::endPhase(){
+	if(ActPhase.empty()) return;
+
+	Phase ActStats;
+	ActStats.Name=ActPhase;
+	ActStats.WallTime=std::chrono::duration<double>(std::chrono::steady_clock::now()-PhaseWallStart).count();
+	ActStats.CpuTime=(double)(std::clock()-PhaseCpuStart)/CLOCKS_PER_SEC;
+	ActStats.PeakRss=MemoryUsage::getPeakRss();
+	ActStats.EndRss=MemoryUsage::getCurrentRss();
+
+	AllocStats PhaseAllocEnd=getAllocStats();
+	ActStats.Allocs.Allocations=PhaseAllocEnd.Allocations-PhaseAllocStart.Allocations;
+	ActStats.Allocs.Deallocations=PhaseAllocEnd.Deallocations-PhaseAllocStart.Deallocations;
+	ActStats.Allocs.AllocatedBytes=PhaseAllocEnd.AllocatedBytes-PhaseAllocStart.AllocatedBytes;
+	ActStats.Allocs.CurrentBytes=PhaseAllocEnd.CurrentBytes;
+	ActStats.Allocs.PeakBytes=PhaseAllocEnd.PeakBytes;
+	Phases.push_back(ActStats);
+	ActPhase.clear();
+}
+
+/**
+ * Sets the value of a counter, the counter is created if it didn't exist.
+ *
+ * @param[in] name The name of the counter
+ * @param[in] value The value to set
+ */
+void RunStats::setCounter(const std::string& name,uint64_t value){
+	for(auto& ActCounter:Counters){
+		if(ActCounter.first==name){
+			ActCounter.second=value;
+			return;
+		}
+	}
+	Counters.push_back(std::make_pair(name,value));
+}
+
+/**
+ * @param[in] name The name of the counter
+ * @return The value of the counter, 0 if it is not set
+ */
+uint64_t RunStats::getCounter(const std::string& name) const{
+	for(const auto& ActCounter:Counters){
+		if(ActCounter.first==name) return ActCounter.second;
+	}
+	return 0;
+}
+
+/**
+ * Writes the collected statistics in JSON format. The phases are written in the order
+ * of their measurement, and the totals of the phases are written as well. Memory sizes are given in bytes.
+ *
+ * @param[in,out] o The stream to write to
+ */
+void RunStats::write(std::ostream& o) const{
+	double TotalWall=0;
+	double TotalCpu=0;
+	size_t PeakRss=0;
+
+	o << "{\n  \"version\": " << RUN_STATS_VERSION << ",\n";
+	for(const auto& ActInfo:Info){
+		o << "  \"" << escape(ActInfo.first) << "\": \"" << escape(ActInfo.second) << "\",\n";
+	}
+
+	o << "  \"phases\": [";
+	for(size_t i=0;i<Phases.size();++i){
+		o << (i==0 ? "\n" : ",\n");
+		o << "    {\"name\": \"" << escape(Phases[i].Name) << "\", \"wall_seconds\": " << Phases[i].WallTime;
+		o << ", \"cpu_seconds\": " << Phases[i].CpuTime;
+		o << ", \"peak_rss_bytes\": " << Phases[i].PeakRss << ", \"end_rss_bytes\": " << Phases[i].EndRss;
+		if(isAllocCountingEnabled()){
+			o << ", \"allocations\": " << Phases[i].Allocs.Allocations << ", \"deallocations\": " << Phases[i].Allocs.Deallocations;
+			o << ", \"allocated_bytes\": " << Phases[i].Allocs.AllocatedBytes << ", \"peak_heap_bytes\": " << Phases[i].Allocs.PeakBytes;
+			o << ", \"end_heap_bytes\": " << Phases[i].Allocs.CurrentBytes;
+		}
+		o << "}";
+		TotalWall+=Phases[i].WallTime;
+		TotalCpu+=Phases[i].CpuTime;
+		if(Phases[i].PeakRss>PeakRss) PeakRss=Phases[i].PeakRss;
+	}
+	o << "\n  ],\n";
+	o << "  \"total_wall_seconds\": " << TotalWall << ",\n";
+	o << "  \"total_cpu_seconds\": " << TotalCpu << ",\n";
+	o << "  \"peak_rss_bytes\": " << PeakRss << ",\n";
+	o << "  \"peak_rss_per_phase\": " << (PeakRssResettable ? "true" : "false") << ",\n";
+	o << "  \"alloc_counting\": " << (isAllocCountingEnabled() ? "true" : "false") << ",\n";
+
+	o << "  \"counters\": {";
+	for(size_t i=0;i<Counters.size();++i){
+		o << (i==0 ? "\n" : ",\n");
+		o << "    \"" << escape(Counters[i].first) << "\": " << Counters[i].second;
+	}
+	o << "\n  }\n}\n";
+}
+
+/**
+ * Writes the collected statistics to a file in JSON format
+ *
+ * @param[in] path The path of the file to write
+ * @throws std::ios::failure if the file can't be written
+ */
+void RunStats::save(const std::string& path) const{
+	std::ofstream ofile;
+	ofile.exceptions(std::ios::failbit | std::ios::badbit);
+	ofile.open(path.c_str(),std::ios::out | std::ios::binary);
+	ofile.imbue(std::locale::classic());
+	write(ofile);
+	ofile.close();
+}
@@ -0,0 +1,179 @@
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include "pugixml.hpp"
+#include "Sharding.h"
+
+const wchar_t* Sharding::PartialNodeName(L"templates");
+const wchar_t* Sharding::LineCountAttributeName(L"lines");
+const wchar_t* Sharding::LineLenAttributeName(L"TotalLen");
+
+/**
+ * Moves an offset to the beginning of the next line (if it isn't at the beginning of a line already)
+ *
+ * @param[in,out] is The opened input file (binary mode)
+ * @param[in] offset The offset to align
+ * @param[in] FileSize The size of the input file
+ * @return The aligned offset
+ */
+uint64_t Sharding::alignToLine(std::istream& is,uint64_t offset,uint64_t FileSize){
+	if(offset==0) return 0;
+	if(offset>=FileSize) return FileSize;
+
+	is.clear();
+	is.seekg(offset-1);
+	char buffer[4096];
+	uint64_t Position=offset-1;
+	while(is.read(buffer,sizeof(buffer)) || is.gcount()>0){
+		size_t Read=is.gcount();
+		const char* LineEnd=std::find(buffer,buffer+Read,'\n');
+		if(LineEnd!=buffer+Read) return Position+(LineEnd-buffer)+1;
+		Position+=Read;
+	}
+	return FileSize;
+}
+
+/**
+ * Calculates the byte range of a shard. The file is divided into ranges of (almost) equal size.
+ *
+ * @param[in] path The path of the input file
+ * @param[in] Index The index of the shard (0 <= Index < Count)
+ * @param[in] Count The number of shards
+ * @return The range of the shard
+ * @throws std::invalid_argument if the index is invalid
+ * @throws std::ios::failure if the file can't be read
+ */
+ShardRange Sharding::getRange(const std::string& path,unsigned int Index,unsigned int Count){
+	if(Count==0 || Index>=Count) throw std::invalid_argument("Invalid shard index!");
+
+	std::ifstream ifile;
+	ifile.exceptions(std::ios::badbit);
+	ifile.open(path.c_str(),std::ios::in | std::ios::binary);
+	if(!ifile.is_open()) throw std::ios::failure("Couldn't open input file: "+path);
+
+	ifile.seekg(0,std::ios::end);
+	uint64_t FileSize=ifile.tellg();
+
+	ShardRange Range;
+	Range.Begin=alignToLine(ifile,FileSize*Index/Count,FileSize);
+	Range.End=alignToLine(ifile,FileSize*(Index+1)/Count,FileSize);
+
+	ifile.clear();
+	ifile.seekg(Range.Begin);
+	char buffer[65536];
+	char LastChar='\n';
+	uint64_t Left=Range.End-Range.Begin;
+	while(Left>0){
+		ifile.read(buffer,std::min<uint64_t>(Left,sizeof(buffer)));
+		size_t Read=ifile.gcount();
+		if(Read==0) break;
+		Range.LineCount+=std::count(buffer,buffer+Read,'\n');
+		LastChar=buffer[Read-1];
+		Left-=Read;
+	}
+	if(LastChar!='\n') ++Range.LineCount; //the last line of the file has no line break
+
+	return Range;
+}
+
+/**
+ * Reads the lines of a shard, and stores them in the parser (see LogParser::addMessage())
+ *
+ * @param[in] path The path of the input file
+ * @param[in] Range The range of the shard (see getRange())
+ * @param[in,out] parser The parser to fill
+ * @throws std::ios::failure if the file can't be read
+ */
+void Sharding::readRange(const std::string& path,const ShardRange& Range,LogParser& parser){
+	std::ifstream ifile;
+	ifile.exceptions(std::ios::failbit);
+	ifile.open(path.c_str(),std::ios::binary | std::ios::in);
+	ifile.seekg(Range.Begin);
+
+	TokenizedMessage Message;
+	for(size_t i=0;i<Range.LineCount && !ifile.eof();++i){
+		try{
+			getline(ifile,Message.Line);
+		}
+		catch(...){
+			if(!ifile.eof()){
+				throw;
+			}
+		}
+
+		if(parser.tokenize(Message.Line,Message)) parser.addMessage(Message);
+	}
+}
+
+/**
+ * Writes a partial template set. The clusters must be compressed to templates already.
+ *
+ * @param[in] path The path of the file to write
+ * @param[in] Clusters The clusters of the shard
+ * @throws std::ios::failure if the file can't be written
+ */
+void Sharding::writePartial(const std::string& path,ListOfClusters& Clusters){
+	pugi::xml_document doc;
+	pugi::xml_node Root=doc.append_child(PartialNodeName);
+
+	for(Cluster& ActClust:Clusters){
+		pugi::xml_node ClustNode=Root.append_child(LogParser::ClusterNodeName);
+		ClustNode.append_attribute(LogParser::GoodnessAttributeName)=ActClust.getGoodness();
+		ClustNode.append_attribute(LogParser::AvgLenAttributeName)=ActClust.getAvgLen();
+		ClustNode.append_attribute(LineCountAttributeName)=(unsigned long long)ActClust.getTotalLineCount();
+		ClustNode.append_attribute(LineLenAttributeName)=(unsigned long long)ActClust.getTotalLineLen();
+
+		for(const std::shared_ptr<TokenDescriptor>& ActWord:ActClust.getLine(0)){
+			pugi::xml_node TokenNode=ClustNode.append_child(LogParser::TokenNodeName);
+			TokenNode.append_attribute(LogParser::TokenValAttributeName)=toWide(ActWord->TokenString).c_str();
+			TokenNode.append_attribute(LogParser::TokenTypeAttributeName)=ActWord->TypeOfToken;
+		}
+	}
+
+	if(!doc.save_file(path.c_str(),L"\t",pugi::format_default,pugi::encoding_utf8)){
+		throw std::ios::failure("Couldn't write partial template set: "+path);
+	}
+}
+
+/**
+ * Reads a partial template set, the clusters are appended to the list as compressed clusters.
+ *
+ * @param[in] path The path of the file to read
+ * @param[in] dict The dictionary used by the clusters (the tokens of the templates are stored in it)
+ * @param[out] Output The list to append to
+ * @throws std::runtime_error if the file can't be loaded
+ */
+void Sharding::readPartial(const std::string& path,const DictionaryPtr dict,ListOfClusters& Output){
+	pugi::xml_document doc;
+	pugi::xml_parse_result result=doc.load_file(path.c_str());
+	if(!result) throw std::runtime_error("Couldn't load partial template set "+path+": "+result.description());
+
+	pugi::xml_node Root=doc.child(PartialNodeName);
+	if(!Root) throw std::runtime_error("Not a partial template set: "+path);
+
+	for(pugi::xml_node ClustNode=Root.child(LogParser::ClusterNodeName);ClustNode;
+			ClustNode=ClustNode.next_sibling(LogParser::ClusterNodeName)){
+		ArrayOfWords Template;
+		for(pugi::xml_node TokenNode=ClustNode.child(LogParser::TokenNodeName);TokenNode;
+				TokenNode=TokenNode.next_sibling(LogParser::TokenNodeName)){
+			std::shared_ptr<TokenDescriptor> ActDesc=std::make_shared<TokenDescriptor>(
+					toUtf8(TokenNode.attribute(LogParser::TokenValAttributeName).value()),
+					(wordtype)TokenNode.attribute(LogParser::TokenTypeAttributeName).as_int());
+			auto it=dict->find(ActDesc);
+			if(it==dict->end()){
+				dict->insert(ActDesc);
+				Template.push_back(ActDesc);
+			}
+			else{
+				Template.push_back(*it);
+			}
+		}
+		if(Template.empty()) continue;
+
+		size_t LineCount=ClustNode.attribute(LineCountAttributeName).as_ullong();
+		size_t LineLen=ClustNode.attribute(LineLenAttributeName).as_ullong();
+		if(LineCount==0) throw std::runtime_error("Missing line count in partial template set: "+path);
+		Output.push_back(Cluster(std::move(Template),ClustNode.attribute(LogParser::GoodnessAttributeName).as_double(),
+				LineCount,LineLen,dict,0));
+	}
+}
@@ -0,0 +1,378 @@
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdio>
+#include "SpillClusterer.h"
+#include "ThreadPool.h"
+#include "MemoryUsage.h"
+#include "BinaryIO.h"
+
+/**
+ * Adds a line to the statistics
+ *
+ * @param[in] line The token ids of the line
+ * @param[in] Tokens The token table that stores the tokens of the line
+ */
+void StreamStatistics::add(const std::vector<uint32_t>& line,const TokenTable& Tokens){
+	if(line.size()>Values.size()){
+		Values.resize(line.size());
+		FilledColumns.resize(line.size());
+		FilledNonNumColumns.resize(line.size());
+	}
+	if(LineCount==0) FirstLine=line;
+	++LineCount;
+	TotalLineLen+=line.size();
+
+	for(size_t ActPos=0;ActPos<line.size();++ActPos){
+		if(Values[ActPos].insert(line[ActPos]).second) ++DistinctCount;
+		if(Tokens[line[ActPos]].TypeOfToken!=Number) FilledNonNumColumns[ActPos]++;
+		FilledColumns[ActPos]++;
+	}
+}
+
+/**
+ * The same as Cluster::getSplit()
+ *
+ * @return The column's number to split on, -1 if there is no ideal column
+ */
+int StreamStatistics::getSplit() const{
+	double max=-1;
+	int pos=-1;
+	for(size_t ind=0;ind<Values.size();++ind){
+		size_t NoDistinctValues=Values[ind].size();
+		if(NoDistinctValues>1 &&
+				max<(double)FilledNonNumColumns[ind]/NoDistinctValues &&
+				(double)FilledNonNumColumns[ind]/LineCount>PERCENT_OF_FILL
+		  ){
+			max=(double)FilledNonNumColumns[ind]/NoDistinctValues;
+			pos=ind;
+		}
+	}
+
+	return pos;
+}
+
+/**
+ * The same as the goodness calculated by Cluster
+ *
+ * @return The goodness of the lines added so far
+ */
+double StreamStatistics::getGoodness() const{
+	if(LineCount==0 || Values.empty()) return 1;
+
+	size_t CommonWordCounter=0;
+	for(size_t i=0;i<Values.size();++i){
+		if(Values[i].size()==1 && FilledColumns[i]==LineCount) CommonWordCounter++;
+	}
+
+	double AvgLen=(double)TotalLineLen/LineCount;
+	return (double)CommonWordCounter/AvgLen;
+}
+
+/**
+ * The same as Cluster::getTemplate()
+ *
+ * @return The token ids of the template that describes the added lines
+ */
+std::vector<uint32_t> StreamStatistics::getTemplate() const{
+	std::vector<uint32_t> Template;
+	for(size_t WordCounter=0;WordCounter<Values.size();++WordCounter){
+		if(FilledColumns[WordCounter]==LineCount){ //isn't it +n
+			if(Values[WordCounter].size()>1){ //is it constant?
+				if(FilledNonNumColumns[WordCounter]>0){
+					Template.push_back(TokenTable::AnyTokenId);
+				}
+				else{
+					Template.push_back(TokenTable::NumberTokenId);
+				}
+			}
+			else{
+				Template.push_back(FirstLine[WordCounter]);
+			}
+		}
+		else{
+			Template.push_back(TokenTable::EndTokenId);
+			break;
+		}
+	}
+	return Template;
+}
+
+/**
+ * @return The estimated bytes needed to load the added lines as a Cluster and split it in the memory
+ */
+size_t StreamStatistics::estimateClusterBytes() const{
+	size_t ret=LineCount*(LIST_NODE_OVERHEAD+sizeof(ArrayOfWords)+2*sizeof(const ArrayOfWords*));
+	ret+=TotalLineLen*sizeof(std::shared_ptr<TokenDescriptor>);
+	ret+=2*DistinctCount*(TREE_NODE_OVERHEAD+sizeof(const TokenDescriptor*));
+	ret+=2*Values.size()*(sizeof(TokenSet)+2*sizeof(size_t));
+	return ret;
+}
+
+/**
+ * @param[in] HeaderLen The length of header part of log messages
+ * @param[in] regexp The regular expression used for tokenizing the log messages
+ * @param[in] Budget The memory budget in bytes
+ * @param[in] SpillPrefix The path prefix of the partition files
+ * @param[in] lim The threshold value for goodness
+ * @param[in] numThreads The number of threads used for splitting in the memory
+ */
+SpillClusterer::SpillClusterer(size_t HeaderLen,const std::string& regexp,size_t Budget,const std::string& SpillPrefix,double lim,unsigned int numThreads):
+	Parser(HeaderLen,regexp),Budget(Budget),SpillPrefix(SpillPrefix),lim(lim),numThreads(numThreads),dict(std::make_shared<Dictionary>()),
+	FileCounter(0),PartitionCount(0),SpilledBytes(0),SplitCount(0),MaxDepth(0),BatchBytes(0),Available(Budget){}
+
+/**
+ * Reads the messages of a log file, and gives them to a function as token ids. The tokens are stored in the token table.
+ *
+ * @param[in,out] is The stream to read from
+ * @param[in] fn The function to call for each line
+ */
+void SpillClusterer::readText(std::istream& is,const std::function<void(const std::vector<uint32_t>&)>& fn){
+	std::vector<TokenDescriptor> ActTokens;
+	std::vector<uint32_t> ActLine;
+	while(Parser.readMessage(is,ActTokens)){
+		ActLine.clear();
+		for(const TokenDescriptor& ActToken:ActTokens){
+			ActLine.push_back(Tokens.intern(ActToken.TokenString,ActToken.TypeOfToken));
+		}
+		fn(ActLine);
+	}
+}
+
+/**
+ * Reads the lines of a partition file, and gives them to a function. Each line is stored
+ * as the number of its tokens followed by the token ids (32 bit unsigned integers).
+ *
+ * @param[in] path The path of the partition file
+ * @param[in] fn The function to call for each line
+ * @throws std::ios::failure if the file can't be read
+ * @throws std::runtime_error if the file is truncated
+ */
+void SpillClusterer::readPartition(const std::string& path,const std::function<void(const std::vector<uint32_t>&)>& fn) const{
+	std::ifstream ifile;
+	ifile.exceptions(std::ios::badbit);
+	ifile.open(path.c_str(),std::ios::in | std::ios::binary);
+	if(!ifile.is_open()) throw std::ios::failure("Couldn't open partition file: "+path);
+
+	std::vector<uint32_t> ActLine;
+	while(ifile.peek()!=std::char_traits<char>::eof()){
+		ActLine.resize(readPod<uint32_t>(ifile));
+		readPodArray(ifile,ActLine.data(),ActLine.size());
+		fn(ActLine);
+	}
+}
+
+/**
+ * Appends the buffered lines of a partition to its file, and releases the buffer
+ *
+ * @param[in,out] part The partition to flush
+ * @throws std::ios::failure if the file can't be written
+ */
+void SpillClusterer::flush(Partition& part){
+	if(part.Buffer.empty()) return;
+
+	std::ofstream ofile;
+	ofile.exceptions(std::ios::failbit | std::ios::badbit);
+	ofile.open(part.Path.c_str(),std::ios::out | std::ios::binary | std::ios::app);
+	writePodArray(ofile,part.Buffer.data(),part.Buffer.size());
+	ofile.close();
+
+	SpilledBytes+=part.Buffer.size()*sizeof(uint32_t);
+	std::vector<uint32_t>().swap(part.Buffer);
+}
+
+/**
+ * Splits a set of lines on disk the same way as Cluster::Split() does in the memory,
+ * each subcluster is written to its own partition file. Then the partitions are processed.
+ *
+ * @param[in] SourcePath The path of the lines to split
+ * @param[in] IsText true if the source is the input log file, false if it is a partition file
+ * @param[in] stats The statistics of the lines to split
+ * @param[in] depth The depth of the lines in the split tree
+ * @param[out] Output The list where the output clusters are stored
+ */
+void SpillClusterer::split(const std::string& SourcePath,bool IsText,const StreamStatistics& stats,unsigned int depth,ListOfClusters& Output){
+	int Position=stats.getSplit();
+	++SplitCount;
+
+	std::unordered_map<uint32_t,size_t> ChildIds;
+	std::vector<Partition> Children;
+	size_t Buffered=0;
+	size_t BufferLimit=std::max<size_t>(std::min<size_t>(SPILL_BUFFER_SIZE,Available/4),1024*1024);
+
+	auto Distribute=[&](const std::vector<uint32_t>& ActLine){
+		uint32_t Label=TokenTable::EndTokenId;
+		if((size_t)Position<ActLine.size()){
+			Label=Tokens[ActLine[Position]].TypeOfToken==Number ? TokenTable::NumberTokenId : ActLine[Position];
+		}
+
+		auto it=ChildIds.find(Label);
+		if(it==ChildIds.end()){
+			it=ChildIds.insert(std::make_pair(Label,Children.size())).first;
+			Children.push_back(Partition());
+			Children.back().Path=SpillPrefix+".spill."+std::to_string(FileCounter++);
+			Children.back().Depth=depth+1;
+			Children.back().Label=Label;
+			++PartitionCount;
+		}
+
+		Partition& Child=Children[it->second];
+		Child.Stats.add(ActLine,Tokens);
+		Child.Buffer.push_back(ActLine.size());
+		Child.Buffer.insert(Child.Buffer.end(),ActLine.begin(),ActLine.end());
+		Buffered+=(ActLine.size()+1)*sizeof(uint32_t);
+		if(Buffered>BufferLimit){
+			for(Partition& ActChild:Children) flush(ActChild);
+			Buffered=0;
+		}
+	};
+
+	if(IsText){
+		std::ifstream ifile;
+		ifile.exceptions(std::ios::failbit);
+		ifile.open(SourcePath.c_str(),std::ios::binary | std::ios::in);
+		readText(ifile,Distribute);
+	}
+	else{
+		readPartition(SourcePath,Distribute);
+	}
+	for(Partition& ActChild:Children) flush(ActChild);
+
+	std::sort(Children.begin(),Children.end(),[this](const Partition& first,const Partition& second){
+		return Tokens[first.Label].TokenString<Tokens[second.Label].TokenString;
+	});
+	for(Partition& ActChild:Children) process(ActChild,Output);
+}
+
+/**
+ * Processes a partition: it becomes an output cluster if it is good enough, it is put into the
+ * current batch if it fits in the memory, otherwise it is split on disk again.
+ *
+ * @param[in,out] part The partition to process (its statistics are released)
+ * @param[out] Output The list where the output clusters are stored
+ */
+void SpillClusterer::process(Partition& part,ListOfClusters& Output){
+	if(part.Depth>MaxDepth) MaxDepth=part.Depth;
+
+	if(part.Stats.getGoodness()>=lim){
+		ArrayOfWords Template;
+		for(uint32_t ActId:part.Stats.getTemplate()) Template.push_back(TokenPtrs[ActId]);
+		Output.push_back(Cluster(std::move(Template),part.Stats.getGoodness(),part.Stats.getLineCount(),
+				part.Stats.getTotalLineLen(),dict,part.Depth));
+		std::remove(part.Path.c_str());
+	}
+	else{
+		size_t Need=part.Stats.estimateClusterBytes();
+		if(Need<=Available || part.Stats.getSplit()==-1){
+			if(Need>Available){
+				std::cerr << "A partition can't be split on disk, it is loaded despite the memory budget (estimated size: "
+						<< Need/(1024*1024) << " MB)\n";
+			}
+			if(BatchBytes+Need>Available) processBatch(Output);
+			part.Stats=StreamStatistics();
+			Batch.push_back(std::move(part));
+			BatchBytes+=Need;
+		}
+		else{
+			split(part.Path,false,part.Stats,part.Depth,Output);
+			std::remove(part.Path.c_str());
+		}
+	}
+
+	part.Stats=StreamStatistics();
+}
+
+/**
+ * Loads the partitions of the current batch into the memory and splits them in parallel.
+ * The output clusters are compressed to templates immediately, thus the loaded lines are released.
+ *
+ * @param[out] Output The list where the output clusters are stored
+ */
+void SpillClusterer::processBatch(ListOfClusters& Output){
+	if(Batch.empty()) return;
+
+	ListOfClusters StartingClusters;
+	for(Partition& ActPart:Batch){
+		std::shared_ptr<ListOfLines> Lines=std::make_shared<ListOfLines>();
+		readPartition(ActPart.Path,[this,&Lines](const std::vector<uint32_t>& ActLine){
+			ArrayOfWords LineArray;
+			LineArray.reserve(ActLine.size());
+			for(uint32_t ActId:ActLine) LineArray.push_back(TokenPtrs[ActId]);
+			Lines->push_back(std::move(LineArray));
+		});
+		std::remove(ActPart.Path.c_str());
+		StartingClusters.push_back(Cluster(Lines,dict,ActPart.Depth));
+	}
+	Batch.clear();
+	BatchBytes=0;
+
+	ListOfClusters BatchOutput;
+	ThreadPool worker(numThreads,StartingClusters,BatchOutput,lim);
+	worker.joinAll();
+	SplitCount+=worker.getSplitCount();
+	if(worker.getMaxDepth()>MaxDepth) MaxDepth=worker.getMaxDepth();
+
+	for(Cluster& ActClust:BatchOutput) Output.push_back(std::move(ActClust)); //the workers compressed them already
+}
+
+/**
+ * Makes the shared TokenDescriptor objects (and the dictionary) used by the clusters from the token table
+ */
+void SpillClusterer::buildDictionary(){
+	TokenPtrs.clear();
+	TokenPtrs.reserve(Tokens.size());
+	for(size_t i=0;i<Tokens.size();++i){
+		std::shared_ptr<TokenDescriptor> ActToken=std::make_shared<TokenDescriptor>(Tokens[i]);
+		TokenPtrs.push_back(ActToken);
+		dict->insert(ActToken);
+	}
+}
+
+/**
+ * Reads the whole input in a streaming way, and calculates the statistics of the first cluster.
+ *
+ * @param[in,out] is The input log file
+ * @return true if the input fits in the memory budget, thus it can be clustered in the memory
+ */
+bool SpillClusterer::analyze(std::istream& is){
+	readText(is,[this](const std::vector<uint32_t>& ActLine){
+		RootStats.add(ActLine,Tokens);
+	});
+
+	return RootStats.estimateClusterBytes()<=Budget;
+}
+
+/**
+ * Clusters the input on disk. The input must be analyzed first.
+ *
+ * @param[in] InputPath The path of the input log file (it is read again)
+ * @param[out] Output The list where the output clusters are stored (their templates are already made)
+ * @throws std::ios::failure if a file can't be read or written
+ */
+void SpillClusterer::run(const std::string& InputPath,ListOfClusters& Output){
+	buildDictionary();
+
+	size_t DictionaryBytes=2*MemoryUsage::estimate(*dict)+Tokens.size()*4*sizeof(void*);
+	Available=Budget>DictionaryBytes ? Budget-DictionaryBytes : 0;
+	if(Available<Budget/4){
+		std::cerr << "The dictionary alone uses most of the memory budget (estimated size: "
+				<< DictionaryBytes/(1024*1024) << " MB)\n";
+		Available=Budget/4;
+	}
+
+	if(RootStats.getSplit()==-1){
+		std::cerr << "The cluster is not splitable yet!\n";
+		Partition Root;
+		Root.Stats=RootStats;
+		Root.Depth=0;
+		ArrayOfWords Template;
+		for(uint32_t ActId:Root.Stats.getTemplate()) Template.push_back(TokenPtrs[ActId]);
+		Output.push_back(Cluster(std::move(Template),Root.Stats.getGoodness(),Root.Stats.getLineCount(),
+				Root.Stats.getTotalLineLen(),dict,0));
+		return;
+	}
+
+	split(InputPath,true,RootStats,0,Output);
+	processBatch(Output);
+}
@@ -0,0 +1,225 @@
+#include <fstream>
+#include <deque>
+#include <algorithm>
+#include "BinaryIO.h"
+#include "SplitTree.h"
+
+static const char SplitTreeMagic[8]={'H','E','L','O','T','R','E','\0'};
+
+/**
+ * Constructor
+ *
+ * @param[in] dict The dictionary of the tokens (the labels are taken from it, and the tokens of a loaded tree are stored in it)
+ */
+SplitTree::SplitTree(const DictionaryPtr dict):dict(dict){}
+
+/**
+ * Looks up a token in the token table, a new token is appended to it
+ *
+ * @param[in] Token The token to look up (tokens are identified by address, as each token is stored once)
+ * @return The index of the token
+ */
+uint32_t SplitTree::getTokenId(const std::shared_ptr<TokenDescriptor>& Token){
+	auto it=TokenIds.find(Token.get());
+	if(it!=TokenIds.end()) return it->second;
+
+	uint32_t Id=Tokens.size();
+	Tokens.push_back(Token);
+	TokenIds.insert(std::make_pair(Token.get(),Id));
+	return Id;
+}
+
+/**
+ * Appends a node to the tree, and assigns it to the cluster (see Cluster::setTreeNode()).
+ * The lock must be held by the caller.
+ *
+ * @param[in] ActClust The cluster of the node
+ * @param[in] Label The index of the label token
+ * @return The index of the node
+ */
+uint32_t SplitTree::addNode(Cluster& ActClust,uint32_t Label){
+	Node ActNode;
+	ActNode.Depth=ActClust.getDepth();
+	ActNode.Goodness=ActClust.getGoodness();
+	ActNode.LineCount=ActClust.getTotalLineCount();
+	ActNode.LineLen=ActClust.getTotalLineLen();
+	ActNode.SplitColumn=-1;
+	ActNode.Label=Label;
+
+	ArrayOfWords Template=ActClust.getTemplate();
+	ActNode.Template.reserve(Template.size());
+	for(const std::shared_ptr<TokenDescriptor>& ActWord:Template) ActNode.Template.push_back(getTokenId(ActWord));
+
+	Nodes.push_back(std::move(ActNode));
+	return Nodes.size()-1;
+}
+
+/**
+ * Records the cluster of the whole input as the root of the tree (the tree must be empty)
+ *
+ * @param[in,out] Root The first cluster of the split phase
+ */
+void SplitTree::setRoot(Cluster& Root){
+	std::lock_guard<std::mutex> g(Locker);
+	Root.setTreeNode(addNode(Root,SPLIT_TREE_NO_LABEL));
+}
+
+/**
+ * Records a split, it can be called by several threads at once. The subclusters must not be compressed
+ * yet, as their labels are taken from their lines.
+ *
+ * @param[in] Parent The cluster that was split (its node must be recorded already)
+ * @param[in] Column The column the cluster was split on (see Cluster::Split())
+ * @param[in,out] Children The subclusters made by the split, they get the indexes of their nodes
+ */
+void SplitTree::addSplit(Cluster& Parent,int Column,ListOfClusters& Children){
+	std::shared_ptr<TokenDescriptor> NumberLabel=*(dict->find(std::make_shared<TokenDescriptor>("+d")));
+	std::shared_ptr<TokenDescriptor> EndLabel=*(dict->find(std::make_shared<TokenDescriptor>("+n")));
+
+	std::lock_guard<std::mutex> g(Locker);
+	Nodes[Parent.getTreeNode()].SplitColumn=Column;
+	for(Cluster& ActClust:Children){
+		const ArrayOfWords& FirstLine=ActClust.getLine(0);
+		const std::shared_ptr<TokenDescriptor>* Label=&EndLabel;
+		if((size_t)Column<FirstLine.size()){
+			Label=FirstLine[Column]->TypeOfToken==Number ? &NumberLabel : &FirstLine[Column];
+		}
+
+		uint32_t Id=addNode(ActClust,getTokenId(*Label));
+		Nodes[Parent.getTreeNode()].Children.push_back(Id);
+		ActClust.setTreeNode(Id);
+	}
+}
+
+/**
+ * Cuts the tree at a goodness threshold. The clusters are taken in the same order as the split
+ * phase takes them with one thread: the root is always split, a subcluster is final if its goodness
+ * reaches the threshold, otherwise its subclusters are taken. A cluster that couldn't be split is dropped,
+ * just like in the split phase. The tree must be recorded with a threshold of 1, or at least with the given one.
+ *
+ * @param[in] lim The goodness threshold
+ * @param[out] Output The list to append the final clusters to (they are compressed to their templates)
+ */
+void SplitTree::cut(double lim,ListOfClusters& Output) const{
+	if(Nodes.empty()) return;
+
+	std::deque<uint32_t> ToSplit(1,0);
+	while(!ToSplit.empty()){
+		const Node& ActNode=Nodes[ToSplit.front()];
+		ToSplit.pop_front();
+		for(uint32_t ActChild:ActNode.Children){
+			const Node& Child=Nodes[ActChild];
+			if(Child.Goodness<lim){
+				ToSplit.push_back(ActChild);
+				continue;
+			}
+
+			ArrayOfWords Template;
+			Template.reserve(Child.Template.size());
+			for(uint32_t ActToken:Child.Template) Template.push_back(Tokens[ActToken]);
+			Output.push_back(Cluster(std::move(Template),Child.Goodness,Child.LineCount,Child.LineLen,dict,Child.Depth));
+		}
+	}
+}
+
+/**
+ * Saves the tree to a binary file
+ *
+ * @param[in] path The path of the file
+ * @throws std::ios::failure if the file can't be written
+ */
+void SplitTree::save(const std::string& path) const{
+	std::ofstream file;
+	file.exceptions(std::ios::failbit | std::ios::badbit);
+	file.open(path.c_str(),std::ios::out | std::ios::binary | std::ios::trunc);
+
+	file.write(SplitTreeMagic,sizeof(SplitTreeMagic));
+	writePod<uint32_t>(file,SPLIT_TREE_FILE_VERSION);
+	writePod<uint32_t>(file,HELO_BYTE_ORDER_MARK);
+
+	writePod<uint64_t>(file,Tokens.size());
+	for(const std::shared_ptr<TokenDescriptor>& ActToken:Tokens){
+		writePod<uint32_t>(file,ActToken->TypeOfToken);
+		writeString(file,ActToken->TokenString);
+	}
+
+	writePod<uint64_t>(file,Nodes.size());
+	for(const Node& ActNode:Nodes){
+		writePod<uint32_t>(file,ActNode.Depth);
+		writePod<double>(file,ActNode.Goodness);
+		writePod<uint64_t>(file,ActNode.LineCount);
+		writePod<uint64_t>(file,ActNode.LineLen);
+		writePod<int32_t>(file,ActNode.SplitColumn);
+		writePod<uint32_t>(file,ActNode.Label);
+		writePod<uint32_t>(file,ActNode.Template.size());
+		writePodArray(file,ActNode.Template.data(),ActNode.Template.size());
+		writePod<uint32_t>(file,ActNode.Children.size());
+		writePodArray(file,ActNode.Children.data(),ActNode.Children.size());
+	}
+	file.close();
+}
+
+/**
+ * Loads a tree saved by save(), the tree must be empty. The tokens are looked up in the dictionary
+ * (a token that isn't in it is stored in it).
+ *
+ * @param[in] path The path of the file
+ * @throws SplitTreeError if the file can't be opened, or it isn't a valid split tree file
+ */
+void SplitTree::load(const std::string& path){
+	std::ifstream file(path.c_str(),std::ios::in | std::ios::binary);
+	if(!file.is_open()) throw SplitTreeError("Couldn't open split tree file: "+path);
+
+	try{
+		char Magic[sizeof(SplitTreeMagic)];
+		readPodArray(file,Magic,sizeof(Magic));
+		if(!std::equal(SplitTreeMagic,SplitTreeMagic+sizeof(SplitTreeMagic),Magic)){
+			throw SplitTreeError("Not a split tree file: "+path);
+		}
+		if(readPod<uint32_t>(file)!=SPLIT_TREE_FILE_VERSION) throw SplitTreeError("Unsupported split tree version: "+path);
+		if(readPod<uint32_t>(file)!=HELO_BYTE_ORDER_MARK) throw SplitTreeError("The split tree was written with another byte order: "+path);
+
+		uint64_t TokenCount=readPod<uint64_t>(file);
+		for(uint64_t i=0;i<TokenCount;++i){
+			wordtype Type=(wordtype)readPod<uint32_t>(file);
+			std::string ActString=readString(file);
+
+			auto it=dict->find(TokenKey(ActString.data(),ActString.size()));
+			if(it==dict->end()) it=dict->insert(std::make_shared<TokenDescriptor>(ActString,Type)).first;
+			Tokens.push_back(*it);
+		}
+
+		uint64_t NodeCount=readPod<uint64_t>(file);
+		Nodes.resize(NodeCount);
+		for(uint64_t i=0;i<NodeCount;++i){
+			Node& ActNode=Nodes[i];
+			ActNode.Depth=readPod<uint32_t>(file);
+			ActNode.Goodness=readPod<double>(file);
+			ActNode.LineCount=readPod<uint64_t>(file);
+			ActNode.LineLen=readPod<uint64_t>(file);
+			ActNode.SplitColumn=readPod<int32_t>(file);
+			ActNode.Label=readPod<uint32_t>(file);
+			ActNode.Template.resize(readPod<uint32_t>(file));
+			readPodArray(file,ActNode.Template.data(),ActNode.Template.size());
+			ActNode.Children.resize(readPod<uint32_t>(file));
+			readPodArray(file,ActNode.Children.data(),ActNode.Children.size());
+
+			if(ActNode.LineCount==0 || ActNode.Template.empty() || (ActNode.Label>=TokenCount && (i>0 || ActNode.Label!=SPLIT_TREE_NO_LABEL))){
+				throw SplitTreeError("Invalid node in split tree file: "+path);
+			}
+			for(uint32_t ActToken:ActNode.Template){
+				if(ActToken>=TokenCount) throw SplitTreeError("Invalid token index in split tree file: "+path);
+			}
+			//the subclusters are recorded after their parent, thus the tree can't contain cycles
+			for(uint32_t ActChild:ActNode.Children){
+				if(ActChild<=i || ActChild>=NodeCount) throw SplitTreeError("Invalid node index in split tree file: "+path);
+			}
+		}
+	}
+	catch(const SplitTreeError&){
+		throw;
+	}
+	catch(const std::runtime_error& e){
+		throw SplitTreeError(std::string("Corrupt split tree file ")+path+": "+e.what());
+	}
+}
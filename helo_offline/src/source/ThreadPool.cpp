@@ -1,21 +1,87 @@
 #include "ThreadPool.h"
 
+/**
+ * Copies the line pointers of a cluster to a checkpoint line set
+ *
+ * @param[out] Sets The list of line sets to append to
+ * @param[in] ActClust The cluster to copy
+ */
+static void addLineSet(std::vector<Checkpoint::LineSet>& Sets,const Cluster& ActClust){
+	Sets.emplace_back();
+	Sets.back().Depth=ActClust.getDepth();
+	Sets.back().Lines.reserve(ActClust.getLineCount());
+	for(size_t i=0;i<ActClust.getLineCount();++i) Sets.back().Lines.push_back(&ActClust.getLine(i));
+}
+
+/**
+ * Copies the template of a finished (compressed) cluster to a checkpoint
+ *
+ * @param[out] Templates The list of templates to append to
+ * @param[in] ActClust The cluster to copy
+ */
+static void addTemplate(std::vector<Checkpoint::CompressedCluster>& Templates,Cluster& ActClust){
+	Templates.emplace_back();
+	Templates.back().Template=ActClust.getTemplate();
+	Templates.back().Goodness=ActClust.getGoodness();
+	Templates.back().LineCount=ActClust.getTotalLineCount();
+	Templates.back().LineLen=ActClust.getTotalLineLen();
+	Templates.back().Depth=ActClust.getDepth();
+}
+
 /**
  * @param[in] noThreads The number of threads to create
  * @param[in] StartingCluster The first cluster that contains the whole file
  * @param[out] Output A reference to a list where good enough clusters (goodness>=threshold)
  * can be stored
  * @param[in] lim The threshold value for goodness
+ * @param[in] Saver The checkpoint to save the state to (NULL if no checkpoint is needed)
+ * @param[in] Interval The time between two checkpoints in seconds
+ * @param[in] Tree The split tree to record the splits in (NULL if the tree isn't needed)
  */
-ThreadPool::ThreadPool(size_t noThreads,Cluster StartingCluster,ListOfClusters& Output,double lim):lim(lim),OutputClusters(Output){
-	ClustersToSplit.push_back(StartingCluster);
+ThreadPool::ThreadPool(size_t noThreads,Cluster StartingCluster,ListOfClusters& Output,double lim,Checkpoint* Saver,unsigned int Interval,SplitTree* Tree):
+	lim(lim),OutputClusters(Output),SplitCount(0),MaxDepth(0),Saver(Saver),Interval(Interval),Tree(Tree),FinishedCount(0),
+	Stopping(false),CheckpointCount(0),MaxCheckpointPause(0){
+	ClustersToSplit.push_back(std::move(StartingCluster));
+	start(noThreads);
+}
+
+/**
+ * This constructor splits several clusters in parallel (e.g. partitions of a file that was
+ * split on disk). Each starting cluster is split at least once.
+ *
+ * @param[in] noThreads The number of threads to create
+ * @param[in,out] StartingClusters The clusters to split, they are moved to the pool
+ * @param[out] Output A reference to a list where good enough clusters (goodness>=threshold)
+ * can be stored
+ * @param[in] lim The threshold value for goodness
+ * @param[in] Saver The checkpoint to save the state to (NULL if no checkpoint is needed)
+ * @param[in] Interval The time between two checkpoints in seconds
+ * @param[in] Tree The split tree to record the splits in (NULL if the tree isn't needed)
+ */
+ThreadPool::ThreadPool(size_t noThreads,ListOfClusters& StartingClusters,ListOfClusters& Output,double lim,Checkpoint* Saver,unsigned int Interval,SplitTree* Tree):
+	lim(lim),OutputClusters(Output),SplitCount(0),MaxDepth(0),Saver(Saver),Interval(Interval),Tree(Tree),FinishedCount(0),
+	Stopping(false),CheckpointCount(0),MaxCheckpointPause(0){
+	for(Cluster& ActClust:StartingClusters){
+		ClustersToSplit.push_back(std::move(ActClust));
+	}
+	start(noThreads);
+}
+
+/**
+ * Starts the threads of the pool
+ * @param[in] noThreads The number of threads to create
+ */
+void ThreadPool::start(size_t noThreads){
 	threads.resize(noThreads);
 	Busy.resize(noThreads);
+	InFlight.resize(noThreads,NULL);
 
 	for(size_t i=0;i<noThreads;++i){
 
 		threads[i]=std::thread(&ThreadPool::ThreadFunction,this,i);
 	}
+
+	if(Saver && Interval>0) CheckpointThread=std::thread(&ThreadPool::CheckpointFunction,this);
 }
 
 /**
@@ -37,7 +103,9 @@ void ThreadPool::ThreadFunction(size_t id){
 	do{
 		Cluster OwnCluster;
 		try{
+			std::shared_lock<std::shared_timed_mutex> StateGuard(StateLock);
 			OwnCluster=ClustersToSplit.pop_front();
+			InFlight[id]=&OwnCluster;
 			std::lock_guard<std::mutex> g(BusyLocker);
 			Busy[id]=true;
 		}
@@ -50,7 +118,9 @@ void ThreadPool::ThreadFunction(size_t id){
 		bool IsSplitable=true;
 
 		try{
-			OwnCluster.Split(OwnList);
+			++SplitCount;
+			int Column=OwnCluster.Split(OwnList);
+			if(Tree) Tree->addSplit(OwnCluster,Column,OwnList);
 		}
 		catch(const std::invalid_argument& e){
 			std::lock_guard<std::mutex> g(ErrorLocker);
@@ -58,15 +128,26 @@ void ThreadPool::ThreadFunction(size_t id){
 			IsSplitable=false;
 		}
 
+		//the final clusters are compressed by the workers, thus their lines and statistics are released at once
 		for(Cluster& ActClust:OwnList){
-			if(ActClust.getGoodness()>=lim || !IsSplitable){
-				OutputClusters.push_back(ActClust);
-			}
-			else{
-				ClustersToSplit.push_back(ActClust);
+			if(ActClust.getGoodness()>=lim || !IsSplitable) ActClust.compressToTemplate();
+		}
+
+		unsigned int ActMaxDepth=MaxDepth.load();
+		{
+			std::shared_lock<std::shared_timed_mutex> StateGuard(StateLock);
+			for(Cluster& ActClust:OwnList){
+				while(ActClust.getDepth()>ActMaxDepth && !MaxDepth.compare_exchange_weak(ActMaxDepth,ActClust.getDepth()));
+				if(ActClust.getGoodness()>=lim || !IsSplitable){
+					OutputClusters.push_back(std::move(ActClust));
+				}
+				else{
+					ClustersToSplit.push_back(std::move(ActClust));
+				}
 			}
+			InFlight[id]=NULL;
 		}
-		
+
 		{
 			std::lock_guard<std::mutex> g(BusyLocker);
 			Busy[id]=false;
@@ -75,8 +156,70 @@ void ThreadPool::ThreadFunction(size_t id){
 }
 
 /**
- * This method joins all threads in the pool (waits for all the threads to terminate)
+ * The thread function of the checkpoint thread, it saves a checkpoint in every Interval seconds
+ * until the pool is stopped
+ */
+void ThreadPool::CheckpointFunction(){
+	std::unique_lock<std::mutex> g(StopLocker);
+	while(!StopSignal.wait_for(g,std::chrono::seconds(Interval),[this]{return Stopping;})){
+		g.unlock();
+		saveCheckpoint();
+		g.lock();
+	}
+}
+
+/**
+ * Saves a checkpoint. The workers are blocked only while the line pointers of the clusters to split are copied,
+ * and the clusters finished since the previous checkpoint are collected. The output is only appended to
+ * (its elements don't move), thus the templates of these clusters are copied after the lock is released,
+ * and the templates of the earlier checkpoints are reused. A failed save is reported, but it doesn't stop the split phase.
+ */
+void ThreadPool::saveCheckpoint(){
+	std::vector<Checkpoint::LineSet> Pending;
+	std::vector<Cluster*> NewFinished;
+	std::chrono::steady_clock::time_point Begin=std::chrono::steady_clock::now();
+	{
+		std::unique_lock<std::shared_timed_mutex> StateGuard(StateLock);
+		for(const Cluster& ActClust:ClustersToSplit) addLineSet(Pending,ActClust);
+		for(const Cluster* ActClust:InFlight){
+			if(ActClust) addLineSet(Pending,*ActClust);
+		}
+		ListOfClusters::iterator it=(FinishedCount==0 ? OutputClusters.begin() : std::next(LastFinished));
+		for(;it!=OutputClusters.end();++it){
+			NewFinished.push_back(&*it);
+			LastFinished=it;
+			++FinishedCount;
+		}
+	}
+	uint64_t Pause=std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-Begin).count();
+	if(Pause>MaxCheckpointPause) MaxCheckpointPause=Pause;
+
+	for(Cluster* ActClust:NewFinished) addTemplate(Finished,*ActClust);
+
+	try{
+		Saver->save(Pending,Finished,SplitCount.load(),MaxDepth.load());
+		++CheckpointCount;
+	}
+	catch(const std::exception& e){
+		std::lock_guard<std::mutex> g(ErrorLocker);
+		std::cerr << "Couldn't write checkpoint: " << e.what() << std::endl;
+	}
+}
+
+/**
+ * This method joins all threads in the pool (waits for all the threads to terminate).
+ * If checkpoints are enabled, a last checkpoint is saved with the finished state.
  */
 void ThreadPool::joinAll(){
 	for(std::thread& ActThread:threads) ActThread.join();
-} 
+
+	if(CheckpointThread.joinable()){
+		{
+			std::lock_guard<std::mutex> g(StopLocker);
+			Stopping=true;
+		}
+		StopSignal.notify_all();
+		CheckpointThread.join();
+		saveCheckpoint();
+	}
+}
@@ -1,18 +1,116 @@
 #include <stdexcept>
 #include <map>
-#include <codecvt>
 #include "cluster.h"
+#include "MemoryUsage.h"
 #include "pugixml.hpp"
 
 /**
  * @param[in] lines A list of lines with the contents of the cluster
  * @param[in] dict A set that contains the words used in the cluster
+ * @param[in] depth The depth of the cluster in the split tree
+ * @param[in] weights The multiplicities of the lines if the input was deduplicated (NULL otherwise)
  */
-Cluster::Cluster(const std::shared_ptr<ListOfLines> lines,const DictionaryPtr dict):Content(lines),dict(dict),id(0),TotalLineLen(0){
-    TotalLineCount=Content->size();
+Cluster::Cluster(const std::shared_ptr<ListOfLines> lines,const DictionaryPtr dict,unsigned int depth,const std::shared_ptr<const LineWeights> weights):Corpus(lines),
+    Memory(std::make_shared<Arena>(lines->size()*sizeof(ArrayOfWords*)*2)),Lines(ArenaAllocator<const ArrayOfWords*>(Memory.get())),dict(dict),
+    Weights(weights),Values(ArenaAllocator<TokenSet>(Memory.get())),FilledColumns(ArenaAllocator<size_t>(Memory.get())),
+    FilledNonNumColumns(ArenaAllocator<size_t>(Memory.get())),id(0),TotalLineLen(0),depth(depth),TreeNode(0){
+    Lines.reserve(lines->size());
+    for(const ArrayOfWords& ActLine:*lines) Lines.push_back(&ActLine);
     CalcStatistics();
 }
 
+/**
+ * This constructor makes a cluster from a subset of the lines of the parsed file (it is used when a
+ * checkpoint is loaded).
+ *
+ * @param[in] lines The lines of the parsed file
+ * @param[in] subset Pointers to the lines of the cluster (they must point into lines)
+ * @param[in] dict The dictionary of the tokens
+ * @param[in] depth The depth of the cluster in the split tree
+ * @param[in] weights The multiplicities of the lines if the input was deduplicated (NULL otherwise)
+ */
+Cluster::Cluster(const std::shared_ptr<ListOfLines> lines,const std::vector<const ArrayOfWords*>& subset,const DictionaryPtr dict,unsigned int depth,
+    const std::shared_ptr<const LineWeights> weights):
+    Corpus(lines),Memory(std::make_shared<Arena>(subset.size()*sizeof(ArrayOfWords*)*2)),
+    Lines(subset.begin(),subset.end(),ArenaAllocator<const ArrayOfWords*>(Memory.get())),dict(dict),Weights(weights),
+    Values(ArenaAllocator<TokenSet>(Memory.get())),FilledColumns(ArenaAllocator<size_t>(Memory.get())),
+    FilledNonNumColumns(ArenaAllocator<size_t>(Memory.get())),id(0),TotalLineLen(0),depth(depth),TreeNode(0){
+    CalcStatistics();
+}
+
+/**
+ * This constructor makes an already compressed cluster from a template and the statistics of its
+ * former lines (it is used if the lines were never loaded into the memory).
+ *
+ * @param[in] Template The template of the cluster (its tokens must be stored in the dictionary)
+ * @param[in] goodness The goodness of the cluster
+ * @param[in] LineCount The number of lines in the cluster
+ * @param[in] LineLen The total length (number of tokens) of the lines
+ * @param[in] dict The dictionary of the tokens
+ * @param[in] depth The depth of the cluster in the split tree
+ */
+Cluster::Cluster(ArrayOfWords&& Template,double goodness,size_t LineCount,size_t LineLen,const DictionaryPtr dict,unsigned int depth):
+    dict(dict),TotalLineCount(LineCount),MaxLineLen(0),goodness(goodness),id(0),TotalLineLen(LineLen),depth(depth),TreeNode(0){
+    setTemplateLine(std::move(Template));
+}
+
+/**
+ * This constructor makes a subcluster, its lines and statistics are allocated from the given arena.
+ *
+ * @param[in] parent The cluster that is split
+ * @param[in] lines The lines of the subcluster (they must be allocated from the arena)
+ * @param[in] memory The arena of the subclusters made by one split
+ */
+Cluster::Cluster(const Cluster& parent,LineVector&& lines,const std::shared_ptr<Arena>& memory):Corpus(parent.Corpus),
+    Memory(memory),Lines(std::move(lines)),dict(parent.dict),Weights(parent.Weights),Values(ArenaAllocator<TokenSet>(memory.get())),
+    FilledColumns(ArenaAllocator<size_t>(memory.get())),FilledNonNumColumns(ArenaAllocator<size_t>(memory.get())),
+    id(0),TotalLineLen(0),depth(parent.depth+1),TreeNode(0){
+    CalcStatistics();
+}
+
+/**
+ * Copy assignment, the lines and the statistics of the copy are allocated from the heap (see ArenaAllocator)
+ *
+ * @param[in] other The cluster to copy
+ * @return Reference to this cluster
+ */
+Cluster& Cluster::operator=(const Cluster& other){
+    return *this=Cluster(other);
+}
+
+/**
+ * Move assignment. The members that may be allocated from the arena (the lines and the statistics) are
+ * replaced before the arena itself. The implicit move assignment would assign Memory first (in the order
+ * of declaration), and if this cluster held the last reference to its arena, the old token sets would
+ * be destroyed after their arena had been released. Declaring Memory after them is not an option, because
+ * then the destructor would release the arena first.
+ *
+ * @param[in,out] other The cluster to move from
+ * @return Reference to this cluster
+ */
+Cluster& Cluster::operator=(Cluster&& other){
+    if(this==&other) return *this;
+
+    Lines=std::move(other.Lines);
+    Values=std::move(other.Values);
+    FilledColumns=std::move(other.FilledColumns);
+    FilledNonNumColumns=std::move(other.FilledNonNumColumns);
+    Memory=std::move(other.Memory);
+
+    Corpus=std::move(other.Corpus);
+    TemplateLine=std::move(other.TemplateLine);
+    dict=std::move(other.dict);
+    Weights=std::move(other.Weights);
+    TotalLineCount=other.TotalLineCount;
+    MaxLineLen=other.MaxLineLen;
+    goodness=other.goodness;
+    id=other.id;
+    TotalLineLen=other.TotalLineLen;
+    depth=other.depth;
+    TreeNode=other.TreeNode;
+    return *this;
+}
+
 /**
  * @return The column's number to split on, -1 if there is no ideal column
  */
@@ -23,7 +121,7 @@ int Cluster::getSplit(){
         size_t NoDistinctValues=Values[ind].size();
         if(NoDistinctValues>1 &&
                 max<(double)FilledNonNumColumns[ind]/NoDistinctValues &&
-                (double)FilledNonNumColumns[ind]/Content->size()>PERCENT_OF_FILL
+                (double)FilledNonNumColumns[ind]/TotalLineCount>PERCENT_OF_FILL
           ){
             max=(double)FilledNonNumColumns[ind]/NoDistinctValues;
             pos=ind;
@@ -34,78 +132,106 @@ int Cluster::getSplit(){
 }
 
 /**
- * Splits a cluster to several smaller subclusters
+ * Splits a cluster to several smaller subclusters. The subclusters share one arena, which
+ * is sized according to the number of lines of this cluster.
  *
  * @param[in,out] ClusterList A reference to a list where output clusters can be stored
+ * @return The column the cluster was split on
  * @throws std::invalid_argument if the cluster can't be split yet (there is no proper split position)
  */
-void Cluster::Split(ListOfClusters& ClusterList){
+int Cluster::Split(ListOfClusters& ClusterList){
     int Position=getSplit();
     if(Position==-1) throw std::invalid_argument("The cluster is not splitable yet!\n");
-    std::map<std::shared_ptr<TokenDescriptor>,std::shared_ptr<ListOfLines>,WordComparator> Clusters;
-
-    for(ArrayOfWords& ActLine:*Content){
-        std::shared_ptr<TokenDescriptor> ClusterLabel;
-
-        try{
-            std::shared_ptr<TokenDescriptor> TokDesc=ActLine.at(Position);
+    std::map<std::shared_ptr<TokenDescriptor>,size_t,WordComparator> Clusters;
+    std::vector<size_t> LabelOfLine(Lines.size());
+    std::vector<size_t> LineCounts;
+    std::shared_ptr<TokenDescriptor> NumberLabel=*(dict->find(std::make_shared<TokenDescriptor>("+d")));
+    std::shared_ptr<TokenDescriptor> EndLabel=*(dict->find(std::make_shared<TokenDescriptor>("+n")));
+
+    for(size_t i=0;i<Lines.size();++i){
+        const ArrayOfWords& ActLine=*Lines[i];
+        const std::shared_ptr<TokenDescriptor>* ClusterLabel=&EndLabel;
+
+        if((size_t)Position<ActLine.size()){
+            const std::shared_ptr<TokenDescriptor>& TokDesc=ActLine[Position];
             if(TokDesc->TypeOfToken==Number){
-                ClusterLabel=*(dict->find(std::make_shared<TokenDescriptor>(L"+d")));
+                ClusterLabel=&NumberLabel;
             }
             else{
-                ClusterLabel=TokDesc;
+                ClusterLabel=&TokDesc;
             }
         }
-        catch(const std::out_of_range&){
-            ClusterLabel=*(dict->find(std::make_shared<TokenDescriptor>(L"+n")));
-        }
 
-        try{
-            Clusters.at(ClusterLabel)->push_back(ActLine);
-        }
-        catch(std::out_of_range&){
-            Clusters.insert(std::make_pair(ClusterLabel,std::make_shared<ListOfLines>()));
-            Clusters[ClusterLabel]->push_back(ActLine);
+        auto it=Clusters.find(*ClusterLabel);
+        if(it==Clusters.end()){
+            it=Clusters.insert(std::make_pair(*ClusterLabel,LineCounts.size())).first;
+            LineCounts.push_back(0);
         }
+        LabelOfLine[i]=it->second;
+        LineCounts[it->second]++;
+    }
+
+    std::shared_ptr<Arena> SubMemory=std::make_shared<Arena>(Lines.size()*sizeof(ArrayOfWords*)*2);
+    std::vector<LineVector> SubLines;
+    SubLines.reserve(LineCounts.size());
+    for(size_t ActCount:LineCounts){
+        SubLines.push_back(LineVector(ArenaAllocator<const ArrayOfWords*>(SubMemory.get())));
+        SubLines.back().reserve(ActCount);
+    }
+    for(size_t i=0;i<Lines.size();++i){
+        SubLines[LabelOfLine[i]].push_back(Lines[i]);
     }
 
     for(const auto& ActEntry:Clusters){
-        ClusterList.push_back(Cluster(ActEntry.second,dict));
+        ClusterList.push_back(Cluster(*this,std::move(SubLines[ActEntry.second]),SubMemory));
     }
+    return Position;
 }
 
+/**
+ * Calculates the statistics of the cluster. If the input was deduplicated, each line is
+ * counted with its multiplicity, thus the statistics are the same as without deduplication.
+ */
 void Cluster::CalcStatistics(){
     double AvgLen=0;
     MaxLineLen=0;
+    TotalLineCount=0;
     FilledColumns.clear();
     FilledNonNumColumns.clear();
     Values.clear();
 
-    for(const ArrayOfWords& ActLine:*Content){
-        if(ActLine.size()>MaxLineLen){
-            MaxLineLen=ActLine.size();
-            Values.resize(MaxLineLen);
-            FilledColumns.resize(MaxLineLen);
-            FilledNonNumColumns.resize(MaxLineLen);
-        }
-        AvgLen+=ActLine.size();
-
-        for(size_t ActPos=0;ActPos<ActLine.size();++ActPos){
-            Values[ActPos].insert(ActLine[ActPos]);
-            if(ActLine[ActPos]->TypeOfToken!=Number) FilledNonNumColumns[ActPos]++;
-            FilledColumns[ActPos]++;
+    for(const ArrayOfWords* ActLine:Lines){
+        if(ActLine->size()>MaxLineLen) MaxLineLen=ActLine->size();
+    }
+    Values.reserve(MaxLineLen);
+    for(size_t i=0;i<MaxLineLen;++i){
+        Values.emplace_back(std::less<const TokenDescriptor*>(),TokenSet::allocator_type(Memory.get()));
+    }
+    FilledColumns.resize(MaxLineLen);
+    FilledNonNumColumns.resize(MaxLineLen);
+
+    for(const ArrayOfWords* ActLine:Lines){
+        size_t Weight=getWeight(ActLine);
+        TotalLineCount+=Weight;
+        AvgLen+=ActLine->size()*Weight;
+
+        for(size_t ActPos=0;ActPos<ActLine->size();++ActPos){
+            const TokenDescriptor* ActToken=(*ActLine)[ActPos].get();
+            Values[ActPos].insert(ActToken);
+            if(ActToken->TypeOfToken!=Number) FilledNonNumColumns[ActPos]+=Weight;
+            FilledColumns[ActPos]+=Weight;
         }
     }
 
     size_t CommonWordCounter=0;
     for(size_t i=0;i<Values.size();++i){
-        if(Values[i].size()==1 && FilledColumns[i]==Content->size()) CommonWordCounter++;
+        if(Values[i].size()==1 && FilledColumns[i]==TotalLineCount) CommonWordCounter++;
     }
 
     if(TotalLineLen==0) TotalLineLen=AvgLen;
     AvgLen/=TotalLineCount;
 
-    if(Content->size()==0 || MaxLineLen==0){
+    if(Lines.size()==0 || MaxLineLen==0){
         goodness=1;
     }
     else{
@@ -127,16 +253,16 @@ double Cluster::getGoodness(){
  * @return The relative goodness of the clusters (it is a measure of closeness here).
  */
 double Cluster::getGoodness(Cluster& other){
-    if(Content->empty() ||other.Content->empty()) return 0;
+    if(Lines.empty() || other.Lines.empty()) return 0;
     size_t CommonWordCounter=0;
-    ArrayOfWords& this_template=(*(Content->begin()));
-    ArrayOfWords& other_template=(*(other.Content->begin()));
+    const ArrayOfWords& this_template=*Lines.front();
+    const ArrayOfWords& other_template=*other.Lines.front();
     size_t this_length=this_template.size();
     size_t other_length=other_template.size();
     double AvgLineLen=(double)(this_length+other_length)/2;
 
     for(size_t ActPos=0;ActPos<this_length && ActPos<other_length;++ActPos){
-        if(this_template[ActPos]->TokenString==L"+n" || other_template[ActPos]->TokenString==L"+n") {
+        if(this_template[ActPos]->TokenString=="+n" || other_template[ActPos]->TokenString=="+n") {
             ++CommonWordCounter;
             break;
         }
@@ -147,28 +273,53 @@ double Cluster::getGoodness(Cluster& other){
 }
 
 /**
- * @return A template that describes the cluster
+ * @return The estimated bytes held by the statistics of the cluster (Values, FilledColumns, FilledNonNumColumns).
+ * The tokens are not counted, as they are shared with the dictionary.
+ */
+size_t Cluster::getStatisticsBytes() const {
+    size_t ret=Values.capacity()*sizeof(TokenSet);
+    for(const auto& ActColumn:Values){
+        ret+=ActColumn.size()*(TREE_NODE_OVERHEAD+sizeof(const TokenDescriptor*));
+    }
+    ret+=FilledColumns.capacity()*sizeof(size_t);
+    ret+=FilledNonNumColumns.capacity()*sizeof(size_t);
+    return ret;
+}
+
+/**
+ * @return The estimated bytes held by the lines of the cluster (the pointers to the lines, or the template
+ * if the cluster is compressed). The lines of the parsed file are not counted.
+ */
+size_t Cluster::getContentBytes() const {
+    size_t ret=Lines.capacity()*sizeof(const ArrayOfWords*);
+    if(TemplateLine) ret+=SHARED_BLOCK_OVERHEAD+sizeof(ArrayOfWords)+TemplateLine->capacity()*sizeof(std::shared_ptr<TokenDescriptor>);
+    return ret;
+}
+
+/**
+ * @return A template that describes the cluster (if the cluster is already compressed then the stored template)
  */
 ArrayOfWords Cluster::getTemplate() const {
+    if(TemplateLine) return *TemplateLine;
     ArrayOfWords Template;
 
     std::vector<wordtype> AggregatedType(MaxLineLen,Number);
-    for(const ArrayOfWords& ActLine:*Content){
-        size_t LineLen=ActLine.size();
+    for(const ArrayOfWords* ActLine:Lines){
+        size_t LineLen=ActLine->size();
         for(size_t i=0;i<LineLen;++i){
-            if(ActLine[i]->TypeOfToken!=Number) AggregatedType[i]=ActLine[i]->TypeOfToken;
+            if((*ActLine)[i]->TypeOfToken!=Number) AggregatedType[i]=(*ActLine)[i]->TypeOfToken;
         }
     }
 
-    ArrayOfWords& FirstLine=(*(Content->begin()));
+    const ArrayOfWords& FirstLine=*Lines.front();
     for(size_t WordCounter=0;WordCounter<MaxLineLen;++WordCounter){
-        if(FilledColumns[WordCounter]==Content->size()){ //isn't it +n
+        if(FilledColumns[WordCounter]==TotalLineCount){ //isn't it +n
             if(Values[WordCounter].size()>1){ //is it constant?
                 if(AggregatedType[WordCounter]!=Number){
-                    Template.push_back(*(dict->find(std::make_shared<TokenDescriptor>(L"*"))));
+                    Template.push_back(*(dict->find(std::make_shared<TokenDescriptor>("*"))));
                 }
                 else{
-                    Template.push_back(*(dict->find(std::make_shared<TokenDescriptor>(L"+d"))));
+                    Template.push_back(*(dict->find(std::make_shared<TokenDescriptor>("+d"))));
                 }
 
             }
@@ -177,21 +328,42 @@ ArrayOfWords Cluster::getTemplate() const {
             }
         }
         else{
-            Template.push_back(*(dict->find(std::make_shared<TokenDescriptor>(L"+n"))));
+            Template.push_back(*(dict->find(std::make_shared<TokenDescriptor>("+n"))));
             break;
         }
     }
     return Template;
 }
 
+/**
+ * This method replaces the lines of the cluster with one template line, and
+ * releases the statistics. The template is stored on the heap, thus the arena
+ * of the cluster is released when all the clusters of its group are compressed,
+ * and the parsed file is released when all the clusters are compressed.
+ *
+ * @param[in] Template The template line to store
+ */
+void Cluster::setTemplateLine(ArrayOfWords&& Template){
+    TemplateLine=std::make_shared<const ArrayOfWords>(std::move(Template));
+    LineVector TemplateLines;
+    TemplateLines.push_back(TemplateLine.get());
+    Lines.swap(TemplateLines);
+
+    std::vector<TokenSet,ArenaAllocator<TokenSet> >().swap(Values);
+    std::vector<size_t,ArenaAllocator<size_t> >().swap(FilledColumns);
+    std::vector<size_t,ArenaAllocator<size_t> >().swap(FilledNonNumColumns);
+    MaxLineLen=0;
+    Memory.reset();
+    Corpus.reset();
+}
+
 /**
  * This method deletes all lines of the cluster, and stores only a template line
- * calculated from the former content.
+ * calculated from the former content. A cluster that is already compressed is not changed.
  */
 void Cluster::compressToTemplate(){
-    ArrayOfWords Template=getTemplate();
-    Content->clear();
-    Content->push_back(Template);
+    if(TemplateLine) return;
+    setTemplateLine(getTemplate());
 }
 
 /**
@@ -202,12 +374,12 @@ void Cluster::compressToTemplate(){
  * totally deleted
  */
 void Cluster::join(Cluster& other){
-    const ArrayOfWords& thisLine=Content->front();
-    const ArrayOfWords& otherLine=other.Content->front();
+    const ArrayOfWords& thisLine=*Lines.front();
+    const ArrayOfWords& otherLine=*other.Lines.front();
     ArrayOfWords mergedTemplate;
     for(size_t i=0;i<thisLine.size() && i<otherLine.size();++i){
-        if(thisLine[i]->TokenString==L"+n" || otherLine[i]->TokenString==L"+n"){
-            mergedTemplate.push_back(*dict->find(std::make_shared<TokenDescriptor>(L"+n")));
+        if(thisLine[i]->TokenString=="+n" || otherLine[i]->TokenString=="+n"){
+            mergedTemplate.push_back(*dict->find(std::make_shared<TokenDescriptor>("+n")));
             break;
         }
 
@@ -218,22 +390,22 @@ void Cluster::join(Cluster& other){
         }
         else{
             if(AggregateType==Number){ //insert +d
-                mergedTemplate.push_back(*dict->find(std::make_shared<TokenDescriptor>(L"+d")));
+                mergedTemplate.push_back(*dict->find(std::make_shared<TokenDescriptor>("+d")));
             }
             else{ //insert *
-                mergedTemplate.push_back(*dict->find(std::make_shared<TokenDescriptor>(L"*")));
+                mergedTemplate.push_back(*dict->find(std::make_shared<TokenDescriptor>("*")));
             }
         }
     }
 
-    if(mergedTemplate.back()->TokenString!=L"+n" && thisLine.size()!=otherLine.size()){ //push_back +n
-        mergedTemplate.push_back(*dict->find(std::make_shared<TokenDescriptor>(L"+n")));
+    if(mergedTemplate.back()->TokenString!="+n" && thisLine.size()!=otherLine.size()){ //push_back +n
+        mergedTemplate.push_back(*dict->find(std::make_shared<TokenDescriptor>("+n")));
     }
     TotalLineLen+=other.TotalLineLen;
     TotalLineCount+=other.TotalLineCount;
-    other.Content->clear();
-    Content->clear();
-    Content->push_back(mergedTemplate);
+    other.Lines.clear();
+    other.TemplateLine.reset();
+    setTemplateLine(std::move(mergedTemplate));
 }
 
 /**
@@ -251,9 +423,9 @@ std::wostream& operator<<(std::wostream& o,const Cluster& c){
     ClustNode.append_attribute(LogParser::GoodnessAttributeName)=c.goodness;
     ClustNode.append_attribute(LogParser::AvgLenAttributeName)=c.getAvgLen();
 
-    for(const std::shared_ptr<TokenDescriptor> ActWord:(*c.Content->begin())){
+    for(const std::shared_ptr<TokenDescriptor> ActWord:*c.Lines.front()){
         pugi::xml_node TokenNode=ClustNode.append_child(LogParser::TokenNodeName);
-        TokenNode.append_attribute(LogParser::TokenValAttributeName)=ActWord->TokenString.c_str();
+        TokenNode.append_attribute(LogParser::TokenValAttributeName)=toWide(ActWord->TokenString).c_str();
         TokenNode.append_attribute(LogParser::TokenTypeAttributeName)=ActWord->TypeOfToken;
     }
 
@@ -263,7 +435,8 @@ std::wostream& operator<<(std::wostream& o,const Cluster& c){
 
 /**
  * This method implements cluster output to a SQLite database.
- * The database must be already opened for writing before using this method
+ * The database must be already opened for writing before using this method. The line statistics
+ * of the cluster are written to the cluster_stats table.
  *
  * @param[in,out] db A reference to the Database object, which implements the database API
  * @param[in] c The cluster to write to the database
@@ -273,12 +446,16 @@ SQLite::Database& operator<<(SQLite::Database& db,const Cluster& c){
     std::ostringstream query;
     try{
         query << "INSERT INTO clusters VALUES (NULL,\"";
-        for(const std::shared_ptr<TokenDescriptor> ActWord:(*c.Content->begin())){
-            query << std::wstring_convert<std::codecvt_utf8<wchar_t>>().to_bytes(ActWord->TokenString) << " ";
+        for(const std::shared_ptr<TokenDescriptor> ActWord:*c.Lines.front()){
+            query << ActWord->TokenString << " ";
         }
 
         query << "\"," << c.goodness << "," << c.getAvgLen() << ")";
         db.exec(query.str().c_str());
+
+        query.str("");
+        query << "INSERT INTO cluster_stats VALUES (last_insert_rowid()," << c.TotalLineCount << "," << c.TotalLineLen << ")";
+        db.exec(query.str().c_str());
     }
     catch(const SQLite::Exception& e){
         std::wcerr << "An SQL error occured: " << e.what() << std::endl << "Query: " << query.str().c_str() << std::endl;
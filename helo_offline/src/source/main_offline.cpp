@@ -2,8 +2,19 @@
 #include <fstream>
 #include <iostream>
 #include <string.h>
+#include <stdio.h>
+#include <memory>
 
 #include "ThreadPool.h"
+#include "SpillClusterer.h"
+#include "IncrementalUpdate.h"
+#include "Sharding.h"
+#include "Checkpoint.h"
+#include "SplitTree.h"
+#include "CorpusCache.h"
+#include "ModelFile.h"
+#include "RunStats.h"
+#include "MemoryUsage.h"
 
 /**
  * @file main_offline.cpp
@@ -65,6 +76,56 @@ using namespace std;
  * <tr><td>regexp</td><td>The regular expression used for tokenizing the input messages. It can be given
  * in POSIX regex format, and it can be set by -re\<regexpr\> command line parameter. Defaultly white spaces
  * will be used as token separators.</td></tr>
+ * <tr><td>ModelPath</td><td>The path of a binary cluster model to write besides the normal output. It can be set
+ * by -bm\<path\> command line parameter. The model can be loaded by the online algorithm much faster than
+ * the database. The cluster ids in the model are the same as in the normal output. If the output is a database,
+ * the model stores its generation, thus the online algorithm only reads the rows changed since the model was made.</td></tr>
+ * <tr><td>UseStats</td><td>A boolean parameter, if it is set by --stats parameter then the wall clock and CPU time
+ * of each phase, and some counters (number of lines, tokens, Split calls, etc.) are written in JSON format
+ * to \<output_file\>.stats.json. The peak memory usage of each phase and the estimated size of the main data
+ * structures are written as well.</td></tr>
+ * <tr><td>MemoryBudget</td><td>The memory budget of the clustering in megabytes, it can be set by -mb\<value\>
+ * command line parameter. If it is set, the input is read in a streaming way first, and if the estimated memory
+ * need of the clustering exceeds the budget, the input is split on disk into partition files (see SpillClusterer).
+ * Defaultly there is no budget, the whole input is clustered in the memory.</td></tr>
+ * <tr><td>SpillPrefix</td><td>The path prefix of the partition files written if the memory budget is exceeded.
+ * It can be set by -sp\<prefix\> command line parameter, its default value is the path of the output file.</td></tr>
+ * <tr><td>Update</td><td>A boolean parameter, if it is set by -up parameter then the output database (it requires -d)
+ * is updated incrementally: the existing clusters are loaded, and only the messages that don't match their templates
+ * are clustered. The new clusters are merged into the existing ones if they are similar enough (see MergeThreshold),
+ * otherwise they are added to the database. The ids of the existing clusters don't change.</td></tr>
+ * <tr><td>Shard</td><td>The shard to process, it can be set by -sh\<index\>/\<count\> command line parameter.
+ * If it is set, the input file is divided into \<count\> parts at line boundaries, only the part with the given index
+ * (starting from 0) is clustered, and a partial template set (see Sharding) is written to the output file.
+ * The shards can be run by separate processes, even on separate machines.</td></tr>
+ * <tr><td>CheckpointInterval</td><td>The time between two checkpoints of the split phase in seconds, it can be set by
+ * -cp\<value\> command line parameter. The finished clusters and the clusters still to split are saved to
+ * \<output_file\>.checkpoint (see Checkpoint), the file is deleted after a successful run. Defaultly there are
+ * no checkpoints.</td></tr>
+ * <tr><td>Resume</td><td>A boolean parameter, if it is set by --resume parameter then the split phase continues from
+ * the checkpoint of a former run. The input is parsed again, thus the input file and the options must be the same as
+ * in the former run. If there is no checkpoint, the clustering starts from the beginning.</td></tr>
+ * <tr><td>Deduplicate</td><td>A boolean parameter, if it is set by --dedup parameter then the messages that are the same
+ * after the header is dropped are stored only once, with their multiplicity. The statistics of the clusters count each
+ * message with its multiplicity, thus the templates are the same as without deduplication, but the memory need and the
+ * time of the split phase decrease with the ratio of duplicates.</td></tr>
+ * <tr><td>UseNumberTable</td><td>A boolean parameter, if it is set by --number-table parameter then the Number tokens
+ * are not stored in the dictionary, but in a compact table (see LogParser::setNumberTable()). The numbers are usually
+ * the bulk of the dictionary, thus the memory need of the parse phase decreases. The templates don't change.</td></tr>
+ * <tr><td>MergeMode</td><td>If the first command line parameter is --merge, then the following parameters (except the
+ * options) are a partial template sets written by shards. These are merged into one result, which is written to the
+ * output file (this is the second command line parameter) as usual.</td></tr>
+ * <tr><td>TreePath</td><td>The path of the split tree file, it can be set by -tr\<path\> command line parameter. If it is set,
+ * the input is split until no cluster can be split further, and the whole split hierarchy is saved (see SplitTree). The output
+ * is the same as without this parameter, but the split phase takes longer.</td></tr>
+ * <tr><td>RecutMode</td><td>If the first command line parameter is --recut, then the following parameter (except the options)
+ * is a split tree file written by -tr. The tree is cut at the goodness threshold (see lim) without parsing and splitting the input,
+ * and the result is merged (see MergeThreshold) and written to the output file (this is the second command line parameter) as
+ * usual. The result is the same as the result of a run with one thread on the original input with the same options.</td></tr>
+ * <tr><td>CachePath</td><td>The path of the tokenized corpus to write, it can be set by -tc\<path\> command line parameter.
+ * The parsed input is written to this file (see CorpusCache), and the file can be given as the input file of later runs,
+ * which skip the parsing then. The cache can only be used with the same HeaderLen, regexp, loc, Deduplicate and
+ * UseNumberTable options as the run that wrote it.</td></tr>
  * </table>
  */
 int main(int argc,char* argv[]){
@@ -73,17 +134,51 @@ int main(int argc,char* argv[]){
 	double lim=0.4;
 	double MergeLimit=0.8;
 	bool UseDb=false;
+	bool UseStats=false;
+	bool Update=false;
+	bool MergeMode=false;
+	bool RecutMode=false;
+	unsigned int ShardIndex=0;
+	unsigned int ShardCount=0;
+	unsigned int CheckpointInterval=0;
+	bool Resume=false;
+	bool Deduplicate=false;
+	bool UseNumberTable=false;
+	vector<string> PartialPaths;
+	string TreePath="";
+	string CachePath="";
 	string loc="";
-	wstring regexp(L"[\\s]+");
+	string ModelPath="";
+	size_t MemoryBudget=0;
+	string SpillPrefix=argv[argc>2 ? 2 : 0];
+	string regexp("[\\s]+");
 
 	const string HelpMessage=string("Usage: ")+string(argv[0])+
-			string(" <input_file> <output_file> [options]\n Options:\n  -st<value> - sets the goodness threshold")+
+			string(" <input_file> <output_file> [options]\n   or: ")+string(argv[0])+
+			string(" --merge <output_file> <partial_file>... [options]\n   or: ")+string(argv[0])+
+			string(" --recut <output_file> <tree_file> [options]\n Options:\n  -st<value> - sets the goodness threshold")+
 			string("\n  \t(default: 0.4), this value must be between 0 and 1\n")+
 			string("  -he<value> The length (number of words) of the header part of log messages\n \t(default: 4)\n")+
-			string("  -lo<name> The localization used to read the input file \n  \t(system language is default)\n")+
+			string("  -lo<name> The localization used to classify the national characters of the input file,\n")+
+			string("  \tthe input is read as UTF-8 (system language is default)\n")+
 			string("  -d The program will write the results into a SQLite file if this option is used\n")+
 			string("  -re<value> <value> can be an extended POSIX regular expression, it sets the regex for tokenization\n")+
-			string("  -mt<value> Sets the merge threshold value (default value is 0.8)\n");
+			string("  -mt<value> Sets the merge threshold value (default value is 0.8)\n")+
+			string("  -bm<path> Writes a binary cluster model to <path> besides the normal output\n")+
+			string("  --stats Writes timing, memory usage and counters of the run to <output_file>.stats.json\n")+
+			string("  -mb<value> Sets the memory budget in megabytes, the input is split on disk if it doesn't fit\n")+
+			string("  -sp<prefix> The path prefix of the partition files (default: <output_file>)\n")+
+			string("  -up Updates the existing clusters of the output database (requires -d), only new messages are clustered\n")+
+			string("  -sh<index>/<count> Clusters only the given part of the input, and writes a partial template set\n")+
+			string("  \tto <output_file> (these can be merged by --merge)\n")+
+			string("  -cp<value> Saves a checkpoint of the split phase to <output_file>.checkpoint in every <value> seconds\n")+
+			string("  --resume Continues the split phase from the checkpoint of a former run with the same input and options\n")+
+			string("  --dedup Stores repeated messages only once with their multiplicity (the templates don't change)\n")+
+			string("  --number-table Keeps the numbers out of the dictionary in a compact table (the templates don't change)\n")+
+			string("  -tr<path> Saves the whole split tree to <path>, it can be cut at any threshold by --recut later\n")+
+			string("  \t(the input is split until no cluster can be split further, thus the split phase takes longer)\n")+
+			string("  -tc<path> Writes the tokenized input to <path> (.helotok), it can be the input file of later runs\n")+
+			string("  \twith the same -he, -re, -lo, --dedup and --number-table options, these don't parse the input again\n");
 
 	if(argc<3){
 		cerr << HelpMessage;
@@ -95,17 +190,34 @@ int main(int argc,char* argv[]){
 		return 0;
 	}
 
+	if(strcmp(argv[1],"--merge")==0) MergeMode=true;
+	if(strcmp(argv[1],"--recut")==0) RecutMode=true;
+
 	if(argc>3){
 		for(int i=3;i<argc;++i){
+			if(MergeMode && argv[i][0]!='-') PartialPaths.push_back(argv[i]);
+			if(RecutMode && argv[i][0]!='-') TreePath=argv[i];
+			if(strncmp(argv[i],"-tr",3)==0 && !RecutMode) TreePath=string(&argv[i][3]);
+			if(strncmp(argv[i],"-tc",3)==0) CachePath=string(&argv[i][3]);
 			if(strncmp(argv[i],"-he",3)==0) HeaderLen=atoi(&argv[i][3]);
 			if(strncmp(argv[i],"-mt",3)==0) MergeLimit=atof(&argv[i][3]);
 			if(strncmp(argv[i],"-st",3)==0) lim=atof(&argv[i][3]);
 			if(strncmp(argv[i],"-lo",3)==0) loc=string(&argv[i][3]);
 			if(strncmp(argv[i],"-d",2)==0) UseDb=true;
-			if(strncmp(argv[i],"-re",3)==0){
-				string tempStr(&argv[i][3]);
-				regexp=wstring(tempStr.begin(),tempStr.end());
+			if(strncmp(argv[i],"-bm",3)==0) ModelPath=string(&argv[i][3]);
+			if(strcmp(argv[i],"--stats")==0) UseStats=true;
+			if(strncmp(argv[i],"-mb",3)==0) MemoryBudget=(size_t)atol(&argv[i][3])*1024*1024;
+			if(strncmp(argv[i],"-sp",3)==0) SpillPrefix=string(&argv[i][3]);
+			if(strcmp(argv[i],"-up")==0) Update=true;
+			if(strncmp(argv[i],"-cp",3)==0) CheckpointInterval=atoi(&argv[i][3]);
+			if(strcmp(argv[i],"--resume")==0) Resume=true;
+			if(strcmp(argv[i],"--dedup")==0) Deduplicate=true;
+			if(strcmp(argv[i],"--number-table")==0) UseNumberTable=true;
+			if(strncmp(argv[i],"-sh",3)==0 && (sscanf(&argv[i][3],"%u/%u",&ShardIndex,&ShardCount)!=2 || ShardIndex>=ShardCount)){
+				cerr << "Wrong shard! It must be given as <index>/<count>, where 0 <= index < count.\n";
+				return -1;
 			}
+			if(strncmp(argv[i],"-re",3)==0) regexp=string(&argv[i][3]);
 		}
 	}
 
@@ -114,7 +226,65 @@ int main(int argc,char* argv[]){
 		return -1;
 	}
 
+	if(Update && (!UseDb || MemoryBudget>0)){
+		cerr << "Incremental update (-up) requires a database output (-d), and it can't be used with a memory budget (-mb)!\n";
+		return -1;
+	}
+
+	if(ShardCount>0 && (UseDb || Update || MemoryBudget>0 || MergeMode || !ModelPath.empty())){
+		cerr << "A shard (-sh) writes a partial template set, it can't be used with -d, -up, -mb, -bm or --merge!\n";
+		return -1;
+	}
+
+	if(MergeMode && (PartialPaths.empty() || Update || MemoryBudget>0)){
+		cerr << "At least one partial template set must be given to merge, and it can't be used with -up or -mb!\n";
+		return -1;
+	}
+
+	if((CheckpointInterval>0 || Resume) && (ShardCount>0 || MemoryBudget>0 || MergeMode)){
+		cerr << "Checkpoints (-cp, --resume) can't be used with -sh, -mb or --merge!\n";
+		return -1;
+	}
+
+	if((Deduplicate || UseNumberTable) && (MemoryBudget>0 || MergeMode)){
+		cerr << "Deduplication (--dedup) and the number table (--number-table) can't be used with -mb or --merge!\n";
+		return -1;
+	}
+
+	if(!TreePath.empty() && (MemoryBudget>0 || Update || ShardCount>0 || CheckpointInterval>0 || Resume || MergeMode)){
+		cerr << "The split tree (-tr, --recut) can't be used with -mb, -up, -sh, -cp, --resume or --merge!\n";
+		return -1;
+	}
+
+	if(RecutMode && (TreePath.empty() || Deduplicate || UseNumberTable)){
+		cerr << "A split tree file must be given to cut, and it can't be used with --dedup or --number-table!\n";
+		return -1;
+	}
+
+	bool CacheInput=!MergeMode && !RecutMode && CorpusCache::isCache(argv[1]);
+	if((CacheInput || !CachePath.empty()) && (MemoryBudget>0 || Update || ShardCount>0 || MergeMode || RecutMode)){
+		cerr << "A tokenized corpus (-tc, or as input file) can't be used with -mb, -up, -sh, --merge or --recut!\n";
+		return -1;
+	}
+
+	RunStats Stats;
+	Stats.setInfo("input",argv[1]);
+	Stats.setInfo("output",argv[2]);
+	Stats.setCounter("threads",numCPU);
+	if(ShardCount>0){
+		Stats.setCounter("shard_index",ShardIndex);
+		Stats.setCounter("shard_count",ShardCount);
+	}
+
 	Cluster FirstCluster;
+	ListOfClusters OutputClusters;
+	ListOfClusters ResumedClusters;
+	DictionaryPtr Dict;
+	shared_ptr<ListOfLines> Corpus;
+	unique_ptr<SpillClusterer> Spiller;
+	unique_ptr<IncrementalUpdate> Updater;
+	unique_ptr<Checkpoint> Saver;
+	unique_ptr<SplitTree> Tree;
 	try{
 		locale WordLocale=locale(loc.c_str());
 		locale local=locale(WordLocale,locale(),locale::numeric);
@@ -122,22 +292,162 @@ int main(int argc,char* argv[]){
 		cout << "Starting Helo! Number of CPU cores: " << numCPU << endl;
 		cout << "Applied options:\n localization: " << WordLocale.name() << "\n Length of header part (in words): " << HeaderLen;
 		cout << "\n Goodness limit: " << lim << "\n Merge limit: " << MergeLimit;
-		cout << "\n Regular expression: " << string(regexp.begin(),regexp.end()) << endl;
-
-		LogParser File((size_t)HeaderLen,regexp);
-		wifstream ifile;
-		ifile.exceptions(ios::failbit);
-		ifile.open(argv[1],ios::binary | ios::in);
-		ifile >> File;
-		ifile.close();
-		FirstCluster=Cluster(File.getContent(),File.getDictionary());
+		cout << "\n Regular expression: " << regexp << endl;
+
+		Stats.beginPhase("parse");
+		if(MemoryBudget>0){
+			Spiller.reset(new SpillClusterer((size_t)HeaderLen,regexp,MemoryBudget,SpillPrefix,lim,numCPU));
+			ifstream ifile;
+			ifile.exceptions(ios::failbit);
+			ifile.open(argv[1],ios::binary | ios::in);
+			bool Fits=Spiller->analyze(ifile);
+			ifile.close();
+			Stats.setCounter("estimated_bytes",Spiller->getEstimatedBytes());
+			if(Fits){
+				Spiller.reset();
+			}
+			else{
+				cout << "The input doesn't fit in the memory budget (estimated size: " << Spiller->getEstimatedBytes()/(1024*1024)
+						<< " MB), it is split on disk\n";
+				Stats.setCounter("lines",Spiller->getLineCount());
+				Stats.setCounter("tokens",Spiller->getTokenCount());
+				Stats.setCounter("dictionary_size",Spiller->getDictionarySize());
+			}
+		}
+
+		if(Update){
+			SQLite::Database db(argv[2],SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+			db.exec("CREATE TABLE IF NOT EXISTS clusters (clustid INTEGER PRIMARY KEY,template text NOT NULL,goodness real NOT NULL,AvgLen real NOT NULL)");
+			db.exec("CREATE TABLE IF NOT EXISTS cluster_stats (clustid INTEGER PRIMARY KEY,LineCount INTEGER NOT NULL,TotalLen INTEGER NOT NULL,FOREIGN KEY(clustid) REFERENCES clusters(clustid))");
+			Updater.reset(new IncrementalUpdate(db));
+			cout << "Incremental update, number of existing clusters: " << Updater->getTemplateCount() << endl;
+		}
+
+		if(MergeMode || RecutMode){
+			Dict=make_shared<Dictionary>();
+			Dict->insert(make_shared<TokenDescriptor>("*",Word));
+			Dict->insert(make_shared<TokenDescriptor>("+d",Number));
+			Dict->insert(make_shared<TokenDescriptor>("+n",Word));
+			try{
+				if(RecutMode){
+					Tree.reset(new SplitTree(Dict));
+					Tree->load(TreePath);
+					Tree->cut(lim,OutputClusters);
+				}
+				for(const string& ActPath:PartialPaths) Sharding::readPartial(ActPath,Dict,OutputClusters);
+			}
+			catch(const runtime_error& e){
+				cerr << e.what() << endl;
+				return -1;
+			}
+			if(RecutMode){
+				Stats.setCounter("split_tree_nodes",Tree->size());
+				cout << "Split tree is loaded, number of nodes: " << Tree->size() << ", number of clusters: " << OutputClusters.size() << endl;
+			}
+			else{
+				Stats.setCounter("partial_sets",PartialPaths.size());
+				cout << "Partial template sets are loaded, number of clusters: " << OutputClusters.size() << endl;
+			}
+		}
+		else if(!Spiller){
+			CorpusSettings Settings={(uint32_t)HeaderLen,regexp,WordLocale.name(),
+					(Deduplicate ? (uint32_t)CorpusDeduplicated : 0u) | (UseNumberTable ? (uint32_t)CorpusNumberTable : 0u)};
+			shared_ptr<const LineWeights> Weights;
+			shared_ptr<const NumberTable> Numbers;
+			size_t MessageCount=0;
+			if(CacheInput){
+				CorpusCache Cache(argv[1],Settings);
+				Corpus=Cache.getContent();
+				Dict=Cache.getDictionary();
+				Weights=Cache.getWeights();
+				Numbers=Cache.getNumberTable();
+				MessageCount=Cache.getMessageCount();
+				cout << "The input is a tokenized corpus, parsing is skipped\n";
+			}
+			else{
+				LogParser File((size_t)HeaderLen,regexp);
+				File.setDeduplication(Deduplicate);
+				File.setNumberTable(UseNumberTable);
+				if(ShardCount>0){
+					ShardRange Range=Sharding::getRange(argv[1],ShardIndex,ShardCount);
+					Sharding::readRange(argv[1],Range,File);
+					Stats.setCounter("shard_begin",Range.Begin);
+					Stats.setCounter("shard_end",Range.End);
+					cout << "Shard " << ShardIndex << "/" << ShardCount << ": bytes " << Range.Begin << "-" << Range.End << endl;
+				}
+				else{
+					ifstream ifile;
+					ifile.exceptions(ios::failbit);
+					ifile.open(argv[1],ios::binary | ios::in);
+					if(Updater){
+						vector<TokenDescriptor> Tokens;
+						while(File.readMessage(ifile,Tokens)){
+							if(!Updater->classify(Tokens)) File.addMessage(Tokens);
+						}
+						Stats.setCounter("existing_clusters",Updater->getTemplateCount());
+						Stats.setCounter("matched_lines",Updater->getMatchedLines());
+						cout << "Messages matching existing clusters: " << Updater->getMatchedLines()
+								<< ", messages to cluster: " << File.getContent()->size() << endl;
+					}
+					else{
+						ifile >> File;
+					}
+					ifile.close();
+				}
+				Corpus=File.getContent();
+				Dict=File.getDictionary();
+				Weights=File.getWeights();
+				Numbers=File.getNumberTable();
+				MessageCount=File.getMessageCount();
+
+				if(!CachePath.empty()){
+					try{
+						CorpusCache::save(CachePath,File,Settings);
+						cout << "Tokenized corpus is written (filename: " << CachePath << ")\n";
+					}
+					catch(const ios::failure& e){
+						cerr << "Couldn't write the tokenized corpus! Cause: " << e.what() << endl;
+					}
+				}
 #ifdef DEBUG
-		wcout << File << endl;
+				wcout << File << endl;
 #endif
+			}
+			if(CheckpointInterval>0 || Resume) Saver.reset(new Checkpoint(string(argv[2])+".checkpoint",Corpus,Dict,Weights));
+			if(!Resume || !Saver->exists()) FirstCluster=Cluster(Corpus,Dict,0,Weights);
+			if(!TreePath.empty()){
+				Tree.reset(new SplitTree(Dict));
+				Tree->setRoot(FirstCluster);
+			}
+
+			size_t TokenCount=0;
+			for(const ArrayOfWords& ActLine:*Corpus) TokenCount+=ActLine.size();
+			Stats.setCounter("lines",MessageCount);
+			if(Deduplicate){
+				Stats.setCounter("distinct_lines",Corpus->size());
+				cout << "Deduplication: " << MessageCount << " messages, " << Corpus->size() << " distinct\n";
+			}
+			Stats.setCounter("tokens",TokenCount);
+			Stats.setCounter("dictionary_size",Dict->size());
+			Stats.setCounter("dictionary_bytes",MemoryUsage::estimate(*Dict));
+			if(Numbers){
+				Stats.setCounter("number_table_size",Numbers->size());
+				Stats.setCounter("number_table_bytes",MemoryUsage::estimate(*Numbers));
+			}
+			Stats.setCounter("lines_bytes",MemoryUsage::estimate(*Corpus));
+			Stats.setCounter("first_cluster_statistics_bytes",FirstCluster.getStatisticsBytes());
+		}
 	}
 	catch(const ios::failure& e){
 		cerr << "A problem occurred during reading the input file: " << e.what() << endl;
-		cerr << "Maybe the used localization doesn't fit the input file?\n";
+		return -1;
+	}
+	catch(const SQLite::Exception& e){
+		cerr << "Couldn't load the clusters of the database: " << e.what() << endl;
+		return -1;
+	}
+	catch(const CorpusCacheError& e){
+		cerr << e.what() << endl;
 		return -1;
 	}
 	catch(runtime_error&){
@@ -145,17 +455,85 @@ int main(int argc,char* argv[]){
 		return -1;
 	}
 
+	if(Resume){
+		if(Saver && Saver->exists()){
+			try{
+				Saver->load(ResumedClusters,OutputClusters);
+			}
+			catch(const CheckpointError& e){
+				cerr << e.what() << endl;
+				return -1;
+			}
+			Stats.setCounter("resumed_pending_clusters",ResumedClusters.size());
+			Stats.setCounter("resumed_finished_clusters",OutputClusters.size());
+			cout << "Resuming from checkpoint, clusters to split: " << ResumedClusters.size()
+					<< ", finished clusters: " << OutputClusters.size() << endl;
+		}
+		else{
+			cout << "There is no checkpoint to resume from, clustering starts from the beginning\n";
+		}
+	}
+	if(FirstCluster.getLineCount()>0) ResumedClusters.push_back(std::move(FirstCluster));
+
 	cout << "Beginning of multithreaded run!\n";
-	ListOfClusters OutputClusters;
-	ThreadPool worker(numCPU,FirstCluster,OutputClusters,lim);
-	try{
-		worker.joinAll();
+	Stats.beginPhase("split");
+	if(Spiller){
+		try{
+			Spiller->run(argv[1],OutputClusters);
+		}
+		catch(std::exception& e){
+			cerr << "Spill mode run failed! Error: " << e.what();
+			return -1;
+		}
+		Stats.setCounter("split_calls",Spiller->getSplitCount());
+		Stats.setCounter("split_depth",Spiller->getMaxDepth());
+		Stats.setCounter("spill_partitions",Spiller->getPartitionCount());
+		Stats.setCounter("spill_bytes",Spiller->getSpilledBytes());
 	}
-	catch(std::exception& e){
-		cerr << "Multithreaded run failed! Error: " << e.what();
-		return -1;
+	else if(!ResumedClusters.empty()){
+		//the tree is split as deep as possible, thus it can be cut at any threshold
+		ThreadPool worker(numCPU,ResumedClusters,OutputClusters,Tree ? 1.0 : lim,Saver.get(),CheckpointInterval,Tree.get());
+		try{
+			worker.joinAll();
+		}
+		catch(std::exception& e){
+			cerr << "Multithreaded run failed! Error: " << e.what();
+			return -1;
+		}
+		if(Tree){
+			OutputClusters.clear();
+			Tree->cut(lim,OutputClusters);
+			Stats.setCounter("split_tree_nodes",Tree->size());
+			try{
+				Tree->save(TreePath);
+				cout << "Split tree is written (filename: " << TreePath << ", number of nodes: " << Tree->size() << ")\n";
+			}
+			catch(const ios::failure& e){
+				cerr << "Couldn't write the split tree! Cause: " << e.what() << endl;
+			}
+		}
+		uint64_t SplitCalls=worker.getSplitCount();
+		unsigned int SplitDepth=worker.getMaxDepth();
+		if(Saver){
+			SplitCalls+=Saver->getLoadedSplitCount();
+			if(Saver->getLoadedMaxDepth()>SplitDepth) SplitDepth=Saver->getLoadedMaxDepth();
+			Stats.setCounter("checkpoints",worker.getCheckpointCount());
+			Stats.setCounter("checkpoint_max_pause_us",worker.getMaxCheckpointPause());
+		}
+		Stats.setCounter("split_calls",SplitCalls);
+		Stats.setCounter("split_depth",SplitDepth);
 	}
 
+	size_t OutputLinesBytes=0;
+	size_t OutputStatisticsBytes=0;
+	for(const Cluster& ActClust:OutputClusters){
+		OutputLinesBytes+=ActClust.getContentBytes();
+		OutputStatisticsBytes+=ActClust.getStatisticsBytes();
+	}
+	Stats.setCounter("output_clusters_lines_bytes",OutputLinesBytes);
+	Stats.setCounter("output_clusters_statistics_bytes",OutputStatisticsBytes);
+	Stats.setCounter("arena_bytes",Arena::getTotalBytes());
+
 #ifdef DEBUG
 	for(const Cluster& ActClust:OutputClusters){
 		wcout << ActClust << endl;
@@ -163,11 +541,15 @@ int main(int argc,char* argv[]){
 #endif
 
 	cout << "Multithreaded run is done, making templates...\n";
+	Stats.beginPhase("template");
 	for(Cluster& ActClust:OutputClusters){
 		ActClust.compressToTemplate();
 	}
 
 	cout << "Templates are done, joining similar templates...\n";
+	Stats.beginPhase("merge");
+	Stats.setCounter("clusters_before_merge",OutputClusters.size());
+	size_t PairsCompared=0;
 	for(Cluster& OuterCluster:OutputClusters){
 		for(auto it=OutputClusters.begin();it!=OutputClusters.end();){
 			if(OuterCluster==*it){
@@ -175,6 +557,7 @@ int main(int argc,char* argv[]){
 				continue;
 			}
 
+			++PairsCompared;
 			if(OuterCluster.getGoodness(*it)>=MergeLimit){
 				OuterCluster.join(*it);
 				it=OutputClusters.erase(it);
@@ -185,18 +568,42 @@ int main(int argc,char* argv[]){
 		}
 	}
 
+	Stats.setCounter("clusters_after_merge",OutputClusters.size());
+	Stats.setCounter("merge_pairs_compared",PairsCompared);
+	if(Updater){
+		Stats.setCounter("merged_into_existing",Updater->merge(OutputClusters,Dict,MergeLimit));
+	}
+
 	cout << "Templates are merged! Writing the result to file...\n";
+	Stats.beginPhase("write");
+	int64_t Generation=-1;
 	try{
-		if(UseDb){
+		if(ShardCount>0){
+			Sharding::writePartial(argv[2],OutputClusters);
+		}
+		else if(UseDb){
 			SQLite::Database db(argv[2], SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
 			SQLite::Transaction transaction(db);
 			db.exec("PRAGMA foreign_keys=ON");
 			db.exec("CREATE TABLE IF NOT EXISTS clusters (clustid INTEGER PRIMARY KEY,template text NOT NULL,goodness real NOT NULL,AvgLen real NOT NULL)");
+			db.exec("CREATE TABLE IF NOT EXISTS cluster_stats (clustid INTEGER PRIMARY KEY,LineCount INTEGER NOT NULL,TotalLen INTEGER NOT NULL,FOREIGN KEY(clustid) REFERENCES clusters(clustid))");
 			db.exec("CREATE TABLE IF NOT EXISTS syslog (clustid INTEGER,msg text NOT NULL,FOREIGN KEY(clustid) REFERENCES clusters(clustid))");
 
+			if(Updater) Stats.setCounter("updated_clusters",Updater->save(db));
 			for(Cluster& ActClust:OutputClusters){
 				db << ActClust;
+				ActClust.setId(db.getLastInsertRowid());
 			}
+
+			//the clusters written so far are in the model, the later changes of the clusters table are logged by triggers
+			db.exec("CREATE TABLE IF NOT EXISTS cluster_changes (seq INTEGER PRIMARY KEY AUTOINCREMENT,clustid INTEGER UNIQUE NOT NULL)");
+			db.exec("CREATE TRIGGER IF NOT EXISTS clusters_inserted AFTER INSERT ON clusters BEGIN "
+					"DELETE FROM cluster_changes WHERE clustid=NEW.clustid; INSERT INTO cluster_changes(clustid) VALUES(NEW.clustid); END");
+			db.exec("CREATE TRIGGER IF NOT EXISTS clusters_updated AFTER UPDATE ON clusters BEGIN "
+					"DELETE FROM cluster_changes WHERE clustid=NEW.clustid; INSERT INTO cluster_changes(clustid) VALUES(NEW.clustid); END");
+			SQLite::Statement GenerationQuery(db,"SELECT ifnull(max(seq),0) FROM cluster_changes");
+			GenerationQuery.executeStep();
+			Generation=GenerationQuery.getColumn(0).getInt64();
 			transaction.commit();
 		}
 		else{
@@ -211,6 +618,17 @@ int main(int argc,char* argv[]){
 			}
 			ofile.close();
 		}
+
+		if(!ModelPath.empty()){
+			ModelWriter model;
+			if(Generation>=0) model.setGeneration(Generation);
+			if(Updater) Updater->addToModel(model);
+			for(Cluster& ActClust:OutputClusters){
+				model.addCluster(ActClust.getLine(0),ActClust.getGoodness(),ActClust.getAvgLen(),ActClust.getId());
+			}
+			model.save(ModelPath);
+			cout << "Binary cluster model is written (filename: " << ModelPath << ")\n";
+		}
 	}
 	catch(const ios::failure& e){
 		cerr << "Couldn't write result to output file!\nCause:" << e.what() << endl;
@@ -231,6 +649,20 @@ int main(int argc,char* argv[]){
 		return -1;
 	}
 
+	if(Saver) Saver->remove();
+
+	Stats.endPhase();
+	if(UseStats){
+		string StatsPath=string(argv[2])+".stats.json";
+		try{
+			Stats.save(StatsPath);
+			cout << "Run statistics are written (filename: " << StatsPath << ")\n";
+		}
+		catch(const ios::failure& e){
+			cerr << "Couldn't write run statistics! Cause: " << e.what() << endl;
+		}
+	}
+
 	cout << "Successful run, see the output file (filename: " << argv[2] << ")\n";
 	return 0;
 }
@@ -0,0 +1,49 @@
+#include <vector>
+#include <cstdint>
+#include <lest/lest.hpp>
+#include "Arena.h"
+
+static const lest::test _arenaSuite[] {
+    CASE("allocate: Allocated memory is aligned") {
+        Arena arena;
+        arena.allocate(1, 1);
+        void* ptr = arena.allocate(sizeof(double), alignof(double));
+        EXPECT(reinterpret_cast<uintptr_t>(ptr) % alignof(double) == 0u);
+    },
+    CASE("allocate: Allocations don't overlap") {
+        Arena arena;
+        char* first = static_cast<char*>(arena.allocate(16, 1));
+        char* second = static_cast<char*>(arena.allocate(16, 1));
+        EXPECT((second >= first + 16 || first >= second + 16));
+    },
+    CASE("allocate: Allocation larger than a chunk gets its own chunk") {
+        Arena arena;
+        arena.allocate(ARENA_MIN_CHUNK_SIZE * 4, 1);
+        EXPECT(arena.getAllocatedBytes() >= ARENA_MIN_CHUNK_SIZE * 4u);
+    },
+    CASE("ArenaAllocator: Container elements are allocated from the arena") {
+        Arena arena;
+        std::vector<int, ArenaAllocator<int> > vect{ArenaAllocator<int>(&arena)};
+        for (int i = 0; i < 1000; ++i) vect.push_back(i);
+        EXPECT(vect[999] == 999);
+        EXPECT(arena.getAllocatedBytes() >= 1000 * sizeof(int));
+    },
+    CASE("ArenaAllocator: Copied container allocates from the heap") {
+        Arena arena;
+        std::vector<int, ArenaAllocator<int> > vect{ArenaAllocator<int>(&arena)};
+        vect.push_back(1);
+        std::vector<int, ArenaAllocator<int> > copy(vect);
+        EXPECT(copy.get_allocator().Memory == nullptr);
+        EXPECT(copy[0] == 1);
+    },
+    CASE("ArenaAllocator: Moved container keeps the arena") {
+        Arena arena;
+        std::vector<int, ArenaAllocator<int> > vect{ArenaAllocator<int>(&arena)};
+        vect.push_back(1);
+        std::vector<int, ArenaAllocator<int> > moved;
+        moved = std::move(vect);
+        EXPECT(moved.get_allocator().Memory == &arena);
+    }
+};
+
+extern const lest::tests arenaSuite(_arenaSuite, _arenaSuite + sizeof(_arenaSuite) / sizeof(*_arenaSuite));
@@ -0,0 +1,104 @@
+#include <sstream>
+#include <cstdio>
+#include <lest/lest.hpp>
+#include "Checkpoint.h"
+#include "ThreadPool.h"
+
+static const char* checkpointTestFile = "checkpoint_test.bin";
+
+static inline LogParser* genParser(const std::string& fileContent) {
+    LogParser* parser = new LogParser(0, "[\\s]+");
+    std::stringstream fileObj(fileContent);
+    fileObj >> *parser;
+    return parser;
+}
+
+static inline Checkpoint::LineSet genLineSet(const ListOfLines& lines, size_t first, size_t count, unsigned int depth) {
+    Checkpoint::LineSet lineSet;
+    lineSet.Depth = depth;
+    auto it = lines.begin();
+    std::advance(it, first);
+    for (size_t i = 0; i < count; ++i, ++it) lineSet.Lines.push_back(&*it);
+    return lineSet;
+}
+
+static inline Checkpoint::CompressedCluster genCompressed(LogParser& parser, size_t first, size_t count, unsigned int depth) {
+    Checkpoint::LineSet lineSet = genLineSet(*parser.getContent(), first, count, depth);
+    Cluster clust(parser.getContent(), lineSet.Lines, parser.getDictionary(), depth);
+    clust.compressToTemplate();
+    Checkpoint::CompressedCluster compressed;
+    compressed.Template = clust.getTemplate();
+    compressed.Goodness = clust.getGoodness();
+    compressed.LineCount = clust.getTotalLineCount();
+    compressed.LineLen = clust.getTotalLineLen();
+    compressed.Depth = depth;
+    return compressed;
+}
+
+static const lest::test _checkpointSuite[] {
+    CASE("load: The clusters are restored with their lines and depths") {
+        std::unique_ptr<LogParser> parser(genParser("A B 1\nA B 2\nC D E\nC D F\nC D G\n"));
+        Checkpoint saver(checkpointTestFile, parser->getContent(), parser->getDictionary());
+        std::vector<Checkpoint::LineSet> pending { genLineSet(*parser->getContent(), 2, 3, 1) };
+        std::vector<Checkpoint::CompressedCluster> finished { genCompressed(*parser, 0, 2, 2) };
+        saver.save(pending, finished, 7, 2);
+
+        Checkpoint loader(checkpointTestFile, parser->getContent(), parser->getDictionary());
+        ListOfClusters loadedPending, loadedFinished;
+        loader.load(loadedPending, loadedFinished);
+        loader.remove();
+        EXPECT(loader.getLoadedSplitCount() == 7u);
+        EXPECT(loader.getLoadedMaxDepth() == 2u);
+        EXPECT(loadedPending.size() == 1u);
+        EXPECT(loadedFinished.size() == 1u);
+        EXPECT(loadedPending.begin()->getLineCount() == 3u);
+        EXPECT(loadedPending.begin()->getDepth() == 1u);
+        EXPECT(&loadedPending.begin()->getLine(0) == pending[0].Lines[0]);
+        EXPECT(loadedFinished.begin()->getTotalLineCount() == 2u);
+        EXPECT(loadedFinished.begin()->getTotalLineLen() == 6u);
+        EXPECT(loadedFinished.begin()->getDepth() == 2u);
+        EXPECT(loadedFinished.begin()->getTemplate() == finished[0].Template);
+        EXPECT(!loader.exists());
+    },
+    CASE("load: A checkpoint of another input is rejected") {
+        std::unique_ptr<LogParser> parser(genParser("A B 1\nA B 2\n"));
+        Checkpoint saver(checkpointTestFile, parser->getContent(), parser->getDictionary());
+        saver.save({ genLineSet(*parser->getContent(), 0, 2, 0) }, {}, 0, 0);
+
+        std::unique_ptr<LogParser> other(genParser("A B 1\nA B C 2\n"));
+        Checkpoint loader(checkpointTestFile, other->getContent(), other->getDictionary());
+        ListOfClusters pending, finished;
+        EXPECT_THROWS_AS(loader.load(pending, finished), CheckpointError);
+        loader.remove();
+    },
+    CASE("load: A missing checkpoint file is reported") {
+        std::unique_ptr<LogParser> parser(genParser("A B 1\n"));
+        Checkpoint loader("no_such_checkpoint.bin", parser->getContent(), parser->getDictionary());
+        ListOfClusters pending, finished;
+        EXPECT(!loader.exists());
+        EXPECT_THROWS_AS(loader.load(pending, finished), CheckpointError);
+    },
+    CASE("joinAll: The last checkpoint contains all clusters as finished") {
+        std::unique_ptr<LogParser> parser(genParser("A B 1\nA B 2\nC D E\nC D F\nX Y Z\n"));
+        Checkpoint saver(checkpointTestFile, parser->getContent(), parser->getDictionary());
+        ListOfClusters output;
+        ThreadPool pool(1, Cluster(parser->getContent(), parser->getDictionary()), output, 0.4, &saver, 60);
+        pool.joinAll();
+        EXPECT(pool.getCheckpointCount() == 1u);
+
+        ListOfClusters pending, finished;
+        saver.load(pending, finished);
+        saver.remove();
+        EXPECT(pending.size() == 0u);
+        EXPECT(finished.size() == output.size());
+        size_t lineCount = 0;
+        for (const Cluster& clust : finished) lineCount += clust.getTotalLineCount();
+        size_t outputLineCount = 0;
+        for (const Cluster& clust : output) outputLineCount += clust.getTotalLineCount();
+        EXPECT(lineCount == outputLineCount);
+        EXPECT(lineCount == 5u);
+        EXPECT(finished.begin()->getTemplate() == output.begin()->getTemplate());
+    },
+};
+
+extern const lest::tests checkpointSuite(std::begin(_checkpointSuite), std::end(_checkpointSuite));
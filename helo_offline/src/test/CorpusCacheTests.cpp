@@ -0,0 +1,144 @@
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <lest/lest.hpp>
+#include "CorpusCache.h"
+
+static const char* corpusCacheTestFile = "corpus_cache_test.helotok";
+
+static inline LogParser* genParser(const std::string& fileContent, bool deduplicate, bool numberTable) {
+    LogParser* parser = new LogParser(0, "[\\s]+");
+    parser->setDeduplication(deduplicate);
+    parser->setNumberTable(numberTable);
+    std::stringstream fileObj(fileContent);
+    fileObj >> *parser;
+    return parser;
+}
+
+static inline CorpusSettings genSettings(uint32_t flags) {
+    return CorpusSettings{ 0, "[\\s]+", "C", flags };
+}
+
+static inline std::vector<std::string> getLines(const ListOfLines& lines) {
+    std::vector<std::string> ret;
+    for (const ArrayOfWords& line : lines) {
+        std::string str;
+        for (const std::shared_ptr<TokenDescriptor>& word : line) str += word->TokenString + "/" + std::to_string(word->TypeOfToken) + " ";
+        ret.push_back(str);
+    }
+    return ret;
+}
+
+static inline std::string readFile(const char* path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static inline void writeFile(const char* path, const std::string& content) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(content.data(), content.size());
+}
+
+static inline CorpusCacheHeader getHeader(const std::string& cache) {
+    CorpusCacheHeader header;
+    std::memcpy(&header, cache.data(), sizeof(header));
+    return header;
+}
+
+static inline void setHeader(std::string& cache, const CorpusCacheHeader& header) {
+    std::memcpy(&cache[0], &header, sizeof(header));
+}
+
+static const lest::test _corpusCacheSuite[] {
+    CASE("CorpusCache: The loaded corpus is the same as the parsed one") {
+        std::unique_ptr<LogParser> parser(genParser("A B 1\nA #c 2\nA B 1\n", false, false));
+        CorpusCache::save(corpusCacheTestFile, *parser, genSettings(0));
+        EXPECT(CorpusCache::isCache(corpusCacheTestFile));
+
+        CorpusCache cache(corpusCacheTestFile, genSettings(0));
+        std::remove(corpusCacheTestFile);
+        EXPECT(getLines(*cache.getContent()) == getLines(*parser->getContent()));
+        EXPECT(cache.getDictionary()->size() == parser->getDictionary()->size());
+        EXPECT(cache.getMessageCount() == 3u);
+        EXPECT(!cache.getWeights());
+        EXPECT(!cache.getNumberTable());
+        const ArrayOfWords& first = cache.getContent()->front();
+        const ArrayOfWords& last = cache.getContent()->back();
+        EXPECT(first[0].get() == last[0].get());
+        EXPECT(cache.getDictionary()->find(first[1]) != cache.getDictionary()->end());
+    },
+    CASE("CorpusCache: The weights and the number table are restored") {
+        uint32_t flags = CorpusDeduplicated | CorpusNumberTable;
+        std::unique_ptr<LogParser> parser(genParser("A B 1\nA B 1\nA B 2\nA B 1\n", true, true));
+        CorpusCache::save(corpusCacheTestFile, *parser, genSettings(flags));
+
+        CorpusCache cache(corpusCacheTestFile, genSettings(flags));
+        std::remove(corpusCacheTestFile);
+        EXPECT(getLines(*cache.getContent()) == getLines(*parser->getContent()));
+        EXPECT(cache.getMessageCount() == 4u);
+        EXPECT(cache.getWeights()->size() == 1u);
+        EXPECT(cache.getWeights()->at(&cache.getContent()->front()) == 3u);
+        EXPECT(cache.getNumberTable()->size() == 2u);
+        EXPECT(cache.getDictionary()->size() == parser->getDictionary()->size());
+    },
+    CASE("CorpusCache: A cache of other settings or an invalid file is rejected") {
+        std::unique_ptr<LogParser> parser(genParser("A B 1\n", false, false));
+        CorpusCache::save(corpusCacheTestFile, *parser, genSettings(0));
+        CorpusSettings other = genSettings(0);
+        other.HeaderLen = 4;
+        EXPECT_THROWS_AS(CorpusCache(corpusCacheTestFile, other), CorpusCacheError);
+        EXPECT_THROWS_AS(CorpusCache(corpusCacheTestFile, genSettings(CorpusDeduplicated)), CorpusCacheError);
+
+        {
+            std::ofstream file(corpusCacheTestFile, std::ios::binary);
+            file << "A B 1\n";
+        }
+        EXPECT(!CorpusCache::isCache(corpusCacheTestFile));
+        EXPECT_THROWS_AS(CorpusCache(corpusCacheTestFile, genSettings(0)), CorpusCacheError);
+        std::remove(corpusCacheTestFile);
+        EXPECT(!CorpusCache::isCache(corpusCacheTestFile));
+    },
+    CASE("CorpusCache: A corrupt file that overflows the offset arithmetic or is misaligned is rejected") {
+        std::unique_ptr<LogParser> parser(genParser("A B 1\nA #c 2\n", false, false));
+        CorpusCache::save(corpusCacheTestFile, *parser, genSettings(0));
+        const std::string valid = readFile(corpusCacheTestFile);
+        const CorpusCacheHeader validHeader = getHeader(valid);
+
+        std::string cache = valid;
+        CorpusCacheHeader header = validHeader;
+        header.LineCount = 1ull << 61; // (LineCount+1)*sizeof(uint64_t) wraps around to 8
+        setHeader(cache, header);
+        writeFile(corpusCacheTestFile, cache);
+        EXPECT_THROWS_AS(CorpusCache(corpusCacheTestFile, genSettings(0)), CorpusCacheError);
+
+        cache = valid;
+        header = validHeader;
+        header.NumberTokenCount = ~0ull - header.DictionaryTokenCount + 1; // the token count wraps around to 0
+        setHeader(cache, header);
+        writeFile(corpusCacheTestFile, cache);
+        EXPECT_THROWS_AS(CorpusCache(corpusCacheTestFile, genSettings(0)), CorpusCacheError);
+
+        cache = valid;
+        CorpusToken token;
+        std::memcpy(&token, cache.data() + validHeader.TokenTableOffset, sizeof(token));
+        token.StringOffset = ~0ull;
+        std::memcpy(&cache[validHeader.TokenTableOffset], &token, sizeof(token));
+        writeFile(corpusCacheTestFile, cache);
+        EXPECT_THROWS_AS(CorpusCache(corpusCacheTestFile, genSettings(0)), CorpusCacheError);
+
+        cache = valid;
+        header = validHeader;
+        header.LineTableOffset += 4;
+        setHeader(cache, header);
+        writeFile(corpusCacheTestFile, cache);
+        EXPECT_THROWS_AS(CorpusCache(corpusCacheTestFile, genSettings(0)), CorpusCacheError);
+
+        writeFile(corpusCacheTestFile, valid);
+        EXPECT_NO_THROW(CorpusCache(corpusCacheTestFile, genSettings(0)));
+        std::remove(corpusCacheTestFile);
+    },
+};
+
+extern const lest::tests corpusCacheSuite(std::begin(_corpusCacheSuite), std::end(_corpusCacheSuite));
@@ -0,0 +1,159 @@
+#include <sstream>
+#include <lest/lest.hpp>
+#include "IncrementalUpdate.h"
+
+static inline void genDatabase(SQLite::Database& db) {
+    db.exec("CREATE TABLE clusters (clustid INTEGER PRIMARY KEY,template text NOT NULL,goodness real NOT NULL,AvgLen real NOT NULL)");
+    db.exec("CREATE TABLE cluster_stats (clustid INTEGER PRIMARY KEY,LineCount INTEGER NOT NULL,TotalLen INTEGER NOT NULL)");
+}
+
+static inline std::vector<TokenDescriptor> genMessage(const std::string& line) {
+    std::vector<TokenDescriptor> tokens;
+    std::istringstream str(line);
+    std::string token;
+    while (str >> token) {
+        tokens.push_back(TokenDescriptor(token, isdigit((unsigned char)token[0]) ? Number : Word));
+    }
+    return tokens;
+}
+
+static inline void genNewCluster(LogParser& parser, const std::string& lines, ListOfClusters& clusters) {
+    std::stringstream input(lines);
+    input >> parser;
+    Cluster clust(parser.getContent(), parser.getDictionary());
+    clust.compressToTemplate();
+    clusters.push_back(std::move(clust));
+}
+
+static inline long long getValue(SQLite::Database& db, const std::string& query) {
+    SQLite::Statement stmt(db, query);
+    stmt.executeStep();
+    return stmt.getColumn(0).getInt64();
+}
+
+static inline double getDouble(SQLite::Database& db, const std::string& query) {
+    SQLite::Statement stmt(db, query);
+    stmt.executeStep();
+    return stmt.getColumn(0).getDouble();
+}
+
+static const lest::test _incrementalUpdateSuite[] {
+    CASE("classify: Only the messages matching an existing template are counted") {
+        SQLite::Database db(":memory:", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        genDatabase(db);
+        db.exec("INSERT INTO clusters VALUES(1,'A B C ',1,3)");
+        db.exec("INSERT INTO clusters VALUES(2,'X +d ',0.5,2)");
+        IncrementalUpdate updater(db);
+        EXPECT(updater.getTemplateCount() == 2u);
+        EXPECT(updater.classify(genMessage("A B C")));
+        EXPECT(updater.classify(genMessage("X 5")));
+        EXPECT(!updater.classify(genMessage("A B D")));
+        EXPECT(updater.getMatchedLines() == 2u);
+    },
+    CASE("classify: A message matching more templates is counted for the one of the smallest id") {
+        SQLite::Database db(":memory:", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        genDatabase(db);
+        db.exec("INSERT INTO clusters VALUES(7,'A * C ',1,3)");
+        db.exec("INSERT INTO clusters VALUES(3,'A B +n ',1,5)");
+        db.exec("INSERT INTO clusters VALUES(9,'A B C ',1,3)");
+        IncrementalUpdate updater(db);
+        EXPECT(updater.classify(genMessage("A B C")));
+        EXPECT(updater.classify(genMessage("A X C")));
+
+        LogParser parser(0, "[\\s]+");
+        ListOfClusters newClusters;
+        updater.merge(newClusters, parser.getDictionary(), 0.8);
+        updater.save(db);
+        EXPECT(getValue(db, "SELECT LineCount FROM cluster_stats WHERE clustid=3") == 1);
+        EXPECT(getValue(db, "SELECT LineCount FROM cluster_stats WHERE clustid=7") == 1);
+        EXPECT(getValue(db, "SELECT count(*) FROM cluster_stats WHERE clustid=9") == 0);
+    },
+    CASE("save: The matched lines are added to the history, the unmatched clusters are not changed") {
+        SQLite::Database db(":memory:", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        genDatabase(db);
+        db.exec("INSERT INTO clusters VALUES(1,'A B +n ',1,5)");
+        db.exec("INSERT INTO clusters VALUES(2,'X Y ',1,2)");
+        db.exec("INSERT INTO cluster_stats VALUES(1,10,50)");
+        db.exec("INSERT INTO cluster_stats VALUES(2,4,8)");
+        IncrementalUpdate updater(db);
+        EXPECT(updater.classify(genMessage("A B C")));
+        EXPECT(updater.classify(genMessage("A B C D E F G")));
+        EXPECT(!updater.classify(genMessage("Q")));
+
+        LogParser parser(0, "[\\s]+");
+        ListOfClusters newClusters;
+        EXPECT(updater.merge(newClusters, parser.getDictionary(), 0.8) == 0u);
+        EXPECT(updater.save(db) == 0u);
+        EXPECT(getValue(db, "SELECT LineCount FROM cluster_stats WHERE clustid=1") == 12);
+        EXPECT(getValue(db, "SELECT TotalLen FROM cluster_stats WHERE clustid=1") == 60);
+        EXPECT(getValue(db, "SELECT LineCount FROM cluster_stats WHERE clustid=2") == 4);
+        EXPECT(getValue(db, "SELECT TotalLen FROM cluster_stats WHERE clustid=2") == 8);
+        EXPECT(getDouble(db, "SELECT AvgLen FROM clusters WHERE clustid=1") == 5);
+    },
+    CASE("merge: The existing cluster is weighted by its whole history") {
+        SQLite::Database db(":memory:", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        genDatabase(db);
+        db.exec("INSERT INTO clusters VALUES(1,'A B +n ',1,5)");
+        db.exec("INSERT INTO cluster_stats VALUES(1,4,20)");
+        IncrementalUpdate updater(db);
+
+        LogParser parser(0, "[\\s]+");
+        ListOfClusters newClusters;
+        genNewCluster(parser, "A B X\n", newClusters);
+        EXPECT(updater.merge(newClusters, parser.getDictionary(), 0.8) == 1u);
+        EXPECT(newClusters.size() == 0u);
+        EXPECT(updater.save(db) == 1u);
+        EXPECT(getValue(db, "SELECT LineCount FROM cluster_stats WHERE clustid=1") == 5);
+        EXPECT(getValue(db, "SELECT TotalLen FROM cluster_stats WHERE clustid=1") == 23);
+        EXPECT(getDouble(db, "SELECT AvgLen FROM clusters WHERE clustid=1") == 23.0 / 5);
+    },
+    CASE("merge: The lines matched now are part of the weight of the existing cluster") {
+        SQLite::Database db(":memory:", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        genDatabase(db);
+        db.exec("INSERT INTO clusters VALUES(1,'A B +n ',1,5)");
+        db.exec("INSERT INTO cluster_stats VALUES(1,4,20)");
+        IncrementalUpdate updater(db);
+        EXPECT(updater.classify(genMessage("A B C D E F G")));
+
+        LogParser parser(0, "[\\s]+");
+        ListOfClusters newClusters;
+        genNewCluster(parser, "A B X\n", newClusters);
+        EXPECT(updater.merge(newClusters, parser.getDictionary(), 0.8) == 1u);
+        EXPECT(updater.save(db) == 1u);
+        EXPECT(getValue(db, "SELECT LineCount FROM cluster_stats WHERE clustid=1") == 6);
+        EXPECT(getValue(db, "SELECT TotalLen FROM cluster_stats WHERE clustid=1") == 30);
+        EXPECT(getDouble(db, "SELECT AvgLen FROM clusters WHERE clustid=1") == 5);
+    },
+    CASE("merge: A cluster without history is weighted by the lines matched now (at least 1)") {
+        SQLite::Database db(":memory:", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        genDatabase(db);
+        db.exec("INSERT INTO clusters VALUES(1,'A B +n ',1,5)");
+        IncrementalUpdate updater(db);
+
+        LogParser parser(0, "[\\s]+");
+        ListOfClusters newClusters;
+        genNewCluster(parser, "A B X\n", newClusters);
+        EXPECT(updater.merge(newClusters, parser.getDictionary(), 0.8) == 1u);
+        EXPECT(updater.save(db) == 1u);
+        EXPECT(getValue(db, "SELECT LineCount FROM cluster_stats WHERE clustid=1") == 2);
+        EXPECT(getDouble(db, "SELECT AvgLen FROM clusters WHERE clustid=1") == 4);
+    },
+    CASE("merge: A new cluster that is not similar enough is kept") {
+        SQLite::Database db(":memory:", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        genDatabase(db);
+        db.exec("INSERT INTO clusters VALUES(1,'A B C ',1,3)");
+        db.exec("INSERT INTO cluster_stats VALUES(1,4,12)");
+        IncrementalUpdate updater(db);
+
+        LogParser parser(0, "[\\s]+");
+        ListOfClusters newClusters;
+        genNewCluster(parser, "X Y Z\n", newClusters);
+        EXPECT(updater.merge(newClusters, parser.getDictionary(), 0.8) == 0u);
+        EXPECT(newClusters.size() == 1u);
+        EXPECT(updater.save(db) == 0u);
+        EXPECT(getValue(db, "SELECT LineCount FROM cluster_stats WHERE clustid=1") == 4);
+    },
+};
+
+extern const lest::tests incrementalUpdateSuite(_incrementalUpdateSuite,
+        _incrementalUpdateSuite + sizeof(_incrementalUpdateSuite) / sizeof(*_incrementalUpdateSuite));
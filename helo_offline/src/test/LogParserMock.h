@@ -2,7 +2,7 @@
 
 class LogParserMock : public LogParser {
 protected:
-    void ProcessHybrid(std::wstring&) const override {}
+    void ProcessHybrid(const std::string&, TokenView&) const override {}
 public:
-    LogParserMock(size_t headerLen, const std::wstring& regex) : LogParser(headerLen, regex){}
+    LogParserMock(size_t headerLen, const std::string& regex) : LogParser(headerLen, regex){}
 };
@@ -0,0 +1,48 @@
+#include <sstream>
+#include <lest/lest.hpp>
+#include "MemoryUsage.h"
+#include "cluster.h"
+#include "LogParserMock.h"
+
+static const lest::test _memoryUsageSuite[] {
+    CASE("estimate: Long strings are counted with their capacity") {
+        std::string str(100, 'a');
+        EXPECT(MemoryUsage::estimate(str) >= 101u);
+    },
+    CASE("estimate: Empty dictionary and content hold no memory") {
+        EXPECT(MemoryUsage::estimate(Dictionary()) == 0u);
+        EXPECT(MemoryUsage::estimate(ListOfLines()) == 0u);
+    },
+    CASE("estimate: Memory of lines grows with their length") {
+        LogParserMock shortParser(0, "[\\s]+");
+        LogParserMock longParser(0, "[\\s]+");
+        std::stringstream shortFile("A B\nA C\n");
+        std::stringstream longFile("A B C D E F G H I J K L\nA C D E F G H I J K L M\n");
+        shortFile >> shortParser;
+        longFile >> longParser;
+        EXPECT(MemoryUsage::estimate(*shortParser.getContent()) < MemoryUsage::estimate(*longParser.getContent()));
+    },
+    CASE("estimate: Dictionary is counted with its tokens") {
+        LogParserMock parser(0, "[\\s]+");
+        std::stringstream file("A B\nA C\n");
+        file >> parser;
+        EXPECT(MemoryUsage::estimate(*parser.getDictionary()) >= parser.getDictionary()->size() * sizeof(TokenDescriptor));
+    },
+    CASE("getStatisticsBytes: Empty cluster has no statistics") {
+        Cluster clust;
+        EXPECT(clust.getStatisticsBytes() == 0u);
+    },
+    CASE("getStatisticsBytes: Statistics grow with the number of distinct values") {
+        LogParserMock sameParser(0, "[\\s]+");
+        LogParserMock distinctParser(0, "[\\s]+");
+        std::stringstream sameFile("A B\nA B\nA B\n");
+        std::stringstream distinctFile("A B\nA C\nA D\n");
+        sameFile >> sameParser;
+        distinctFile >> distinctParser;
+        Cluster same(sameParser.getContent(), sameParser.getDictionary());
+        Cluster distinct(distinctParser.getContent(), distinctParser.getDictionary());
+        EXPECT(same.getStatisticsBytes() < distinct.getStatisticsBytes());
+    }
+};
+
+extern const lest::tests memoryUsageSuite(_memoryUsageSuite, _memoryUsageSuite + sizeof(_memoryUsageSuite) / sizeof(*_memoryUsageSuite));
@@ -0,0 +1,50 @@
+#include <sstream>
+#include <lest/lest.hpp>
+#include "RunStats.h"
+
+static const lest::test _runStatsSuite[] {
+    CASE("counters: Unset counter is 0") {
+        RunStats stats;
+        EXPECT(stats.getCounter("lines") == 0u);
+    },
+    CASE("counters: Setting a counter again overwrites it") {
+        RunStats stats;
+        stats.setCounter("lines", 10);
+        stats.setCounter("lines", 20);
+        std::ostringstream json;
+        stats.write(json);
+        EXPECT(stats.getCounter("lines") == 20u);
+        EXPECT(json.str().find("\"lines\": 20") != std::string::npos);
+        EXPECT(json.str().find("\"lines\": 10") == std::string::npos);
+    },
+    CASE("phases: Beginning a phase finishes the former one") {
+        RunStats stats;
+        stats.beginPhase("parse");
+        stats.beginPhase("split");
+        stats.endPhase();
+        stats.endPhase();
+        EXPECT(stats.getPhaseCount() == 2u);
+    },
+    CASE("write: Phases are written in order of measurement") {
+        RunStats stats;
+        stats.beginPhase("parse");
+        stats.beginPhase("split");
+        stats.endPhase();
+        std::ostringstream json;
+        stats.write(json);
+        size_t parsePos = json.str().find("\"name\": \"parse\"");
+        size_t splitPos = json.str().find("\"name\": \"split\"");
+        EXPECT(parsePos != std::string::npos);
+        EXPECT(splitPos != std::string::npos);
+        EXPECT(parsePos < splitPos);
+    },
+    CASE("write: Special characters are escaped") {
+        RunStats stats;
+        stats.setInfo("input", "C:\\logs\\\"a\".log");
+        std::ostringstream json;
+        stats.write(json);
+        EXPECT(json.str().find("\"input\": \"C:\\\\logs\\\\\\\"a\\\".log\"") != std::string::npos);
+    }
+};
+
+extern const lest::tests runStatsSuite(_runStatsSuite, _runStatsSuite + sizeof(_runStatsSuite) / sizeof(*_runStatsSuite));
@@ -0,0 +1,66 @@
+#include <fstream>
+#include <cstdio>
+#include <lest/lest.hpp>
+#include "Sharding.h"
+
+static const char* shardTestLog = "sharding_test.log";
+
+static inline void genLog(size_t lineCount) {
+    std::ofstream ofile(shardTestLog, std::ios::out | std::ios::binary);
+    for (size_t i = 0; i < lineCount; ++i) {
+        ofile << "message number " << i << (i % 3 == 0 ? " with a longer tail" : "") << "\n";
+    }
+}
+
+static const lest::test _shardingSuite[] {
+    CASE("getRange: The shards cover the file at line boundaries") {
+        genLog(100);
+        size_t lineCount = 0;
+        uint64_t end = 0;
+        for (unsigned int i = 0; i < 7; ++i) {
+            ShardRange range = Sharding::getRange(shardTestLog, i, 7);
+            EXPECT(range.Begin == end);
+            lineCount += range.LineCount;
+            end = range.End;
+        }
+        EXPECT(lineCount == 100u);
+        std::remove(shardTestLog);
+    },
+    CASE("getRange: Invalid shard index is rejected") {
+        EXPECT_THROWS_AS(Sharding::getRange(shardTestLog, 2, 2), std::invalid_argument);
+    },
+    CASE("readRange: Only the lines of the shard are read") {
+        genLog(10);
+        size_t lineCount = 0;
+        for (unsigned int i = 0; i < 3; ++i) {
+            LogParser parser(0, "[\\s]+");
+            Sharding::readRange(shardTestLog, Sharding::getRange(shardTestLog, i, 3), parser);
+            lineCount += parser.getContent()->size();
+        }
+        EXPECT(lineCount == 10u);
+        std::remove(shardTestLog);
+    },
+    CASE("readPartial: Templates and line counts are read back") {
+        LogParser parser(0, "[\\s]+");
+        std::stringstream input("A B 1\nA B 2\nA B 3 4\n");
+        input >> parser;
+        ListOfClusters clusters;
+        Cluster clust(parser.getContent(), parser.getDictionary());
+        clust.compressToTemplate();
+        clusters.push_back(std::move(clust));
+        Sharding::writePartial(shardTestLog, clusters);
+
+        ListOfClusters loaded;
+        Sharding::readPartial(shardTestLog, parser.getDictionary(), loaded);
+        std::remove(shardTestLog);
+        EXPECT(loaded.size() == 1u);
+        Cluster& first = *loaded.begin();
+        EXPECT(first.getTotalLineCount() == 3u);
+        EXPECT(first.getTotalLineLen() == 10u);
+        EXPECT(first.getLine(0).size() == 4u);
+        EXPECT(first.getLine(0)[2]->TokenString == "+d");
+        EXPECT(first.getLine(0)[3]->TokenString == "+n");
+    }
+};
+
+extern const lest::tests shardingSuite(_shardingSuite, _shardingSuite + sizeof(_shardingSuite) / sizeof(*_shardingSuite));
@@ -0,0 +1,98 @@
+#include <sstream>
+#include <lest/lest.hpp>
+#include "SpillClusterer.h"
+
+static inline StreamStatistics genStatistics(const std::string& fileContent, TokenTable& tokens) {
+    LogParser parser(0, "[\\s]+");
+    std::stringstream fileObj(fileContent);
+    std::vector<TokenDescriptor> lineTokens;
+    StreamStatistics stats;
+    while (parser.readMessage(fileObj, lineTokens)) {
+        std::vector<uint32_t> line;
+        for (const TokenDescriptor& token : lineTokens) line.push_back(tokens.intern(token.TokenString, token.TypeOfToken));
+        stats.add(line, tokens);
+    }
+    return stats;
+}
+
+static inline Cluster genCluster(const std::string& fileContent) {
+    LogParser parser(0, "[\\s]+");
+    std::stringstream fileObj(fileContent);
+    fileObj >> parser;
+    return Cluster(parser.getContent(), parser.getDictionary());
+}
+
+static inline std::string getTemplateMsg(const std::vector<uint32_t>& clusterTemplate, const TokenTable& tokens) {
+    std::string templateMsg;
+    for (size_t i=0; i<clusterTemplate.size(); ++i) {
+        if (i>0) templateMsg += " ";
+        templateMsg += tokens[clusterTemplate[i]].TokenString;
+    }
+    return templateMsg;
+}
+
+static inline std::string getTemplateMsg(const ArrayOfWords& clusterTemplate) {
+    std::string templateMsg;
+    for (size_t i=0; i<clusterTemplate.size(); ++i) {
+        if (i>0) templateMsg += " ";
+        templateMsg += clusterTemplate[i]->TokenString;
+    }
+    return templateMsg;
+}
+
+static const std::string mixedLines = "A B 12 x\n\
+        A B 13 y\n\
+        A C 14 x\n\
+        A C 15\n\
+        A D 16 x\n";
+
+static const lest::test _spillClustererSuite[] {
+    CASE("StreamStatistics: Template is the same as the template of the cluster") {
+        TokenTable tokens;
+        StreamStatistics stats = genStatistics(mixedLines, tokens);
+        Cluster clust = genCluster(mixedLines);
+        EXPECT(getTemplateMsg(stats.getTemplate(), tokens) == getTemplateMsg(clust.getTemplate()));
+    },
+    CASE("StreamStatistics: Goodness is the same as the goodness of the cluster") {
+        TokenTable tokens;
+        StreamStatistics stats = genStatistics(mixedLines, tokens);
+        Cluster clust = genCluster(mixedLines);
+        EXPECT(stats.getGoodness() == clust.getGoodness());
+    },
+    CASE("StreamStatistics: Split column is the one that the cluster splits on") {
+        TokenTable tokens;
+        StreamStatistics stats = genStatistics("A B C\n\
+                A B C\n\
+                A B C\n\
+                A C C\n\
+                A C C\n\
+                A C C\n", tokens);
+        EXPECT(stats.getSplit() == 1);
+    },
+    CASE("StreamStatistics: Constant lines can't be split") {
+        TokenTable tokens;
+        StreamStatistics stats = genStatistics("A B C\n\
+                A B C\n", tokens);
+        EXPECT(stats.getSplit() == -1);
+        EXPECT(stats.getGoodness() == 1.0);
+    },
+    CASE("StreamStatistics: Lines and tokens are counted") {
+        TokenTable tokens;
+        StreamStatistics stats = genStatistics(mixedLines, tokens);
+        EXPECT(stats.getLineCount() == 5u);
+        EXPECT(stats.getTotalLineLen() == 19u);
+        EXPECT(stats.estimateClusterBytes() > 0u);
+    },
+    CASE("SpillClusterer: Input fits if the estimated size is within the budget") {
+        SpillClusterer large(0, "[\\s]+", 1024 * 1024, "unused", 0.4, 1);
+        std::stringstream largeInput(mixedLines);
+        EXPECT(large.analyze(largeInput));
+
+        SpillClusterer small(0, "[\\s]+", 1, "unused", 0.4, 1);
+        std::stringstream smallInput(mixedLines);
+        EXPECT_NOT(small.analyze(smallInput));
+        EXPECT(small.getLineCount() == 5u);
+    }
+};
+
+extern const lest::tests spillClustererSuite(_spillClustererSuite, _spillClustererSuite + sizeof(_spillClustererSuite) / sizeof(*_spillClustererSuite));
@@ -0,0 +1,107 @@
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <lest/lest.hpp>
+#include "SplitTree.h"
+#include "ThreadPool.h"
+
+static const char* splitTreeTestFile = "split_tree_test.bin";
+static const char* splitTreeTestLog = "A B 1\nA B 2\nC D E\nC D F\nC G F\nX Y Z\nX Y W\nX Q W\n";
+
+static inline LogParser* genParser(const std::string& fileContent) {
+    LogParser* parser = new LogParser(0, "[\\s]+");
+    std::stringstream fileObj(fileContent);
+    fileObj >> *parser;
+    return parser;
+}
+
+static inline std::string getTemplateMsg(const ArrayOfWords& clusterTemplate) {
+    std::string templateMsg;
+    for (const std::shared_ptr<TokenDescriptor>& word : clusterTemplate) templateMsg += word->TokenString + " ";
+    return templateMsg;
+}
+
+static inline std::vector<std::string> getTemplates(ListOfClusters& clusters) {
+    std::vector<std::string> templates;
+    for (Cluster& clust : clusters) {
+        std::stringstream desc;
+        desc << getTemplateMsg(clust.getTemplate()) << clust.getGoodness() << " " << clust.getTotalLineCount() << " " << clust.getDepth();
+        templates.push_back(desc.str());
+    }
+    return templates;
+}
+
+static inline void recordTree(LogParser& parser, SplitTree& tree) {
+    Cluster root(parser.getContent(), parser.getDictionary());
+    tree.setRoot(root);
+    ListOfClusters output;
+    ThreadPool pool(1, std::move(root), output, 1.0, NULL, 0, &tree);
+    pool.joinAll();
+}
+
+static inline DictionaryPtr genDictionary() {
+    DictionaryPtr dict = std::make_shared<Dictionary>();
+    dict->insert(std::make_shared<TokenDescriptor>("*", Word));
+    dict->insert(std::make_shared<TokenDescriptor>("+d", Number));
+    dict->insert(std::make_shared<TokenDescriptor>("+n", Word));
+    return dict;
+}
+
+static const lest::test _splitTreeSuite[] {
+    CASE("addSplit: The nodes store the split column and the labels of the subclusters") {
+        std::unique_ptr<LogParser> parser(genParser(splitTreeTestLog));
+        SplitTree tree(parser->getDictionary());
+        recordTree(*parser, tree);
+        EXPECT(tree.size() > 4u);
+        const SplitTree::Node& root = tree.getNode(0);
+        EXPECT(root.Label == SPLIT_TREE_NO_LABEL);
+        EXPECT(root.SplitColumn == 0);
+        EXPECT(root.LineCount == 8u);
+        EXPECT(root.Children.size() == 3u);
+        EXPECT(tree.getToken(tree.getNode(root.Children[0]).Label).TokenString == "A");
+        EXPECT(tree.getToken(tree.getNode(root.Children[2]).Label).TokenString == "X");
+        EXPECT(tree.getNode(root.Children[0]).SplitColumn == -1);
+        EXPECT(tree.getNode(root.Children[0]).Depth == 1u);
+    },
+    CASE("cut: The clusters of a threshold are the same as the output of the split phase") {
+        std::unique_ptr<LogParser> parser(genParser(splitTreeTestLog));
+        SplitTree tree(parser->getDictionary());
+        recordTree(*parser, tree);
+        for (double lim : { 0.3, 0.6, 0.9, 1.0 }) {
+            ListOfClusters expected, cut;
+            ThreadPool pool(1, Cluster(parser->getContent(), parser->getDictionary()), expected, lim);
+            pool.joinAll();
+            tree.cut(lim, cut);
+            EXPECT(getTemplates(cut) == getTemplates(expected));
+        }
+    },
+    CASE("load: The loaded tree is cut the same way as the saved one") {
+        std::unique_ptr<LogParser> parser(genParser(splitTreeTestLog));
+        SplitTree tree(parser->getDictionary());
+        recordTree(*parser, tree);
+        tree.save(splitTreeTestFile);
+
+        SplitTree loaded(genDictionary());
+        loaded.load(splitTreeTestFile);
+        std::remove(splitTreeTestFile);
+        EXPECT(loaded.size() == tree.size());
+        for (double lim : { 0.4, 0.8 }) {
+            ListOfClusters expected, cut;
+            tree.cut(lim, expected);
+            loaded.cut(lim, cut);
+            EXPECT(getTemplates(cut) == getTemplates(expected));
+        }
+    },
+    CASE("load: An invalid or missing file is reported") {
+        {
+            std::ofstream file(splitTreeTestFile, std::ios::binary);
+            file << "HELOCKP";
+        }
+        SplitTree tree(genDictionary());
+        EXPECT_THROWS_AS(tree.load(splitTreeTestFile), SplitTreeError);
+        std::remove(splitTreeTestFile);
+        EXPECT_THROWS_AS(tree.load("no_such_split_tree.bin"), SplitTreeError);
+    },
+};
+
+extern const lest::tests splitTreeSuite(std::begin(_splitTreeSuite), std::end(_splitTreeSuite));
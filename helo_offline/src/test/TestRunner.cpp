@@ -2,6 +2,15 @@
 #include <trompeloeil.hpp>
 
 extern const lest::tests clusterSuite;
+extern const lest::tests runStatsSuite;
+extern const lest::tests memoryUsageSuite;
+extern const lest::tests arenaSuite;
+extern const lest::tests spillClustererSuite;
+extern const lest::tests shardingSuite;
+extern const lest::tests checkpointSuite;
+extern const lest::tests splitTreeSuite;
+extern const lest::tests corpusCacheSuite;
+extern const lest::tests incrementalUpdateSuite;
 
 int main(int argc, char* argv[]) {
     std::ostream& stream = std::cout;
@@ -14,6 +23,16 @@ int main(int argc, char* argv[]) {
             stream << lest::location{ line ? file : "[file/line unavailable]", int(line) } << ": " << msg;
         }
     });
-    int ret = lest::run(clusterSuite, argc, argv, stream);
+    lest::tests allTests(clusterSuite);
+    allTests.insert(allTests.end(), runStatsSuite.begin(), runStatsSuite.end());
+    allTests.insert(allTests.end(), memoryUsageSuite.begin(), memoryUsageSuite.end());
+    allTests.insert(allTests.end(), arenaSuite.begin(), arenaSuite.end());
+    allTests.insert(allTests.end(), spillClustererSuite.begin(), spillClustererSuite.end());
+    allTests.insert(allTests.end(), shardingSuite.begin(), shardingSuite.end());
+    allTests.insert(allTests.end(), checkpointSuite.begin(), checkpointSuite.end());
+    allTests.insert(allTests.end(), splitTreeSuite.begin(), splitTreeSuite.end());
+    allTests.insert(allTests.end(), corpusCacheSuite.begin(), corpusCacheSuite.end());
+    allTests.insert(allTests.end(), incrementalUpdateSuite.begin(), incrementalUpdateSuite.end());
+    int ret = lest::run(allTests, argc, argv, stream);
     return ret;
 }
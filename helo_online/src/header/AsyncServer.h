@@ -0,0 +1,102 @@
+#ifndef ASYNC_SERVER_H
+#define ASYNC_SERVER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <atomic>
+#include <boost/asio.hpp>
+#include "IngestQueue.h"
+#include "Metrics.h"
+
+/**
+* @file AsyncServer.h
+*
+* This file contains the AsyncServer and TcpConnection classes, the network input of the online algorithm.
+* @author Jenei Gábor <jengab@elte.hu>
+*/
+
+/// The size of the receive buffer of a connection in bytes
+///
+#define RECEIVE_BUFFER_SIZE 65536
+
+/// The maximal length of a message in bytes, a longer message (without a line break) is processed in parts
+///
+#define MAX_MESSAGE_LENGTH 1048576
+
+class AsyncServer;
+
+/**
+* This class represents a client connection. It reads the TCP stream asynchronously into a large buffer,
+* and puts each complete line on the IngestQueue. The line breaks are searched by memchr, which is
+* vectorized by the C library. There is only one pending read for a connection, thus its handlers are
+* never called concurrently. If the IngestQueue defers a line (it is full), the connection is parked: the rest of
+* the buffer is kept, and the next read is started only after the queue calls it back, thus a slow classification
+* slows the sender down by TCP without holding a thread of the io_service.
+*/
+class TcpConnection:public std::enable_shared_from_this<TcpConnection>{
+private:
+    AsyncServer& Server;
+    boost::asio::ip::tcp::socket Socket;
+    bool Started;
+    std::vector<char> Buffer;
+    size_t ReadPos;
+    size_t ReadEnd;
+    boost::system::error_code ReadError;
+    std::string Line;
+    void read();
+    void onRead(const boost::system::error_code&,size_t);
+    void processBuffer();
+    void resume();
+    bool processLine();
+
+public:
+    TcpConnection(AsyncServer&);
+    ~TcpConnection();
+    void start();
+
+    /**
+    * @return The socket of the connection (it is opened by the acceptor)
+    */
+    boost::asio::ip::tcp::socket& getSocket(){return Socket;}
+};
+
+/**
+* This class implements the TCP server of the online algorithm. The connections are accepted and served
+* asynchronously by one io_service, which is run by a fixed number of threads, thus many concurrent senders
+* are served by a few threads. The server counts the received lines and the open connections.
+*/
+class AsyncServer{
+private:
+    friend class TcpConnection;
+    ShardedCounter Received;
+    std::atomic<int64_t> ActiveConnections;
+    boost::asio::io_service Service;
+    boost::asio::ip::tcp::acceptor Acceptor;
+    std::shared_ptr<IngestQueue> Queue;
+    std::ostream* ErrorStream;
+    void accept();
+
+public:
+    AsyncServer(unsigned short,std::shared_ptr<IngestQueue>,std::ostream*);
+    void run(unsigned int);
+    void stop();
+
+    /**
+    * @return The io_service that serves the connections, other inputs (e.g. the UDP listener) can be served by it too
+    */
+    boost::asio::io_service& getService(){return Service;}
+
+    /**
+    * @return The number of lines received over TCP
+    */
+    uint64_t getReceived() const{return Received.get();}
+
+    /**
+    * @return The number of open TCP connections
+    */
+    int64_t getActiveConnections() const{return ActiveConnections;}
+};
+
+#endif
@@ -1,13 +1,20 @@
 #ifndef CLUSTER_PARSER_H
 #define CLUSTER_PARSER_H
 
-#include <list>
+#include <vector>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
 #include <SQLiteCpp/SQLiteCpp.h>
 
 #include "ClusterTemplate.h"
+#include "TemplateIndex.h"
+#include "TemplateLoader.h"
 #include "ConfigFile.h"
 #include "LogParser.h"
+#include "DatabaseWriter.h"
+#include "ClassificationCache.h"
+#include "Metrics.h"
 
 /**
 * @file ClusterParser.h
@@ -17,23 +24,74 @@
 */
 
 /**
-* This class loads clusters from a database, and can be used to
-* process new messages. It implements processing in a thread-safe way.
+* This class loads clusters from a database (or from a binary cluster model),
+* and can be used to process new messages. It implements processing in a thread-safe way.
+* The tokens of the templates are interned in a TokenTable, thus each distinct token
+* is stored only once, and the templates are arrays of token ids.
+* The classification is separated from the persistence: the classified messages and the
+* changed templates are written to the database in the background by a DatabaseWriter.
+* The ids of the new clusters are assigned here, thus classification never waits for the database.
+* The templates are looked up in a TemplateIndex instead of testing every template.
+* The exact matching only reads the templates, thus it runs concurrently in many threads
+* (under a shared lock), only joining a message to a cluster and creating a new cluster
+* take the lock exclusively. Repeated messages are answered by a ClassificationCache
+* before the templates are searched.
 */
 class ClusterParser{
 private:
     const Settings settings;
     const LogParser logParser;
-    std::mutex WriteMutex;
-    std::list<ClusterTemplate> Clusters;
-    ClusterParser(const ClusterParser&):settings(),logParser(settings.HeaderLen, settings.regexp){}
+    std::shared_timed_mutex TemplateMutex;
+    TokenTable Tokens;
+    std::vector<ClusterTemplate> Clusters;
+    std::atomic<size_t> TemplateCount;
+    TemplateIndex Index;
+    ClassificationCache Cache;
+    ShardedCounter ExactMatches;
+    ShardedCounter FuzzyMatches;
+    ShardedCounter NewClusters;
+    sqlite3_int64 NextId;
+    DatabaseWriter Writer;
+    void loadDatabase(SQLite::Database&,TemplateLoader&,const ModelReader*);
+    void getTokenIds(const std::vector<TokenDescriptor>&,std::vector<MessageToken>&) const;
+    ClusterParser(const ClusterParser&);
 
 public:
     ClusterParser(const Settings&);
     //friend std::wistream& operator>>(std::wistream&,ClusterParser&);
     friend std::wostream& operator<<(std::wostream&,ClusterParser&);
     void printToConsole() const;
-    void ProcessMessage(std::wstring&);
+    void ProcessMessage(std::string&);
+
+    /**
+    * @return The writer that persists the processed messages (e.g. to stop it on shutdown, or to read its counters)
+    */
+    DatabaseWriter& getWriter(){return Writer;}
+
+    /**
+    * @return The cache of the classified messages (e.g. to read its counters)
+    */
+    const ClassificationCache& getCache() const{return Cache;}
+
+    /**
+    * @return The number of templates (clusters), it is read without the lock of the templates
+    */
+    size_t getTemplateCount() const{return TemplateCount;}
+
+    /**
+    * @return The number of messages that matched a template exactly
+    */
+    uint64_t getExactMatches() const{return ExactMatches.get();}
+
+    /**
+    * @return The number of messages joined to the most similar template
+    */
+    uint64_t getFuzzyMatches() const{return FuzzyMatches.get();}
+
+    /**
+    * @return The number of messages that created a new cluster
+    */
+    uint64_t getNewClusters() const{return NewClusters.get();}
 };
 
 #endif
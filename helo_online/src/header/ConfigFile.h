@@ -3,6 +3,7 @@
 
 #include <fstream>
 #include <iostream>
+#include <string>
 
 /**
 * @file ConfigFile.h
@@ -12,6 +13,21 @@
 * @author Jenei Gábor <jengab@elte.hu>
 */
 
+/**
+* \enum OverloadPolicy
+* Tells what happens to a received message when the ingest queue is full
+*/
+enum OverloadPolicy{
+    /// The TCP connection isn't read until the queue drains, thus the sender is slowed down (backpressure), a UDP datagram is dropped
+    BlockSender,
+    /// The message is dropped
+    DropNewest,
+    /// The message is appended to the spill file, it can be replayed later
+    SpillToFile
+};
+
+bool toOverloadPolicy(const std::string&,OverloadPolicy&);
+
 /**
 * This class stores all the data needed to run the HELO online algorithm
 * It only has public members, just like a \c struct
@@ -30,6 +46,11 @@ public:
     /// The path of the SQLite3 file to use
     ///
     std::string DbFile;
+
+    /// The path of the binary cluster model made by the offline algorithm. If it is set,
+    /// the clusters are loaded from this file instead of the database's clusters table
+    ///
+    std::string ModelFile;
     
     /// The header length used in the protocol (on syslog this is 4 by default)
     ///
@@ -39,15 +60,53 @@ public:
     ///
     double lim;
     
-    /// The regular expression in POSIX regex format that is used to tokenize the log message
+    /// The regular expression in POSIX regex format that is used to tokenize the log message (in UTF-8)
     ///
-    std::wstring regexp;
+    std::string regexp;
     
     /// A pointer to the output stream that is used for writing out error messages
     ///
     std::ostream* ErrorStream;
 
-    Settings():port(514),loc(""),DbFile(""),HeaderLen(4),lim(1.0),regexp(L"[\\s]+"),ErrorStream(&std::cout){}
+    /// The number of threads that serve the network connections (0 means the number of CPU cores)
+    ///
+    unsigned int threads;
+
+    /// The UDP port to listen on (-1 means the same port as the TCP port, 0 disables the UDP input)
+    ///
+    int udpPort;
+
+    /// The maximal number of messages written to the database in one transaction
+    ///
+    unsigned int writeBatch;
+
+    /// The maximal time in milliseconds a processed message waits before it is written to the database
+    ///
+    unsigned int writeLatency;
+
+    /// The number of entries of the classification cache (0 disables the cache)
+    ///
+    unsigned int cacheSize;
+
+    /// The maximal number of received messages waiting to be classified
+    ///
+    unsigned int ingestQueueSize;
+
+    /// What happens to a received message when the ingest queue is full
+    ///
+    OverloadPolicy overload;
+
+    /// The path of the file of the spilled messages (if it is empty, the path of the database with ".spill" extension is used)
+    ///
+    std::string SpillFile;
+
+    /// The port of the metrics endpoint on the loopback interface (0 disables the endpoint)
+    ///
+    unsigned short metricsPort;
+
+    Settings():port(514),loc(""),DbFile(""),ModelFile(""),HeaderLen(4),lim(1.0),regexp("[\\s]+"),ErrorStream(&std::cout),threads(0),udpPort(-1),
+        writeBatch(1000),writeLatency(100),cacheSize(65536),
+        ingestQueueSize(65536),overload(BlockSender),SpillFile(""),metricsPort(0){}
 };
 
 /**
@@ -88,6 +147,10 @@ public:
     ///
     static const wchar_t* dbPathTag;
     
+    /// The XML tag that represents the binary cluster model's path setting
+    ///
+    static const wchar_t* modelPathTag;
+
     /// The XML tag that represents the log file's path setting
     ///
     static const wchar_t* logPathTag;
@@ -95,6 +158,42 @@ public:
     /// The XML tag that denotes the regular expression setting
     ///
     static const wchar_t* regexpTag;
+
+    /// The XML tag that denotes the number of network threads (optional)
+    ///
+    static const wchar_t* threadsTag;
+
+    /// The XML tag that denotes the UDP port (optional)
+    ///
+    static const wchar_t* udpPortTag;
+
+    /// The XML tag that denotes the batch size of the database writes (optional)
+    ///
+    static const wchar_t* writeBatchTag;
+
+    /// The XML tag that denotes the maximal latency of the database writes in milliseconds (optional)
+    ///
+    static const wchar_t* writeLatencyTag;
+
+    /// The XML tag that denotes the number of entries of the classification cache (optional)
+    ///
+    static const wchar_t* cacheSizeTag;
+
+    /// The XML tag that denotes the capacity of the ingest queue (optional)
+    ///
+    static const wchar_t* ingestQueueSizeTag;
+
+    /// The XML tag that denotes the overload policy: block, drop or spill (optional)
+    ///
+    static const wchar_t* overloadPolicyTag;
+
+    /// The XML tag that denotes the path of the spill file (optional)
+    ///
+    static const wchar_t* spillPathTag;
+
+    /// The XML tag that denotes the port of the metrics endpoint (optional)
+    ///
+    static const wchar_t* metricsPortTag;
 };
 
 #endif
@@ -0,0 +1,191 @@
+#ifndef DATABASE_WRITER_H
+#define DATABASE_WRITER_H
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <SQLiteCpp/SQLiteCpp.h>
+#include "Metrics.h"
+
+/**
+* @file DatabaseWriter.h
+*
+* This file contains the DatabaseWriter class, the write-behind persistence of the online algorithm.
+* @author Jenei Gábor <jengab@elte.hu>
+*/
+
+/// The maximal number of records waiting to be written, ProcessMessage() waits if the queue is full
+///
+#define WRITE_QUEUE_CAPACITY 65536
+
+/// The time in milliseconds a statement waits for the lock of the database, if another connection holds it
+///
+#define WRITE_BUSY_TIMEOUT 5000
+
+/// The number of attempts to write a batch if the database stays locked
+///
+#define WRITE_RETRY_COUNT 3
+
+/// The delay in milliseconds before the next attempt to write a locked batch (it grows with each attempt)
+///
+#define WRITE_RETRY_DELAY 100
+
+/**
+* \enum TemplateChange
+* Tells how a record changes the clusters table
+*/
+enum TemplateChange{
+    /// The cluster is not changed, only the message is inserted
+    NoChange,
+    /// The cluster is new, it is inserted with its id
+    NewCluster,
+    /// The cluster is already stored, it is updated
+    UpdatedCluster
+};
+
+/**
+* A record of the write queue: a classified message and the change of its cluster
+*/
+struct WriteRecord{
+    /// The id of the cluster of the message
+    ///
+    sqlite3_int64 ClusterId;
+
+    /// The message to insert to the syslog table
+    ///
+    std::string Message;
+
+    /// The change of the cluster
+    ///
+    TemplateChange Change;
+
+    /// The new template of the cluster (if it is changed)
+    ///
+    std::string Template;
+
+    /// The new goodness of the cluster (if it is changed)
+    ///
+    double Goodness;
+
+    /// The new average line length of the cluster (if it is changed)
+    ///
+    double AvgLen;
+
+    /// The length of the message (number of tokens), it is added to the line statistics of the cluster
+    ///
+    size_t Length;
+
+    /// The time the record was put on the queue (it is set by DatabaseWriter::push())
+    ///
+    std::chrono::steady_clock::time_point Queued;
+};
+
+/**
+* <p>This class persists the classified messages in the background. The records are put on a bounded queue,
+* and a dedicated writer thread commits them in batches: a batch is written when BatchSize records are waiting,
+* or when the oldest waiting record has waited MaxLatency milliseconds. The database is kept open in WAL mode,
+* the statements are prepared once.</p>
+*
+* <p>Durability: a message is acknowledged (ProcessMessage() returns) when it is on the queue, not when it is
+* on the disk. Records are written in the order they were queued, each batch in one transaction, thus the database
+* always holds a prefix of the processed messages. On stop() (the regular shutdown) every queued record is written,
+* the records pushed after stop() are rejected and counted as failed.
+* The changes of the clusters are made under the lock of the templates, but they are pushed after the lock is
+* released (so that a full queue doesn't stop the classification): they reserve() a ticket under the lock, and
+* are queued in the order of their tickets, thus a cluster is never overwritten with an older template.
+* If the process is killed, the queued records and the batch being written are lost (at most
+* WRITE_QUEUE_CAPACITY+BatchSize messages, or MaxLatency milliseconds of traffic if the writer keeps up). As the
+* database uses synchronous=NORMAL, a committed batch survives the crash of the process, but the last batches
+* may be lost on a power failure.</p>
+*
+* <p>If another connection holds the lock of the database, a statement waits WRITE_BUSY_TIMEOUT milliseconds for it,
+* and a batch that still finds the database locked is tried again WRITE_RETRY_COUNT times. If a record of a batch
+* is rejected (e.g. it violates a constraint), the batch is written again record by record, each in a savepoint
+* within the same transaction, thus only the wrong records are logged and dropped. A new cluster is inserted or
+* replaced, and an updated cluster that is missing from the table is inserted, so that a cluster lost with an
+* earlier failure is restored by its next change.</p>
+*
+* <p>The number and the total length of the lines of each cluster are summed up per batch, and added to the
+* cluster_stats table (it is created if the database doesn't have it yet), so that the offline incremental update
+* can weight the clusters by their whole history. The changes of the clusters table are logged in the
+* cluster_changes table by triggers (they are created if the database doesn't have them yet).</p>
+*/
+class DatabaseWriter{
+private:
+    std::ostream* ErrorStream;
+    size_t BatchSize;
+    unsigned int MaxLatency;
+    SQLite::Database Db;
+    SQLite::Statement InsertMessage;
+    SQLite::Statement InsertCluster;
+    SQLite::Statement UpdateCluster;
+    SQLite::Statement InitStats;
+    SQLite::Statement AddStats;
+    std::mutex QueueMutex;
+    std::condition_variable NotEmpty;
+    std::condition_variable NotFull;
+    std::condition_variable Turn;
+    std::atomic<uint64_t> NextTicket;
+    uint64_t Served;
+    std::deque<WriteRecord> Queue;
+    bool Stopping;
+    size_t MaxDepth;
+    std::atomic<uint64_t> Written;
+    std::atomic<uint64_t> Failed;
+    std::atomic<uint64_t> Batches;
+    LatencyHistogram CommitLatency;
+    std::thread Writer;
+    bool enqueue(std::unique_lock<std::mutex>&,WriteRecord&&);
+    void run();
+    void writeBatch(std::vector<WriteRecord>&);
+    int writeRecords(const std::vector<WriteRecord>&,bool,uint64_t&,std::string&);
+    void writeRecord(const WriteRecord&);
+    void resetStatements();
+    DatabaseWriter(const DatabaseWriter&);
+
+public:
+    DatabaseWriter(const std::string&,size_t,unsigned int,std::ostream*);
+    ~DatabaseWriter();
+    bool push(WriteRecord&&);
+    bool push(WriteRecord&&,uint64_t);
+
+    /**
+    * Reserves the place of a record on the queue, the record is queued by push(WriteRecord&&,uint64_t)
+    * after the records of the earlier tickets. Every reserved ticket must be pushed.
+    *
+    * @return The ticket of the record
+    */
+    uint64_t reserve(){return NextTicket++;}
+    void stop();
+    size_t getQueueDepth();
+    size_t getMaxQueueDepth();
+    std::string getStatistics();
+
+    /**
+    * @return The number of records written to the database
+    */
+    uint64_t getWritten() const{return Written;}
+
+    /**
+    * @return The number of records that couldn't be written (including the records pushed after stop())
+    */
+    uint64_t getFailed() const{return Failed;}
+
+    /**
+    * @return The number of committed batches
+    */
+    uint64_t getBatches() const{return Batches;}
+
+    /**
+    * @return The durations of the committed batches (from the beginning of the transaction to the commit)
+    */
+    const LatencyHistogram& getCommitLatency() const{return CommitLatency;}
+};
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef INGEST_QUEUE_H
+#define INGEST_QUEUE_H
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <fstream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <ostream>
+#include <cstdint>
+#include "ConfigFile.h"
+#include "ClusterParser.h"
+#include "Metrics.h"
+
+/**
+* @file IngestQueue.h
+*
+* This file contains the IngestQueue class, the bounded queue between the network inputs and the classification.
+* @author Jenei Gábor <jengab@elte.hu>
+*/
+
+/// The maximal number of messages a classifier thread takes from the queue at once
+///
+#define INGEST_BATCH_SIZE 64
+
+/// The time in milliseconds the spill file isn't tried again after its first failure (it doubles after each failure)
+///
+#define SPILL_RETRY_MIN 1000
+
+/// The maximal time in milliseconds the spill file isn't tried again after a failure
+///
+#define SPILL_RETRY_MAX 60000
+
+/**
+* \enum MessageTransport
+* Tells how a message was received
+*/
+enum MessageTransport{
+    /// The message was a line of a TCP connection
+    TcpTransport,
+    /// The message was a UDP datagram
+    UdpTransport,
+    /// The number of transports
+    TransportCount
+};
+
+/**
+* \enum IngestOutcome
+* Tells what happened to a message given to IngestQueue::push()
+*/
+enum IngestOutcome{
+    /// The message is queued for the classification
+    MessageQueued,
+    /// The queue was full, the message is dropped
+    MessageDropped,
+    /// The queue was full, the message is written to the spill file
+    MessageSpilled,
+    /// The queue was full, the message is parked until the queue drains, then the caller is called back (see IngestQueue::tryPush())
+    MessageDeferred
+};
+
+/**
+* <p>This class decouples receiving the messages from classifying them. The network inputs put the received
+* messages on a bounded queue, and a fixed number of classifier threads hand them to the ClusterParser. Thus the
+* memory used by the waiting messages is limited even if the classification (or the database behind it) stalls.</p>
+*
+* <p>When the queue is full, the OverloadPolicy decides: BlockSender parks the message of a TCP connection, the
+* connection stops reading until the queue is drained to the half of its capacity (then the parked message is
+* queued, and the connection is called back), so the sender is slowed down by
+* the flow control of TCP, while the network threads go on serving the other inputs. A UDP datagram can't be pushed
+* back, it is dropped. DropNewest drops the message; SpillToFile appends it to the spill file, one message per line.
+* A message may contain line breaks (e.g. a UDP datagram), thus the backslashes and the line breaks are escaped
+* (\\\\, \\n, \\r), the file can be replayed by helo_replay -sf. Each outcome is counted.</p>
+*
+* <p>If the spill file can't be opened or written, the overflowing messages are dropped, and the file is not tried
+* again for SPILL_RETRY_MIN milliseconds, which doubles after each failure (up to SPILL_RETRY_MAX), thus a full disk
+* doesn't make every message try and log it. The failures are counted.</p>
+*
+* <p>On stop() the parked messages are queued, and the queued messages are classified before the threads exit.
+* The messages on the queue are lost if the process is killed.</p>
+*/
+class IngestQueue{
+private:
+    struct Entry{
+        std::string Line;
+        MessageTransport Transport;
+    };
+
+    struct Waiter{
+        Entry Parked;
+        std::function<void()> Resume;
+    };
+
+    std::shared_ptr<ClusterParser> Parser;
+    std::ostream* ErrorStream;
+    size_t Capacity;
+    OverloadPolicy Policy;
+    std::string SpillPath;
+    std::ofstream SpillFile;
+    std::mutex SpillMutex;
+    std::chrono::steady_clock::time_point SpillRetry;
+    unsigned int SpillBackoff;
+    bool SpillPartial;
+    std::mutex QueueMutex;
+    std::condition_variable NotEmpty;
+    std::deque<Entry> Queue;
+    std::vector<Waiter> Waiters;
+    bool Stopping;
+    size_t MaxDepth;
+    std::atomic<uint64_t> Queued;
+    std::atomic<uint64_t> Blocked;
+    std::atomic<uint64_t> Dropped;
+    std::atomic<uint64_t> Spilled;
+    std::atomic<uint64_t> SpillErrors;
+    ShardedCounter Processed[TransportCount];
+    std::atomic<uint64_t> Failed;
+    LatencyHistogram ClassificationLatency;
+    std::vector<std::thread> Classifiers;
+    void run();
+    size_t queueWaiters(std::vector<Waiter>&);
+    bool spill(const std::string&);
+    void spillFailed(const char*);
+    IngestQueue(const IngestQueue&);
+
+public:
+    IngestQueue(std::shared_ptr<ClusterParser>,size_t,OverloadPolicy,const std::string&,unsigned int,std::ostream*);
+    ~IngestQueue();
+    IngestOutcome push(std::string&&,MessageTransport);
+    IngestOutcome tryPush(std::string&&,MessageTransport,std::function<void()>);
+    void stop();
+    size_t getQueueDepth();
+    size_t getMaxQueueDepth();
+    std::string getStatistics();
+
+    /**
+    * @return The number of messages put on the queue
+    */
+    uint64_t getQueued() const{return Queued;}
+
+    /**
+    * @return The number of messages whose connection had to wait for room (BlockSender policy)
+    */
+    uint64_t getBlocked() const{return Blocked;}
+
+    /**
+    * @return The number of messages dropped because the queue was full (or the spill file couldn't be written)
+    */
+    uint64_t getDropped() const{return Dropped;}
+
+    /**
+    * @return The number of messages written to the spill file
+    */
+    uint64_t getSpilled() const{return Spilled;}
+
+    /**
+    * @return The number of failed attempts to open or to write the spill file
+    */
+    uint64_t getSpillErrors() const{return SpillErrors;}
+
+    /**
+    * @return The number of messages classified
+    */
+    uint64_t getProcessed() const{return Processed[TcpTransport].get()+Processed[UdpTransport].get();}
+
+    /**
+    * @param[in] Transport A transport
+    * @return The number of messages classified that were received by the transport
+    */
+    uint64_t getProcessed(MessageTransport Transport) const{return Processed[Transport].get();}
+
+    /**
+    * @return The durations of the classification of the messages
+    */
+    const LatencyHistogram& getClassificationLatency() const{return ClassificationLatency;}
+
+    /**
+    * @return The number of messages whose classification failed
+    */
+    uint64_t getFailed() const{return Failed;}
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+/**
+* @file Metrics.h
+*
+* This file contains the ShardedCounter and LatencyHistogram classes, the counters of the metrics endpoint.
+* @author Jenei Gábor <jengab@elte.hu>
+*/
+
+/// The number of cells of a ShardedCounter, the threads are spread over them
+///
+#define METRICS_SHARDS 16
+
+/// The number of buckets of a LatencyHistogram (without the +Inf bucket)
+///
+#define LATENCY_BUCKETS 16
+
+/**
+* This class is a counter that is incremented by many threads cheaply. Each thread increments
+* the cell of its own shard (a cell is a cache line, thus the threads don't share it) with a relaxed
+* atomic operation, and the cells are summed only when the counter is read.
+*/
+class ShardedCounter{
+private:
+    struct alignas(64) Cell{
+        std::atomic<uint64_t> Value;
+    };
+
+    Cell Cells[METRICS_SHARDS];
+    static size_t getShard();
+    ShardedCounter(const ShardedCounter&);
+
+public:
+    ShardedCounter();
+
+    /**
+    * Increments the counter
+    *
+    * @param[in] Count The increment
+    */
+    void add(uint64_t Count=1){Cells[getShard()].Value.fetch_add(Count,std::memory_order_relaxed);}
+
+    uint64_t get() const;
+};
+
+/**
+* This class counts durations in buckets of fixed bounds (from 50 microseconds to 10 seconds), as a Prometheus
+* histogram. Each bucket is a ShardedCounter, thus observing a duration is cheap from many threads.
+*/
+class LatencyHistogram{
+private:
+    ShardedCounter Buckets[LATENCY_BUCKETS+1];
+    ShardedCounter SumNanoseconds;
+
+public:
+    /// The upper bounds of the buckets in seconds
+    ///
+    static const double Bounds[LATENCY_BUCKETS];
+
+    void observe(std::chrono::steady_clock::duration);
+
+    /**
+    * @param[in] Bucket The index of a bucket (LATENCY_BUCKETS is the +Inf bucket)
+    * @return The number of durations in the bucket (not cumulative)
+    */
+    uint64_t getBucket(size_t Bucket) const{return Buckets[Bucket].get();}
+
+    /**
+    * @return The sum of the observed durations in seconds
+    */
+    double getSum() const{return SumNanoseconds.get()/1e9;}
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <memory>
+#include <string>
+#include <ostream>
+#include <boost/asio.hpp>
+#include "ClusterParser.h"
+#include "IngestQueue.h"
+#include "AsyncServer.h"
+#include "UdpListener.h"
+#include "Metrics.h"
+
+/**
+* @file MetricsServer.h
+*
+* This file contains the MetricsServer class, the HTTP endpoint of the metrics of the online algorithm.
+* @author Jenei Gábor <jengab@elte.hu>
+*/
+
+/// The maximal size of an HTTP request of the metrics endpoint in bytes
+///
+#define MAX_METRICS_REQUEST_SIZE 8192
+
+/// The time in milliseconds a client of the metrics endpoint has to send its request and to read the response
+///
+#define METRICS_REQUEST_TIMEOUT 5000
+
+/**
+* <p>This class serves the counters of the online algorithm in the Prometheus text format at
+* http://127.0.0.1:\<port\>/metrics. It listens on the loopback interface only, and it runs on the io_service
+* of the AsyncServer. Each request gets one response, then the connection is closed. A connection that is not
+* answered in METRICS_REQUEST_TIMEOUT milliseconds (e.g. the client doesn't send its request) is closed.</p>
+*
+* <p>The counters are updated by the components on their hot paths (see ShardedCounter), this class only reads
+* them when a request arrives: the received and processed messages per transport, the outcomes of the
+* classification, the latency of the classification and of the database commits, the queue depths, the
+* number of templates and the open connections.</p>
+*/
+class MetricsServer:public std::enable_shared_from_this<MetricsServer>{
+private:
+    struct Request{
+        boost::asio::ip::tcp::socket Socket;
+        boost::asio::io_service::strand Strand;
+        boost::asio::steady_timer Timer;
+        boost::asio::streambuf Buffer;
+        std::string Response;
+        Request(boost::asio::io_service& Service):Socket(Service),Strand(Service),Timer(Service),Buffer(MAX_METRICS_REQUEST_SIZE){}
+    };
+
+    boost::asio::ip::tcp::acceptor Acceptor;
+    std::shared_ptr<ClusterParser> Parser;
+    std::shared_ptr<IngestQueue> Queue;
+    AsyncServer& Server;
+    std::shared_ptr<UdpListener> Udp;
+    std::ostream* ErrorStream;
+    void accept();
+    void respond(std::shared_ptr<Request>);
+
+public:
+    MetricsServer(unsigned short,std::shared_ptr<ClusterParser>,std::shared_ptr<IngestQueue>,AsyncServer&,
+        std::shared_ptr<UdpListener>,std::ostream*);
+    void start();
+    std::string getMetrics();
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef UDP_LISTENER_H
+#define UDP_LISTENER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <ostream>
+#include <cstdint>
+#include <boost/asio.hpp>
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+#include "IngestQueue.h"
+
+/**
+* @file UdpListener.h
+*
+* This file contains the UdpListener class, the UDP syslog input of the online algorithm.
+* @author Jenei Gábor <jengab@elte.hu>
+*/
+
+/// The number of datagrams received by one recvmmsg call (on Linux)
+///
+#define UDP_BATCH_SIZE 64
+
+/// The maximal size of a datagram in bytes, a longer datagram is dropped (see UdpListener::getTruncated())
+///
+#define UDP_MESSAGE_SIZE 8192
+
+/// The requested size of the kernel receive buffer of the UDP socket in bytes
+///
+#define UDP_SOCKET_BUFFER_SIZE (8*1024*1024)
+
+/**
+* <p>This class receives syslog messages over UDP. Each datagram is treated as one message. On Linux, when the socket
+* becomes readable, the datagrams are received in batches by recvmmsg (until the socket is empty), and the batch is put
+* on the IngestQueue. On the other systems the datagrams are received one by one by async_receive_from. The listener
+* runs on the io_service of the AsyncServer, alongside the TCP connections.</p>
+*
+* <p>The listener counts the received, the queued and the dropped messages. A message is dropped if the kernel
+* had no room for it in the receive buffer, it was longer than UDP_MESSAGE_SIZE (the kernel cut it, thus only a part
+* of the message would be classified), or it couldn't be queued (the full queue is counted by the IngestQueue).
+* The drops of the kernel are only known on Linux (SO_MEMINFO), elsewhere they are reported as unavailable.</p>
+*/
+class UdpListener:public std::enable_shared_from_this<UdpListener>{
+private:
+    boost::asio::ip::udp::socket Socket;
+    std::shared_ptr<IngestQueue> Queue;
+    std::ostream* ErrorStream;
+    std::vector<char> Buffers;
+#ifdef __linux__
+    std::vector<struct iovec> Vectors;
+    std::vector<struct mmsghdr> Headers;
+    std::vector<std::string> Batch;
+#else
+    boost::asio::ip::udp::endpoint Sender;
+#endif
+    std::atomic<uint64_t> Received;
+    std::atomic<uint64_t> Processed;
+    std::atomic<uint64_t> Failed;
+    std::atomic<uint64_t> Truncated;
+#ifdef __linux__
+    void wait();
+    void onReadable(const boost::system::error_code&);
+    size_t receiveBatch();
+#else
+    void receive();
+    void onReceived(const boost::system::error_code&,size_t);
+#endif
+    void queueMessage(std::string&&);
+
+public:
+    UdpListener(boost::asio::io_service&,unsigned short,std::shared_ptr<IngestQueue>,std::ostream*);
+    void start();
+    std::string getStatistics();
+    uint64_t getDropped();
+    bool getKernelDropped(uint64_t&);
+
+    /**
+    * @return The number of datagrams received
+    */
+    uint64_t getReceived() const{return Received;}
+
+    /**
+    * @return The number of messages put on the IngestQueue
+    */
+    uint64_t getProcessed() const{return Processed;}
+
+    /**
+    * @return The number of datagrams dropped because they were longer than UDP_MESSAGE_SIZE
+    */
+    uint64_t getTruncated() const{return Truncated;}
+};
+
+#endif
@@ -0,0 +1,471 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <boost/asio.hpp>
+#include <SQLiteCpp/SQLiteCpp.h>
+
+/**
+* @file main_replay.cpp
+*
+* This file contains the main() function of helo_replay, the load generator of the online algorithm.
+* It replays a log file (or synthetic messages) to a running helo_online, and measures how fast
+* the messages get to its database.
+* @author Jenei Gábor <jengab@elte.hu>
+*/
+
+using namespace std;
+using boost::asio::ip::tcp;
+using boost::asio::ip::udp;
+typedef std::chrono::steady_clock Clock;
+
+/// The size of the buffer of a TCP sender in bytes, the messages are written in chunks of this size at the maximal rate
+///
+#define REPLAY_BUFFER_SIZE 65536
+
+/// The time between two queries of the database in milliseconds
+///
+#define POLL_INTERVAL 5
+
+/**
+* This class stores the parameters of a replay, it only has public members, just like a \c struct
+*/
+class ReplaySettings{
+public:
+    /// The path of the database of helo_online
+    ///
+    std::string DbFile;
+
+    /// The log file to replay (if it is empty, synthetic messages are sent)
+    ///
+    std::string LogFile;
+
+    /// The log file is a spill file of helo_online (its lines are escaped, see IngestQueue)
+    ///
+    bool spill;
+
+    /// The port of helo_online
+    ///
+    unsigned short port;
+
+    /// Send the messages over UDP instead of TCP
+    ///
+    bool udp;
+
+    /// The number of TCP connections (or UDP sockets) sending in parallel
+    ///
+    unsigned int connections;
+
+    /// The number of messages sent per second (0 means as fast as possible)
+    ///
+    double rate;
+
+    /// The number of messages to send (0 means the lines of the log file, or 100000 synthetic messages)
+    ///
+    size_t count;
+
+    /// The time in seconds the database is waited for after the last new message
+    ///
+    unsigned int timeout;
+
+    ReplaySettings():DbFile(""),LogFile(""),spill(false),port(514),udp(false),connections(1),rate(0),count(0),timeout(10){}
+};
+
+/**
+* The state shared by the sender threads: the next message to send, and the times of sending
+*/
+struct ReplayState{
+    /// The messages to send (they are sent in turn if more messages are sent than this)
+    ///
+    std::vector<std::string> Messages;
+
+    /// The number of messages to send
+    ///
+    size_t Count;
+
+    /// The index of the next message to send
+    ///
+    std::atomic<size_t> Next;
+
+    /// The number of messages sent
+    ///
+    std::atomic<size_t> Sent;
+
+    /// The number of messages that couldn't be sent
+    ///
+    std::atomic<size_t> SendErrors;
+
+    /// The time of sending of each message (Clock::time_point::min() if it wasn't sent)
+    ///
+    std::vector<Clock::time_point> SendTimes;
+
+    /// The beginning of the replay
+    ///
+    Clock::time_point Start;
+};
+
+/**
+* Makes a synthetic syslog message. The messages come from a few typical templates
+* (sshd, kernel, cron, web application, mail), with random variable fields.
+*
+* @param[in,out] rnd The random generator
+* @return The message with a 4 token header (date, time and host)
+*/
+std::string makeSyntheticMessage(std::mt19937& rnd){
+    char Message[256];
+    int Length=snprintf(Message,sizeof(Message),"Oct 19 12:%02u:%02u bench%u ",(unsigned)(rnd()%60),(unsigned)(rnd()%60),(unsigned)(rnd()%4));
+    unsigned int Pid=1000+rnd()%9000;
+    char* Body=Message+Length;
+    size_t Rest=sizeof(Message)-Length;
+    switch(rnd()%8){
+    case 0:
+        snprintf(Body,Rest,"sshd[%u]: Accepted password for user%u from 10.%u.%u.%u port %u ssh2",Pid,(unsigned)(rnd()%50),
+            (unsigned)(rnd()%4),(unsigned)(rnd()%256),(unsigned)(rnd()%256),(unsigned)(1024+rnd()%60000));
+        break;
+    case 1:
+        snprintf(Body,Rest,"sshd[%u]: Failed password for invalid user guest%u from 10.%u.%u.%u",Pid,(unsigned)(rnd()%50),
+            (unsigned)(rnd()%4),(unsigned)(rnd()%256),(unsigned)(rnd()%256));
+        break;
+    case 2:
+        snprintf(Body,Rest,"kernel: eth%u: link up, 1000 Mbps, full duplex",(unsigned)(rnd()%4));
+        break;
+    case 3:
+        snprintf(Body,Rest,"cron[%u]: (root) CMD (run-parts /etc/cron.hourly)",Pid);
+        break;
+    case 4:
+        snprintf(Body,Rest,"app[%u]: request GET /api/v1/items/%u completed in %u ms status 200",Pid,(unsigned)(rnd()%100000),
+            (unsigned)(rnd()%500));
+        break;
+    case 5:
+        snprintf(Body,Rest,"app[%u]: cache miss for key session:%u",Pid,(unsigned)(rnd()%100000));
+        break;
+    case 6:
+        snprintf(Body,Rest,"postfix/smtpd[%u]: connect from mail%u.example.com[192.168.%u.%u]",Pid,(unsigned)(rnd()%20),
+            (unsigned)(rnd()%256),(unsigned)(rnd()%256));
+        break;
+    default:
+        snprintf(Body,Rest,"heartbeat ok");
+    }
+    return std::string(Message);
+}
+
+/**
+* Restores a message of a spill file of helo_online: \\\\, \\n and \\r are replaced by the
+* backslash and the line breaks
+*
+* @param[in] Line The line of the spill file
+* @return The message
+*/
+std::string unescapeSpilled(const std::string& Line){
+    std::string Message;
+    Message.reserve(Line.size());
+    for(size_t i=0;i<Line.size();++i){
+        if(Line[i]=='\\' && i+1<Line.size()){
+            char Next=Line[++i];
+            Message+=(Next=='n' ? '\n' : Next=='r' ? '\r' : Next);
+        }
+        else Message+=Line[i];
+    }
+    return Message;
+}
+
+/**
+* Waits until a message is due at the given rate
+*
+* @param[in] State The state of the replay
+* @param[in] Index The index of the message
+* @param[in] rate The number of messages per second (0 means no waiting)
+*/
+void waitForTurn(const ReplayState& State,size_t Index,double rate){
+    if(rate<=0) return;
+    std::this_thread::sleep_until(State.Start+std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(Index/rate)));
+}
+
+/**
+* This is a thread function that sends messages over one TCP connection, until every message is sent.
+* At the maximal rate the messages are written in large chunks, at a fixed rate each message is written when it is due.
+*
+* @param[in] settings The parameters of the replay
+* @param[in,out] State The state of the replay
+*/
+void sendTcp(const ReplaySettings& settings,ReplayState& State){
+    try{
+        boost::asio::io_service Service;
+        tcp::socket Socket(Service);
+        Socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(),settings.port));
+
+        std::string Buffer;
+        Buffer.reserve(REPLAY_BUFFER_SIZE+1024);
+        size_t Buffered=0;
+        size_t Index;
+        while((Index=State.Next++)<State.Count){
+            waitForTurn(State,Index,settings.rate);
+            Buffer+=State.Messages[Index%State.Messages.size()];
+            Buffer+='\n';
+            State.SendTimes[Index]=Clock::now();
+            ++Buffered;
+            if(settings.rate>0 || Buffer.size()>=REPLAY_BUFFER_SIZE){
+                boost::asio::write(Socket,boost::asio::buffer(Buffer));
+                State.Sent+=Buffered;
+                Buffer.clear();
+                Buffered=0;
+            }
+        }
+        boost::asio::write(Socket,boost::asio::buffer(Buffer));
+        State.Sent+=Buffered;
+        Socket.shutdown(tcp::socket::shutdown_send);
+        Socket.close();
+    }
+    catch(const std::exception& e){
+        cerr << "Sending over TCP failed: " << e.what() << endl;
+        State.Next=State.Count; //the other senders stop too
+    }
+}
+
+/**
+* This is a thread function that sends messages as UDP datagrams, until every message is sent.
+* A datagram that can't be sent is counted as a send error.
+*
+* @param[in] settings The parameters of the replay
+* @param[in,out] State The state of the replay
+*/
+void sendUdp(const ReplaySettings& settings,ReplayState& State){
+    try{
+        boost::asio::io_service Service;
+        udp::socket Socket(Service);
+        Socket.open(udp::v4());
+        udp::endpoint Target(boost::asio::ip::address_v4::loopback(),settings.port);
+
+        size_t Index;
+        while((Index=State.Next++)<State.Count){
+            waitForTurn(State,Index,settings.rate);
+            const std::string& Message=State.Messages[Index%State.Messages.size()];
+            boost::system::error_code error;
+            State.SendTimes[Index]=Clock::now();
+            Socket.send_to(boost::asio::buffer(Message),Target,0,error);
+            if(error){
+                State.SendTimes[Index]=Clock::time_point::min();
+                ++State.SendErrors;
+            }
+            else ++State.Sent;
+        }
+    }
+    catch(const std::exception& e){
+        cerr << "Sending over UDP failed: " << e.what() << endl;
+        State.Next=State.Count;
+    }
+}
+
+/**
+* @param[in] query The prepared query of the highest rowid
+* @return The highest rowid of the syslog table (0 if it is empty)
+*/
+sqlite3_int64 getLastRow(SQLite::Statement& query){
+    query.reset();
+    query.executeStep();
+    return query.getColumn(0).getInt64();
+}
+
+/**
+* @param[in] Values The sorted values
+* @param[in] Ratio The ratio of the percentile (between 0 and 1)
+* @return The percentile of the values
+*/
+double getPercentile(const std::vector<double>& Values,double Ratio){
+    if(Values.empty()) return 0;
+    size_t Index=std::min(Values.size()-1,(size_t)(Ratio*Values.size()));
+    return Values[Index];
+}
+
+/**
+* Creates an empty database with the tables of helo_online
+*
+* @param[in] DbFile The path of the database
+*/
+void initDatabase(const std::string& DbFile){
+    SQLite::Database db(DbFile.c_str(),SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    db.exec("CREATE TABLE IF NOT EXISTS clusters (clustid INTEGER PRIMARY KEY,template text NOT NULL,goodness real NOT NULL,AvgLen real NOT NULL)");
+    db.exec("CREATE TABLE IF NOT EXISTS cluster_stats (clustid INTEGER PRIMARY KEY,LineCount INTEGER NOT NULL,TotalLen INTEGER NOT NULL,FOREIGN KEY(clustid) REFERENCES clusters(clustid))");
+    db.exec("CREATE TABLE IF NOT EXISTS syslog (clustid INTEGER,msg text NOT NULL,FOREIGN KEY(clustid) REFERENCES clusters(clustid))");
+}
+
+/**
+ * <p>This is the main() function of helo_replay.</p>
+ *
+ * <p>It sends messages to a helo_online running on the local computer over TCP (or UDP), from a given number of
+ * connections, at a fixed or at the maximal rate. Meanwhile the syslog table of the database of helo_online is
+ * polled, and the arrival time of each new row is recorded. The replay ends when every message is stored, or no
+ * message was stored for the timeout. Then a summary is printed: the sending rate, the sustained throughput
+ * (stored messages per second from the beginning to the last stored message), the drop rate, and the end-to-end
+ * latency. The latency pairs the n-th stored row with the n-th sent message, which is exact for one TCP connection,
+ * and an approximation for parallel senders (their messages may be stored in a slightly different order).</p>
+ *
+ * <p>\c helo_replay \c init \c \<db_file\> creates an empty database for helo_online.</p>
+ *
+ * @param[in] argc The number of command line arguments
+ * @param[in] argv The array of command line arguments
+ * @return 0 if the replay was finished, 1 if it failed, 2 if messages were lost
+ */
+int main(int argc,char** argv){
+    const string HelpMsg=string("Usage: helo_replay <db_file> [options]\n       helo_replay init <db_file>\n Options: \n")+
+                         string("  -p<value> : Sets the port of helo_online (default: 514)\n")+
+                         string("  -lf<value> : Sets the log file to replay (default: synthetic messages)\n")+
+                         string("  -sf<value> : Sets a spill file of helo_online to replay (its messages may contain line breaks, which are kept over UDP only)\n")+
+                         string("  -n<value> : Sets the number of messages to send (default: the lines of the log file, or 100000)\n")+
+                         string("  -c<value> : Sets the number of parallel connections (default: 1)\n")+
+                         string("  -r<value> : Sets the number of messages sent per second (default: 0, as fast as possible)\n")+
+                         string("  -ud : Sends the messages over UDP instead of TCP\n")+
+                         string("  -to<value> : Sets the time in seconds to wait for the database after the last stored message (default: 10)\n\n");
+
+    if(argc<2 || strcmp(argv[1],"-h")==0){
+        cout << HelpMsg;
+        return argc<2 ? 1 : 0;
+    }
+
+    ReplaySettings settings;
+    try{
+        if(strcmp(argv[1],"init")==0){
+            if(argc<3){
+                cout << HelpMsg;
+                return 1;
+            }
+            initDatabase(argv[2]);
+            return 0;
+        }
+
+        settings.DbFile=argv[1];
+        for(int i=2;i<argc;++i){
+            if(strncmp(argv[i],"-p",2)==0) settings.port=atoi(&argv[i][2]);
+            if(strncmp(argv[i],"-lf",3)==0) settings.LogFile=string(&argv[i][3]);
+            if(strncmp(argv[i],"-sf",3)==0){
+                settings.LogFile=string(&argv[i][3]);
+                settings.spill=true;
+            }
+            if(strncmp(argv[i],"-n",2)==0) settings.count=strtoull(&argv[i][2],NULL,10);
+            if(strncmp(argv[i],"-c",2)==0) settings.connections=std::max(1,atoi(&argv[i][2]));
+            if(strncmp(argv[i],"-r",2)==0) settings.rate=atof(&argv[i][2]);
+            if(strcmp(argv[i],"-ud")==0) settings.udp=true;
+            if(strncmp(argv[i],"-to",3)==0) settings.timeout=atoi(&argv[i][3]);
+        }
+
+        ReplayState State;
+        if(!settings.LogFile.empty()){
+            ifstream Input(settings.LogFile);
+            if(Input.fail()){
+                cerr << "The log file couldn't be opened\n";
+                return 1;
+            }
+            string Line;
+            while(getline(Input,Line)){
+                if(!Line.empty() && Line.back()=='\r') Line.pop_back();
+                if(settings.spill) Line=unescapeSpilled(Line);
+                if(!Line.empty()) State.Messages.push_back(Line);
+            }
+            if(State.Messages.empty()){
+                cerr << "The log file is empty\n";
+                return 1;
+            }
+            if(settings.count==0) settings.count=State.Messages.size();
+        }
+        else{
+            if(settings.count==0) settings.count=100000;
+            std::mt19937 rnd(42);
+            for(size_t i=0;i<settings.count;++i) State.Messages.push_back(makeSyntheticMessage(rnd));
+        }
+
+        State.Count=settings.count;
+        State.Next=0;
+        State.Sent=0;
+        State.SendErrors=0;
+        State.SendTimes.assign(State.Count,Clock::time_point::min());
+
+        SQLite::Database db(settings.DbFile.c_str(),SQLITE_OPEN_READONLY);
+        SQLite::Statement LastRowQuery(db,"SELECT IFNULL(MAX(rowid),0) FROM syslog");
+        sqlite3_int64 FirstRow=getLastRow(LastRowQuery);
+
+        cout << "Replaying " << State.Count << (settings.LogFile.empty() ? " synthetic" : "") << " messages over "
+             << (settings.udp ? "UDP" : "TCP") << " to port " << settings.port << " from " << settings.connections
+             << " connection(s) at " << (settings.rate>0 ? std::to_string((long long)settings.rate)+" messages/s" : string("the maximal rate"))
+             << endl;
+
+        State.Start=Clock::now();
+        std::vector<std::thread> Senders;
+        for(unsigned int i=0;i<settings.connections;++i){
+            if(settings.udp) Senders.push_back(std::thread(sendUdp,std::cref(settings),std::ref(State)));
+            else Senders.push_back(std::thread(sendTcp,std::cref(settings),std::ref(State)));
+        }
+
+        std::atomic<bool> SendingDone(false);
+        Clock::time_point SendEnd;
+        std::thread Joiner([&](){
+            for(std::thread& ActSender:Senders) ActSender.join();
+            SendEnd=Clock::now();
+            SendingDone=true;
+        });
+
+        std::vector<Clock::time_point> Arrivals;
+        Arrivals.reserve(State.Count);
+        Clock::time_point LastProgress=Clock::now();
+        while(Arrivals.size()<State.Count){
+            std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL));
+            sqlite3_int64 Stored=getLastRow(LastRowQuery)-FirstRow;
+            Clock::time_point Now=Clock::now();
+            if((size_t)Stored>Arrivals.size()){
+                Arrivals.resize(std::min<size_t>(Stored,State.Count),Now);
+                LastProgress=Now;
+            }
+            else if(!SendingDone) LastProgress=Now; //the timeout starts when every message is sent
+            else if(Now-LastProgress>std::chrono::seconds(settings.timeout)) break;
+        }
+        Joiner.join();
+
+        std::vector<Clock::time_point> SendTimes;
+        SendTimes.reserve(State.Count);
+        for(const Clock::time_point& ActTime:State.SendTimes){
+            if(ActTime!=Clock::time_point::min()) SendTimes.push_back(ActTime);
+        }
+        std::sort(SendTimes.begin(),SendTimes.end());
+
+        std::vector<double> Latencies;
+        size_t Paired=std::min(SendTimes.size(),Arrivals.size());
+        Latencies.reserve(Paired);
+        for(size_t i=0;i<Paired;++i){
+            Latencies.push_back(std::max(0.0,std::chrono::duration<double,std::milli>(Arrivals[i]-SendTimes[i]).count()));
+        }
+        std::sort(Latencies.begin(),Latencies.end());
+
+        size_t Sent=State.Sent;
+        size_t Stored=Arrivals.size();
+        double SendSeconds=std::chrono::duration<double>(SendEnd-State.Start).count();
+        double StoreSeconds=Stored>0 ? std::chrono::duration<double>(Arrivals.back()-State.Start).count() : 0;
+        size_t Dropped=Sent>Stored ? Sent-Stored : 0;
+
+        ostringstream str;
+        str.setf(ios::fixed);
+        str.precision(2);
+        str << "Sent: " << Sent << " messages in " << SendSeconds << " s (" << (SendSeconds>0 ? Sent/SendSeconds : 0) << " messages/s)";
+        if(State.SendErrors>0 || Sent<State.Count) str << ", not sent: " << State.Count-Sent;
+        str << "\nStored: " << Stored << " messages in " << StoreSeconds << " s, sustained throughput: "
+            << (StoreSeconds>0 ? Stored/StoreSeconds : 0) << " messages/s\n";
+        str << "Dropped: " << Dropped << " messages (" << (Sent>0 ? 100.0*Dropped/Sent : 0) << "%)\n";
+        str << "End-to-end latency (ms): p50: " << getPercentile(Latencies,0.5) << ", p90: " << getPercentile(Latencies,0.9)
+            << ", p99: " << getPercentile(Latencies,0.99) << ", max: " << (Latencies.empty() ? 0 : Latencies.back()) << "\n";
+        cout << str.str();
+
+        if(Sent<State.Count) return 1;
+        return Dropped>0 ? 2 : 0;
+    }
+    catch(const std::exception& e){
+        cerr << "The replay failed: " << e.what() << endl;
+        return 1;
+    }
+}
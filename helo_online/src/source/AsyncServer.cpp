@@ -0,0 +1,171 @@
+#include <cstring>
+#include <thread>
+#include "AsyncServer.h"
+#include "OutputHandler.h"
+
+using boost::asio::ip::tcp;
+
+/**
+ * Constructor
+ *
+ * @param[in] server The server of the connection (its io_service serves the connection, and it counts the connection)
+ */
+TcpConnection::TcpConnection(AsyncServer& server):
+    Server(server),Socket(server.Service),Started(false),Buffer(RECEIVE_BUFFER_SIZE),ReadPos(0),ReadEnd(0){}
+
+/**
+ * Destructor, the connection isn't counted as active anymore (if it was started)
+ */
+TcpConnection::~TcpConnection(){
+    if(Started) --Server.ActiveConnections;
+}
+
+/**
+ * Starts reading the accepted connection
+ */
+void TcpConnection::start(){
+    Started=true;
+    ++Server.ActiveConnections;
+    read();
+}
+
+/**
+ * Starts an asynchronous read into the buffer, the handler keeps the connection alive
+ */
+void TcpConnection::read(){
+    std::shared_ptr<TcpConnection> self=shared_from_this();
+    Socket.async_read_some(boost::asio::buffer(Buffer),[self](const boost::system::error_code& error,size_t length){
+        self->onRead(error,length);
+    });
+}
+
+/**
+ * Puts the collected line on the queue, and clears it. If the queue is full and the overload policy
+ * is BlockSender, the queue parks the line, and calls resume() on the io_service when it drains.
+ *
+ * @return true if the connection can go on, false if it has to wait
+ */
+bool TcpConnection::processLine(){
+    std::shared_ptr<TcpConnection> self=shared_from_this();
+    IngestOutcome Outcome=Server.Queue->tryPush(std::move(Line),TcpTransport,[self](){
+        self->Server.Service.post([self](){self->resume();});
+    });
+    Server.Received.add();
+    Line.clear();
+    return Outcome!=MessageDeferred;
+}
+
+/**
+ * Handles a finished read: the received bytes are processed (see processBuffer())
+ *
+ * @param[in] error The result of the read
+ * @param[in] length The number of bytes read
+ */
+void TcpConnection::onRead(const boost::system::error_code& error,size_t length){
+    ReadPos=0;
+    ReadEnd=length;
+    ReadError=error;
+    processBuffer();
+}
+
+/**
+ * Continues a connection that waited for the queue (its deferred line is queued already):
+ * the rest of the buffer is processed
+ */
+void TcpConnection::resume(){
+    processBuffer();
+}
+
+/**
+ * Processes the rest of the buffer: the complete lines are processed, the last incomplete
+ * line is kept until the rest of it arrives. When the client closes the connection, its last
+ * line is processed even if it has no line break. Then the next read is started, unless
+ * the connection has to wait for the queue.
+ */
+void TcpConnection::processBuffer(){
+    try{
+        while(ReadPos<ReadEnd){
+            const char* Begin=Buffer.data()+ReadPos;
+            const char* End=Buffer.data()+ReadEnd;
+            const char* LineEnd=static_cast<const char*>(memchr(Begin,'\n',End-Begin));
+            if(LineEnd==NULL){
+                Line.append(Begin,End);
+                ReadPos=ReadEnd;
+                if(Line.size()>=MAX_MESSAGE_LENGTH && !processLine()) return;
+                break;
+            }
+            Line.append(Begin,LineEnd);
+            ReadPos=LineEnd+1-Buffer.data();
+            if(!processLine()) return;
+        }
+
+        if(ReadError==boost::asio::error::eof){
+            if(!Line.empty()) processLine();
+            return;
+        }
+        if(ReadError) throw boost::system::system_error(ReadError);
+    }
+    catch(const std::exception& e){
+        if(ReadError!=boost::asio::error::operation_aborted){
+            OutputHandler::logException(Server.ErrorStream,"Exception in connection: ",e);
+        }
+        return;
+    }
+    read();
+}
+
+/**
+ * Constructor, it starts listening on the given port
+ *
+ * @param[in] port The TCP port to listen on
+ * @param[in] queue The queue of the received messages
+ * @param[in] errorStream The stream to log the errors to
+ * @throws boost::system::system_error if the port can't be used
+ */
+AsyncServer::AsyncServer(unsigned short port,std::shared_ptr<IngestQueue> queue,std::ostream* errorStream):
+    ActiveConnections(0),Acceptor(Service),Queue(queue),ErrorStream(errorStream){
+    tcp::endpoint logger(tcp::v4(),port);
+    Acceptor.open(logger.protocol());
+    Acceptor.set_option(tcp::acceptor::reuse_address(true));
+    Acceptor.bind(logger);
+    Acceptor.listen();
+    accept();
+}
+
+/**
+ * Starts accepting the next connection. A failed accept is logged, and the server goes on accepting.
+ */
+void AsyncServer::accept(){
+    std::shared_ptr<TcpConnection> Connection=std::make_shared<TcpConnection>(std::ref(*this));
+    Acceptor.async_accept(Connection->getSocket(),[this,Connection](const boost::system::error_code& error){
+        if(error==boost::asio::error::operation_aborted) return;
+        if(error){
+            OutputHandler::logException(ErrorStream,"An error occurred during accepting a connection: ",boost::system::system_error(error));
+        }
+        else{
+            Connection->start();
+        }
+        accept();
+    });
+}
+
+/**
+ * Serves the connections until stop() is called. The calling thread is one of the threads that run the server.
+ *
+ * @param[in] threads The number of threads to use (at least one is used)
+ */
+void AsyncServer::run(unsigned int threads){
+    std::vector<std::thread> Workers;
+    for(unsigned int i=1;i<threads;++i){
+        Workers.push_back(std::thread([this](){Service.run();}));
+    }
+    Service.run();
+    for(std::thread& ActWorker:Workers) ActWorker.join();
+}
+
+/**
+ * Stops the server, run() returns in all threads. It can be called from any thread.
+ */
+void AsyncServer::stop(){
+    Service.stop();
+}
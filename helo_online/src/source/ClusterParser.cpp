@@ -1,48 +1,72 @@
 #include "ClusterParser.h"
 #include "pugixml.hpp"
 #include "OutputHandler.h"
+#include "ModelFile.h"
 #include <sstream>
-#include <regex>
-#include <codecvt>
+#include <algorithm>
 #include <string.h>
 
-inline std::wstring from_utf(const char* bytes) {
-    std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
-    return converter.from_bytes(bytes);
-}
-
-inline std::string to_utf(const std::wstring& str) {
-    std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
-    return converter.to_bytes(str);
-}
-
 /**
-* Constructor
+* Constructor. It loads the clusters (from the model if there is one, then from the database,
+* whose rows take precedence), and starts the writer of the database. The prebuilt index of the
+* model is mapped, otherwise the index is built from the loaded clusters.
+*
 * @param[in] s A reference to an object that stores the loaded
 * settings (Header length, regular expression, etc.)
+* @throws SQLite::Exception if the database can't be opened or it has no proper tables
+* @throws ModelError if the model can't be loaded
 */
-ClusterParser::ClusterParser(const Settings& s):settings(s), logParser(s.HeaderLen, s.regexp) {
-    SQLite::Database db(settings.DbFile.c_str(),SQLITE_OPEN_READWRITE);
-    SQLite::Statement query(db,"SELECT * FROM clusters");
+ClusterParser::ClusterParser(const Settings& s):settings(s), logParser(s.HeaderLen, s.regexp), TemplateCount(0),Cache(s.cacheSize),NextId(1),
+    Writer(s.DbFile,s.writeBatch,s.writeLatency,s.ErrorStream) {
+    TemplateLoader Loader(Tokens,Clusters);
+    std::unique_ptr<ModelReader> Model;
+    if(!settings.ModelFile.empty()){
+        Model.reset(new ModelReader(settings.ModelFile));
+        Loader.loadModel(*Model);
+    }
 
-    while(query.executeStep()){
-        sqlite3_int64 id=query.getColumn(0).getInt64();
+    SQLite::Database db(settings.DbFile.c_str(),SQLITE_OPEN_READONLY);
+    loadDatabase(db,Loader,Model.get());
+    NextId=Loader.getMaxId()+1;
 
-        std::vector<TokenDescriptor> Template;
-        std::wistringstream TemplStr(from_utf((const char*)query.getColumn(1)));
-        while(!TemplStr.eof()){
-            std::wstring ActToken;
-            TemplStr >> ActToken;
-            if(ActToken.empty()) continue;
-            wordtype type=Word;
-            if(ActToken==L"+d") type=Number;
-            Template.push_back(TokenDescriptor(ActToken,type));
+    if(Model && Loader.isModelIndexed()){ //only the clusters changed since the model was made are indexed
+        Index.attach(*Model);
+        for(size_t i:Loader.getReplaced()){
+            Index.remove(i,Clusters[i]);
+            Index.insert(i,Clusters[i]);
         }
-        if(Template.empty()) continue;
+        for(size_t i=Index.getBase().TemplateCount;i<Clusters.size();++i) Index.insert(i,Clusters[i]);
+    }
+    else Index.build(Clusters);
+    TemplateCount=Clusters.size();
+}
 
-        double goodness=query.getColumn(2);
-        double AvgLen=query.getColumn(3);
-        Clusters.push_back(ClusterTemplate(Template,goodness,AvgLen,id));
+/**
+* Loads the clusters from the clusters table of the database. Token types are not stored in
+* the database, thus only +d is loaded as Number, every other token is a Word (see ClusterTemplate::parseTemplate()).
+* The clusters joined since the model was made are only up to date in the database (see TemplateLoader). If the model
+* has the generation of the database, only the rows changed since then are read (the cluster_changes table logs them,
+* see DatabaseWriter), otherwise every row is read.
+*
+* @param[in] db The opened database
+* @param[in,out] Loader The loader that collects the templates
+* @param[in] Model The loaded model, NULL if there is none
+*/
+void ClusterParser::loadDatabase(SQLite::Database& db,TemplateLoader& Loader,const ModelReader* Model){
+    uint64_t Generation=0;
+    bool Changed=Model!=NULL && Model->getGeneration(Generation) && db.tableExists("cluster_changes");
+    if(Changed){ //a database older than the model (e.g. it was rebuilt) is read as a whole
+        SQLite::Statement LastChange(db,"SELECT ifnull(max(seq),0) FROM cluster_changes");
+        LastChange.executeStep();
+        Changed=(uint64_t)LastChange.getColumn(0).getInt64()>=Generation;
+    }
+
+    SQLite::Statement query(db,Changed ? "SELECT clustid,template,goodness,AvgLen FROM cluster_changes JOIN clusters USING(clustid) "
+        "WHERE seq>? ORDER BY clustid" : "SELECT clustid,template,goodness,AvgLen FROM clusters");
+    if(Changed) query.bind(1,(sqlite3_int64)Generation);
+    while(query.executeStep()){
+        Loader.addRow(query.getColumn(0).getInt64(),(const char*)query.getColumn(1),
+            query.getColumn(2).getDouble(),query.getColumn(3).getDouble());
     }
 }
 
@@ -84,9 +108,10 @@ std::wostream& operator<<(std::wostream& os,ClusterParser& parser){
         ClustNode.append_attribute(LogParser::GoodnessAttributeName)=ActTempl.getGoodness();
         ClustNode.append_attribute(LogParser::AvgLenAttributeName)=ActTempl.getAvgLen();
 
-        for(const TokenDescriptor& ActTok:ActTempl.getTemplate()){
+        for(uint32_t ActId:ActTempl.getTemplate()){
+            const TokenDescriptor& ActTok=parser.Tokens[ActId];
             pugi::xml_node TemplNode=ClustNode.append_child(LogParser::TokenNodeName);
-            TemplNode.append_attribute(LogParser::TokenValAttributeName)=ActTok.TokenString.c_str();
+            TemplNode.append_attribute(LogParser::TokenValAttributeName)=toWide(ActTok.TokenString).c_str();
             TemplNode.append_attribute(LogParser::TokenTypeAttributeName)=ActTok.TypeOfToken;
         }
     }
@@ -102,112 +127,110 @@ std::wostream& operator<<(std::wostream& os,ClusterParser& parser){
 void ClusterParser::printToConsole() const{
     for(const ClusterTemplate& ActTempl:Clusters){
         std::wcout << ActTempl.getId() << " Cluster goodness: " << ActTempl.getGoodness() << " AvgLen: " << ActTempl.getAvgLen() << std::endl;
-        for(const TokenDescriptor& ActToken:ActTempl.getTemplate()){
-            std::wcout << ActToken.TokenString << " ";
+        for(uint32_t ActToken:ActTempl.getTemplate()){
+            std::wcout << toWide(Tokens[ActToken].TokenString) << " ";
         }
         std::wcout << std::endl;
     }
 }
 
+/**
+* Looks up the tokens of a message in the token table of the templates
+*
+* @param[in] LineVect The tokens of the message
+* @param[out] LineIds The ids of the tokens (TokenTable::UnknownTokenId for the tokens not used by any template)
+*/
+void ClusterParser::getTokenIds(const std::vector<TokenDescriptor>& LineVect,std::vector<MessageToken>& LineIds) const{
+    LineIds.clear();
+    LineIds.reserve(LineVect.size());
+    for(const TokenDescriptor& ActToken:LineVect){
+        LineIds.push_back(MessageToken(Tokens.find(ActToken.TokenString),ActToken.TypeOfToken));
+    }
+}
+
 /**
 * This method implements the processing of a newly arrived message.
-* It does INSERT,UPDATE on the SQLite file. This method is thread-safe!
-* The parameter string gets modified in this method!
+* The message and the change of its cluster are queued for the DatabaseWriter,
+* the new clusters get their id here. This method is thread-safe!
+* The exact match is searched under a shared lock, if there is none, the lock is
+* taken exclusively, and the search is repeated (another thread may have changed the templates
+* in the meantime) before the message is joined to a cluster, or a new cluster is created.
+* The exact matches are cached, a join invalidates the cached matches that may have changed.
+* The records of the database are pushed after the lock is released, the changes are
+* queued in the order they were made (see DatabaseWriter::reserve()).
 *
-* @param[in,out] line The syslog message encoded in UTF-8 to be processed.
+* @param[in] line The syslog message encoded in UTF-8 to be processed.
 */
-void ClusterParser::ProcessMessage(std::wstring& line){
-    size_t start_pos=0;
-    while((start_pos=line.find(L'\"',start_pos))!=std::wstring::npos){
-        line.replace(start_pos,1,L"\'");
-        ++start_pos;
+void ClusterParser::ProcessMessage(std::string& line){
+    TokenizedMessage Message;
+    if(!logParser.tokenize(line,Message)) return;
+    const std::string& msg=Message.Buffer;
+
+    std::vector<TokenDescriptor> LineVect;
+    LineVect.reserve(Message.Tokens.size());
+    for(size_t i=0;i<Message.Tokens.size();++i){
+        LineVect.push_back(TokenDescriptor(Message.getToken(i),Message.Tokens[i].TypeOfToken));
     }
 
+    std::string Key;
+    if(Cache.isEnabled()) ClassificationCache::makeKey(LineVect,Key);
 
-    std::wistringstream Tokens(line);
-    std::wstring msg;
+    std::vector<MessageToken> LineIds;
+    int64_t MatchId=0;
+    bool Matched=false;
     {
-        std::wstring ActToken;
-        std::wostringstream msgStream;
-        size_t TokenCounter=0;
-        for(std::wstringstream Tokens(line);!Tokens.eof();++TokenCounter){
-            if(TokenCounter<settings.HeaderLen){
-                Tokens >> ActToken;
-                continue;
+        std::shared_lock<std::shared_timed_mutex> readerGuard(TemplateMutex);
+        Matched=Cache.find(Key,MatchId);
+        if(!Matched){
+            getTokenIds(LineVect,LineIds);
+            uint32_t Match=Index.findMatch(LineIds);
+            if(Match!=TemplateIndex::NoMatch){
+                MatchId=Clusters[Match].getId();
+                Matched=true;
+                Cache.insert(Key,Match,MatchId);
             }
-
-            Tokens >> ActToken;
-            msgStream << ActToken << " ";
         }
-        msg=msgStream.str();
-    }
-
-    std::vector<TokenDescriptor> LineVect;
-    std::wregex expr(settings.regexp);
-    std::wsregex_token_iterator TokenIterator(msg.begin(),msg.end(),expr,-1);
-    std::wsregex_token_iterator End;
-    for(;TokenIterator!=End;++TokenIterator){
-        std::wstring ActToken=*TokenIterator;
-
-        wordtype ActType=logParser.parse(ActToken);
-        if(!ActToken.empty()) LineVect.push_back(TokenDescriptor(ActToken,ActType));
     }
-    if(LineVect.empty()) return;
-
-    std::lock_guard<std::mutex> writerGuard(WriteMutex);
-    ClusterTemplate* ClusterAssigned=NULL;
-    double MaxGoodness=0;
-    for(ClusterTemplate& ActTempl:Clusters){
-        if(ActTempl.match(LineVect)){ //exact match, we can assign the id only
-            std::ostringstream query;
-            try{
-                SQLite::Database db(settings.DbFile.c_str(),SQLITE_OPEN_READWRITE);
-                query << "INSERT INTO syslog VALUES(" << ActTempl.getId() << ",\"" << to_utf(msg) << "\")";
-                db.exec(query.str().c_str());
-            }
-            catch(const SQLite::Exception& e){
-                OutputHandler::logException(settings.ErrorStream,"An exception occured in the database. Query: "+query.str()+"\n",e);
-            }
-            return;
-        }
-
-        double ActGoodness=ActTempl.getGoodness(LineVect);
-        if(ActGoodness>MaxGoodness){
-            ClusterAssigned=&ActTempl;
-            MaxGoodness=ActGoodness;
-        }
+    if(Matched){ //exact match, we can assign the id only (the cluster is already on the write queue)
+        ExactMatches.add();
+        Writer.push(WriteRecord{MatchId,msg,NoChange,std::string(),0,0,LineVect.size()});
+        return;
     }
 
-    SQLite::Database db(settings.DbFile.c_str(),SQLITE_OPEN_READWRITE);
-    if(MaxGoodness>=settings.lim && ClusterAssigned!=NULL){
-        ClusterAssigned->join(LineVect,MaxGoodness);
-        try{
-            SQLite::Transaction tr(db);
-            db.exec(ClusterAssigned->getUpdateStr().c_str()); //update clusters
-            std::ostringstream query;
-            query << "INSERT INTO syslog VALUES(" << ClusterAssigned->getId() << ",\"" << to_utf(msg) << "\")";
-            db.exec(query.str().c_str());
-            tr.commit();
-        }
-        catch(const SQLite::Exception& e){
-            OutputHandler::logException(settings.ErrorStream,"An error occured in the database: ",e);
+    WriteRecord Record;
+    uint64_t Ticket;
+    {
+        std::lock_guard<std::shared_timed_mutex> writerGuard(TemplateMutex);
+        getTokenIds(LineVect,LineIds);
+        uint32_t Match=Index.findMatch(LineIds);
+        double MaxGoodness=0;
+        uint32_t Best=TemplateIndex::NoMatch;
+        if(Match!=TemplateIndex::NoMatch){
+            Cache.insert(Key,Match,Clusters[Match].getId());
+            ExactMatches.add();
+            Record=WriteRecord{Clusters[Match].getId(),msg,NoChange,std::string(),0,0,LineVect.size()};
         }
-    }
-    else{
-        ClusterTemplate ActTempl(LineVect,1,LineVect.size(),0);
-        try{
-            SQLite::Transaction tr(db);
-            db.exec(ActTempl.getValueStr().c_str()); //insert to clusters
-            sqlite3_int64 Id=db.getLastInsertRowid();
-            std::ostringstream query;
-            query << "INSERT INTO syslog VALUES(" << Id << ",\"" << to_utf(msg) << "\")";
-            db.exec(query.str().c_str());
-            ActTempl.setId(Id);
-            tr.commit();
-            Clusters.push_back(ActTempl);
+        else if((Best=Index.findBest(LineIds,Clusters,MaxGoodness))!=TemplateIndex::NoMatch && MaxGoodness>=settings.lim){
+            ClusterTemplate& ClusterAssigned=Clusters[Best];
+            Index.remove(Best,ClusterAssigned);
+            ClusterAssigned.join(LineIds,MaxGoodness,Tokens);
+            Index.insert(Best,ClusterAssigned);
+            Cache.invalidate(Best);
+            FuzzyMatches.add();
+            Record=WriteRecord{ClusterAssigned.getId(),msg,UpdatedCluster,ClusterAssigned.getTemplateStr(Tokens),
+                ClusterAssigned.getGoodness(),ClusterAssigned.getAvgLen(),LineVect.size()};
         }
-        catch(const SQLite::Exception& e){
-            OutputHandler::logException(settings.ErrorStream,"An error occured in the database: ",e);
+        else{
+            std::vector<uint32_t> Template;
+            for(const TokenDescriptor& ActToken:LineVect) Template.push_back(Tokens.intern(ActToken.TokenString,ActToken.TypeOfToken));
+            Clusters.push_back(ClusterTemplate(Template,1,LineVect.size(),NextId++));
+            const ClusterTemplate& ActTempl=Clusters.back();
+            Index.insert(Clusters.size()-1,ActTempl);
+            TemplateCount=Clusters.size();
+            NewClusters.add();
+            Record=WriteRecord{ActTempl.getId(),msg,NewCluster,ActTempl.getTemplateStr(Tokens),ActTempl.getGoodness(),ActTempl.getAvgLen(),LineVect.size()};
         }
+        Ticket=Writer.reserve();
     }
+    Writer.push(std::move(Record),Ticket); //outside the lock, a full queue doesn't stop the classification
 }
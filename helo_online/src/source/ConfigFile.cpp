@@ -1,6 +1,7 @@
 #include <pugixml.hpp>
 #include <stdexcept>
 #include "ConfigFile.h"
+#include "Utf8.h"
 
 const wchar_t* ConfigFile::onlineTag=L"online";
 const wchar_t* ConfigFile::mergeTag=L"MergeLimit";
@@ -8,8 +9,33 @@ const wchar_t* ConfigFile::headerTag=L"HeaderLen";
 const wchar_t* ConfigFile::locTag=L"UsedLocal";
 const wchar_t* ConfigFile::portTag=L"Port";
 const wchar_t* ConfigFile::dbPathTag=L"DBPath";
+const wchar_t* ConfigFile::modelPathTag=L"ModelPath";
 const wchar_t* ConfigFile::logPathTag=L"LogPath";
 const wchar_t* ConfigFile::regexpTag=L"RegExp";
+const wchar_t* ConfigFile::threadsTag=L"Threads";
+const wchar_t* ConfigFile::udpPortTag=L"UdpPort";
+const wchar_t* ConfigFile::writeBatchTag=L"WriteBatchSize";
+const wchar_t* ConfigFile::writeLatencyTag=L"WriteLatency";
+const wchar_t* ConfigFile::cacheSizeTag=L"CacheSize";
+const wchar_t* ConfigFile::ingestQueueSizeTag=L"IngestQueueSize";
+const wchar_t* ConfigFile::overloadPolicyTag=L"OverloadPolicy";
+const wchar_t* ConfigFile::spillPathTag=L"SpillPath";
+const wchar_t* ConfigFile::metricsPortTag=L"MetricsPort";
+
+/**
+* Converts the name of an overload policy
+*
+* @param[in] Name The name of the policy: "block", "drop" or "spill"
+* @param[out] Policy The policy of the name
+* @return false if the name is unknown
+*/
+bool toOverloadPolicy(const std::string& Name,OverloadPolicy& Policy){
+	if(Name=="block") Policy=BlockSender;
+	else if(Name=="drop") Policy=DropNewest;
+	else if(Name=="spill") Policy=SpillToFile;
+	else return false;
+	return true;
+}
 
 /**
 * Constructor. It reads "settings.xml" (only this path can be used as config file).
@@ -38,10 +64,26 @@ ConfigFile::ConfigFile(){
 	std::wstring wPath=OnlineNode.child(dbPathTag).attribute(L"value").value();
 	settings.DbFile=std::string(wPath.begin(),wPath.end());
 	if(settings.DbFile.empty()) throw std::runtime_error("Invalid config file! The database file's path is not set.\n");
+	std::wstring wModel=OnlineNode.child(modelPathTag).attribute(L"value").value();
+	settings.ModelFile=std::string(wModel.begin(),wModel.end());
 	std::wstring wLog=OnlineNode.child(logPathTag).attribute(L"value").value();
 	LogPath=std::string(wLog.begin(),wLog.end());
-	settings.regexp=OnlineNode.child(regexpTag).attribute(L"value").value();
-	if(settings.regexp.empty()) settings.regexp=L"[\\s]+";
+	settings.regexp=toUtf8(OnlineNode.child(regexpTag).attribute(L"value").value());
+	if(settings.regexp.empty()) settings.regexp="[\\s]+";
+	settings.threads=OnlineNode.child(threadsTag).attribute(L"value").as_uint();
+	settings.udpPort=OnlineNode.child(udpPortTag).attribute(L"value").as_int(-1);
+	settings.writeBatch=OnlineNode.child(writeBatchTag).attribute(L"value").as_uint(1000);
+	settings.writeLatency=OnlineNode.child(writeLatencyTag).attribute(L"value").as_uint(100);
+	settings.cacheSize=OnlineNode.child(cacheSizeTag).attribute(L"value").as_uint(65536);
+	settings.ingestQueueSize=OnlineNode.child(ingestQueueSizeTag).attribute(L"value").as_uint(65536);
+	if(settings.ingestQueueSize==0) throw std::runtime_error("Invalid config file! The size of the ingest queue must be positive.\n");
+	std::string Policy=toUtf8(OnlineNode.child(overloadPolicyTag).attribute(L"value").value());
+	if(!Policy.empty() && !toOverloadPolicy(Policy,settings.overload)){
+		throw std::runtime_error("Invalid config file! The overload policy must be block, drop or spill.\n");
+	}
+	std::wstring wSpill=OnlineNode.child(spillPathTag).attribute(L"value").value();
+	settings.SpillFile=std::string(wSpill.begin(),wSpill.end());
+	settings.metricsPort=OnlineNode.child(metricsPortTag).attribute(L"value").as_uint();
 }
 
 /**
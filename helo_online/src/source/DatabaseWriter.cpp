@@ -0,0 +1,337 @@
+#include <chrono>
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+#include <thread>
+#include "DatabaseWriter.h"
+#include "OutputHandler.h"
+
+/**
+* Creates the cluster_stats table if the database doesn't have it yet (it is used before the statements are prepared)
+*
+* @param[in,out] db The opened database
+* @return The database
+*/
+static SQLite::Database& createStatsTable(SQLite::Database& db){
+    db.exec("CREATE TABLE IF NOT EXISTS cluster_stats (clustid INTEGER PRIMARY KEY,LineCount INTEGER NOT NULL,TotalLen INTEGER NOT NULL,"
+        "FOREIGN KEY(clustid) REFERENCES clusters(clustid))");
+    return db;
+}
+
+/**
+* Creates the cluster_changes table and its triggers if the database doesn't have them yet. Every inserted or
+* updated cluster gets a new sequence number in the table, thus the clusters changed since a model was made
+* can be read without reading the whole clusters table (see ClusterParser::loadDatabase()).
+*
+* @param[in,out] db The opened database
+*/
+static void createChangeLog(SQLite::Database& db){
+    db.exec("CREATE TABLE IF NOT EXISTS cluster_changes (seq INTEGER PRIMARY KEY AUTOINCREMENT,clustid INTEGER UNIQUE NOT NULL)");
+    db.exec("CREATE TRIGGER IF NOT EXISTS clusters_inserted AFTER INSERT ON clusters BEGIN "
+        "DELETE FROM cluster_changes WHERE clustid=NEW.clustid; INSERT INTO cluster_changes(clustid) VALUES(NEW.clustid); END");
+    db.exec("CREATE TRIGGER IF NOT EXISTS clusters_updated AFTER UPDATE ON clusters BEGIN "
+        "DELETE FROM cluster_changes WHERE clustid=NEW.clustid; INSERT INTO cluster_changes(clustid) VALUES(NEW.clustid); END");
+}
+
+/**
+* Constructor. It opens the database in WAL mode, prepares the statements and starts the writer thread.
+* The statements wait WRITE_BUSY_TIMEOUT milliseconds for the lock of the database.
+*
+* @param[in] DbFile The path of the database
+* @param[in] batchSize The number of records written in one transaction at most (at least 1 is used)
+* @param[in] maxLatency The time in milliseconds a record waits at most before its batch is written
+* @param[in] errorStream The stream to log the errors to
+* @throws SQLite::Exception if the database can't be opened or it has no proper tables
+*/
+DatabaseWriter::DatabaseWriter(const std::string& DbFile,size_t batchSize,unsigned int maxLatency,std::ostream* errorStream):
+    ErrorStream(errorStream),BatchSize(batchSize>0 ? batchSize : 1),MaxLatency(maxLatency),
+    Db(DbFile.c_str(),SQLITE_OPEN_READWRITE),
+    InsertMessage(Db,"INSERT INTO syslog VALUES(?,?)"),
+    InsertCluster(Db,"INSERT OR REPLACE INTO clusters VALUES(?,?,?,?)"),
+    UpdateCluster(Db,"UPDATE clusters SET goodness=?,AvgLen=?,template=? WHERE clustid=?"),
+    InitStats(createStatsTable(Db),"INSERT OR IGNORE INTO cluster_stats VALUES(?,0,0)"),
+    AddStats(Db,"UPDATE cluster_stats SET LineCount=LineCount+?,TotalLen=TotalLen+? WHERE clustid=?"),
+    NextTicket(0),Served(0),Stopping(false),MaxDepth(0),Written(0),Failed(0),Batches(0){
+    Db.setBusyTimeout(WRITE_BUSY_TIMEOUT);
+    Db.exec("PRAGMA journal_mode=WAL");
+    Db.exec("PRAGMA synchronous=NORMAL");
+    createChangeLog(Db);
+    Writer=std::thread(&DatabaseWriter::run,this);
+}
+
+/**
+* Destructor, it writes the queued records (see stop())
+*/
+DatabaseWriter::~DatabaseWriter(){
+    stop();
+}
+
+/**
+* Puts a record on the queue. If the queue is full, it waits until the writer makes room.
+* After stop() is called the record is rejected (the writer thread may have exited already),
+* and it is counted as failed.
+*
+* @param[in] Record The record to write
+* @return true if the record is queued, false if it is rejected
+*/
+bool DatabaseWriter::push(WriteRecord&& Record){
+    std::unique_lock<std::mutex> lock(QueueMutex);
+    return enqueue(lock,std::move(Record));
+}
+
+/**
+* Puts a record on the queue after the records of the earlier tickets (see push(WriteRecord&&)).
+*
+* @param[in] Record The record to write
+* @param[in] Ticket The ticket of the record returned by reserve()
+* @return true if the record is queued, false if it is rejected
+*/
+bool DatabaseWriter::push(WriteRecord&& Record,uint64_t Ticket){
+    std::unique_lock<std::mutex> lock(QueueMutex);
+    Turn.wait(lock,[this,Ticket](){return Served==Ticket;});
+    bool Queued=enqueue(lock,std::move(Record));
+    ++Served;
+    Turn.notify_all();
+    return Queued;
+}
+
+/**
+* Puts a record on the queue, it waits until the queue has room, or the writer is stopped
+*
+* @param[in] lock The lock of the queue (it is held)
+* @param[in] Record The record to write
+* @return true if the record is queued, false if it is rejected
+*/
+bool DatabaseWriter::enqueue(std::unique_lock<std::mutex>& lock,WriteRecord&& Record){
+    NotFull.wait(lock,[this](){return Queue.size()<WRITE_QUEUE_CAPACITY || Stopping;});
+    if(Stopping){
+        ++Failed;
+        return false;
+    }
+    Record.Queued=std::chrono::steady_clock::now();
+    Queue.push_back(std::move(Record));
+    if(Queue.size()>MaxDepth) MaxDepth=Queue.size();
+    if(Queue.size()==1 || Queue.size()>=BatchSize) NotEmpty.notify_one();
+    return true;
+}
+
+/**
+* Stops the writer thread after every queued record is written. It can be called more than once.
+*/
+void DatabaseWriter::stop(){
+    {
+        std::lock_guard<std::mutex> lock(QueueMutex);
+        Stopping=true;
+    }
+    NotEmpty.notify_one();
+    NotFull.notify_all();
+    if(Writer.joinable()) Writer.join();
+}
+
+/**
+* The function of the writer thread. It waits for a full batch (or until the oldest record
+* has waited MaxLatency milliseconds since it was queued), then writes the batch without holding the queue.
+*/
+void DatabaseWriter::run(){
+    std::vector<WriteRecord> Batch;
+    Batch.reserve(BatchSize);
+    std::unique_lock<std::mutex> lock(QueueMutex);
+    while(true){
+        NotEmpty.wait(lock,[this](){return !Queue.empty() || Stopping;});
+        if(Queue.empty()) break; //stopping and everything is written
+
+        std::chrono::steady_clock::time_point Deadline=Queue.front().Queued+std::chrono::milliseconds(MaxLatency);
+        NotEmpty.wait_until(lock,Deadline,[this](){return Queue.size()>=BatchSize || Stopping;});
+
+        size_t Count=std::min(BatchSize,Queue.size());
+        for(size_t i=0;i<Count;++i){
+            Batch.push_back(std::move(Queue.front()));
+            Queue.pop_front();
+        }
+        NotFull.notify_all();
+
+        lock.unlock();
+        writeBatch(Batch);
+        Batch.clear();
+        lock.lock();
+    }
+}
+
+/**
+* Writes a batch of records in one transaction. If the database is locked, the batch is tried again
+* after a growing delay. If a record is rejected, the batch is written again record by record, and only the
+* rejected records are dropped.
+*
+* @param[in] Batch The records to write
+*/
+void DatabaseWriter::writeBatch(std::vector<WriteRecord>& Batch){
+    std::chrono::steady_clock::time_point Begin=std::chrono::steady_clock::now();
+    bool PerRecord=false;
+    for(unsigned int Attempt=1;;){
+        uint64_t Rejected=0;
+        std::string Error;
+        int Result=writeRecords(Batch,PerRecord,Rejected,Error);
+        if(Result==SQLITE_OK){
+            CommitLatency.observe(std::chrono::steady_clock::now()-Begin);
+            Written+=Batch.size()-Rejected;
+            Failed+=Rejected;
+            ++Batches;
+            return;
+        }
+
+        bool Locked=(Result==SQLITE_BUSY || Result==SQLITE_LOCKED);
+        if(Locked && Attempt<WRITE_RETRY_COUNT){
+            std::this_thread::sleep_for(std::chrono::milliseconds(WRITE_RETRY_DELAY*Attempt));
+            ++Attempt;
+            continue;
+        }
+        if(!Locked && !PerRecord){
+            PerRecord=true;
+            continue;
+        }
+
+        Failed+=Batch.size();
+        std::ostringstream str;
+        str << "An error occured in the database, " << Batch.size() << " messages are lost: " << Error << "\n";
+        OutputHandler::print(ErrorStream,str.str());
+        return;
+    }
+}
+
+/**
+* Writes the records in one transaction, and adds their lengths to the line statistics of their clusters
+*
+* @param[in] Batch The records to write
+* @param[in] PerRecord If it is true, each record is written in a savepoint, and a rejected record is logged and skipped
+* @param[out] Rejected The number of skipped records
+* @param[out] Error The message of the error if the transaction failed
+* @return SQLITE_OK if the transaction is committed, the error code of the database otherwise (the transaction is rolled back)
+*/
+int DatabaseWriter::writeRecords(const std::vector<WriteRecord>& Batch,bool PerRecord,uint64_t& Rejected,std::string& Error){
+    int Result=SQLITE_ERROR;
+    bool Committed=false;
+    try{
+        SQLite::Transaction tr(Db);
+        try{
+            std::unordered_map<sqlite3_int64,std::pair<sqlite3_int64,sqlite3_int64> > Stats;
+            for(const WriteRecord& ActRecord:Batch){
+                if(!PerRecord) writeRecord(ActRecord);
+                else{
+                    Db.exec("SAVEPOINT record");
+                    try{
+                        writeRecord(ActRecord);
+                        Db.exec("RELEASE record");
+                    }
+                    catch(const SQLite::Exception& e){
+                        resetStatements();
+                        Db.exec("ROLLBACK TO record");
+                        Db.exec("RELEASE record");
+                        ++Rejected;
+                        OutputHandler::logException(ErrorStream,"An error occured in the database, a message of the cluster "+
+                            std::to_string(ActRecord.ClusterId)+" is lost: ",e);
+                        continue;
+                    }
+                }
+
+                std::pair<sqlite3_int64,sqlite3_int64>& ActStats=Stats[ActRecord.ClusterId];
+                ActStats.first++;
+                ActStats.second+=ActRecord.Length;
+            }
+            for(const auto& ActStats:Stats){
+                InitStats.reset();
+                InitStats.bind(1,ActStats.first);
+                InitStats.exec();
+                AddStats.reset();
+                AddStats.bind(1,ActStats.second.first);
+                AddStats.bind(2,ActStats.second.second);
+                AddStats.bind(3,ActStats.first);
+                AddStats.exec();
+            }
+            tr.commit();
+            Committed=true;
+        }
+        catch(const SQLite::Exception& e){
+            Result=sqlite3_errcode(Db.getHandle()) & 0xff; //before the rollback of the transaction overwrites it
+            Error=e.what();
+        }
+    }
+    catch(const SQLite::Exception& e){
+        Result=sqlite3_errcode(Db.getHandle()) & 0xff;
+        if(Error.empty()) Error=e.what();
+    }
+    if(Committed) return SQLITE_OK;
+
+    resetStatements();
+    Rejected=0;
+    return Result!=SQLITE_OK ? Result : SQLITE_ERROR;
+}
+
+/**
+* Writes a record: the change of its cluster, and the message
+*
+* @param[in] ActRecord The record to write
+* @throws SQLite::Exception if the database rejected the record
+*/
+void DatabaseWriter::writeRecord(const WriteRecord& ActRecord){
+    bool Insert=(ActRecord.Change==NewCluster);
+    if(ActRecord.Change==UpdatedCluster){
+        UpdateCluster.reset();
+        UpdateCluster.bind(1,ActRecord.Goodness);
+        UpdateCluster.bind(2,ActRecord.AvgLen);
+        UpdateCluster.bind(3,ActRecord.Template);
+        UpdateCluster.bind(4,ActRecord.ClusterId);
+        Insert=(UpdateCluster.exec()==0); //the cluster is missing, e.g. its insert was lost
+    }
+    if(Insert){
+        InsertCluster.reset();
+        InsertCluster.bind(1,ActRecord.ClusterId);
+        InsertCluster.bind(2,ActRecord.Template);
+        InsertCluster.bind(3,ActRecord.Goodness);
+        InsertCluster.bind(4,ActRecord.AvgLen);
+        InsertCluster.exec();
+    }
+    InsertMessage.reset();
+    InsertMessage.bind(1,ActRecord.ClusterId);
+    InsertMessage.bind(2,ActRecord.Message);
+    InsertMessage.exec();
+}
+
+/**
+* Resets the statements after a failed step. SQLite reports the error of the last step again on the next
+* reset, thus it is swallowed here, so that the next batch doesn't fail on it.
+*/
+void DatabaseWriter::resetStatements(){
+    SQLite::Statement* Statements[]={&InsertMessage,&InsertCluster,&UpdateCluster,&InitStats,&AddStats};
+    for(SQLite::Statement* ActStatement:Statements){
+        try{
+            ActStatement->reset();
+        }
+        catch(const SQLite::Exception&){}
+    }
+}
+
+/**
+* @return The number of records waiting on the queue
+*/
+size_t DatabaseWriter::getQueueDepth(){
+    std::lock_guard<std::mutex> lock(QueueMutex);
+    return Queue.size();
+}
+
+/**
+* @return The highest number of records that waited on the queue at the same time
+*/
+size_t DatabaseWriter::getMaxQueueDepth(){
+    std::lock_guard<std::mutex> lock(QueueMutex);
+    return MaxDepth;
+}
+
+/**
+* @return The counters of the writer in a human-readable form
+*/
+std::string DatabaseWriter::getStatistics(){
+    std::ostringstream str;
+    str << "Database writes: " << getWritten() << " messages in " << getBatches() << " batches, failed: " << getFailed()
+        << ", queue depth: " << getQueueDepth() << " (max: " << getMaxQueueDepth() << ")\n";
+    return str.str();
+}
@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include "IngestQueue.h"
+#include "OutputHandler.h"
+
+/**
+* Constructor. It starts the classifier threads.
+*
+* @param[in] parser The ClusterParser object that classifies the messages
+* @param[in] capacity The maximal number of messages on the queue (at least 1 is used)
+* @param[in] policy What happens to a message when the queue is full
+* @param[in] spillPath The path of the spill file (it is only opened when the first message is spilled)
+* @param[in] classifiers The number of classifier threads (at least 1 is used)
+* @param[in] errorStream The stream to log the errors to
+*/
+IngestQueue::IngestQueue(std::shared_ptr<ClusterParser> parser,size_t capacity,OverloadPolicy policy,const std::string& spillPath,
+    unsigned int classifiers,std::ostream* errorStream):
+    Parser(parser),ErrorStream(errorStream),Capacity(capacity>0 ? capacity : 1),Policy(policy),SpillPath(spillPath),
+    SpillBackoff(SPILL_RETRY_MIN),SpillPartial(false),Stopping(false),MaxDepth(0),Queued(0),Blocked(0),Dropped(0),Spilled(0),SpillErrors(0),Failed(0){
+    for(unsigned int i=0;i<std::max(1u,classifiers);++i){
+        Classifiers.push_back(std::thread(&IngestQueue::run,this));
+    }
+}
+
+/**
+* Destructor, it classifies the queued messages (see stop())
+*/
+IngestQueue::~IngestQueue(){
+    stop();
+}
+
+/**
+* Puts a received message on the queue, it never waits. If the queue is full, the overload policy decides what
+* happens, the message is dropped under BlockSender (it is used for the UDP datagrams, which can't be pushed back).
+*
+* @param[in] Line The message
+* @param[in] Transport The transport that received the message
+* @return What happened to the message
+*/
+IngestOutcome IngestQueue::push(std::string&& Line,MessageTransport Transport){
+    return tryPush(std::move(Line),Transport,std::function<void()>());
+}
+
+/**
+* Puts a received message on the queue, it never waits. If the queue is full, the overload policy decides what
+* happens. Under BlockSender the message is deferred: it is parked, and when the queue is drained to the half of
+* its capacity, it is queued and Resume is called (once, from a classifier thread), the caller should not push
+* more messages until then. On stop() the parked message is queued, and Resume is not called.
+*
+* @param[in] Line The message, it is moved from
+* @param[in] Transport The transport that received the message
+* @param[in] Resume The function to call when the deferred message is queued (if it is empty, the message is dropped instead)
+* @return What happened to the message
+*/
+IngestOutcome IngestQueue::tryPush(std::string&& Line,MessageTransport Transport,std::function<void()> Resume){
+    {
+        std::unique_lock<std::mutex> lock(QueueMutex);
+        if(Queue.size()>=Capacity && !Stopping){
+            if(Policy==BlockSender && Resume){
+                ++Blocked;
+                Waiters.push_back(Waiter{Entry{std::move(Line),Transport},std::move(Resume)});
+                return MessageDeferred;
+            }
+            lock.unlock();
+            if(Policy==SpillToFile && spill(Line)) return MessageSpilled;
+            ++Dropped;
+            return MessageDropped;
+        }
+        Queue.push_back(Entry{std::move(Line),Transport});
+        if(Queue.size()>MaxDepth) MaxDepth=Queue.size();
+    }
+    ++Queued;
+    NotEmpty.notify_one();
+    return MessageQueued;
+}
+
+/**
+* Queues the parked messages of the deferred senders. The lock of the queue must be held.
+*
+* @param[out] Resumed The deferred senders are moved here, their functions are to be called without the lock
+* @return The number of queued messages
+*/
+size_t IngestQueue::queueWaiters(std::vector<Waiter>& Resumed){
+    Resumed.swap(Waiters);
+    for(Waiter& ActWaiter:Resumed) Queue.push_back(std::move(ActWaiter.Parked));
+    if(Queue.size()>MaxDepth) MaxDepth=Queue.size();
+    Queued+=Resumed.size();
+    return Resumed.size();
+}
+
+/**
+* Writes a message to the spill file as one line: the backslashes and the line breaks are escaped
+*
+* @param[in,out] File The spill file
+* @param[in] Line The message
+*/
+static void writeEscaped(std::ofstream& File,const std::string& Line){
+    size_t Begin=0,Pos;
+    while((Pos=Line.find_first_of("\\\n\r",Begin))!=std::string::npos){
+        File.write(Line.data()+Begin,Pos-Begin);
+        File.put('\\');
+        File.put(Line[Pos]=='\n' ? 'n' : Line[Pos]=='\r' ? 'r' : '\\');
+        Begin=Pos+1;
+    }
+    File.write(Line.data()+Begin,Line.size()-Begin);
+    File.put('\n');
+}
+
+/**
+* Appends a message to the spill file. After a failure the file isn't tried again until the backoff expires.
+*
+* @param[in] Line The message
+* @return true if the message is written
+*/
+bool IngestQueue::spill(const std::string& Line){
+    std::lock_guard<std::mutex> lock(SpillMutex);
+    if(!SpillFile.is_open()){
+        if(std::chrono::steady_clock::now()<SpillRetry) return false;
+        SpillFile.clear();
+        SpillFile.open(SpillPath,std::ios::out | std::ios::app | std::ios::binary);
+        if(SpillFile.fail()){
+            spillFailed("opened");
+            return false;
+        }
+        if(SpillPartial) SpillFile.put('\n'); //the last line may have been written partly
+        SpillPartial=false;
+    }
+    writeEscaped(SpillFile,Line);
+    if(SpillFile.fail()){
+        SpillPartial=true;
+        spillFailed("written");
+        return false;
+    }
+    SpillBackoff=SPILL_RETRY_MIN;
+    ++Spilled;
+    return true;
+}
+
+/**
+* Handles a failure of the spill file: it is closed, and it isn't tried again until the backoff expires.
+* The failure is logged and counted. The lock of the spill file must be held.
+*
+* @param[in] What What couldn't be done with the file ("opened" or "written")
+*/
+void IngestQueue::spillFailed(const char* What){
+    ++SpillErrors;
+    SpillFile.close();
+    SpillRetry=std::chrono::steady_clock::now()+std::chrono::milliseconds(SpillBackoff);
+    OutputHandler::print(ErrorStream,"The spill file "+SpillPath+" couldn't be "+What+", the overflowing messages are dropped for "+
+        std::to_string(SpillBackoff)+" ms\n");
+    SpillBackoff=std::min(SpillBackoff*2,(unsigned int)SPILL_RETRY_MAX);
+}
+
+/**
+* Stops the classifier threads after every queued message is classified, and closes the spill file.
+* It can be called more than once.
+*/
+void IngestQueue::stop(){
+    std::vector<Waiter> Parked;
+    {
+        std::lock_guard<std::mutex> lock(QueueMutex);
+        Stopping=true;
+        queueWaiters(Parked); //the senders are not resumed, the server may be stopped already
+    }
+    NotEmpty.notify_all();
+    Parked.clear();
+    for(std::thread& ActClassifier:Classifiers){
+        if(ActClassifier.joinable()) ActClassifier.join();
+    }
+
+    std::lock_guard<std::mutex> lock(SpillMutex);
+    if(SpillFile.is_open()) SpillFile.close();
+}
+
+/**
+* The function of the classifier threads. They take the messages in small batches,
+* and classify them without holding the queue. The deferred senders are resumed when the queue is drained
+* to the half of its capacity.
+*/
+void IngestQueue::run(){
+    std::vector<Entry> Batch;
+    Batch.reserve(INGEST_BATCH_SIZE);
+    std::vector<Waiter> Resumed;
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(QueueMutex);
+            NotEmpty.wait(lock,[this](){return !Queue.empty() || Stopping;});
+            if(Queue.empty()) break; //stopping and everything is classified
+
+            size_t Count=std::min<size_t>(INGEST_BATCH_SIZE,Queue.size());
+            for(size_t i=0;i<Count;++i){
+                Batch.push_back(std::move(Queue.front()));
+                Queue.pop_front();
+            }
+            if(!Waiters.empty() && Queue.size()<=Capacity/2 && queueWaiters(Resumed)>0) NotEmpty.notify_all();
+        }
+        for(Waiter& ActWaiter:Resumed) ActWaiter.Resume(); //their messages were queued under the lock
+        Resumed.clear();
+
+        for(Entry& ActEntry:Batch){
+            try{
+                std::chrono::steady_clock::time_point Begin=std::chrono::steady_clock::now();
+                Parser->ProcessMessage(ActEntry.Line);
+                ClassificationLatency.observe(std::chrono::steady_clock::now()-Begin);
+                Processed[ActEntry.Transport].add();
+            }
+            catch(const std::exception& e){
+                ++Failed;
+                OutputHandler::logException(ErrorStream,"An error occurred during processing a message: ",e);
+            }
+        }
+        Batch.clear();
+    }
+}
+
+/**
+* @return The number of messages waiting on the queue
+*/
+size_t IngestQueue::getQueueDepth(){
+    std::lock_guard<std::mutex> lock(QueueMutex);
+    return Queue.size();
+}
+
+/**
+* @return The highest number of messages that waited on the queue at the same time
+*/
+size_t IngestQueue::getMaxQueueDepth(){
+    std::lock_guard<std::mutex> lock(QueueMutex);
+    return MaxDepth;
+}
+
+/**
+* @return The counters of the queue in a human-readable form
+*/
+std::string IngestQueue::getStatistics(){
+    std::ostringstream str;
+    str << "Ingest queue: " << getQueued() << " messages queued, processed: " << getProcessed() << ", failed: " << getFailed()
+        << ", blocked: " << getBlocked() << ", dropped: " << getDropped() << ", spilled: " << getSpilled()
+        << " (spill errors: " << getSpillErrors() << "), queue depth: " << getQueueDepth() << " (max: " << getMaxQueueDepth() << ")\n";
+    return str.str();
+}
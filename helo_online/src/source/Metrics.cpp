@@ -0,0 +1,43 @@
+#include <algorithm>
+#include "Metrics.h"
+
+const double LatencyHistogram::Bounds[LATENCY_BUCKETS]={0.00005,0.0001,0.00025,0.0005,0.001,0.0025,0.005,0.01,
+    0.025,0.05,0.1,0.25,0.5,1,2.5,10};
+
+/**
+* Constructor, the counter starts from zero
+*/
+ShardedCounter::ShardedCounter(){
+    for(Cell& ActCell:Cells) ActCell.Value.store(0,std::memory_order_relaxed);
+}
+
+/**
+* @return The shard of the calling thread (the threads get the shards in turn, when they first use a counter)
+*/
+size_t ShardedCounter::getShard(){
+    static std::atomic<size_t> NextShard(0);
+    static thread_local size_t Shard=NextShard.fetch_add(1,std::memory_order_relaxed)%METRICS_SHARDS;
+    return Shard;
+}
+
+/**
+* @return The value of the counter (the sum of its cells)
+*/
+uint64_t ShardedCounter::get() const{
+    uint64_t Sum=0;
+    for(const Cell& ActCell:Cells) Sum+=ActCell.Value.load(std::memory_order_relaxed);
+    return Sum;
+}
+
+/**
+* Counts a duration in its bucket
+*
+* @param[in] Duration The duration
+*/
+void LatencyHistogram::observe(std::chrono::steady_clock::duration Duration){
+    int64_t Nanoseconds=std::chrono::duration_cast<std::chrono::nanoseconds>(Duration).count();
+    if(Nanoseconds<0) Nanoseconds=0;
+    size_t Bucket=std::lower_bound(Bounds,Bounds+LATENCY_BUCKETS,Nanoseconds/1e9)-Bounds;
+    Buckets[Bucket].add();
+    SumNanoseconds.add(Nanoseconds);
+}
@@ -0,0 +1,191 @@
+#include <sstream>
+#include "MetricsServer.h"
+#include "OutputHandler.h"
+
+using boost::asio::ip::tcp;
+
+/**
+ * Writes the header of a metric family
+ *
+ * @param[in,out] str The stream to write to
+ * @param[in] Name The name of the metric
+ * @param[in] Type The Prometheus type of the metric (counter, gauge or histogram)
+ * @param[in] Help The description of the metric
+ */
+static void writeFamily(std::ostream& str,const char* Name,const char* Type,const char* Help){
+    str << "# HELP " << Name << " " << Help << "\n# TYPE " << Name << " " << Type << "\n";
+}
+
+/**
+ * Writes a histogram of durations, its buckets are cumulative in the Prometheus format
+ *
+ * @param[in,out] str The stream to write to
+ * @param[in] Name The name of the metric
+ * @param[in] Help The description of the metric
+ * @param[in] Histogram The histogram
+ */
+static void writeHistogram(std::ostream& str,const char* Name,const char* Help,const LatencyHistogram& Histogram){
+    writeFamily(str,Name,"histogram",Help);
+    uint64_t Count=0;
+    for(size_t i=0;i<LATENCY_BUCKETS;++i){
+        Count+=Histogram.getBucket(i);
+        str << Name << "_bucket{le=\"" << LatencyHistogram::Bounds[i] << "\"} " << Count << "\n";
+    }
+    Count+=Histogram.getBucket(LATENCY_BUCKETS);
+    str << Name << "_bucket{le=\"+Inf\"} " << Count << "\n";
+    str << Name << "_sum " << Histogram.getSum() << "\n";
+    str << Name << "_count " << Count << "\n";
+}
+
+/**
+ * Constructor, it starts listening on the given port of the loopback interface
+ *
+ * @param[in] port The TCP port of the endpoint
+ * @param[in] parser The ClusterParser object that classifies the messages
+ * @param[in] queue The queue of the received messages
+ * @param[in] server The TCP server (the endpoint runs on its io_service)
+ * @param[in] udp The UDP listener (it is NULL if the UDP input is disabled)
+ * @param[in] errorStream The stream to log the errors to
+ * @throws boost::system::system_error if the port can't be used
+ */
+MetricsServer::MetricsServer(unsigned short port,std::shared_ptr<ClusterParser> parser,std::shared_ptr<IngestQueue> queue,
+    AsyncServer& server,std::shared_ptr<UdpListener> udp,std::ostream* errorStream):
+    Acceptor(server.getService()),Parser(parser),Queue(queue),Server(server),Udp(udp),ErrorStream(errorStream){
+    tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(),port);
+    Acceptor.open(endpoint.protocol());
+    Acceptor.set_option(tcp::acceptor::reuse_address(true));
+    Acceptor.bind(endpoint);
+    Acceptor.listen();
+}
+
+/**
+ * Starts accepting the requests
+ */
+void MetricsServer::start(){
+    accept();
+}
+
+/**
+ * Accepts the next connection, and reads its request. A failed accept is logged, and the endpoint goes on accepting.
+ * The handlers of a connection run in its strand, thus the timeout can't close the socket while it is used.
+ */
+void MetricsServer::accept(){
+    std::shared_ptr<MetricsServer> self=shared_from_this();
+    std::shared_ptr<Request> Act=std::make_shared<Request>(Server.getService());
+    Acceptor.async_accept(Act->Socket,[self,Act](const boost::system::error_code& error){
+        if(error==boost::asio::error::operation_aborted) return;
+        if(error){
+            OutputHandler::logException(self->ErrorStream,"An error occurred during accepting a metrics request: ",boost::system::system_error(error));
+        }
+        else{
+            Act->Timer.expires_from_now(std::chrono::milliseconds(METRICS_REQUEST_TIMEOUT));
+            Act->Timer.async_wait(Act->Strand.wrap([Act](const boost::system::error_code& error){
+                if(error==boost::asio::error::operation_aborted) return;
+                boost::system::error_code ignored;
+                Act->Socket.close(ignored); //the pending read or write is aborted
+            }));
+            boost::asio::async_read_until(Act->Socket,Act->Buffer,"\r\n\r\n",Act->Strand.wrap([self,Act](const boost::system::error_code& error,size_t){
+                if(!error) self->respond(Act);
+                else Act->Timer.cancel();
+            }));
+        }
+        self->accept();
+    });
+}
+
+/**
+ * Answers a request: GET /metrics gets the metrics, everything else gets 404. The connection is closed after the response.
+ *
+ * @param[in] Act The connection and its received request
+ */
+void MetricsServer::respond(std::shared_ptr<Request> Act){
+    std::istream RequestStream(&Act->Buffer);
+    std::string Method,Target;
+    RequestStream >> Method >> Target;
+
+    std::string Status="200 OK",Body;
+    if(Method=="GET" && (Target=="/metrics" || Target.compare(0,9,"/metrics?")==0)) Body=getMetrics();
+    else{
+        Status="404 Not Found";
+        Body="Not found, the metrics are served at /metrics\n";
+    }
+
+    std::ostringstream str;
+    str << "HTTP/1.0 " << Status << "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: " << Body.size()
+        << "\r\nConnection: close\r\n\r\n" << Body;
+    Act->Response=str.str();
+    boost::asio::async_write(Act->Socket,boost::asio::buffer(Act->Response),Act->Strand.wrap([Act](const boost::system::error_code&,size_t){
+        Act->Timer.cancel();
+        boost::system::error_code ignored;
+        Act->Socket.shutdown(tcp::socket::shutdown_both,ignored);
+        Act->Socket.close(ignored);
+    }));
+}
+
+/**
+ * @return The current values of the metrics in the Prometheus text format
+ */
+std::string MetricsServer::getMetrics(){
+    std::ostringstream str;
+
+    writeFamily(str,"helo_messages_received_total","counter","The number of messages received, by transport.");
+    str << "helo_messages_received_total{transport=\"tcp\"} " << Server.getReceived() << "\n";
+    if(Udp) str << "helo_messages_received_total{transport=\"udp\"} " << Udp->getReceived() << "\n";
+
+    writeFamily(str,"helo_messages_processed_total","counter","The number of messages classified, by transport.");
+    str << "helo_messages_processed_total{transport=\"tcp\"} " << Queue->getProcessed(TcpTransport) << "\n";
+    if(Udp) str << "helo_messages_processed_total{transport=\"udp\"} " << Queue->getProcessed(UdpTransport) << "\n";
+
+    writeFamily(str,"helo_messages_failed_total","counter","The number of messages whose classification failed.");
+    str << "helo_messages_failed_total " << Queue->getFailed() << "\n";
+
+    if(Udp){
+        writeFamily(str,"helo_udp_dropped_total","counter","The number of UDP messages dropped by the kernel, truncated or failed to be queued.");
+        str << "helo_udp_dropped_total " << Udp->getDropped() << "\n";
+        writeFamily(str,"helo_udp_truncated_total","counter","The number of UDP messages dropped because they were longer than the receive buffer.");
+        str << "helo_udp_truncated_total " << Udp->getTruncated() << "\n";
+        uint64_t KernelDropped=0;
+        if(Udp->getKernelDropped(KernelDropped)){ //it is unavailable on the systems other than Linux
+            writeFamily(str,"helo_udp_kernel_dropped_total","counter","The number of UDP messages dropped by the kernel, because the receive buffer was full.");
+            str << "helo_udp_kernel_dropped_total " << KernelDropped << "\n";
+        }
+    }
+
+    writeFamily(str,"helo_ingest_overflow_total","counter","The number of messages that found the ingest queue full, by the outcome.");
+    str << "helo_ingest_overflow_total{outcome=\"blocked\"} " << Queue->getBlocked() << "\n";
+    str << "helo_ingest_overflow_total{outcome=\"dropped\"} " << Queue->getDropped() << "\n";
+    str << "helo_ingest_overflow_total{outcome=\"spilled\"} " << Queue->getSpilled() << "\n";
+
+    writeFamily(str,"helo_spill_errors_total","counter","The number of failed attempts to open or write the spill file.");
+    str << "helo_spill_errors_total " << Queue->getSpillErrors() << "\n";
+
+    writeFamily(str,"helo_classifications_total","counter","The number of classified messages, by the outcome.");
+    str << "helo_classifications_total{outcome=\"exact\"} " << Parser->getExactMatches() << "\n";
+    str << "helo_classifications_total{outcome=\"fuzzy\"} " << Parser->getFuzzyMatches() << "\n";
+    str << "helo_classifications_total{outcome=\"new_cluster\"} " << Parser->getNewClusters() << "\n";
+
+    writeFamily(str,"helo_classification_cache_requests_total","counter","The number of lookups in the classification cache, by the result.");
+    str << "helo_classification_cache_requests_total{result=\"hit\"} " << Parser->getCache().getHits() << "\n";
+    str << "helo_classification_cache_requests_total{result=\"miss\"} " << Parser->getCache().getMisses() << "\n";
+
+    writeHistogram(str,"helo_classification_latency_seconds","The time of the classification of a message.",Queue->getClassificationLatency());
+
+    DatabaseWriter& Writer=Parser->getWriter();
+    writeHistogram(str,"helo_db_commit_latency_seconds","The time of writing and committing a batch to the database.",Writer.getCommitLatency());
+
+    writeFamily(str,"helo_db_messages_total","counter","The number of messages given to the database, by the result.");
+    str << "helo_db_messages_total{result=\"written\"} " << Writer.getWritten() << "\n";
+    str << "helo_db_messages_total{result=\"failed\"} " << Writer.getFailed() << "\n";
+
+    writeFamily(str,"helo_queue_depth","gauge","The number of messages waiting, by queue.");
+    str << "helo_queue_depth{queue=\"ingest\"} " << Queue->getQueueDepth() << "\n";
+    str << "helo_queue_depth{queue=\"write\"} " << Writer.getQueueDepth() << "\n";
+
+    writeFamily(str,"helo_templates","gauge","The number of cluster templates.");
+    str << "helo_templates " << Parser->getTemplateCount() << "\n";
+
+    writeFamily(str,"helo_active_connections","gauge","The number of open TCP connections.");
+    str << "helo_active_connections " << Server.getActiveConnections() << "\n";
+
+    return str.str();
+}
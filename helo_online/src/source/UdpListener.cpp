@@ -0,0 +1,235 @@
+#include <cerrno>
+#include <algorithm>
+#include <sstream>
+#include "UdpListener.h"
+#include "OutputHandler.h"
+
+#ifdef __linux__
+#include <linux/sock_diag.h>
+#endif
+
+using boost::asio::ip::udp;
+
+/// The maximal number of batches received at once, then the other handlers of the io_service get their turn (on Linux)
+///
+#define UDP_BATCHES_PER_TURN 16
+
+/**
+ * Constructor, it binds the socket to the given port. The kernel receive buffer is enlarged
+ * (up to the limit of the system), so that bursts don't get dropped.
+ *
+ * @param[in] service The io_service that serves the socket
+ * @param[in] port The UDP port to listen on
+ * @param[in] queue The queue of the received messages
+ * @param[in] errorStream The stream to log the errors to
+ * @throws boost::system::system_error if the port can't be used
+ */
+UdpListener::UdpListener(boost::asio::io_service& service,unsigned short port,std::shared_ptr<IngestQueue> queue,std::ostream* errorStream):
+    Socket(service),Queue(queue),ErrorStream(errorStream),
+#ifdef __linux__
+    Buffers(UDP_BATCH_SIZE*UDP_MESSAGE_SIZE),Vectors(UDP_BATCH_SIZE),Headers(UDP_BATCH_SIZE),Batch(UDP_BATCH_SIZE),
+#else
+    Buffers(UDP_MESSAGE_SIZE+1), //a longer datagram fills the last byte, if it isn't reported by an error
+#endif
+    Received(0),Processed(0),Failed(0),Truncated(0){
+    udp::endpoint logger(udp::v4(),port);
+    Socket.open(logger.protocol());
+    Socket.set_option(udp::socket::reuse_address(true));
+    Socket.set_option(boost::asio::socket_base::receive_buffer_size(UDP_SOCKET_BUFFER_SIZE));
+    Socket.bind(logger);
+#ifdef __linux__
+    Socket.non_blocking(true);
+#endif
+}
+
+/**
+ * Starts waiting for datagrams
+ */
+void UdpListener::start(){
+#ifdef __linux__
+    wait();
+#else
+    receive();
+#endif
+}
+
+/**
+ * Removes the trailing line breaks (and zero bytes) of a message
+ *
+ * @param[in] Begin The first byte of the message
+ * @param[in] Length The length of the message
+ * @return The length of the message without the trailing line breaks
+ */
+static size_t trimLength(const char* Begin,size_t Length){
+    while(Length>0 && (Begin[Length-1]=='\n' || Begin[Length-1]=='\r' || Begin[Length-1]=='\0')) --Length;
+    return Length;
+}
+
+/**
+ * Puts a received message on the IngestQueue, a failure is logged and counted
+ *
+ * @param[in] Message The message, it is moved from
+ */
+void UdpListener::queueMessage(std::string&& Message){
+    try{
+        if(Queue->push(std::move(Message),UdpTransport)==MessageQueued) ++Processed;
+    }
+    catch(const std::exception& e){
+        ++Failed;
+        OutputHandler::logException(ErrorStream,"An error occurred during queueing a UDP message: ",e);
+    }
+}
+
+#ifdef __linux__
+
+/**
+ * Waits asynchronously until the socket becomes readable, the handler keeps the listener alive
+ */
+void UdpListener::wait(){
+    std::shared_ptr<UdpListener> self=shared_from_this();
+    Socket.async_receive(boost::asio::null_buffers(),[self](const boost::system::error_code& error,size_t){
+        self->onReadable(error);
+    });
+}
+
+/**
+ * Receives one batch of datagrams into the buffers, without blocking
+ *
+ * @return The number of datagrams received (0 if the socket is empty)
+ * @throws boost::system::system_error if the receiving failed
+ */
+size_t UdpListener::receiveBatch(){
+    for(size_t i=0;i<UDP_BATCH_SIZE;++i){
+        Vectors[i].iov_base=&Buffers[i*UDP_MESSAGE_SIZE];
+        Vectors[i].iov_len=UDP_MESSAGE_SIZE;
+        Headers[i].msg_hdr=msghdr();
+        Headers[i].msg_hdr.msg_iov=&Vectors[i];
+        Headers[i].msg_hdr.msg_iovlen=1;
+        Headers[i].msg_len=0;
+    }
+
+    int Count=recvmmsg(Socket.native_handle(),Headers.data(),UDP_BATCH_SIZE,MSG_DONTWAIT,NULL);
+    if(Count<0){
+        if(errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR) return 0;
+        throw boost::system::system_error(errno,boost::system::system_category());
+    }
+    Received+=Count;
+    return Count;
+}
+
+/**
+ * Handles the readable socket: the datagrams are received in batches until the socket is empty
+ * (or enough batches were received for this turn), and each batch is put on the IngestQueue.
+ * The trailing line break of a message is removed, a datagram that was cut by the kernel is dropped.
+ *
+ * @param[in] error The result of the wait
+ */
+void UdpListener::onReadable(const boost::system::error_code& error){
+    if(error==boost::asio::error::operation_aborted) return;
+    try{
+        if(error) throw boost::system::system_error(error);
+        for(size_t Turn=0;Turn<UDP_BATCHES_PER_TURN;++Turn){
+            size_t Count=receiveBatch();
+            for(size_t i=0;i<Count;++i){
+                if(Headers[i].msg_hdr.msg_flags & MSG_TRUNC) continue;
+                const char* Begin=&Buffers[i*UDP_MESSAGE_SIZE];
+                Batch[i].assign(Begin,trimLength(Begin,std::min<size_t>(Headers[i].msg_len,UDP_MESSAGE_SIZE)));
+            }
+            for(size_t i=0;i<Count;++i){
+                if(Headers[i].msg_hdr.msg_flags & MSG_TRUNC){
+                    ++Truncated;
+                    continue;
+                }
+                queueMessage(std::move(Batch[i]));
+            }
+            if(Count<UDP_BATCH_SIZE) break;
+        }
+    }
+    catch(const std::exception& e){
+        OutputHandler::logException(ErrorStream,"An error occurred during receiving UDP messages: ",e);
+    }
+    wait();
+}
+
+/**
+ * @param[out] Count The number of datagrams that didn't fit into the receive buffer of the socket
+ * @return true if the kernel counts them (SO_MEMINFO)
+ */
+bool UdpListener::getKernelDropped(uint64_t& Count){
+    uint32_t MemInfo[SK_MEMINFO_VARS]={0};
+    socklen_t Size=sizeof(MemInfo);
+    if(getsockopt(Socket.native_handle(),SOL_SOCKET,SO_MEMINFO,MemInfo,&Size)==0 && Size>SK_MEMINFO_DROPS*sizeof(uint32_t)){
+        Count=MemInfo[SK_MEMINFO_DROPS];
+        return true;
+    }
+    return false;
+}
+
+#else
+
+/**
+ * Receives the next datagram asynchronously, the handler keeps the listener alive
+ */
+void UdpListener::receive(){
+    std::shared_ptr<UdpListener> self=shared_from_this();
+    Socket.async_receive_from(boost::asio::buffer(Buffers),Sender,[self](const boost::system::error_code& error,size_t length){
+        self->onReceived(error,length);
+    });
+}
+
+/**
+ * Handles a received datagram: it is put on the IngestQueue without its trailing line break.
+ * A datagram longer than UDP_MESSAGE_SIZE is dropped (it is reported by an error, or it fills the buffer).
+ *
+ * @param[in] error The result of the receiving
+ * @param[in] length The length of the datagram
+ */
+void UdpListener::onReceived(const boost::system::error_code& error,size_t length){
+    if(error==boost::asio::error::operation_aborted) return;
+    if(error==boost::asio::error::message_size || (!error && length>UDP_MESSAGE_SIZE)){
+        ++Received;
+        ++Truncated;
+    }
+    else if(error){
+        OutputHandler::logException(ErrorStream,"An error occurred during receiving UDP messages: ",boost::system::system_error(error));
+    }
+    else{
+        ++Received;
+        queueMessage(std::string(Buffers.data(),trimLength(Buffers.data(),length)));
+    }
+    receive();
+}
+
+/**
+ * @param[out] Count The number of datagrams dropped by the kernel
+ * @return false, the system doesn't report it
+ */
+bool UdpListener::getKernelDropped(uint64_t& Count){
+    Count=0;
+    return false;
+}
+
+#endif
+
+/**
+ * @return The number of messages dropped by the kernel (if it is known, see getKernelDropped()), truncated or failed to be queued
+ */
+uint64_t UdpListener::getDropped(){
+    uint64_t KernelDropped=0;
+    getKernelDropped(KernelDropped);
+    return KernelDropped+Failed+Truncated;
+}
+
+/**
+ * @return The counters of the listener in a human-readable form
+ */
+std::string UdpListener::getStatistics(){
+    std::ostringstream str;
+    uint64_t KernelDropped=0;
+    bool KernelKnown=getKernelDropped(KernelDropped);
+    str << "UDP messages received: " << getReceived() << ", queued: " << getProcessed() << ", dropped: " << getDropped()
+        << " (truncated: " << getTruncated() << ", by the kernel: ";
+    if(KernelKnown) str << KernelDropped << ")\n";
+    else str << "unavailable)\n";
+    return str.str();
+}
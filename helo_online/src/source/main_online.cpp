@@ -1,12 +1,15 @@
 #include <iostream>
 #include <thread>
-#include <codecvt>
 #include <boost/interprocess/sync/named_semaphore.hpp>
-#include <boost/asio.hpp>
 #include <pugixml.hpp>
 #include "ConfigFile.h"
 #include "ClusterParser.h"
+#include "AsyncServer.h"
+#include "UdpListener.h"
+#include "IngestQueue.h"
+#include "MetricsServer.h"
 #include "OutputHandler.h"
+#include "ModelFile.h"
 
 /**
 * @file main_online.cpp
@@ -17,86 +20,32 @@
 */
 
 using namespace boost::interprocess;
-using boost::asio::ip::tcp;
 using namespace std;
 
-/// \c typedef for \c shared_ptr on boost TCP socket
-///
-typedef std::shared_ptr<tcp::socket> socketPtr;
-
-/// \c typedef for \c shared_ptr on boost acceptor
-///
-typedef std::shared_ptr<tcp::acceptor> acceptorPtr;
-
 /// This string identifies the stop event on the operating system
 ///
 const char* SemaphoreName="STOP_HELO_ONLINE";
 
 /**
 * This is a thread function that waits for stop event,
-* and closes the application if stop event happened.
+* and stops the server if stop event happened.
 * The thread gets blocked until stop event happens.
 *
-* @param[in] acceptor The acceptor object used for listening
+* @param[in] server The server to stop
 */
-void StopHandler(acceptorPtr acceptor){
+void StopHandler(std::shared_ptr<AsyncServer> server){
     named_semaphore(open_or_create,SemaphoreName,0).wait();
-    try{
-        tcp::endpoint dest=acceptor->local_endpoint();
-        boost::asio::io_service srv;
-        tcp::socket tempSock(srv);
-        acceptor->close();
-        tempSock.connect(dest);
-        tempSock.shutdown(tcp::socket::shutdown_both);
-        tempSock.close();
-    }
-    catch(boost::system::system_error&){}
-}
-
-/**
-* This thread function implements the serving of a client connection.
-* It reads the input TCP stream while it is not closed, and processes
-* it line by line.
-*
-* @param[in] sock An object that represents the remote client socket
-* @param[in,out] parser A pointer to the ClusterParser object that can be used to process new messages
-* @param[in] settings The settings loaded from command prompt/config file
-*/
-void ServeRequest(socketPtr sock,std::shared_ptr<ClusterParser> parser,const Settings& settings){
-    try{
-        std::string msg;
-        while(true){
-            char byte;
-            boost::system::error_code error;
-            sock->read_some(boost::asio::buffer(&byte,1),error);
-            msg+=byte;
-
-            if(byte=='\n'){
-                std::wstring NewMsg=std::wstring_convert<std::codecvt_utf8<wchar_t>>().from_bytes(msg);
-                //OutputHandler::print(std::cout,NewMsg);
-                parser->ProcessMessage(NewMsg);
-                msg="";
-            }
-            if(error==boost::asio::error::eof){
-                break;
-            }
-            else if(error){
-                std::cout << "Error occurred in the server thread!\n";
-                throw boost::system::system_error(error);
-            }
-        }
-    }
-    catch(const std::exception& e){
-        OutputHandler::logException(settings.ErrorStream,"Exception in thread: ",e);
-    }
+    server->stop();
 }
 
 /**
  * <p>This is the main() function of the online program.</p>
  *
  * <p>It reads the already made clusters from a database file.
- * And then waits for incoming syslog messages on a TCP port of
- * the local computer. After a message is received it gets processed.
+ * And then waits for incoming syslog messages on a TCP port and a UDP port of
+ * the local computer. The connections are served asynchronously by a
+ * fixed number of threads (see AsyncServer). After a message is received it is put on a bounded queue,
+ * and the same number of classifier threads process the queued messages (see IngestQueue).
  * The program modifies the database while it runs, adds new messages,
  * clusters, and sometimes just refreshes a cluster. The program also
  * waits for a stopping event, if this event happens it closes the TCP
@@ -131,6 +80,33 @@ void ServeRequest(socketPtr sock,std::shared_ptr<ClusterParser> parser,const Set
  * <tr><td>regexp</td><td>The regular expression used for tokenizing the input messages. It can be given
  * in POSIX regex format, and it can be set by -re\<regexpr\> command line parameter. Defaultly white spaces
  * will be used as token separators.</td></tr>
+ * <tr><td>ModelFile</td><td>The path of a binary cluster model written by the offline algorithm (-bm option).
+ * If it is set by -mf\<path\> then the clusters are loaded from the model instead of the database, which is
+ * much faster for big models. Clusters created online after the model was written are still loaded from the
+ * database.</td></tr>
+ * <tr><td>threads</td><td>The number of threads that serve the network connections, and the number of threads that
+ * classify the received messages. It can be set by -th\<value\> command line parameter. Its default value is the
+ * number of CPU cores.</td></tr>
+ * <tr><td>udpPort</td><td>The UDP port to listen on, each datagram is a message. It can be set by -up\<value\>
+ * command line parameter, by default the UDP port is the same as the TCP port, and 0 disables the UDP input.</td></tr>
+ * <tr><td>writeBatch</td><td>The processed messages are written to the database in the background, in batches.
+ * This is the maximal number of messages written in one transaction, it can be set by -wb\<value\> (1000 by default).</td></tr>
+ * <tr><td>writeLatency</td><td>The maximal time in milliseconds a processed message waits before it is written,
+ * it can be set by -wl\<value\> (100 by default). A message is acknowledged before it is written, the queued
+ * messages are written on the regular shutdown, but they are lost if the program is killed (see DatabaseWriter).</td></tr>
+ * <tr><td>cacheSize</td><td>The number of recently seen messages whose cluster is cached, so that repeated messages are
+ * classified without searching the templates. It can be set by -cs\<value\> (65536 by default), 0 disables the cache.</td></tr>
+ * <tr><td>ingestQueueSize</td><td>The maximal number of received messages waiting to be classified, it can be set
+ * by -iq\<value\> (65536 by default).</td></tr>
+ * <tr><td>overload</td><td>What happens to a received message when the ingest queue is full, it can be set by
+ * -ov\<block|drop|spill\>. By default (block) the TCP connection isn't read until the queue drains, thus TCP senders
+ * are slowed down (UDP datagrams are dropped), drop drops the message, spill appends it to the spill file, which can be
+ * replayed later by helo_replay -sf.</td></tr>
+ * <tr><td>SpillFile</td><td>The path of the spill file, it can be set by -sf\<path\>. By default it is the path of
+ * the database with ".spill" extension.</td></tr>
+ * <tr><td>metricsPort</td><td>The port of the metrics endpoint, it can be set by -mp\<value\>. If it is set, the
+ * counters of the program are served in the Prometheus text format at http://127.0.0.1:\<port\>/metrics
+ * (see MetricsServer). By default (0) there is no endpoint.</td></tr>
  * </table>
  */
 int main(int argc,char** argv){
@@ -140,7 +116,17 @@ int main(int argc,char** argv){
                          string("  -he<value> : Sets the length of header part of log messages (4 by default)\n")+
                          string("  -lf<value> : Sets the path of the log file to use\n")+
                          string("  -mt<value> : Sets the goodness threshold for cluster merging\n")+
-                         string("  -re<value> : Sets the regular expression used for tokenization\n\n");
+                         string("  -re<value> : Sets the regular expression used for tokenization\n")+
+                         string("  -mf<value> : Sets the path of the binary cluster model to load\n")+
+                         string("  -th<value> : Sets the number of threads serving the connections (default: number of CPU cores)\n")+
+                         string("  -up<value> : Sets the UDP port where we receive the log messages (default: the TCP port, 0: off)\n")+
+                         string("  -wb<value> : Sets the maximal number of messages written to the database in one transaction (default: 1000)\n")+
+                         string("  -wl<value> : Sets the maximal delay of the database writes in milliseconds (default: 100)\n")+
+                         string("  -cs<value> : Sets the number of entries of the classification cache (default: 65536, 0: off)\n")+
+                         string("  -iq<value> : Sets the maximal number of received messages waiting to be classified (default: 65536)\n")+
+                         string("  -ov<value> : Sets the policy of a full ingest queue: block, drop or spill (default: block)\n")+
+                         string("  -sf<value> : Sets the path of the file of the spilled messages (default: <input_file>.spill)\n")+
+                         string("  -mp<value> : Sets the local port of the Prometheus metrics endpoint (default: 0, off)\n\n");
 
     Settings settings;
     settings.port=514;
@@ -169,12 +155,22 @@ int main(int argc,char** argv){
             if(strncmp(argv[i],"-he",3)==0) settings.HeaderLen=atoi(&argv[i][3]);
             if(strncmp(argv[i],"-lo",3)==0) settings.loc=string(&argv[i][3]);
             if(strncmp(argv[i],"-mt",3)==0) settings.lim=atoi(&argv[i][3]);
-
-            if(strncmp(argv[i],"-re",3)==0){
-                string tempStr(&argv[i][3]);
-                settings.regexp=wstring(tempStr.begin(),tempStr.end());
+            if(strncmp(argv[i],"-mf",3)==0) settings.ModelFile=string(&argv[i][3]);
+            if(strncmp(argv[i],"-th",3)==0) settings.threads=atoi(&argv[i][3]);
+            if(strncmp(argv[i],"-up",3)==0) settings.udpPort=atoi(&argv[i][3]);
+            if(strncmp(argv[i],"-wb",3)==0) settings.writeBatch=atoi(&argv[i][3]);
+            if(strncmp(argv[i],"-wl",3)==0) settings.writeLatency=atoi(&argv[i][3]);
+            if(strncmp(argv[i],"-cs",3)==0) settings.cacheSize=atoi(&argv[i][3]);
+            if(strncmp(argv[i],"-iq",3)==0) settings.ingestQueueSize=atoi(&argv[i][3]);
+            if(strncmp(argv[i],"-sf",3)==0) settings.SpillFile=string(&argv[i][3]);
+            if(strncmp(argv[i],"-mp",3)==0) settings.metricsPort=atoi(&argv[i][3]);
+            if(strncmp(argv[i],"-ov",3)==0 && !toOverloadPolicy(&argv[i][3],settings.overload)){
+                cerr << "The overload policy must be block, drop or spill\n";
+                return -1;
             }
 
+            if(strncmp(argv[i],"-re",3)==0) settings.regexp=string(&argv[i][3]);
+
             if(strncmp(argv[i],"-lf",3)==0){
                 LogFile.open(&argv[i][3],ios::out | ios::app);
                 LogPath=std::string(&argv[i][3]);
@@ -206,13 +202,26 @@ int main(int argc,char** argv){
         }
     }
 
-    std::cout << "Starting HELO online. Applied parameters:\n" << " Listen port: " << settings.port << std::endl;
+    if(settings.udpPort<0) settings.udpPort=settings.port;
+    std::cout << "Starting HELO online. Applied parameters:\n" << " Listen port: " << settings.port;
+    if(settings.udpPort>0) std::cout << "\n UDP listen port: " << settings.udpPort;
+    std::cout << std::endl;
     std::cout << " Cluster file path: " << settings.DbFile << "\n Log file path: " << LogPath << "\n Header length: " << settings.HeaderLen;
-    std::cout << "\n Regular expression: " << std::string(settings.regexp.begin(),settings.regexp.end()) << std::endl;
+    if(!settings.ModelFile.empty()) std::cout << "\n Cluster model path: " << settings.ModelFile;
+    if(settings.threads==0) settings.threads=std::max(1u,thread::hardware_concurrency());
+    std::cout << "\n Regular expression: " << settings.regexp << "\n Network threads: " << settings.threads << std::endl;
+    if(settings.SpillFile.empty()) settings.SpillFile=settings.DbFile+".spill";
+    const char* PolicyNames[]={"block","drop","spill"};
+    std::cout << " Ingest queue size: " << settings.ingestQueueSize << ", overload policy: " << PolicyNames[settings.overload];
+    if(settings.overload==SpillToFile) std::cout << "\n Spill file path: " << settings.SpillFile;
+    if(settings.metricsPort>0) std::cout << "\n Metrics endpoint: http://127.0.0.1:" << settings.metricsPort << "/metrics";
+    std::cout << std::endl;
 
     std::shared_ptr<ClusterParser> proc;
-    boost::asio::io_service srv;
-    acceptorPtr acceptor=std::make_shared<tcp::acceptor>(srv);
+    std::shared_ptr<IngestQueue> queue;
+    std::shared_ptr<AsyncServer> server;
+    std::shared_ptr<UdpListener> udp;
+    std::shared_ptr<MetricsServer> metrics;
 
     try{
         locale WordLocale=locale(settings.loc.c_str());
@@ -220,11 +229,16 @@ int main(int argc,char** argv){
         proc=std::make_shared<ClusterParser>(settings);
         //proc->printToConsole();
 
-        tcp::endpoint logger(tcp::v4(),settings.port);
-        acceptor->open(logger.protocol());
-        acceptor->set_option(tcp::acceptor::reuse_address(true));
-        acceptor->bind(logger);
-        acceptor->listen();
+        queue=std::make_shared<IngestQueue>(proc,settings.ingestQueueSize,settings.overload,settings.SpillFile,settings.threads,settings.ErrorStream);
+        server=std::make_shared<AsyncServer>(settings.port,queue,settings.ErrorStream);
+        if(settings.udpPort>0){
+            udp=std::make_shared<UdpListener>(std::ref(server->getService()),settings.udpPort,queue,settings.ErrorStream);
+            udp->start();
+        }
+        if(settings.metricsPort>0){
+            metrics=std::make_shared<MetricsServer>(settings.metricsPort,proc,queue,std::ref(*server),udp,settings.ErrorStream);
+            metrics->start();
+        }
     }
     catch(const SQLite::Exception& e){
         OutputHandler::logException(settings.ErrorStream,"A problem occurred during reading the database: ",e);
@@ -236,31 +250,28 @@ int main(int argc,char** argv){
         LogFile.close();
         return -1;
     }
+    catch(const ModelError& e){
+        OutputHandler::logException(settings.ErrorStream,"A problem occurred during loading the cluster model: ",e);
+        LogFile.close();
+        return -1;
+    }
     catch(runtime_error&){
         OutputHandler::print(settings.ErrorStream,std::string("The provided localization is invalid, try using the default (no parameter) instead!"));
         LogFile.close();
         return -1;
     }
 
-    std::thread(StopHandler,acceptor).detach();
-    while(true){
-        try{
-            std::shared_ptr<tcp::socket> remote=std::make_shared<tcp::socket>(srv);
-            acceptor->accept(*remote);
-            std::thread(ServeRequest,remote,proc,settings).detach();
-        }
-        catch(boost::system::system_error& e){
-
-            if(e.code().value()==10004 || e.code().value()==9){ //system error codes are different on different platforms
-                OutputHandler::print(settings.ErrorStream,std::string("Termination request, now shutting down...\n"));
-                named_semaphore::remove(SemaphoreName);
-                LogFile.close();
-                return 0;
-            }
+    std::thread(StopHandler,server).detach();
+    server->run(settings.threads);
 
-            OutputHandler::logException(settings.ErrorStream,std::string("An error occurred during socket handling.\n Now closing the program...\n"),e);
-            LogFile.close();
-            return -1;
-        }
-    }
+    OutputHandler::print(settings.ErrorStream,std::string("Termination request, now shutting down...\n"));
+    if(udp) OutputHandler::print(settings.ErrorStream,udp->getStatistics());
+    queue->stop();
+    OutputHandler::print(settings.ErrorStream,queue->getStatistics());
+    proc->getWriter().stop();
+    OutputHandler::print(settings.ErrorStream,proc->getCache().getStatistics());
+    OutputHandler::print(settings.ErrorStream,proc->getWriter().getStatistics());
+    named_semaphore::remove(SemaphoreName);
+    LogFile.close();
+    return 0;
 }
@@ -0,0 +1,62 @@
+#!/bin/bash
+# Runs the standard end-to-end benchmark of the online algorithm: starts helo_online on a temporary
+# empty database, replays synthetic messages to it by helo_replay over TCP and UDP, then stops it and
+# prints the summaries of the replays and the statistics of helo_online.
+#
+# Usage: OnlineBench.sh <helo_online> <helo_replay> [messages]
+# The port can be set by the BENCH_PORT environment variable (15514 by default, the metrics endpoint uses the next one).
+# helo_online is stopped by "helo_online stop", thus no other helo_online may run on the computer meanwhile.
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 <helo_online> <helo_replay> [messages]" >&2
+    exit 1
+fi
+
+HELO=$1
+REPLAY=$2
+MESSAGES=${3:-200000}
+PORT=${BENCH_PORT:-15514}
+
+if pgrep -x "$(basename "$HELO")" > /dev/null; then
+    echo "Another $(basename "$HELO") is running, stop it before the benchmark" >&2
+    exit 1
+fi
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+DB="$DIR/bench.db"
+"$REPLAY" init "$DB" || exit 1
+
+"$HELO" "$DB" "-p$PORT" "-up$PORT" "-mp$((PORT+1))" "-lf$DIR/helo_online.log" > "$DIR/helo_online.out" 2>&1 &
+PID=$!
+for ((i=0; i<100; i++)); do
+    (echo -n > "/dev/tcp/127.0.0.1/$PORT") 2>/dev/null && break
+    if ! kill -0 $PID 2>/dev/null; then break; fi
+    sleep 0.1
+done
+if ! kill -0 $PID 2>/dev/null || [ $i -eq 100 ]; then
+    echo "helo_online couldn't be started:" >&2
+    cat "$DIR/helo_online.out" "$DIR/helo_online.log" >&2
+    kill $PID 2>/dev/null
+    exit 1
+fi
+
+FAILED=0
+echo "== TCP, 4 connections, maximal rate"
+"$REPLAY" "$DB" "-p$PORT" -c4 "-n$MESSAGES"
+[ $? -eq 1 ] && FAILED=1
+echo
+echo "== TCP, 1 connection, 10000 messages/s"
+"$REPLAY" "$DB" "-p$PORT" -r10000 "-n$((MESSAGES/10))"
+[ $? -eq 1 ] && FAILED=1
+echo
+echo "== UDP, 1 socket, 20000 messages/s"
+"$REPLAY" "$DB" "-p$PORT" -ud -r20000 "-n$((MESSAGES/10))" -to3
+[ $? -eq 1 ] && FAILED=1
+
+"$HELO" stop > /dev/null
+wait $PID
+echo
+echo "== helo_online statistics"
+sed -e 's/^\[[^]]*\] //' "$DIR/helo_online.log"
+exit $FAILED
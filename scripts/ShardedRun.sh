@@ -0,0 +1,51 @@
+#!/bin/bash
+# Runs the offline algorithm on several shards of a log file in parallel (local processes),
+# then merges the partial template sets into one result.
+#
+# Usage: ShardedRun.sh <helo_offline> <input_file> <output_file> <shards> [options]
+# The options are passed to helo_offline, -d and -bm are used only by the merge step, --dedup and --number-table
+# only by the shards (-tc, -tr, -cp and --resume are left to the shards as well, which reject them).
+
+if [ $# -lt 4 ]; then
+    echo "Usage: $0 <helo_offline> <input_file> <output_file> <shards> [options]" >&2
+    exit 1
+fi
+
+HELO=$1
+INPUT=$2
+OUTPUT=$3
+SHARDS=$4
+shift 4
+
+SHARD_OPTS=()
+MERGE_OPTS=()
+for opt in "$@"; do
+    case "$opt" in
+        -d|-bm*) MERGE_OPTS+=("$opt") ;;
+        --dedup|--number-table|-tc*|-tr*|-cp*|--resume) SHARD_OPTS+=("$opt") ;;
+        *) SHARD_OPTS+=("$opt"); MERGE_OPTS+=("$opt") ;;
+    esac
+done
+
+PIDS=()
+PARTIALS=()
+for ((i=0; i<SHARDS; i++)); do
+    PARTIAL="$OUTPUT.shard$i"
+    PARTIALS+=("$PARTIAL")
+    "$HELO" "$INPUT" "$PARTIAL" "-sh$i/$SHARDS" "${SHARD_OPTS[@]}" > "$PARTIAL.log" 2>&1 &
+    PIDS+=($!)
+done
+
+FAILED=0
+for ((i=0; i<SHARDS; i++)); do
+    if ! wait "${PIDS[$i]}"; then
+        echo "Shard $i failed, see ${PARTIALS[$i]}.log" >&2
+        FAILED=1
+    fi
+done
+if [ $FAILED -ne 0 ]; then
+    exit 1
+fi
+
+"$HELO" --merge "$OUTPUT" "${PARTIALS[@]}" "${MERGE_OPTS[@]}" || exit 1
+rm -f "${PARTIALS[@]}" "${PARTIALS[@]/%/.log}"